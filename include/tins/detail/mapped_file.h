@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_MAPPED_FILE_H
+#define TINS_MAPPED_FILE_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <tins/macros.h>
+
+/**
+ * \cond
+ */
+
+namespace Tins {
+namespace Internals {
+
+// A read only view of a whole file. The file is memory mapped, except on 
+// Windows, where it's read into memory
+class TINS_API MappedFile {
+public:
+    enum AccessHint {
+        NORMAL_ACCESS,
+        SEQUENTIAL_ACCESS,
+        RANDOM_ACCESS
+    };
+
+    MappedFile(const std::string& file_name);
+    ~MappedFile();
+
+    const uint8_t* data() const {
+        return data_;
+    }
+
+    uint64_t size() const {
+        return size_;
+    }
+
+    // Tells the kernel how the mapping is going to be read
+    void advise(AccessHint hint) const;
+    // Asks the kernel to start reading the given range ahead of time
+    void prefetch(uint64_t offset, uint64_t size) const;
+private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const uint8_t* data_;
+    uint64_t size_;
+    #ifdef _WIN32
+        std::vector<uint8_t> buffer_;
+    #endif // _WIN32
+};
+
+} // Internals
+} // Tins
+
+/**
+ * \endcond
+ */
+
+#endif // TINS_MAPPED_FILE_H
@@ -30,9 +30,12 @@
 #ifndef TINS_PDU_HELPERS_H
 #define TINS_PDU_HELPERS_H
 
+#include <new>
 #include <tins/constants.h>
 #include <tins/config.h>
 #include <tins/pdu.h>
+#include <tins/packet_decoder.h>
+#include <tins/packet_arena.h>
 
 /**
  * \cond
@@ -50,6 +53,120 @@ PDU* pdu_from_dlt_flag(int flag, const uint8_t* buffer,
                        uint32_t size, bool rawpdu_on_no_match = true);
 #endif // TINS_HAVE_PCAP
 PDU* pdu_from_flag(PDU::PDUType type, const uint8_t* buffer, uint32_t size);
+PDU* pdu_from_link_type(PDU::PDUType type, const uint8_t* buffer, uint32_t size);
+// Maps the LINKTYPE_* values used in capture files. PDU::UNKNOWN is returned 
+// for unsupported ones
+PDU::PDUType capture_link_type_to_pdu_type(uint32_t link_type);
+// The inverse of the above. 0xffffffff is returned for unsupported types
+uint32_t pdu_type_to_capture_link_type(PDU::PDUType type);
+
+#ifdef TINS_HAVE_CXX11
+// Set on the current thread whenever pdu_from_flag keeps an inner layer as 
+// a RawPDU because its header is truncated or malformed
+bool& truncated_layer_flag();
+#endif // TINS_HAVE_CXX11
+
+// Validates the header a PDU's constructor is parsing. An invalid header
+// throws malformed_packet, unless the PDU is the one its caller constructs
+// inside a header_check::scope opened for the same buffer. In that case the
+// failure is recorded on the scope and the constructor just returns, so the
+// caller can discard the object without having to throw or to parse the
+// header twice. PDUs nested inside it, which start further into the
+// buffer, never report to that scope
+class header_check {
+public:
+    class scope {
+    public:
+        explicit scope(const uint8_t* buffer);
+        ~scope();
+
+        bool failed() const {
+            return failed_;
+        }
+    private:
+        friend class header_check;
+
+        scope(const scope&);
+        scope& operator=(const scope&);
+
+        const uint8_t* buffer_;
+        bool failed_;
+        scope* previous_;
+    };
+
+    explicit header_check(const uint8_t* buffer);
+
+    bool check(bool valid) {
+        return TINS_LIKELY(valid) || fail();
+    }
+private:
+    header_check(const header_check&);
+    header_check& operator=(const header_check&);
+
+    bool fail();
+
+    bool* failed_;
+};
+
+// Allocates the inner PDUs of the packet being decoded on this thread. If
+// PacketDecoder::decode was given an arena, it opens a scope for it and the
+// PDUs are constructed in it. Those are flagged, so PDU::~PDU knows how to 
+// release them wherever they're destroyed. Otherwise, PDUs are allocated
+// using new
+class decode_arena {
+public:
+    class scope {
+    public:
+        explicit scope(PacketArena* arena);
+        ~scope();
+    private:
+        scope(const scope&);
+        scope& operator=(const scope&);
+
+        PacketArena* previous_;
+    };
+
+    template <typename T>
+    static PDU* allocate(const uint8_t* buffer, uint32_t size) {
+        #ifdef TINS_HAVE_CXX11
+            if (PacketArena* arena = current()) {
+                void* storage = arena->allocate(sizeof(T));
+                T* output = 0;
+                try {
+                    output = new (storage) T(buffer, size);
+                }
+                catch (...) {
+                    PacketArena::deallocate(storage);
+                    throw;
+                }
+                static_cast<PDU*>(output)->arena_allocated_ = true;
+                return output;
+            }
+        #endif // TINS_HAVE_CXX11
+        return new T(buffer, size);
+    }
+
+    static void destroy(PDU* pdu) {
+        PDU::destroy(pdu);
+    }
+
+    static void build_layer_index(PDU& pdu, PacketArena* arena) {
+        pdu.build_layer_index(arena);
+    }
+private:
+    static PacketArena* current();
+};
+
+// Whether PDUs in the given layer shouldn't be decoded, because of the limit
+// set via PacketDecoder::depth_scope on the current thread
+inline bool is_past_decode_depth(PacketDecoder::Layer layer) {
+    #ifdef TINS_HAVE_CXX11
+        return layer > PacketDecoder::depth_scope::max_layer();
+    #else
+        (void)layer;
+        return false;
+    #endif // TINS_HAVE_CXX11
+}
 
 Constants::Ethernet::e pdu_flag_to_ether_type(PDU::PDUType flag);
 PDU::PDUType ether_type_to_pdu_flag(Constants::Ethernet::e flag);
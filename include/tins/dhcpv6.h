@@ -419,6 +419,19 @@ public:
      */
     static metadata extract_metadata(const uint8_t *buffer, uint32_t total_sz);
 
+    /**
+     * \brief Extracts metadata for this protocol based on the buffer provided
+     *
+     * Unlike extract_metadata, this doesn't throw if the buffer is malformed.
+     *
+     * \param buffer Pointer to a buffer
+     * \param total_sz Size of the buffer pointed by buffer
+     * \param output The object in which the metadata will be stored
+     * \return false iff the buffer doesn't contain a valid header
+     */
+    static bool try_extract_metadata(const uint8_t* buffer, uint32_t total_sz,
+                                     metadata& output);
+
     /**
      * Default constructor.
      */
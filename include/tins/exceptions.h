@@ -295,6 +295,50 @@ public:
     invalid_packet() : exception_base("Invalid packet") { }
 };
 
+/**
+ * \brief Exception thrown when a capture file can't be opened
+ */
+class file_open_error : public exception_base {
+public:
+    file_open_error(const std::string& msg)
+    : exception_base(msg) { }
+};
+
+/**
+ * \brief Exception thrown when a capture file's format is invalid
+ */
+class invalid_file_format : public exception_base {
+public:
+    invalid_file_format() : exception_base("Invalid capture file format") { }
+};
+
+/**
+ * \brief Exception thrown when writing to a capture file fails
+ */
+class file_write_error : public exception_base {
+public:
+    file_write_error(const std::string& msg)
+    : exception_base(msg) { }
+};
+
+/**
+ * \brief Exception thrown when an event loop operation fails
+ */
+class event_loop_error : public exception_base {
+public:
+    event_loop_error(const std::string& msg)
+    : exception_base(msg) { }
+};
+
+/**
+ * \brief Exception thrown when a referenced payload is requested as a
+ * payload_type.
+ */
+class payload_not_owned : public exception_base {
+public:
+    payload_not_owned() : exception_base("Payload is not owned by the PDU") { }
+};
+
 namespace Crypto {
 namespace WPA2 {
     /**
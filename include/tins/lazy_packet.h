@@ -0,0 +1,354 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_LAZY_PACKET_H
+#define TINS_LAZY_PACKET_H
+
+#include <vector>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/cxxstd.h>
+#include <tins/pdu.h>
+#include <tins/packet.h>
+#include <tins/timestamp.h>
+#include <tins/packet_decoder.h>
+#include <tins/exceptions.h>
+
+namespace Tins {
+
+class PacketArena;
+
+/**
+ * \class LazyPacket
+ * \brief Represents a sniffed packet which is decoded on demand.
+ *
+ * Unlike Packet, this class stores the captured bytes along with the
+ * type of the link layer PDU, and only builds the PDU chain the first
+ * time it's requested via LazyPacket::pdu or LazyPacket::find_pdu.
+ * Callbacks which only look at the timestamp or the raw bytes never
+ * pay for the decoding.
+ *
+ * LazyPacket::find_pdu only decodes the packet up to the layer that 
+ * contains the requested PDU type (see PacketDecoder::layer_of), so 
+ * looking for an IP PDU doesn't decode the transport layer. If a deeper
+ * layer is requested afterwards, the packet is decoded again. PDUs found
+ * before that stay valid until the packet is assigned a new one or 
+ * destroyed.
+ *
+ * The bytes are stored in a buffer owned by the packet, which is reused
+ * when a new packet is assigned to it. This means that reusing the same
+ * LazyPacket across calls to BaseSniffer::next_packet won't allocate
+ * memory unless the packets are decoded or bigger than any of the
+ * previous ones. The RawPDUs in the decoded chain reference this buffer
+ * rather than copying it (see RawPDU::zero_copy_scope), so their payload
+ * has to be read through RawPDU::payload_data unless RawPDU::own_payload
+ * is called first.
+ *
+ * \code
+ * Sniffer sniffer("eth0");
+ * sniffer.sniff_lazy_loop([&](LazyPacket& packet) {
+ *     // Only decode packets that are big enough
+ *     if (packet.size() > 1000) {
+ *         if (const TCP* tcp = packet.find_pdu<TCP>()) {
+ *             // ...
+ *         }
+ *     }
+ *     return true;
+ * });
+ * \endcode
+ */
+class TINS_API LazyPacket {
+public:
+    /**
+     * The type used to store the packet's bytes.
+     */
+    typedef std::vector<uint8_t> buffer_type;
+
+    /**
+     * \brief Default constructs a LazyPacket.
+     *
+     * The link type will be PDU::RAW and the buffer will be empty.
+     */
+    LazyPacket();
+
+    /**
+     * \brief Constructs a LazyPacket by copying the given bytes.
+     *
+     * \param link_type The type of the first PDU in the buffer.
+     * \param buffer The packet's bytes.
+     * \param size The size of the buffer.
+     * \param timestamp The packet's timestamp.
+     */
+    LazyPacket(PDU::PDUType link_type, const uint8_t* buffer, uint32_t size,
+               const Timestamp& timestamp);
+
+    /**
+     * \brief Copy constructor.
+     *
+     * Only the bytes are copied. The copy will decode them again if needed.
+     */
+    LazyPacket(const LazyPacket& rhs);
+
+    /**
+     * \brief Copy assignment operator.
+     *
+     * Only the bytes are copied. The copy will decode them again if needed.
+     */
+    LazyPacket& operator=(const LazyPacket& rhs);
+
+    #if TINS_IS_CXX11
+        /**
+         * \brief Move constructor.
+         */
+        LazyPacket(LazyPacket&& rhs) TINS_NOEXCEPT;
+
+        /**
+         * \brief Move assignment operator.
+         */
+        LazyPacket& operator=(LazyPacket&& rhs) TINS_NOEXCEPT;
+    #endif // TINS_IS_CXX11
+
+    /**
+     * \brief Destructor.
+     *
+     * Deletes the decoded PDU chain, if any.
+     */
+    ~LazyPacket();
+
+    /**
+     * \brief Replaces this packet's contents.
+     *
+     * Any decoded PDU chain is deleted. The internal buffer's storage is
+     * reused if it is large enough.
+     *
+     * \param link_type The type of the first PDU in the buffer.
+     * \param buffer The packet's bytes.
+     * \param size The size of the buffer.
+     * \param timestamp The packet's timestamp.
+     */
+    void assign(PDU::PDUType link_type, const uint8_t* buffer, uint32_t size,
+                const Timestamp& timestamp);
+
+    /**
+     * \brief Getter for the packet's bytes.
+     */
+    const buffer_type& buffer() const {
+        return buffer_;
+    }
+
+    /**
+     * \brief Getter for a pointer to the packet's bytes.
+     */
+    const uint8_t* data() const {
+        return buffer_.empty() ? 0 : &buffer_[0];
+    }
+
+    /**
+     * \brief Getter for the size of the packet's bytes.
+     */
+    uint32_t size() const {
+        return static_cast<uint32_t>(buffer_.size());
+    }
+
+    /**
+     * \brief Getter for the type of the first PDU in the buffer.
+     */
+    PDU::PDUType link_type() const {
+        return link_type_;
+    }
+
+    /**
+     * \brief Getter for the packet's timestamp.
+     */
+    const Timestamp& timestamp() const {
+        return ts_;
+    }
+
+    /**
+     * \brief Indicates whether the bytes have already been decoded, 
+     * even if only partially.
+     */
+    bool is_decoded() const {
+        return decoded_;
+    }
+
+    /**
+     * \brief Getter for the last layer that will be decoded.
+     */
+    PacketDecoder::Layer max_decode_layer() const {
+        return max_decode_layer_;
+    }
+
+    /**
+     * \brief Sets the last layer that will be decoded.
+     *
+     * Anything past this layer is kept as a single RawPDU. If the packet
+     * was already decoded using a different layer, the decoded chain is
+     * deleted, so it will be decoded again when it's requested. Sniffers
+     * set this when they fill a LazyPacket.
+     *
+     * If libtins was built without C++11 support, this has no effect.
+     *
+     * \param layer The last layer to be decoded.
+     * \sa PacketDecoder::depth_scope
+     */
+    void set_max_decode_layer(PacketDecoder::Layer layer);
+
+    /**
+     * \brief Sets the arena this packet's PDUs are decoded into.
+     *
+     * Sniffers set this on the packet they pass to the functor in their
+     * lazy loops. The arena isn't kept by copies of this packet, nor by
+     * packets it's moved into, so only this object has to be destroyed 
+     * or given a null arena before the arena is destroyed.
+     *
+     * If libtins was built without C++11 support, this has no effect.
+     *
+     * \param arena The arena to use, or a null pointer to allocate the
+     * PDUs using new.
+     * \sa PacketDecoder::decode(PDU::PDUType, const uint8_t*, uint32_t, PacketArena*)
+     */
+    void set_arena(PacketArena* arena) {
+        arena_ = arena;
+    }
+
+    /**
+     * \brief Returns the decoded PDU chain, decoding it if necessary.
+     *
+     * The returned PDU is owned by this packet. If the packet is malformed
+     * or the link type is unknown, a null pointer is returned.
+     */
+    PDU* pdu();
+
+    /**
+     * \brief Returns the decoded PDU chain, decoding it if necessary.
+     *
+     * The returned PDU is owned by this packet. If the packet is malformed
+     * or the link type is unknown, a null pointer is returned.
+     */
+    const PDU* pdu() const;
+
+    /**
+     * \brief Releases ownership of the decoded PDU chain.
+     *
+     * The bytes are kept, so calling LazyPacket::pdu afterwards will
+     * decode them again. Any RawPDU in the chain copies its payload 
+     * before it's returned.
+     *
+     * \return The decoded PDU chain, or a null pointer if it could not
+     * be decoded.
+     */
+    PDU* release_pdu();
+
+    /**
+     * \brief Finds a PDU of the given type in the decoded chain.
+     *
+     * This will decode the packet up to the layer that contains T if it
+     * hasn't been decoded that deep yet.
+     *
+     * \return A pointer to the PDU, or a null pointer if it's not found.
+     */
+    template<typename T>
+    T* find_pdu() {
+        PDU* chain = decode(PacketDecoder::layer_of(T::pdu_flag));
+        return chain ? chain->find_pdu<T>() : 0;
+    }
+
+    /**
+     * \brief Finds a PDU of the given type in the decoded chain.
+     *
+     * This will decode the packet up to the layer that contains T if it
+     * hasn't been decoded that deep yet.
+     *
+     * \return A pointer to the PDU, or a null pointer if it's not found.
+     */
+    template<typename T>
+    const T* find_pdu() const {
+        const PDU* chain = decode(PacketDecoder::layer_of(T::pdu_flag));
+        return chain ? chain->find_pdu<T>() : 0;
+    }
+
+    /**
+     * \brief Finds a PDU of the given type in the decoded chain.
+     *
+     * This will decode the packet up to the layer that contains T if it
+     * hasn't been decoded that deep yet. If the PDU is not found, a 
+     * pdu_not_found exception is thrown.
+     */
+    template<typename T>
+    T& rfind_pdu() {
+        T* output = find_pdu<T>();
+        if (!output) {
+            throw pdu_not_found();
+        }
+        return *output;
+    }
+
+    /**
+     * \brief Finds a PDU of the given type in the decoded chain.
+     *
+     * This will decode the packet up to the layer that contains T if it
+     * hasn't been decoded that deep yet. If the PDU is not found, a 
+     * pdu_not_found exception is thrown.
+     */
+    template<typename T>
+    const T& rfind_pdu() const {
+        const T* output = find_pdu<T>();
+        if (!output) {
+            throw pdu_not_found();
+        }
+        return *output;
+    }
+
+    /**
+     * \brief Decodes this packet into a Packet.
+     *
+     * The returned Packet owns a copy of the decoded chain. If the packet
+     * could not be decoded, it will contain a null PDU.
+     */
+    Packet to_packet() const;
+private:
+    PDU* decode(PacketDecoder::Layer layer = PacketDecoder::ALL_LAYERS) const;
+    void clear_pdu();
+
+    buffer_type buffer_;
+    Timestamp ts_;
+    PDU::PDUType link_type_;
+    PacketDecoder::Layer max_decode_layer_;
+    PacketArena* arena_;
+    mutable PDU* pdu_;
+    // Chains decoded less deeply than the current one
+    mutable std::vector<PDU*> previous_pdus_;
+    mutable PacketDecoder::Layer decoded_layer_;
+    mutable bool decoded_;
+};
+
+} // Tins
+
+#endif // TINS_LAZY_PACKET_H
@@ -113,6 +113,47 @@ public:
         return TINS_LIKELY(size_ >= byte_count);
     }
 
+    // The try_ variants return false rather than throwing if there's not
+    // enough data left, in which case the stream is left untouched
+    template <typename T>
+    bool try_read(T& value) {
+        if (!can_read(sizeof(value))) {
+            return false;
+        }
+        read_value(buffer_, value);
+        buffer_ += sizeof(value);
+        size_ -= sizeof(value);
+        return true;
+    }
+
+    template <typename T>
+    bool try_read_be(T& value) {
+        if (!try_read(value)) {
+            return false;
+        }
+        value = Endian::be_to_host(value);
+        return true;
+    }
+
+    bool try_read(void* output_buffer, size_t output_buffer_size) {
+        if (!can_read(output_buffer_size)) {
+            return false;
+        }
+        read_data(buffer_, (uint8_t*)output_buffer, output_buffer_size);
+        buffer_ += output_buffer_size;
+        size_ -= output_buffer_size;
+        return true;
+    }
+
+    bool try_skip(size_t size) {
+        if (!can_read(size)) {
+            return false;
+        }
+        buffer_ += size;
+        size_ -= size;
+        return true;
+    }
+
     void read(void* output_buffer, size_t output_buffer_size) {
         if (!can_read(output_buffer_size)) {
             throw malformed_packet();
@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_PACKET_ARENA_H
+#define TINS_PACKET_ARENA_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_CXX11
+
+#include <vector>
+#include <stdint.h>
+#include <tins/macros.h>
+
+namespace Tins {
+
+/**
+ * \class PacketArena
+ * \brief Bump allocator used to construct decoded PDUs.
+ *
+ * An arena can be given to PacketDecoder::decode, which then constructs
+ * the inner layers of the decoded chain, as well as its layer index, in 
+ * the arena's chunks rather than on the heap. Destroying the chain gives 
+ * the storage back to its chunk, and once a chunk has no live objects 
+ * left, it is rewound and reused. This means that a capture loop that 
+ * decodes a packet, processes it and then destroys it only performs one 
+ * heap allocation per packet, for the outermost PDU, once the arena is 
+ * warm.
+ *
+ * \code
+ * PacketArena arena;
+ * PDU* pdu = 0;
+ * PacketDecoder::decode(PDU::ETHERNET_II, buffer, size, pdu, &arena);
+ * // pdu is heap allocated, but its inner PDUs are taken from the arena
+ * delete pdu;
+ * \endcode
+ *
+ * Every PDU records whether it was taken from an arena, so a decoded 
+ * chain is used and destroyed just like any other one. Decoded PDUs may
+ * outlive the arena and may be destroyed on any thread: a chunk is only
+ * released when its last object is destroyed. PDUs which are created 
+ * in any other way, such as copies made using PDU::clone or those 
+ * returned by PDU::release_inner_pdu, are always heap allocated.
+ *
+ * Note that only the PDU objects are allocated from the arena. Storage 
+ * owned by them, such as payloads and options, is still allocated 
+ * using their containers' allocators. An arena must only be used to 
+ * decode packets on one thread at a time.
+ *
+ * \sa BaseSniffer::set_arena_allocation
+ */
+class TINS_API PacketArena {
+public:
+    /**
+     * The default size of each chunk.
+     */
+    static const size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+    /**
+     * \brief Constructs an arena.
+     *
+     * No memory is allocated until the first allocation is performed.
+     *
+     * \param chunk_size The size of each of this arena's chunks. 
+     * Allocations that don't fit in a chunk are served by the heap.
+     */
+    PacketArena(size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+    /**
+     * \brief Destructor.
+     *
+     * Chunks that still contain live objects are released when the last
+     * of those objects is deallocated.
+     */
+    ~PacketArena();
+
+    /**
+     * \brief Allocates storage from this arena.
+     *
+     * The returned pointer has to be released using 
+     * PacketArena::deallocate.
+     *
+     * \param size The amount of bytes to allocate.
+     */
+    void* allocate(size_t size);
+
+    /**
+     * \brief Releases storage allocated by PacketArena::allocate.
+     *
+     * This can be called from any thread, even after the arena that
+     * allocated the storage has been destroyed.
+     *
+     * \param ptr The pointer to release. Might be a null pointer.
+     */
+    static void deallocate(void* ptr);
+
+    /**
+     * \brief Getter for the size of this arena's chunks.
+     */
+    size_t chunk_size() const {
+        return chunk_size_;
+    }
+
+    /**
+     * \brief Getter for the amount of chunks allocated by this arena.
+     */
+    size_t chunk_count() const {
+        return chunks_.size();
+    }
+
+    /**
+     * \brief Indicates whether the given pointer was allocated by 
+     * this arena.
+     */
+    bool owns(const void* ptr) const;
+private:
+    struct chunk;
+
+    PacketArena(const PacketArena&);
+    PacketArena& operator=(const PacketArena&);
+
+    chunk* find_chunk();
+
+    std::vector<chunk*> chunks_;
+    chunk* current_chunk_;
+    size_t chunk_size_;
+};
+
+} // Tins
+
+#endif // TINS_HAVE_CXX11
+
+#endif // TINS_PACKET_ARENA_H
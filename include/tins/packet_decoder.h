@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_PACKET_DECODER_H
+#define TINS_PACKET_DECODER_H
+
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/pdu.h>
+
+namespace Tins {
+
+class PacketArena;
+
+/**
+ * \class PacketDecoder
+ * \brief Decodes packets without throwing if they are malformed.
+ *
+ * Constructing a PDU from a buffer throws malformed_packet if the buffer 
+ * is invalid. When processing untrusted traffic or truncated captures,
+ * throwing and unwinding for every broken packet can get expensive. This
+ * class validates headers before constructing them, so the common cases
+ * of truncated or invalid headers don't involve any exception:
+ *
+ * - If the link layer header is invalid, the packet is reported as
+ *   malformed and nothing is allocated.
+ * - If an inner header is truncated or invalid, that layer and everything
+ *   after it is kept as a RawPDU and the packet is reported as truncated.
+ *
+ * Errors that can only be found while parsing a header's contents (e.g.
+ * options) still make the constructors throw. Those exceptions are caught
+ * here and reported as a malformed packet.
+ *
+ * \code
+ * PDU* pdu = 0;
+ * PacketDecoder::Status status = PacketDecoder::decode(PDU::ETHERNET_II, 
+ *                                                      buffer, size, pdu);
+ * if (status == PacketDecoder::DECODED || status == PacketDecoder::TRUNCATED) {
+ *     // use and delete pdu
+ * }
+ * \endcode
+ *
+ * Decoding can also be limited to the outer layers of a packet by using
+ * a PacketDecoder::depth_scope. Anything past the given layer is kept as a
+ * single RawPDU, which saves parsing and allocating PDUs that won't be
+ * looked at.
+ *
+ * This is what sniffers use to decode packets.
+ */
+class TINS_API PacketDecoder {
+public:
+    /**
+     * \brief The result of decoding a packet.
+     */
+    enum Status {
+        DECODED,
+        TRUNCATED,
+        MALFORMED,
+        UNSUPPORTED
+    };
+
+    /**
+     * \brief The layers at which decoding can be stopped.
+     *
+     * Link layer PDUs are the ones that encapsulate others at the frame 
+     * level (e.g. EthernetII, Dot1Q, MPLS, SNAP). Network layer PDUs are
+     * the ones carried by them (e.g. IP, IPv6, ARP, EAPOL), while transport
+     * layer PDUs are the ones carried by IP and IPv6 (e.g. TCP, UDP, ICMP).
+     */
+    enum Layer {
+        LINK_LAYER,
+        NETWORK_LAYER,
+        TRANSPORT_LAYER,
+        ALL_LAYERS
+    };
+
+    #ifdef TINS_HAVE_CXX11
+        /**
+         * \brief Limits how deep packets are decoded on the current thread.
+         *
+         * While an instance of this class is alive, PDUs constructed from a
+         * buffer on the current thread won't decode any layer past the given
+         * one. That layer's payload is kept as a RawPDU instead. The first
+         * PDU in a buffer is always decoded. The previous limit is restored
+         * when this object is destroyed.
+         *
+         * \code
+         * PacketDecoder::depth_scope depth(PacketDecoder::NETWORK_LAYER);
+         * // The IP PDU will contain a RawPDU rather than a TCP one
+         * EthernetII eth(buffer, size);
+         * \endcode
+         */
+        class TINS_API depth_scope {
+        public:
+            /**
+             * \brief Sets the last layer to be decoded on this thread.
+             *
+             * \param max_layer The last layer to be decoded.
+             */
+            explicit depth_scope(Layer max_layer);
+
+            /**
+             * \brief Restores the previous limit.
+             */
+            ~depth_scope();
+
+            /**
+             * \brief Returns the last layer decoded on the current thread.
+             */
+            static Layer max_layer();
+        private:
+            depth_scope(const depth_scope&);
+            depth_scope& operator=(const depth_scope&);
+
+            Layer previous_;
+        };
+    #endif // TINS_HAVE_CXX11
+
+    /**
+     * \brief Decodes a packet.
+     *
+     * The TRUNCATED status is only reported if libtins was built with
+     * C++11 support. Otherwise, DECODED is returned in that case.
+     *
+     * The decoded chain's layers are indexed, so looking them up using
+     * PDU::find_pdu on the returned PDU doesn't walk the chain.
+     * \sa PDU::build_layer_index
+     *
+     * \param link_type The type of the first PDU in the buffer. Using
+     * PDU::IP will detect both IPv4 and IPv6.
+     * \param buffer The buffer to decode.
+     * \param size The size of the buffer.
+     * \param output The decoded PDU, which is owned by the caller. If 
+     * the status is MALFORMED or UNSUPPORTED, this is a null pointer.
+     * \return The result of decoding the packet.
+     */
+    static Status decode(PDU::PDUType link_type, const uint8_t* buffer, uint32_t size,
+                         PDU*& output);
+
+    /**
+     * \brief Decodes a packet.
+     *
+     * \param link_type The type of the first PDU in the buffer.
+     * \param buffer The buffer to decode.
+     * \param size The size of the buffer.
+     * \return The decoded PDU, which is owned by the caller, or a null 
+     * pointer if it can't be decoded.
+     * \sa PacketDecoder::decode(PDU::PDUType, const uint8_t*, uint32_t, PDU*&)
+     */
+    static PDU* decode(PDU::PDUType link_type, const uint8_t* buffer, uint32_t size);
+
+    /**
+     * \brief Decodes a packet using an arena.
+     *
+     * This behaves just like the overload that doesn't take an arena, 
+     * except that the decoded chain's inner PDUs and its layer index are
+     * constructed in the given arena. The returned PDU itself is still
+     * allocated using new, so it's used and destroyed like any other one.
+     *
+     * If libtins was built without C++11 support, the arena is ignored.
+     *
+     * \param link_type The type of the first PDU in the buffer.
+     * \param buffer The buffer to decode.
+     * \param size The size of the buffer.
+     * \param output The decoded PDU, which is owned by the caller.
+     * \param arena The arena to allocate the PDUs from. If this is a null
+     * pointer, they're allocated using new.
+     * \return The result of decoding the packet.
+     * \sa PacketArena
+     */
+    static Status decode(PDU::PDUType link_type, const uint8_t* buffer, uint32_t size,
+                         PDU*& output, PacketArena* arena);
+
+    /**
+     * \brief Decodes a packet using an arena.
+     *
+     * \param link_type The type of the first PDU in the buffer.
+     * \param buffer The buffer to decode.
+     * \param size The size of the buffer.
+     * \param arena The arena to allocate the PDUs from, if any.
+     * \return The decoded PDU, which is owned by the caller, or a null 
+     * pointer if it can't be decoded.
+     * \sa PacketDecoder::decode(PDU::PDUType, const uint8_t*, uint32_t, PDU*&, PacketArena*)
+     */
+    static PDU* decode(PDU::PDUType link_type, const uint8_t* buffer, uint32_t size,
+                       PacketArena* arena);
+
+    /**
+     * \brief Returns the layer in which PDUs of the given type are decoded.
+     *
+     * Types which are never carried past the transport layer's payload 
+     * (e.g. DNS, DHCP or RawPDU), as well as unknown and user defined 
+     * ones, are mapped to PacketDecoder::ALL_LAYERS.
+     *
+     * \param type The PDU type.
+     */
+    static Layer layer_of(PDU::PDUType type);
+};
+
+} // Tins
+
+#endif // TINS_PACKET_DECODER_H
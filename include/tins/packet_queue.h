@@ -0,0 +1,336 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_PACKET_QUEUE_H
+#define TINS_PACKET_QUEUE_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_CXX11
+
+#include <vector>
+#include <atomic>
+#include <utility>
+#include <stddef.h>
+
+namespace Tins {
+namespace Internals {
+
+// Size of the padding used to keep atomics on their own cache lines
+const size_t CACHE_LINE_SIZE = 64;
+
+inline size_t queue_capacity(size_t capacity) {
+    size_t output = 2;
+    while (output < capacity) {
+        output <<= 1;
+    }
+    return output;
+}
+
+} // Internals
+
+/**
+ * \class SPSCQueue
+ * \brief Bounded lock free queue for a single producer and a single
+ * consumer.
+ *
+ * Values are moved in and out of the queue, so queues of Packet or 
+ * LazyPacket hand over the packet's contents (e.g. the owned PDU) without
+ * copying them. Slots are preallocated, so pushing and popping never
+ * allocate memory.
+ *
+ * SPSCQueue::try_push must only be called from one thread and 
+ * SPSCQueue::try_pop from another one.
+ *
+ * \code
+ * SPSCQueue<Packet> queue(1024);
+ * // On the capture thread
+ * Packet packet = sniffer.next_packet();
+ * if (!queue.try_push(std::move(packet))) {
+ *     // The queue is full
+ * }
+ * // On the worker thread
+ * Packet output;
+ * if (queue.try_pop(output)) {
+ *     // Process output
+ * }
+ * \endcode
+ *
+ * \tparam T The type of the values stored. It has to be default 
+ * constructible and move assignable.
+ */
+template <typename T>
+class SPSCQueue {
+public:
+    /**
+     * The type of the values stored.
+     */
+    typedef T value_type;
+
+    /**
+     * \brief Constructs a queue.
+     *
+     * \param capacity The minimum capacity of the queue. This is rounded
+     * up to a power of 2.
+     */
+    explicit SPSCQueue(size_t capacity)
+    : slots_(Internals::queue_capacity(capacity)), mask_(slots_.size() - 1),
+      head_(0), cached_tail_(0), tail_(0), cached_head_(0) {
+
+    }
+
+    /**
+     * \brief Pushes a value, if there's room for it.
+     *
+     * \param value The value to push. It's only moved from if this 
+     * returns true.
+     * \return false if the queue is full.
+     */
+    bool try_push(T&& value) {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cached_head_ == slots_.size()) {
+            cached_head_ = head_.load(std::memory_order_acquire);
+            if (tail - cached_head_ == slots_.size()) {
+                return false;
+            }
+        }
+        slots_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * \brief Pops a value, if there's any.
+     *
+     * \param output The value in which to move the popped value.
+     * \return false if the queue is empty.
+     */
+    bool try_pop(T& output) {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cached_tail_) {
+            cached_tail_ = tail_.load(std::memory_order_acquire);
+            if (head == cached_tail_) {
+                return false;
+            }
+        }
+        output = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * \brief Gets the amount of values the queue can hold.
+     */
+    size_t capacity() const {
+        return slots_.size();
+    }
+
+    /**
+     * \brief Gets the amount of values in the queue.
+     *
+     * If called while other threads use the queue, this is only an 
+     * estimate.
+     */
+    size_t size() const {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * \brief Indicates whether the queue is empty.
+     *
+     * If called while other threads use the queue, this is only an 
+     * estimate.
+     */
+    bool empty() const {
+        return size() == 0;
+    }
+private:
+    SPSCQueue(const SPSCQueue&);
+    SPSCQueue& operator=(const SPSCQueue&);
+
+    std::vector<T> slots_;
+    const size_t mask_;
+    char padding0_[Internals::CACHE_LINE_SIZE];
+    // Written by the consumer
+    std::atomic<size_t> head_;
+    size_t cached_tail_;
+    char padding1_[Internals::CACHE_LINE_SIZE];
+    // Written by the producer
+    std::atomic<size_t> tail_;
+    size_t cached_head_;
+    char padding2_[Internals::CACHE_LINE_SIZE];
+};
+
+/**
+ * \class MPMCQueue
+ * \brief Bounded lock free queue for multiple producers and consumers.
+ *
+ * This behaves like SPSCQueue, except that any amount of threads can 
+ * push and pop values concurrently. Each slot carries a sequence number
+ * which producers and consumers use to claim it, so threads only contend
+ * on the queue's head and tail counters.
+ *
+ * \tparam T The type of the values stored. It has to be default 
+ * constructible and move assignable.
+ */
+template <typename T>
+class MPMCQueue {
+public:
+    /**
+     * The type of the values stored.
+     */
+    typedef T value_type;
+
+    /**
+     * \brief Constructs a queue.
+     *
+     * \param capacity The minimum capacity of the queue. This is rounded
+     * up to a power of 2.
+     */
+    explicit MPMCQueue(size_t capacity)
+    : slots_(Internals::queue_capacity(capacity)), mask_(slots_.size() - 1),
+      tail_(0), head_(0) {
+        for (size_t i = 0; i < slots_.size(); ++i) {
+            slots_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * \brief Pushes a value, if there's room for it.
+     *
+     * \param value The value to push. It's only moved from if this 
+     * returns true.
+     * \return false if the queue is full.
+     */
+    bool try_push(T&& value) {
+        size_t position = tail_.load(std::memory_order_relaxed);
+        while (true) {
+            slot& current = slots_[position & mask_];
+            const size_t sequence = current.sequence.load(std::memory_order_acquire);
+            const ptrdiff_t difference = static_cast<ptrdiff_t>(sequence - position);
+            if (difference == 0) {
+                if (tail_.compare_exchange_weak(position, position + 1,
+                                                std::memory_order_relaxed)) {
+                    current.value = std::move(value);
+                    current.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0) {
+                // The consumer hasn't released this slot yet
+                return false;
+            }
+            else {
+                position = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * \brief Pops a value, if there's any.
+     *
+     * \param output The value in which to move the popped value.
+     * \return false if the queue is empty.
+     */
+    bool try_pop(T& output) {
+        size_t position = head_.load(std::memory_order_relaxed);
+        while (true) {
+            slot& current = slots_[position & mask_];
+            const size_t sequence = current.sequence.load(std::memory_order_acquire);
+            const ptrdiff_t difference = static_cast<ptrdiff_t>(sequence - (position + 1));
+            if (difference == 0) {
+                if (head_.compare_exchange_weak(position, position + 1,
+                                                std::memory_order_relaxed)) {
+                    output = std::move(current.value);
+                    current.sequence.store(position + slots_.size(),
+                                           std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0) {
+                // The producer hasn't filled this slot yet
+                return false;
+            }
+            else {
+                position = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /**
+     * \brief Gets the amount of values the queue can hold.
+     */
+    size_t capacity() const {
+        return slots_.size();
+    }
+
+    /**
+     * \brief Gets the amount of values in the queue.
+     *
+     * If called while other threads use the queue, this is only an 
+     * estimate.
+     */
+    size_t size() const {
+        const size_t tail = tail_.load(std::memory_order_acquire);
+        const size_t head = head_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    /**
+     * \brief Indicates whether the queue is empty.
+     *
+     * If called while other threads use the queue, this is only an 
+     * estimate.
+     */
+    bool empty() const {
+        return size() == 0;
+    }
+private:
+    struct slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    MPMCQueue(const MPMCQueue&);
+    MPMCQueue& operator=(const MPMCQueue&);
+
+    std::vector<slot> slots_;
+    const size_t mask_;
+    char padding0_[Internals::CACHE_LINE_SIZE];
+    std::atomic<size_t> tail_;
+    char padding1_[Internals::CACHE_LINE_SIZE];
+    std::atomic<size_t> head_;
+    char padding2_[Internals::CACHE_LINE_SIZE];
+};
+
+} // Tins
+
+#endif // TINS_HAVE_CXX11
+
+#endif // TINS_PACKET_QUEUE_H
@@ -0,0 +1,427 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_PACKET_VIEW_H
+#define TINS_PACKET_VIEW_H
+
+#include <cstring>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/pdu.h>
+#include <tins/endianness.h>
+#include <tins/ip_address.h>
+#include <tins/ipv6_address.h>
+#include <tins/hw_address.h>
+
+namespace Tins {
+
+/**
+ * \class PacketView
+ * \brief Dissects a buffer without constructing any PDU.
+ *
+ * This class walks a buffer using the PDUs' extract_metadata functions
+ * and records the type, offset and header size of each layer it finds.
+ * The headers of the most common protocols can then be read through
+ * lightweight, read only views which decode fields straight from the
+ * buffer:
+ *
+ * \code
+ * PacketView view(PDU::ETHERNET_II, buffer, size);
+ * if (view.has_layer(PDU::TCP) && view.tcp().dport() == 443) {
+ *     IPv4Address source = view.ip().src_addr();
+ *     // ...
+ * }
+ * \endcode
+ *
+ * A PacketView doesn't own the buffer, which has to outlive it, and never
+ * allocates memory. The walk stops at the first layer that doesn't provide
+ * metadata (e.g. application layer protocols or fragmented payloads) or
+ * when a header doesn't fit in the buffer, in which case the view is
+ * marked as malformed. The bytes that follow the last recorded header
+ * are accessible through PacketView::payload.
+ *
+ * The supported layers are Ethernet II, IEEE 802.3, 802.1Q, IPv4, IPv6,
+ * ARP, ICMP, TCP and UDP.
+ */
+class TINS_API PacketView {
+public:
+    /**
+     * The maximum amount of layers a view will record.
+     */
+    static const size_t MAX_LAYERS = 8;
+
+    /**
+     * \brief Represents a layer found in the buffer.
+     */
+    struct layer {
+        /**
+         * The type of this layer.
+         */
+        PDU::PDUType type;
+
+        /**
+         * The offset of this layer's header within the buffer.
+         */
+        uint32_t offset;
+
+        /**
+         * The size of this layer's header.
+         */
+        uint32_t header_size;
+    };
+
+    /**
+     * \brief Read only view over an Ethernet II header.
+     */
+    class ethernet_header {
+    public:
+        typedef HWAddress<6> address_type;
+
+        ethernet_header(const uint8_t* data) : data_(data) { }
+
+        address_type dst_addr() const { return address_type(data_); }
+        address_type src_addr() const { return address_type(data_ + 6); }
+        uint16_t payload_type() const { return read_be<uint16_t>(data_ + 12); }
+    private:
+        const uint8_t* data_;
+    };
+
+    /**
+     * \brief Read only view over an 802.1Q header.
+     */
+    class dot1q_header {
+    public:
+        dot1q_header(const uint8_t* data) : data_(data) { }
+
+        uint8_t priority() const { return data_[0] >> 5; }
+        uint8_t cfi() const { return (data_[0] >> 4) & 1; }
+        uint16_t id() const { return read_be<uint16_t>(data_) & 0xfff; }
+        uint16_t payload_type() const { return read_be<uint16_t>(data_ + 2); }
+    private:
+        const uint8_t* data_;
+    };
+
+    /**
+     * \brief Read only view over an IPv4 header.
+     */
+    class ip_header {
+    public:
+        typedef IPv4Address address_type;
+
+        ip_header(const uint8_t* data) : data_(data) { }
+
+        uint8_t head_len() const { return data_[0] & 0xf; }
+        uint8_t tos() const { return data_[1]; }
+        uint16_t tot_len() const { return read_be<uint16_t>(data_ + 2); }
+        uint16_t id() const { return read_be<uint16_t>(data_ + 4); }
+        uint16_t fragment_offset() const { return read_be<uint16_t>(data_ + 6) & 0x1fff; }
+        uint8_t flags() const { return read_be<uint16_t>(data_ + 6) >> 13; }
+        uint8_t ttl() const { return data_[8]; }
+        uint8_t protocol() const { return data_[9]; }
+        uint16_t checksum() const { return read_be<uint16_t>(data_ + 10); }
+        address_type src_addr() const { return address_type(read<uint32_t>(data_ + 12)); }
+        address_type dst_addr() const { return address_type(read<uint32_t>(data_ + 16)); }
+    private:
+        const uint8_t* data_;
+    };
+
+    /**
+     * \brief Read only view over an IPv6 header.
+     */
+    class ipv6_header {
+    public:
+        typedef IPv6Address address_type;
+
+        ipv6_header(const uint8_t* data) : data_(data) { }
+
+        uint8_t traffic_class() const { return (read_be<uint16_t>(data_) >> 4) & 0xff; }
+        uint32_t flow_label() const { return read_be<uint32_t>(data_) & 0xfffff; }
+        uint16_t payload_length() const { return read_be<uint16_t>(data_ + 4); }
+        uint8_t next_header() const { return data_[6]; }
+        uint8_t hop_limit() const { return data_[7]; }
+        address_type src_addr() const { return address_type(data_ + 8); }
+        address_type dst_addr() const { return address_type(data_ + 24); }
+    private:
+        const uint8_t* data_;
+    };
+
+    /**
+     * \brief Read only view over an ARP header.
+     */
+    class arp_header {
+    public:
+        typedef IPv4Address ipaddress_type;
+        typedef HWAddress<6> hwaddress_type;
+
+        arp_header(const uint8_t* data) : data_(data) { }
+
+        uint16_t hw_addr_format() const { return read_be<uint16_t>(data_); }
+        uint16_t prot_addr_format() const { return read_be<uint16_t>(data_ + 2); }
+        uint16_t opcode() const { return read_be<uint16_t>(data_ + 6); }
+        hwaddress_type sender_hw_addr() const { return hwaddress_type(data_ + 8); }
+        ipaddress_type sender_ip_addr() const { return ipaddress_type(read<uint32_t>(data_ + 14)); }
+        hwaddress_type target_hw_addr() const { return hwaddress_type(data_ + 18); }
+        ipaddress_type target_ip_addr() const { return ipaddress_type(read<uint32_t>(data_ + 24)); }
+    private:
+        const uint8_t* data_;
+    };
+
+    /**
+     * \brief Read only view over an ICMP header.
+     */
+    class icmp_header {
+    public:
+        icmp_header(const uint8_t* data) : data_(data) { }
+
+        uint8_t type() const { return data_[0]; }
+        uint8_t code() const { return data_[1]; }
+        uint16_t checksum() const { return read_be<uint16_t>(data_ + 2); }
+        uint16_t id() const { return read_be<uint16_t>(data_ + 4); }
+        uint16_t sequence() const { return read_be<uint16_t>(data_ + 6); }
+    private:
+        const uint8_t* data_;
+    };
+
+    /**
+     * \brief Read only view over a TCP header.
+     */
+    class tcp_header {
+    public:
+        tcp_header(const uint8_t* data) : data_(data) { }
+
+        uint16_t sport() const { return read_be<uint16_t>(data_); }
+        uint16_t dport() const { return read_be<uint16_t>(data_ + 2); }
+        uint32_t seq() const { return read_be<uint32_t>(data_ + 4); }
+        uint32_t ack_seq() const { return read_be<uint32_t>(data_ + 8); }
+        uint8_t data_offset() const { return data_[12] >> 4; }
+
+        /**
+         * \brief Getter for the flags byte.
+         *
+         * The values in TCP::Flags can be used to inspect it.
+         */
+        uint8_t flags() const { return data_[13]; }
+
+        /**
+         * \brief Indicates whether every flag in the given mask is set.
+         *
+         * \param check_flags A mask made of TCP::Flags values.
+         */
+        bool has_flags(uint8_t check_flags) const { return (flags() & check_flags) == check_flags; }
+
+        uint16_t window() const { return read_be<uint16_t>(data_ + 14); }
+        uint16_t checksum() const { return read_be<uint16_t>(data_ + 16); }
+        uint16_t urg_ptr() const { return read_be<uint16_t>(data_ + 18); }
+    private:
+        const uint8_t* data_;
+    };
+
+    /**
+     * \brief Read only view over a UDP header.
+     */
+    class udp_header {
+    public:
+        udp_header(const uint8_t* data) : data_(data) { }
+
+        uint16_t sport() const { return read_be<uint16_t>(data_); }
+        uint16_t dport() const { return read_be<uint16_t>(data_ + 2); }
+        uint16_t length() const { return read_be<uint16_t>(data_ + 4); }
+        uint16_t checksum() const { return read_be<uint16_t>(data_ + 6); }
+    private:
+        const uint8_t* data_;
+    };
+
+    /**
+     * \brief Default constructs an empty PacketView.
+     */
+    PacketView();
+
+    /**
+     * \brief Constructs a PacketView and dissects the given buffer.
+     *
+     * \param link_type The type of the first PDU in the buffer. Using
+     * PDU::IP will detect both IPv4 and IPv6.
+     * \param buffer The buffer to dissect.
+     * \param size The size of the buffer.
+     * \sa PacketView::parse
+     */
+    PacketView(PDU::PDUType link_type, const uint8_t* buffer, uint32_t size);
+
+    /**
+     * \brief Dissects the given buffer, replacing this view's contents.
+     *
+     * \param link_type The type of the first PDU in the buffer. Using
+     * PDU::IP will detect both IPv4 and IPv6.
+     * \param buffer The buffer to dissect.
+     * \param size The size of the buffer.
+     * \return false if the buffer was found to be malformed.
+     */
+    bool parse(PDU::PDUType link_type, const uint8_t* buffer, uint32_t size);
+
+    /**
+     * \brief Getter for the amount of layers found.
+     */
+    size_t layer_count() const {
+        return layer_count_;
+    }
+
+    /**
+     * \brief Getter for the layer at the given index.
+     *
+     * Index 0 is the outermost layer.
+     *
+     * \param index The index of the layer, which has to be lower than
+     * PacketView::layer_count.
+     */
+    const layer& layer_at(size_t index) const {
+        return layers_[index];
+    }
+
+    /**
+     * \brief Finds the first layer of the given type.
+     *
+     * \return A pointer to the layer, or a null pointer if it's not found.
+     */
+    const layer* find_layer(PDU::PDUType type) const;
+
+    /**
+     * \brief Indicates whether there's a layer of the given type.
+     */
+    bool has_layer(PDU::PDUType type) const {
+        return find_layer(type) != 0;
+    }
+
+    /**
+     * \brief Indicates whether a malformed header was found.
+     *
+     * The layers found before the malformed one are still available.
+     */
+    bool is_malformed() const {
+        return malformed_;
+    }
+
+    /**
+     * \brief Getter for a pointer to the bytes after the last layer found.
+     */
+    const uint8_t* payload() const {
+        return buffer_ + payload_offset_;
+    }
+
+    /**
+     * \brief Getter for the amount of bytes after the last layer found.
+     *
+     * This takes into account the length advertised by IPv4 and IPv6
+     * headers, so link layer padding is not included.
+     */
+    uint32_t payload_size() const {
+        return payload_end_ - payload_offset_;
+    }
+
+    /**
+     * \brief Getter for the first Ethernet II header.
+     *
+     * If there's no such layer, a pdu_not_found exception is thrown.
+     */
+    ethernet_header ethernet() const;
+
+    /**
+     * \brief Getter for the first 802.1Q or 802.1ad header.
+     *
+     * If there's no such layer, a pdu_not_found exception is thrown.
+     */
+    dot1q_header dot1q() const;
+
+    /**
+     * \brief Getter for the first IPv4 header.
+     *
+     * If there's no such layer, a pdu_not_found exception is thrown.
+     */
+    ip_header ip() const;
+
+    /**
+     * \brief Getter for the first IPv6 header.
+     *
+     * If there's no such layer, a pdu_not_found exception is thrown.
+     */
+    ipv6_header ipv6() const;
+
+    /**
+     * \brief Getter for the first ARP header.
+     *
+     * If there's no such layer, a pdu_not_found exception is thrown.
+     */
+    arp_header arp() const;
+
+    /**
+     * \brief Getter for the first ICMP header.
+     *
+     * If there's no such layer, a pdu_not_found exception is thrown.
+     */
+    icmp_header icmp() const;
+
+    /**
+     * \brief Getter for the first TCP header.
+     *
+     * If there's no such layer, a pdu_not_found exception is thrown.
+     */
+    tcp_header tcp() const;
+
+    /**
+     * \brief Getter for the first UDP header.
+     *
+     * If there's no such layer, a pdu_not_found exception is thrown.
+     */
+    udp_header udp() const;
+private:
+    template <typename T>
+    static T read(const uint8_t* ptr) {
+        T value;
+        std::memcpy(&value, ptr, sizeof(value));
+        return value;
+    }
+
+    template <typename T>
+    static T read_be(const uint8_t* ptr) {
+        return Endian::be_to_host(read<T>(ptr));
+    }
+
+    const uint8_t* layer_data(PDU::PDUType type) const;
+    bool add_layer(PDU::PDUType type, uint32_t header_size);
+
+    const uint8_t* buffer_;
+    layer layers_[MAX_LAYERS];
+    size_t layer_count_;
+    uint32_t payload_offset_;
+    uint32_t payload_end_;
+    bool malformed_;
+};
+
+} // Tins
+
+#endif // TINS_PACKET_VIEW_H
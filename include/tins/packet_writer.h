@@ -38,6 +38,7 @@
 #ifdef TINS_HAVE_PCAP
 #include <pcap.h>
 #include <tins/data_link_type.h>
+#include <tins/timestamp_index.h>
 
 struct timeval;
 
@@ -141,8 +142,11 @@ public:
          * 
          * \param rhs The PacketWriter to be moved.
          */
-        PacketWriter(PacketWriter &&rhs) TINS_NOEXCEPT {
-            *this = std::move(rhs);
+        PacketWriter(PacketWriter &&rhs) TINS_NOEXCEPT
+        : handle_(rhs.handle_), dumper_(rhs.dumper_), index_(rhs.index_) {
+            rhs.handle_ = 0;
+            rhs.dumper_ = 0;
+            rhs.index_ = 0;
         }
         
         /**
@@ -150,14 +154,19 @@ public:
          * 
          * Note that calling PacketWriter::write on an previously moved
          * object will lead to undefined behaviour.
+         *
+         * The file and index this object was writing to are closed first,
+         * which flushes them. Since that may fail, this isn't noexcept.
          * 
          * \param rhs The PacketWriter to be moved.
          */
-        PacketWriter& operator=(PacketWriter &&rhs) TINS_NOEXCEPT {
-            handle_ = 0;
-            dumper_ = 0;
-            std::swap(handle_, rhs.handle_);
-            std::swap(dumper_, rhs.dumper_);
+        PacketWriter& operator=(PacketWriter &&rhs) {
+            if (this != &rhs) {
+                close();
+                std::swap(handle_, rhs.handle_);
+                std::swap(dumper_, rhs.dumper_);
+                std::swap(index_, rhs.index_);
+            }
             return* this;
         }
     #endif
@@ -184,6 +193,21 @@ public:
      * \param packet The packet to be written.
      */
     void write(Packet& packet);
+
+    /**
+     * \brief Builds a timestamp index while packets are written.
+     *
+     * Every packet written after this call is added to the index 
+     * (see TimestampIndex), so this should be called before writing any
+     * packets. Any previous index being built by this writer is closed.
+     *
+     * If the index file can't be opened, file_open_error is thrown.
+     *
+     * \param file_name The path of the index file.
+     * \param interval The amount of packets per index entry.
+     */
+    void set_timestamp_index(const std::string& file_name,
+                             uint32_t interval = TimestampIndex::DEFAULT_INTERVAL);
     
     /**
      * \brief Writes a PDU to this file. 
@@ -217,9 +241,11 @@ private:
 
     void init(const std::string& file_name, int link_type);
     void write(PDU& pdu, const struct timeval& tv);
+    void close();
 
     pcap_t* handle_;
     pcap_dumper_t* dumper_; 
+    TimestampIndexWriter* index_;
 };
 
 } // Tins
@@ -0,0 +1,272 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_PARALLEL_FILE_PROCESSOR_H
+#define TINS_PARALLEL_FILE_PROCESSOR_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_CXX11
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/pcap_file_reader.h>
+
+namespace Tins {
+
+/**
+ * \class ParallelFileProcessor
+ * \brief Processes a pcap file using several threads.
+ *
+ * The file is processed by a fixed amount of workers, each of them 
+ * running on its own thread and using its own PcapFileReader. How records
+ * are spread among workers depends on the partition mode:
+ *
+ * - CHUNKS: the file is split into contiguous, record aligned chunks of 
+ * roughly the same size and each worker reads one of them. Since pcap
+ * files have no markers between records, chunk boundaries are found using
+ * PcapFileReader::find_record_boundary.
+ * - FLOW_HASH: every worker reads the whole file but only decodes the 
+ * records whose flow hash (see ParallelFileProcessor::flow_hash) maps to 
+ * it. Every packet in a given flow, in both directions, is handled by the
+ * same worker, so stateful consumers like TCPIP::StreamFollower can be 
+ * used without any synchronization. Reading record headers is cheap, 
+ * so the cost of every worker going through the whole file is low 
+ * compared to decoding.
+ *
+ * ParallelFileProcessor::process takes a factory that is called once per 
+ * worker and has to return the functor that worker will use. The returned
+ * functors follow the same rules as the ones used in 
+ * BaseSniffer::sniff_loop. Each worker should keep its results on its own
+ * and these can be merged once ParallelFileProcessor::process returns:
+ *
+ * \code
+ * ParallelFileProcessor processor("capture.pcap", 4);
+ * std::vector<size_t> counts(processor.size());
+ * processor.process([&](size_t index) {
+ *     size_t* count = &counts[index];
+ *     return [count](PDU& pdu) {
+ *         if (pdu.find_pdu<TCP>()) {
+ *             (*count)++;
+ *         }
+ *         return true;
+ *     };
+ * });
+ * size_t total = std::accumulate(counts.begin(), counts.end(), size_t(0));
+ * \endcode
+ *
+ * Note that within a chunk, records are processed in file order, but 
+ * there's no ordering guarantee between different workers.
+ */
+class TINS_API ParallelFileProcessor {
+public:
+    /**
+     * The type used to store the amount of workers.
+     */
+    typedef size_t size_type;
+
+    /**
+     * The ways in which records can be spread among workers.
+     */
+    enum PartitionMode {
+        CHUNKS,
+        FLOW_HASH
+    };
+
+    /**
+     * \brief Represents the range of the file read by a worker.
+     */
+    struct range {
+        /**
+         * The offset of the first record in the range.
+         */
+        uint64_t begin;
+
+        /**
+         * The offset right after the last record in the range.
+         */
+        uint64_t end;
+    };
+
+    /**
+     * \brief Constructs a processor for the given file.
+     *
+     * The file is opened once per worker. If it can't be opened, 
+     * file_open_error is thrown. If it's not a pcap file, 
+     * invalid_file_format is thrown.
+     *
+     * \param file_name The path of the file to process.
+     * \param size The amount of workers (and threads) to use.
+     * \param mode The way in which records are spread among workers.
+     */
+    ParallelFileProcessor(const std::string& file_name, size_type size,
+                          PartitionMode mode = CHUNKS);
+
+    /**
+     * \brief Destructor.
+     */
+    ~ParallelFileProcessor();
+
+    /**
+     * \brief Gets the amount of workers used.
+     */
+    size_type size() const;
+
+    /**
+     * \brief Gets the partition mode used.
+     */
+    PartitionMode partition_mode() const;
+
+    /**
+     * \brief Gets the range of the file read by the given worker.
+     *
+     * When using FLOW_HASH, every worker's range spans the whole file.
+     *
+     * \param index The index of the worker.
+     */
+    const range& worker_range(size_type index) const;
+
+    /**
+     * \brief Sets whether decoded payloads reference the file's mapping.
+     *
+     * \param value Whether to enable zero copy payloads.
+     * \sa PcapFileReader::set_zero_copy_payloads
+     */
+    void set_zero_copy_payloads(bool value);
+
+    /**
+     * \brief Sets the last layer decoded in packets read from the file.
+     *
+     * \param layer The last layer to be decoded.
+     * \sa PcapFileReader::set_max_decode_layer
+     */
+    void set_max_decode_layer(PacketDecoder::Layer layer);
+
+    /**
+     * \brief Processes the file, using one thread per worker.
+     *
+     * The factory is called on the calling thread once for each worker,
+     * using the worker's index as its argument. The functor it returns
+     * is then called for each packet that worker decodes.
+     *
+     * This call blocks until every worker is done. A worker is done once
+     * it reaches the end of its range, when its functor returns false or
+     * when ParallelFileProcessor::stop is called. If any of the callbacks
+     * throws, every worker is stopped and the exception is rethrown here.
+     *
+     * The file can be processed again after this call returns.
+     *
+     * \param factory The functor factory.
+     */
+    template <typename FunctorFactory>
+    void process(FunctorFactory factory);
+
+    /**
+     * \brief Stops every worker.
+     *
+     * This can be called from any thread, including the callbacks
+     * running on this processor's threads.
+     */
+    void stop();
+
+    /**
+     * \brief Computes the hash of the flow a record belongs to.
+     *
+     * The hash is computed over the IP addresses, the transport protocol
+     * and, for TCP and UDP, the ports. Both directions of a flow have the
+     * same hash. Records that don't contain an IP or IPv6 layer have a 
+     * hash of 0.
+     *
+     * Note that the ports of IP fragments are not used, so they will 
+     * normally hash differently than the rest of their flow.
+     *
+     * \param link_type The type of the record's link layer.
+     * \param data The record's data.
+     * \param size The record's size.
+     */
+    static uint32_t flow_hash(PDU::PDUType link_type, const uint8_t* data, uint32_t size);
+private:
+    typedef std::function<void()> worker_type;
+
+    ParallelFileProcessor(const ParallelFileProcessor&);
+    ParallelFileProcessor& operator=(const ParallelFileProcessor&);
+
+    bool is_assigned(size_type index, const PcapFileReader::record& current) const;
+    void run_workers(const std::vector<worker_type>& workers);
+    void cleanup();
+
+    std::vector<PcapFileReader*> readers_;
+    std::vector<range> ranges_;
+    PartitionMode mode_;
+    std::atomic<bool> stopped_;
+};
+
+template <typename FunctorFactory>
+void ParallelFileProcessor::process(FunctorFactory factory) {
+    std::vector<worker_type> workers;
+    for (size_type i = 0; i < readers_.size(); ++i) {
+        auto function = factory(i);
+        workers.push_back([this, i, function]() mutable {
+            PcapFileReader& reader = *readers_[i];
+            const range& current_range = ranges_[i];
+            PcapFileReader::record current;
+            reader.seek(current_range.begin);
+            while (!stopped_ && reader.offset() < current_range.end &&
+                   reader.next_record(current)) {
+                if (!is_assigned(i, current)) {
+                    continue;
+                }
+                PDU* pdu = reader.decode_record(current);
+                if (!pdu) {
+                    continue;
+                }
+                Packet packet(pdu, current.timestamp, Packet::own_pdu());
+                try {
+                    // If the functor returns false, this worker is done
+                    if (!Internals::invoke_loop_cb(function, packet)) {
+                        return;
+                    }
+                }
+                catch(malformed_packet&) { }
+                catch(pdu_not_found&) { }
+            }
+        });
+    }
+    run_workers(workers);
+}
+
+} // Tins
+
+#endif // TINS_HAVE_CXX11
+
+#endif // TINS_PARALLEL_FILE_PROCESSOR_H
@@ -0,0 +1,511 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_PCAP_FILE_READER_H
+#define TINS_PCAP_FILE_READER_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <tins/config.h>
+#include <tins/macros.h>
+#include <tins/packet.h>
+#include <tins/lazy_packet.h>
+#include <tins/packet_decoder.h>
+#include <tins/pdu.h>
+#include <tins/timestamp.h>
+#include <tins/timestamp_index.h>
+#include <tins/exceptions.h>
+#include <tins/detail/type_traits.h>
+
+namespace Tins {
+namespace Internals {
+class MappedFile;
+} // Internals
+
+#ifdef TINS_HAVE_PCAP
+class OfflinePacketFilter;
+#endif // TINS_HAVE_PCAP
+
+/**
+ * \class PcapFileReader
+ * \brief Reads pcap files by memory mapping them.
+ *
+ * Unlike FileSniffer, this class doesn't use libpcap. The whole file is
+ * memory mapped and its record headers are parsed in place, so reading a 
+ * record doesn't copy it. Records can be read without decoding them 
+ * using PcapFileReader::next_record, and the rest of the interface 
+ * mirrors BaseSniffer's:
+ *
+ * \code
+ * PcapFileReader reader("capture.pcap");
+ * reader.sniff_loop([&](Packet& packet) {
+ *     // process packet
+ *     return true;
+ * });
+ * \endcode
+ *
+ * The kernel is told that the file will be read sequentially and the
+ * pages ahead of the current record are prefetched as the file is read
+ * (see PcapFileReader::set_prefetch_size). Both microsecond and nanosecond 
+ * resolution files in either byte order are supported. Nanosecond 
+ * timestamps are truncated to microseconds.
+ *
+ * If the last record in the file is truncated, reading stops right 
+ * before it.
+ */
+class TINS_API PcapFileReader {
+public:
+    /**
+     * \brief Represents a record in the file.
+     *
+     * The data pointer points inside the file's mapping, so it's valid
+     * for as long as the reader is alive.
+     */
+    struct record {
+        /**
+         * Pointer to the record's link layer header.
+         */
+        const uint8_t* data;
+
+        /**
+         * The captured size of this record.
+         */
+        uint32_t size;
+
+        /**
+         * The size of this packet on the wire.
+         */
+        uint32_t length;
+
+        /**
+         * The time at which this packet was captured.
+         */
+        Timestamp timestamp;
+    };
+
+    /**
+     * \brief The default amount of bytes prefetched ahead of the
+     * current record.
+     *
+     * This is 4MB by default.
+     */
+    static const uint32_t DEFAULT_PREFETCH_SIZE;
+
+    /**
+     * \brief The amount of consecutive record headers that have to be 
+     * valid for PcapFileReader::find_record_boundary to accept an offset.
+     */
+    static const uint32_t RECORD_BOUNDARY_CHAIN;
+
+    /**
+     * \brief Opens a pcap file.
+     *
+     * If the file can't be opened, file_open_error is thrown. If it's not
+     * a pcap file, invalid_file_format is thrown.
+     *
+     * \param file_name The path of the file to open.
+     */
+    PcapFileReader(const std::string& file_name);
+
+    /**
+     * \brief Unmaps the file.
+     */
+    ~PcapFileReader();
+
+    /**
+     * \brief Retrieves the next record in the file without decoding it.
+     *
+     * If a filter was set, records that don't match it are skipped.
+     *
+     * \param output The record in which to store the record's information.
+     * \return false if the end of the file was reached, true otherwise.
+     */
+    bool next_record(record& output);
+
+    /**
+     * \brief Retrieves the record at the given offset.
+     *
+     * This doesn't change the offset of the next record to be read.
+     *
+     * \param offset The offset of the record, like the ones returned by
+     * PcapFileReader::offset.
+     * \param output The record in which to store the record's information.
+     * \return false if there's no complete record at the given offset.
+     */
+    bool record_at(uint64_t offset, record& output);
+
+    /**
+     * \brief Retrieves and decodes the next packet.
+     *
+     * Records which can't be decoded are skipped.
+     *
+     * \return The packet read. This will contain a null PDU if the end of 
+     * the file was reached.
+     */
+    Packet next_packet();
+
+    /**
+     * \brief Retrieves and decodes up to max_packets packets.
+     *
+     * \param batch The vector in which to store the packets. It will be
+     * cleared before being filled.
+     * \param max_packets The maximum amount of packets to retrieve,
+     * 0 meaning every packet left in the file.
+     * \return false if there were no packets left in the file, true 
+     * otherwise.
+     */
+    bool next_packets(std::vector<Packet>& batch, uint32_t max_packets = 0);
+
+    /**
+     * \brief Retrieves the next packet without decoding it.
+     *
+     * The record's bytes are copied into the given LazyPacket.
+     *
+     * \param packet The packet in which to store the record.
+     * \return false if the end of the file was reached, true otherwise.
+     * \sa BaseSniffer::next_packet(LazyPacket&)
+     */
+    bool next_packet(LazyPacket& packet);
+
+    /**
+     * \brief Starts a loop over the packets in the file, using a callback 
+     * functor for every packet.
+     *
+     * This behaves just like BaseSniffer::sniff_loop.
+     *
+     * \param function The callback functor.
+     * \param max_packets The maximum amount of packets to read. 0 == all of them.
+     */
+    template <typename Functor>
+    void sniff_loop(Functor function, uint32_t max_packets = 0);
+
+    /**
+     * \brief Starts a loop that delivers packets without decoding them.
+     *
+     * This behaves just like BaseSniffer::sniff_lazy_loop.
+     *
+     * \param function The callback functor.
+     * \param max_packets The maximum amount of packets to read. 0 == all of them.
+     */
+    template <typename Functor>
+    void sniff_lazy_loop(Functor function, uint32_t max_packets = 0);
+
+    /**
+     * \brief Decodes a record.
+     *
+     * This uses the reader's link type and decoding settings. Throws 
+     * unknown_link_type if the file's link type is not supported.
+     *
+     * \param input The record to decode.
+     * \return The decoded PDU, which the caller takes ownership of, or 
+     * a null pointer if the record couldn't be decoded.
+     */
+    PDU* decode_record(const record& input) const;
+
+    /**
+     * \brief Starts a loop over the records at the given offsets.
+     *
+     * This behaves like PcapFileReader::sniff_loop, but only the records 
+     * starting at the given offsets are read, in the order given. This is
+     * meant to be used along with the offsets found in an index, like 
+     * TCPIP::FlowIndex. The filter, if any, is not applied.
+     *
+     * \param function The callback functor.
+     * \param start The beginning of the range of offsets.
+     * \param end The end of the range of offsets.
+     */
+    template <typename Functor, typename InputIterator>
+    void sniff_records(Functor function, InputIterator start, InputIterator end);
+
+    /**
+     * \brief Starts a loop over the packets captured within a time range.
+     *
+     * This moves to the first record at or after start (see 
+     * PcapFileReader::seek(const Timestamp&, const TimestampIndex&)) and
+     * then behaves like PcapFileReader::sniff_loop, stopping at the first
+     * record at or after end. Records are expected to be in capture order,
+     * like the ones written by libpcap.
+     *
+     * \param function The callback functor.
+     * \param start The beginning of the time range.
+     * \param end The end of the time range, which is not included in it.
+     * \param index This file's timestamp index.
+     */
+    template <typename Functor>
+    void sniff_time_range(Functor function, const Timestamp& start, const Timestamp& end,
+                          const TimestampIndex& index);
+
+    /**
+     * \brief Moves back to the first record in the file.
+     */
+    void rewind();
+
+    /**
+     * \brief Gets the offset within the file of the next record to be read.
+     */
+    uint64_t offset() const;
+
+    /**
+     * \brief Moves to the given offset within the file.
+     *
+     * The offset has to be the start of a record, like the ones returned 
+     * by PcapFileReader::offset and PcapFileReader::find_record_boundary.
+     * Offsets past the end of the file are clamped to it.
+     *
+     * \param offset The offset of the record to read next.
+     */
+    void seek(uint64_t offset);
+
+    /**
+     * \brief Moves to the first record captured at or after a timestamp.
+     *
+     * The index is used to find a nearby record using a binary search and
+     * the records from it up to the first one at or after the timestamp 
+     * are skipped. If there's no such record, this moves to the end of 
+     * the file.
+     *
+     * \param timestamp The timestamp to look for.
+     * \param index This file's timestamp index.
+     */
+    void seek(const Timestamp& timestamp, const TimestampIndex& index);
+
+    /**
+     * \brief Finds the first record that starts at or after an offset.
+     *
+     * Since pcap files have no markers between records, this looks for
+     * an offset at which a chain of valid record headers starts. A
+     * candidate is accepted once the records following it line up until 
+     * either RECORD_BOUNDARY_CHAIN headers were checked or the end of the 
+     * file is reached exactly.
+     *
+     * \param offset The offset at which to start looking.
+     * \return The offset of the record found or the file's size if there 
+     * are no records after the given offset.
+     */
+    uint64_t find_record_boundary(uint64_t offset) const;
+
+    /**
+     * \brief Gets the size of the file.
+     */
+    uint64_t file_size() const;
+
+    #ifdef TINS_HAVE_PCAP
+    /**
+     * \brief Sets the filter used to select records.
+     *
+     * The filter should have been compiled for this file's link type.
+     * A copy of it is kept by this reader.
+     *
+     * \param filter The filter to use.
+     */
+    void set_filter(const OfflinePacketFilter& filter);
+
+    /**
+     * \brief Removes the filter, if any.
+     */
+    void clear_filter();
+    #endif // TINS_HAVE_PCAP
+
+    /**
+     * \brief Sets whether decoded payloads reference the file's mapping.
+     *
+     * If enabled, RawPDUs reference the mapping rather than copying their
+     * payload (see RawPDU::zero_copy_scope). Since the mapping is kept 
+     * until the reader is destroyed, packets can be kept as long as the 
+     * reader is alive.
+     *
+     * If libtins was built without C++11 support, enabling this will 
+     * throw feature_disabled.
+     *
+     * \param value Whether to enable zero copy payloads.
+     */
+    void set_zero_copy_payloads(bool value);
+
+    /**
+     * \brief Sets the last layer decoded in packets read from the file.
+     *
+     * This behaves just like BaseSniffer::set_max_decode_layer.
+     *
+     * \param layer The last layer to be decoded.
+     */
+    void set_max_decode_layer(PacketDecoder::Layer layer);
+
+    /**
+     * \brief Sets the amount of bytes prefetched ahead of the current record.
+     *
+     * Using 0 disables prefetching, leaving it up to the kernel's 
+     * readahead.
+     *
+     * \param size The amount of bytes to prefetch.
+     */
+    void set_prefetch_size(uint32_t size);
+
+    /**
+     * \brief Gets the type of the link layer PDU that records are decoded as.
+     *
+     * This is PDU::UNKNOWN if the file's link type is not supported.
+     */
+    PDU::PDUType link_type() const;
+
+    /**
+     * \brief Gets the link type stored in the file's header.
+     *
+     * This is one of the LINKTYPE_* values used in capture files.
+     */
+    uint32_t data_link_type() const;
+
+    /**
+     * \brief Gets the snapshot length stored in the file's header.
+     */
+    uint32_t snap_len() const;
+
+    /**
+     * \brief Indicates whether the file uses nanosecond resolution timestamps.
+     */
+    bool has_nanosecond_timestamps() const;
+private:
+    PcapFileReader(const PcapFileReader&);
+    PcapFileReader& operator=(const PcapFileReader&);
+
+    uint32_t read_uint32(const uint8_t* ptr) const;
+    bool read_record(record& output);
+    bool parse_record(uint64_t offset, record& output) const;
+    bool is_valid_record_header(uint64_t offset) const;
+    bool matches_filter(const record& current) const;
+
+    Internals::MappedFile* file_;
+    #ifdef TINS_HAVE_PCAP
+    OfflinePacketFilter* filter_;
+    #endif // TINS_HAVE_PCAP
+    uint64_t offset_;
+    uint64_t prefetched_offset_;
+    uint32_t prefetch_size_;
+    uint32_t data_link_type_;
+    uint32_t snap_len_;
+    PDU::PDUType link_type_;
+    bool swapped_;
+    bool nanosecond_timestamps_;
+    bool zero_copy_payloads_;
+    PacketDecoder::Layer max_decode_layer_;
+};
+
+template <typename Functor>
+void PcapFileReader::sniff_loop(Functor function, uint32_t max_packets) {
+    record current;
+    while (next_record(current)) {
+        PDU* pdu = decode_record(current);
+        if (!pdu) {
+            continue;
+        }
+        Packet packet(pdu, current.timestamp, Packet::own_pdu());
+        try {
+            // If the functor returns false, we're done
+            if (!Internals::invoke_loop_cb(function, packet)) {
+                return;
+            }
+        }
+        catch(malformed_packet&) { }
+        catch(pdu_not_found&) { }
+        if (max_packets && --max_packets == 0) {
+            return;
+        }
+    }
+}
+
+template <typename Functor, typename InputIterator>
+void PcapFileReader::sniff_records(Functor function, InputIterator start, InputIterator end) {
+    record current;
+    for (; start != end; ++start) {
+        if (!record_at(*start, current)) {
+            continue;
+        }
+        PDU* pdu = decode_record(current);
+        if (!pdu) {
+            continue;
+        }
+        Packet packet(pdu, current.timestamp, Packet::own_pdu());
+        try {
+            // If the functor returns false, we're done
+            if (!Internals::invoke_loop_cb(function, packet)) {
+                return;
+            }
+        }
+        catch(malformed_packet&) { }
+        catch(pdu_not_found&) { }
+    }
+}
+
+template <typename Functor>
+void PcapFileReader::sniff_time_range(Functor function, const Timestamp& start,
+                                      const Timestamp& end, const TimestampIndex& index) {
+    const uint64_t end_value = TimestampIndex::to_microseconds(end);
+    seek(start, index);
+    record current;
+    while (next_record(current)) {
+        if (TimestampIndex::to_microseconds(current.timestamp) >= end_value) {
+            return;
+        }
+        PDU* pdu = decode_record(current);
+        if (!pdu) {
+            continue;
+        }
+        Packet packet(pdu, current.timestamp, Packet::own_pdu());
+        try {
+            // If the functor returns false, we're done
+            if (!Internals::invoke_loop_cb(function, packet)) {
+                return;
+            }
+        }
+        catch(malformed_packet&) { }
+        catch(pdu_not_found&) { }
+    }
+}
+
+template <typename Functor>
+void PcapFileReader::sniff_lazy_loop(Functor function, uint32_t max_packets) {
+    LazyPacket packet;
+    while (next_packet(packet)) {
+        try {
+            // If the functor returns false, we're done
+            if (!function(packet)) {
+                return;
+            }
+        }
+        catch(malformed_packet&) { }
+        catch(pdu_not_found&) { }
+        if (max_packets && --max_packets == 0) {
+            return;
+        }
+    }
+}
+
+} // Tins
+
+#endif // TINS_PCAP_FILE_READER_H
@@ -0,0 +1,365 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_PCAPNG_READER_H
+#define TINS_PCAPNG_READER_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/packet.h>
+#include <tins/lazy_packet.h>
+#include <tins/packet_decoder.h>
+#include <tins/pdu.h>
+#include <tins/timestamp.h>
+#include <tins/exceptions.h>
+#include <tins/detail/type_traits.h>
+
+namespace Tins {
+namespace Internals {
+class MappedFile;
+} // Internals
+
+/**
+ * \class PcapNgReader
+ * \brief Reads pcapng files by memory mapping them.
+ *
+ * This class parses pcapng files without using libpcap, in the same way
+ * PcapFileReader does for pcap files. Section Header, Interface 
+ * Description, Enhanced Packet, Simple Packet and the obsolete Packet
+ * blocks are supported, while any other block is skipped. Files 
+ * containing several sections, using either byte order, are supported.
+ *
+ * Each interface keeps its own link type, so files that merge captures
+ * from different kinds of interfaces are decoded properly. Timestamps are
+ * converted to nanoseconds using each interface's resolution, and are 
+ * available in full precision through PcapNgReader::record::timestamp_ns.
+ *
+ * \code
+ * PcapNgReader reader("capture.pcapng");
+ * PcapNgReader::record record;
+ * while (reader.next_record(record)) {
+ *     const PcapNgReader::interface_info& info = 
+ *         reader.interface_at(record.interface_id);
+ *     // ...
+ * }
+ * \endcode
+ *
+ * If a block is truncated or invalid, reading stops right before it.
+ */
+class TINS_API PcapNgReader {
+public:
+    /**
+     * \brief Represents a packet stored in the file.
+     *
+     * The data pointer points inside the file's mapping, so it's valid
+     * for as long as the reader is alive.
+     */
+    struct record {
+        /**
+         * Pointer to the packet's link layer header.
+         */
+        const uint8_t* data;
+
+        /**
+         * The captured size of this packet.
+         */
+        uint32_t size;
+
+        /**
+         * The size of this packet on the wire.
+         */
+        uint32_t length;
+
+        /**
+         * The index of the interface this packet was captured on.
+         */
+        uint32_t interface_id;
+
+        /**
+         * The time at which this packet was captured.
+         */
+        Timestamp timestamp;
+
+        /**
+         * The time at which this packet was captured, in nanoseconds 
+         * since the epoch.
+         */
+        uint64_t timestamp_ns;
+    };
+
+    /**
+     * \brief Represents an interface described in the file.
+     */
+    struct interface_info {
+        /**
+         * The link type stored in the file (one of the LINKTYPE_* values).
+         */
+        uint32_t data_link_type;
+
+        /**
+         * The type of the link layer PDU that packets are decoded as. This
+         * is PDU::UNKNOWN if the link type is not supported.
+         */
+        PDU::PDUType link_type;
+
+        /**
+         * The snapshot length used, 0 meaning no limit.
+         */
+        uint32_t snap_len;
+
+        /**
+         * The interface's name, if the file contains it.
+         */
+        std::string name;
+
+        /**
+         * The timestamp resolution, encoded as in the if_tsresol option.
+         */
+        uint8_t timestamp_resolution;
+
+        /**
+         * The amount of seconds to add to every timestamp.
+         */
+        int64_t timestamp_offset;
+    };
+
+    /**
+     * \brief The default amount of bytes prefetched ahead of the
+     * current block.
+     *
+     * This is 4MB by default.
+     */
+    static const uint32_t DEFAULT_PREFETCH_SIZE;
+
+    /**
+     * \brief Opens a pcapng file.
+     *
+     * If the file can't be opened, file_open_error is thrown. If it doesn't 
+     * start with a valid Section Header Block, invalid_file_format is thrown.
+     *
+     * \param file_name The path of the file to open.
+     */
+    PcapNgReader(const std::string& file_name);
+
+    /**
+     * \brief Unmaps the file.
+     */
+    ~PcapNgReader();
+
+    /**
+     * \brief Retrieves the next packet in the file without decoding it.
+     *
+     * \param output The record in which to store the packet's information.
+     * \return false if the end of the file was reached, true otherwise.
+     */
+    bool next_record(record& output);
+
+    /**
+     * \brief Retrieves and decodes the next packet.
+     *
+     * Packets which can't be decoded, including the ones captured on 
+     * interfaces whose link type is not supported, are skipped.
+     *
+     * \return The packet read. This will contain a null PDU if the end of 
+     * the file was reached.
+     */
+    Packet next_packet();
+
+    /**
+     * \brief Retrieves and decodes up to max_packets packets.
+     *
+     * \param batch The vector in which to store the packets. It will be
+     * cleared before being filled.
+     * \param max_packets The maximum amount of packets to retrieve,
+     * 0 meaning every packet left in the file.
+     * \return false if there were no packets left in the file, true 
+     * otherwise.
+     */
+    bool next_packets(std::vector<Packet>& batch, uint32_t max_packets = 0);
+
+    /**
+     * \brief Retrieves the next packet without decoding it.
+     *
+     * The packet's bytes are copied into the given LazyPacket, using the
+     * link type of the interface it was captured on. Packets captured on
+     * interfaces with an unsupported link type are skipped.
+     *
+     * \param packet The packet in which to store the packet's bytes.
+     * \return false if the end of the file was reached, true otherwise.
+     */
+    bool next_packet(LazyPacket& packet);
+
+    /**
+     * \brief Starts a loop over the packets in the file, using a callback 
+     * functor for every packet.
+     *
+     * This behaves just like BaseSniffer::sniff_loop.
+     *
+     * \param function The callback functor.
+     * \param max_packets The maximum amount of packets to read. 0 == all of them.
+     */
+    template <typename Functor>
+    void sniff_loop(Functor function, uint32_t max_packets = 0);
+
+    /**
+     * \brief Starts a loop that delivers packets without decoding them.
+     *
+     * This behaves just like BaseSniffer::sniff_lazy_loop.
+     *
+     * \param function The callback functor.
+     * \param max_packets The maximum amount of packets to read. 0 == all of them.
+     */
+    template <typename Functor>
+    void sniff_lazy_loop(Functor function, uint32_t max_packets = 0);
+
+    /**
+     * \brief Moves back to the start of the file.
+     */
+    void rewind();
+
+    /**
+     * \brief Sets whether decoded payloads reference the file's mapping.
+     *
+     * This behaves just like PcapFileReader::set_zero_copy_payloads.
+     *
+     * \param value Whether to enable zero copy payloads.
+     */
+    void set_zero_copy_payloads(bool value);
+
+    /**
+     * \brief Sets the last layer decoded in packets read from the file.
+     *
+     * This behaves just like BaseSniffer::set_max_decode_layer.
+     *
+     * \param layer The last layer to be decoded.
+     */
+    void set_max_decode_layer(PacketDecoder::Layer layer);
+
+    /**
+     * \brief Sets the amount of bytes prefetched ahead of the current block.
+     *
+     * This behaves just like PcapFileReader::set_prefetch_size.
+     *
+     * \param size The amount of bytes to prefetch.
+     */
+    void set_prefetch_size(uint32_t size);
+
+    /**
+     * \brief Gets the amount of interfaces described so far in the current
+     * section.
+     *
+     * Interfaces described at the start of the file are known as soon as 
+     * it's opened. The rest are added as their blocks are read.
+     */
+    size_t interface_count() const;
+
+    /**
+     * \brief Gets the information about an interface in the current section.
+     *
+     * If the index is invalid, invalid_interface is thrown.
+     *
+     * \param index The index of the interface.
+     */
+    const interface_info& interface_at(uint32_t index) const;
+private:
+    struct block {
+        uint32_t type;
+        const uint8_t* body;
+        uint32_t size;
+    };
+
+    PcapNgReader(const PcapNgReader&);
+    PcapNgReader& operator=(const PcapNgReader&);
+
+    uint16_t read_uint16(const uint8_t* ptr) const;
+    uint32_t read_uint32(const uint8_t* ptr) const;
+    bool next_block(block& output);
+    bool read_section_header();
+    void read_leading_interfaces();
+    bool add_interface(const block& current);
+    bool make_record(const block& current, record& output) const;
+    uint64_t to_nanoseconds(const interface_info& info, uint64_t value) const;
+    PDU* decode(const record& current) const;
+
+    Internals::MappedFile* file_;
+    std::vector<interface_info> interfaces_;
+    uint64_t offset_;
+    uint64_t prefetched_offset_;
+    uint32_t prefetch_size_;
+    bool swapped_;
+    bool zero_copy_payloads_;
+    PacketDecoder::Layer max_decode_layer_;
+};
+
+template <typename Functor>
+void PcapNgReader::sniff_loop(Functor function, uint32_t max_packets) {
+    record current;
+    while (next_record(current)) {
+        PDU* pdu = decode(current);
+        if (!pdu) {
+            continue;
+        }
+        Packet packet(pdu, current.timestamp, Packet::own_pdu());
+        try {
+            // If the functor returns false, we're done
+            if (!Internals::invoke_loop_cb(function, packet)) {
+                return;
+            }
+        }
+        catch(malformed_packet&) { }
+        catch(pdu_not_found&) { }
+        if (max_packets && --max_packets == 0) {
+            return;
+        }
+    }
+}
+
+template <typename Functor>
+void PcapNgReader::sniff_lazy_loop(Functor function, uint32_t max_packets) {
+    LazyPacket packet;
+    while (next_packet(packet)) {
+        try {
+            // If the functor returns false, we're done
+            if (!function(packet)) {
+                return;
+            }
+        }
+        catch(malformed_packet&) { }
+        catch(pdu_not_found&) { }
+        if (max_packets && --max_packets == 0) {
+            return;
+        }
+    }
+}
+
+} // Tins
+
+#endif // TINS_PCAPNG_READER_H
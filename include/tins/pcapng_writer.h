@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_PCAPNG_WRITER_H
+#define TINS_PCAPNG_WRITER_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/pdu.h>
+#include <tins/packet.h>
+#include <tins/utils/pdu_utils.h>
+
+namespace Tins {
+
+/**
+ * \class PcapNgWriter
+ * \brief Writes packets to a pcapng file.
+ *
+ * This class writes pcapng files without using libpcap. Every interface
+ * added through PcapNgWriter::add_interface gets its own Interface 
+ * Description Block, so packets captured on interfaces using different
+ * link types can be stored in the same file. Packets are stored in 
+ * Enhanced Packet Blocks using nanosecond resolution timestamps.
+ *
+ * Blocks are buffered in memory and written to the file in batches, 
+ * once the buffer gets full, when PcapNgWriter::flush is called or when
+ * the writer is destroyed.
+ *
+ * \code
+ * PcapNgWriter writer("/tmp/file.pcapng");
+ * uint32_t eth0 = writer.add_interface(PDU::ETHERNET_II, 65535, "eth0");
+ * uint32_t tun0 = writer.add_interface(PDU::IP, 65535, "tun0");
+ * writer.write(ethernet_packet, eth0);
+ * writer.write(ip_packet, tun0);
+ * \endcode
+ */
+class TINS_API PcapNgWriter {
+public:
+    /**
+     * \brief The default size of the buffer used to batch blocks.
+     *
+     * This is 1MB by default.
+     */
+    static const uint32_t DEFAULT_BUFFER_SIZE;
+
+    /**
+     * \brief Creates a pcapng file and writes its Section Header Block.
+     *
+     * If the file can't be created, file_open_error is thrown.
+     *
+     * \param file_name The path of the file to create.
+     * \param buffer_size The size of the buffer used to batch blocks.
+     */
+    PcapNgWriter(const std::string& file_name,
+                 uint32_t buffer_size = DEFAULT_BUFFER_SIZE);
+
+    /**
+     * \brief Flushes the buffered blocks and closes the file.
+     */
+    ~PcapNgWriter();
+
+    /**
+     * \brief Describes a new interface.
+     *
+     * If the link type can't be stored in a pcapng file, unknown_link_type
+     * is thrown.
+     *
+     * \param link_type The type of the link layer PDU of the packets that
+     * will be captured on this interface.
+     * \param snap_len The snapshot length, 0 meaning no limit. Packets are
+     * truncated to this size when written.
+     * \param name The interface's name. If empty, it won't be stored.
+     * \return The index of the interface.
+     */
+    uint32_t add_interface(PDU::PDUType link_type, uint32_t snap_len = 65535,
+                           const std::string& name = std::string());
+
+    /**
+     * \brief Writes a PDU on the first interface using the current time.
+     *
+     * \param pdu The PDU to be written.
+     */
+    void write(PDU& pdu);
+
+    /**
+     * \brief Writes a PDU using the current time.
+     *
+     * \param pdu The PDU to be written.
+     * \param interface_id The index of the interface it was captured on.
+     */
+    void write(PDU& pdu, uint32_t interface_id);
+
+    /**
+     * \brief Writes a Packet on the first interface using its timestamp.
+     *
+     * \param packet The packet to be written.
+     */
+    void write(Packet& packet);
+
+    /**
+     * \brief Writes a Packet using its timestamp.
+     *
+     * \param packet The packet to be written.
+     * \param interface_id The index of the interface it was captured on.
+     */
+    void write(Packet& packet, uint32_t interface_id);
+
+    /**
+     * \brief Writes a PDU on the first interface using the current time.
+     * 
+     * The template parameter T must at some point yield a PDU& after
+     * applying operator* one or more than one time. This accepts both
+     * raw and smart pointers.
+     */
+    template<typename T>
+    void write(T& pdu) {
+        write(Utils::dereference_until_pdu(pdu));
+    }
+
+    /**
+     * \brief Writes all the PDUs in the range [start, end) on the first 
+     * interface.
+     *
+     * \param start A forward iterator pointing to the first PDU
+     * to be written.
+     * \param end A forward iterator pointing to one past the last
+     * PDU in the range.
+     */
+    template<typename ForwardIterator>
+    void write(ForwardIterator start, ForwardIterator end) {
+        while (start != end) {
+            write(Utils::dereference_until_pdu(*start++));
+        }
+    }
+
+    /**
+     * \brief Writes a packet's bytes.
+     *
+     * This can be used to store packets without decoding them, for 
+     * example the records read using PcapNgReader.
+     *
+     * If the interface index is invalid, invalid_interface is thrown.
+     *
+     * \param interface_id The index of the interface it was captured on.
+     * \param timestamp_ns The time at which it was captured, in nanoseconds
+     * since the epoch.
+     * \param data The packet's bytes.
+     * \param size The amount of bytes captured.
+     * \param length The size of the packet on the wire.
+     */
+    void write_record(uint32_t interface_id, uint64_t timestamp_ns,
+                      const uint8_t* data, uint32_t size, uint32_t length);
+
+    /**
+     * \brief Writes the buffered blocks to the file.
+     *
+     * If writing fails, file_write_error is thrown.
+     */
+    void flush();
+private:
+    PcapNgWriter(const PcapNgWriter&);
+    PcapNgWriter& operator=(const PcapNgWriter&);
+
+    void write_pdu(PDU& pdu, uint32_t interface_id, uint64_t timestamp_ns);
+    void append(const void* data, uint32_t size);
+    void append_uint16(uint16_t value);
+    void append_uint32(uint32_t value);
+    void append_padding(uint32_t size);
+    void append_option(uint16_t code, const void* data, uint16_t size);
+    void end_block(size_t start);
+
+    FILE* file_;
+    std::vector<uint8_t> buffer_;
+    std::vector<uint32_t> snap_lens_;
+    uint32_t buffer_size_;
+};
+
+} // Tins
+
+#endif // TINS_PCAPNG_WRITER_H
@@ -43,6 +43,11 @@ namespace Tins {
 
 class PacketSender;
 class NetworkInterface;
+class PacketArena;
+
+namespace Internals {
+    class decode_arena;
+} // Internals
 
 /**
  * The type used to store several PDU option values.
@@ -82,6 +87,13 @@ typedef std::vector<uint8_t> byte_array;
  * const TCP& tcp = packet.rfind_pdu<TCP>();
  * \endcode
  *
+ * Both of them walk the chain, one layer at a time. When several lookups
+ * are performed on the same packet, PDU::build_layer_index can be used 
+ * to index the chain's layers by type, so that lookups made on this PDU
+ * take constant time. PacketDecoder, which sniffers use, does this for 
+ * every packet it decodes. The index is dropped whenever a PDU in the
+ * chain is added or removed.
+ *
  * PDU objects can be serialized. Serialization converts the entire PDU
  * stack into a vector of bytes. This process might modify some parameters
  * on packets depending on which protocols are used in it. For example:
@@ -232,7 +244,11 @@ public:
          * \param rhs The PDU to be moved.
          */
         PDU(PDU &&rhs) TINS_NOEXCEPT 
-        : inner_pdu_(0), parent_pdu_(0) {
+        : inner_pdu_(0), parent_pdu_(0), layer_index_(0) {
+            #ifdef TINS_HAVE_CXX11
+                arena_allocated_ = false;
+            #endif // TINS_HAVE_CXX11
+            rhs.invalidate_layer_index();
             std::swap(inner_pdu_, rhs.inner_pdu_);
             if (inner_pdu_) {
                 inner_pdu_->parent_pdu(this);
@@ -245,7 +261,9 @@ public:
          * \param rhs The PDU to be moved.
          */
         PDU& operator=(PDU &&rhs) TINS_NOEXCEPT {
-            delete inner_pdu_;
+            invalidate_layer_index();
+            rhs.invalidate_layer_index();
+            destroy(inner_pdu_);
             inner_pdu_ = 0;
             std::swap(inner_pdu_, rhs.inner_pdu_);
             if (inner_pdu_) {
@@ -313,6 +331,9 @@ public:
      * 
      * Use this method if you want to somehow re-use a PDU that
      * is already owned by another PDU.
+     *
+     * If the inner PDU was constructed in a PacketArena, a heap 
+     * allocated copy of it is returned instead.
      * 
      * \return The current inner PDU. Might be 0.
      */
@@ -358,6 +379,10 @@ public:
      */
     template<typename T> 
     T* find_pdu(PDUType type = T::pdu_flag) {
+        PDU* indexed;
+        if (layer_index_ && find_indexed_pdu(type, false, indexed)) {
+            return static_cast<T*>(indexed);
+        }
         PDU* pdu = this;
         while (pdu) {
             if (pdu->matches_flag(type)) {
@@ -406,6 +431,63 @@ public:
         return const_cast<PDU*>(this)->rfind_pdu<T>(type);
     }
 
+    /**
+     * \brief Finds and returns the last PDU that matches the given flag.
+     *
+     * This is useful for tunneled packets, e.g. to find the innermost IP
+     * layer. If no PDU matches, 0 is returned.
+     *
+     * \param flag The flag which being searched.
+     */
+    template<typename T> 
+    T* find_last_pdu(PDUType type = T::pdu_flag) {
+        PDU* indexed;
+        if (layer_index_ && find_indexed_pdu(type, true, indexed)) {
+            return static_cast<T*>(indexed);
+        }
+        PDU* output = 0;
+        for (PDU* pdu = this; pdu; pdu = pdu->inner_pdu()) {
+            if (pdu->matches_flag(type)) {
+                output = pdu;
+            }
+        }
+        return static_cast<T*>(output);
+    }
+
+    /**
+     * \brief Finds and returns the last PDU that matches the given flag.
+     *
+     * \param flag The flag which being searched.
+     */
+    template<typename T> 
+    const T* find_last_pdu(PDUType type = T::pdu_flag) const {
+        return const_cast<PDU*>(this)->find_last_pdu<T>(type);
+    }
+
+    /**
+     * \brief Indexes the layers in this PDU's chain by their type.
+     *
+     * After this call, PDU::find_pdu, PDU::rfind_pdu and 
+     * PDU::find_last_pdu, when called on this PDU, no longer walk the
+     * chain for most PDU types. 
+     *
+     * The index is dropped as soon as a PDU is added to or removed from
+     * the chain. Chains which are too long or contain PDUs of unknown or
+     * user defined types are not indexed.
+     *
+     * \sa PDU::has_layer_index
+     */
+    void build_layer_index();
+
+    /**
+     * \brief Indicates whether this PDU's chain is indexed.
+     *
+     * \sa PDU::build_layer_index
+     */
+    bool has_layer_index() const {
+        return layer_index_ != 0;
+    }
+
     /**
      * \brief Clones this packet.
      *
@@ -523,10 +605,25 @@ protected:
      */
     virtual void write_serialization(uint8_t* buffer, uint32_t total_sz) = 0;
 private:
+    friend class Internals::decode_arena;
+
+    struct layer_index;
+
     void parent_pdu(PDU* parent);
+    bool find_indexed_pdu(PDUType type, bool last, PDU*& output) const;
+    void build_layer_index(PacketArena* arena);
+    void free_layer_index();
+    void invalidate_layer_index();
+    static void destroy(PDU* pdu);
 
     PDU* inner_pdu_;
     PDU* parent_pdu_;
+    layer_index* layer_index_;
+    #ifdef TINS_HAVE_CXX11
+        // Whether this PDU was constructed in a PacketArena by
+        // PacketDecoder::decode, rather than allocated using new
+        bool arena_allocated_;
+    #endif // TINS_HAVE_CXX11
 };
 
 /**
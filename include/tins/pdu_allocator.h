@@ -30,7 +30,14 @@
 #ifndef TINS_PDU_ALLOCATOR_H
 #define TINS_PDU_ALLOCATOR_H
 
-#include <map>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <tins/config.h>
+#ifdef TINS_HAVE_CXX11
+    #include <atomic>
+    #include <mutex>
+#endif // TINS_HAVE_CXX11
 #include <tins/pdu.h>
 
 namespace Tins {
@@ -51,48 +58,180 @@ PDU* default_allocator(const uint8_t* buffer, uint32_t size) {
     return new PDUType(buffer, size);
 }
 
+typedef PDU *(*allocator_function)(const uint8_t *, uint32_t);
+
+template<typename IDType>
+struct pdu_tag {
+    typedef IDType identifier_type;
+};
+
+// The allocators for the protocols supported by the library, which are used
+// to fill in the initial allocator tables. Defined in pdu_helpers.cpp
+TINS_API void builtin_allocators(pdu_tag<uint16_t>,
+                                 std::vector<std::pair<uint16_t, allocator_function> >& output);
+TINS_API void builtin_allocators(pdu_tag<uint8_t>,
+                                 std::vector<std::pair<uint8_t, allocator_function> >& output);
+
+// Allocators are kept in an immutable snapshot of flat tables, indexed by 
+// identifier. These start out containing the built-in protocols and 
+// registering an allocator publishes a new snapshot, so PDUs can be decoded 
+// on other threads at the same time. Superseded snapshots can still be in use 
+// by a decoding thread, so they're retired rather than deleted and freed at
+// shutdown. Each registration retires one table and one page.
 template<typename Tag>
 class PDUAllocator {
 public:
     typedef typename Tag::identifier_type id_type;
-    typedef PDU *(*allocator_type)(const uint8_t *, uint32_t);
+    typedef allocator_function allocator_type;
 
     template<typename PDUType>
     static void register_allocator(id_type identifier) {
-        allocators[identifier] = &default_allocator<PDUType>;
-        pdu_types[PDUType::pdu_flag] = identifier;
+        registry& instance = get_registry();
+        #ifdef TINS_HAVE_CXX11
+            std::lock_guard<std::mutex> _(instance.registration_mutex);
+        #endif // TINS_HAVE_CXX11
+        // Copied so the static member isn't ODR-used
+        const PDU::PDUType flag = PDUType::pdu_flag;
+        table* next = new table(*instance.load());
+        instance.tables.push_back(next);
+        set_allocator(instance, *next, identifier, &default_allocator<PDUType>);
+        typename pdu_types_type::iterator it = std::lower_bound(
+            next->pdu_types.begin(),
+            next->pdu_types.end(),
+            pdu_type_entry(flag, id_type())
+        );
+        if (it != next->pdu_types.end() && it->first == flag) {
+            it->second = identifier;
+        }
+        else {
+            next->pdu_types.insert(it, pdu_type_entry(flag, identifier));
+        }
+        instance.store(next);
     }
 
     static PDU* allocate(id_type identifier, const uint8_t* buffer, uint32_t size) {
-        typename allocators_type::const_iterator it = allocators.find(identifier);
-        return (it == allocators.end()) ? 0 : (*it->second)(buffer, size);
+        const page* allocators = get_registry().load()->pages[identifier >> PAGE_BITS];
+        if (!allocators || !allocators->allocators[identifier & PAGE_MASK]) {
+            return 0;
+        }
+        return (*allocators->allocators[identifier & PAGE_MASK])(buffer, size);
     }
 
     static bool pdu_type_registered(PDU::PDUType type) {
-        return pdu_types.count(type) != 0;
+        return find_pdu_type(type) != 0;
     }
 
     static id_type pdu_type_to_id(PDU::PDUType type) {
-        typename pdu_map_types::const_iterator it = pdu_types.find(type);
-        return it->second;
+        return find_pdu_type(type)->second;
     }
 private:
-    typedef std::map<id_type, allocator_type> allocators_type;
-    typedef std::map<PDU::PDUType, id_type> pdu_map_types;
+    #ifdef TINS_HAVE_CXX11
+        static_assert(sizeof(id_type) <= 2, "Identifiers can be at most 16 bits long");
+    #endif // TINS_HAVE_CXX11
 
-    static allocators_type allocators;
-    static pdu_map_types pdu_types;
-};
+    static const size_t PAGE_BITS = 8;
+    static const size_t PAGE_SIZE = size_t(1) << PAGE_BITS;
+    static const size_t PAGE_MASK = PAGE_SIZE - 1;
+    static const size_t PAGE_COUNT = (size_t(1) << (8 * sizeof(id_type))) / PAGE_SIZE;
 
-template<typename Tag>
-typename PDUAllocator<Tag>::allocators_type PDUAllocator<Tag>::allocators;
+    typedef std::pair<PDU::PDUType, id_type> pdu_type_entry;
+    typedef std::vector<pdu_type_entry> pdu_types_type;
 
-template<typename Tag>
-typename PDUAllocator<Tag>::pdu_map_types PDUAllocator<Tag>::pdu_types;
+    struct page {
+        page() {
+            std::fill(allocators, allocators + PAGE_SIZE, allocator_type());
+        }
 
-template<typename IDType>
-struct pdu_tag {
-    typedef IDType identifier_type;
+        allocator_type allocators[PAGE_SIZE];
+    };
+
+    struct table {
+        table() {
+            std::fill(pages, pages + PAGE_COUNT, static_cast<const page*>(0));
+        }
+
+        // Pages are shared with the previous snapshots
+        const page* pages[PAGE_COUNT];
+        // Only contains registered allocators, sorted by PDU type
+        pdu_types_type pdu_types;
+    };
+
+    struct registry {
+        registry() : current(0) {
+            std::vector<std::pair<id_type, allocator_type> > allocators;
+            builtin_allocators(Tag(), allocators);
+            table* initial = new table();
+            tables.push_back(initial);
+            for (size_t i = 0; i < allocators.size(); ++i) {
+                set_allocator(*this, *initial, allocators[i].first, allocators[i].second);
+            }
+            store(initial);
+        }
+
+        ~registry() {
+            for (size_t i = 0; i < tables.size(); ++i) {
+                delete tables[i];
+            }
+            for (size_t i = 0; i < pages.size(); ++i) {
+                delete pages[i];
+            }
+        }
+
+        const table* load() const {
+            #ifdef TINS_HAVE_CXX11
+                return current.load(std::memory_order_acquire);
+            #else
+                return current;
+            #endif // TINS_HAVE_CXX11
+        }
+
+        void store(const table* value) {
+            #ifdef TINS_HAVE_CXX11
+                current.store(value, std::memory_order_release);
+            #else
+                current = value;
+            #endif // TINS_HAVE_CXX11
+        }
+
+        #ifdef TINS_HAVE_CXX11
+            std::atomic<const table*> current;
+            std::mutex registration_mutex;
+        #else
+            const table* current;
+        #endif // TINS_HAVE_CXX11
+        // Every table and page ever published, including retired ones
+        std::vector<const table*> tables;
+        std::vector<const page*> pages;
+    private:
+        registry(const registry&);
+        registry& operator=(const registry&);
+    };
+
+    static registry& get_registry() {
+        static registry instance;
+        return instance;
+    }
+
+    // Copies the page the identifier lives in, as it may be shared
+    static void set_allocator(registry& instance, table& output, id_type identifier,
+                              allocator_type allocator) {
+        const size_t page_index = identifier >> PAGE_BITS;
+        const page* current = output.pages[page_index];
+        page* updated = current ? new page(*current) : new page();
+        instance.pages.push_back(updated);
+        updated->allocators[identifier & PAGE_MASK] = allocator;
+        output.pages[page_index] = updated;
+    }
+
+    static const pdu_type_entry* find_pdu_type(PDU::PDUType type) {
+        const table* current = get_registry().load();
+        typename pdu_types_type::const_iterator it = std::lower_bound(
+            current->pdu_types.begin(),
+            current->pdu_types.end(),
+            pdu_type_entry(type, id_type())
+        );
+        return (it != current->pdu_types.end() && it->first == type) ? &*it : 0;
+    }
 };
 
 template<typename PDUType>
@@ -161,6 +300,13 @@ namespace Allocators {
  * registering an allocator for EthernetII will make it work for 
  * the rest of the link layer protocols, sine they should all work 
  * the same way.
+ *
+ * Registered allocators live in the same flat tables, indexed by the
+ * identifier, as the ones for the protocols supported by the library, 
+ * so using them is as cheap as using the built-in ones. Registering an 
+ * allocator for an identifier used by a built-in protocol replaces it.
+ * If libtins was built with C++11 support, allocators can be registered 
+ * while packets are being decoded on other threads.
  */
 template<typename PDUType, typename AllocatedType>
 void register_allocator(typename Internals::pdu_tag_mapper<PDUType>::type::identifier_type id) {
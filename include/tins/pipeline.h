@@ -0,0 +1,369 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_PIPELINE_H
+#define TINS_PIPELINE_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_CXX11
+
+#include <vector>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <utility>
+#include <stdint.h>
+#include <tins/packet.h>
+#include <tins/packet_queue.h>
+
+namespace Tins {
+
+/**
+ * \class Pipeline
+ * \brief Hands values from a single producer thread to several workers.
+ *
+ * Each worker runs on its own thread and owns an SPSCQueue in which the
+ * producer pushes values. This means handing a value over to a worker
+ * doesn't take any locks nor allocate memory, other than whatever the
+ * value itself requires when being moved.
+ *
+ * Values can be pushed in round robin order or to a specific worker.
+ * The latter allows keeping per flow state on each worker without any
+ * synchronization, e.g. by picking the worker based on 
+ * ParallelFileProcessor::flow_hash.
+ *
+ * When a worker's queue is full, the pipeline's OverflowPolicy determines
+ * what happens: either the producer waits until there's room for the 
+ * value or the value is dropped. The amount of dropped values is tracked
+ * per worker.
+ *
+ * Pipeline::start takes a factory that is called once per worker and has
+ * to return the functor that worker will call for each value it pops:
+ *
+ * \code
+ * Sniffer sniffer("eth0");
+ * Pipeline<Packet> pipeline(4);
+ * pipeline.start([&](size_t index) {
+ *     return [](Packet& packet) {
+ *         // Process packet
+ *     };
+ * });
+ * while (Packet packet = sniffer.next_packet()) {
+ *     pipeline.push(std::move(packet));
+ * }
+ * pipeline.stop();
+ * \endcode
+ *
+ * Every method other than Pipeline::dropped, Pipeline::pushed and
+ * Pipeline::queued has to be called from the producer thread.
+ *
+ * \tparam T The type of the values handed to the workers. Both Packet and
+ * LazyPacket, which keeps the raw captured bytes, can be used.
+ */
+template <typename T = Packet>
+class Pipeline {
+public:
+    /**
+     * The type of the values handed to the workers.
+     */
+    typedef T value_type;
+
+    /**
+     * The type used to store the amount of workers.
+     */
+    typedef size_t size_type;
+
+    /**
+     * \brief The policy used when a worker's queue is full.
+     */
+    enum OverflowPolicy {
+        BLOCK, ///< Wait until there's room in the queue
+        DROP   ///< Drop the value
+    };
+
+    /**
+     * The default capacity of each worker's queue.
+     */
+    static const size_t DEFAULT_QUEUE_CAPACITY = 4096;
+
+    /**
+     * \brief Constructs a pipeline.
+     *
+     * No threads are started until Pipeline::start is called.
+     *
+     * \param size The amount of workers to use.
+     * \param queue_capacity The capacity of each worker's queue.
+     * \param policy The policy used when a worker's queue is full.
+     */
+    Pipeline(size_type size, size_t queue_capacity = DEFAULT_QUEUE_CAPACITY,
+             OverflowPolicy policy = BLOCK)
+    : policy_(policy), next_(0), pushed_(0), stopping_(false), failed_(false) {
+        for (size_type i = 0; i < size; ++i) {
+            workers_.emplace_back(new worker(queue_capacity));
+        }
+    }
+
+    /**
+     * \brief Destructor.
+     *
+     * If the workers are still running, they are stopped. Any exception
+     * thrown by them is discarded.
+     */
+    ~Pipeline() {
+        try {
+            stop();
+        }
+        catch (...) {
+
+        }
+    }
+
+    /**
+     * \brief Gets the amount of workers.
+     */
+    size_type size() const {
+        return workers_.size();
+    }
+
+    /**
+     * \brief Gets the policy used when a worker's queue is full.
+     */
+    OverflowPolicy overflow_policy() const {
+        return policy_;
+    }
+
+    /**
+     * \brief Starts the workers.
+     *
+     * The factory is called on the calling thread once for each worker,
+     * using the worker's index as its argument. The functor it returns
+     * will be called on that worker's thread using a value_type& for each
+     * value popped from its queue. Its return value, if any, is ignored.
+     *
+     * \param factory The functor factory.
+     */
+    template <typename FunctorFactory>
+    void start(FunctorFactory factory);
+
+    /**
+     * \brief Pushes a value to the next worker, in round robin order.
+     *
+     * \param value The value to push.
+     * \return false if the value was dropped.
+     */
+    bool push(value_type&& value) {
+        const size_type index = next_;
+        next_ = (next_ + 1 == workers_.size()) ? 0 : next_ + 1;
+        return push(std::move(value), index);
+    }
+
+    /**
+     * \brief Pushes a value to the given worker.
+     *
+     * If the worker's queue is full, this either waits until there's room
+     * for the value or drops it, depending on the overflow policy. Values
+     * are always dropped after a worker has thrown an exception.
+     *
+     * \param value The value to push.
+     * \param index The index of the worker to push it to.
+     * \return false if the value was dropped.
+     */
+    bool push(value_type&& value, size_type index);
+
+    /**
+     * \brief Stops the workers.
+     *
+     * Each worker processes the values left in its queue before stopping.
+     * This blocks until every worker's thread is done. If any of the 
+     * workers threw an exception, it is rethrown here.
+     */
+    void stop();
+
+    /**
+     * \brief Gets the amount of values pushed to the workers' queues.
+     */
+    uint64_t pushed() const {
+        return pushed_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Gets the amount of values dropped across all workers.
+     */
+    uint64_t dropped() const {
+        uint64_t output = 0;
+        for (size_type i = 0; i < workers_.size(); ++i) {
+            output += dropped(i);
+        }
+        return output;
+    }
+
+    /**
+     * \brief Gets the amount of values dropped for the given worker.
+     *
+     * \param index The index of the worker.
+     */
+    uint64_t dropped(size_type index) const {
+        return workers_[index]->dropped.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * \brief Gets the amount of values waiting in the given worker's queue.
+     *
+     * \param index The index of the worker.
+     */
+    size_t queued(size_type index) const {
+        return workers_[index]->queue.size();
+    }
+private:
+    struct worker {
+        worker(size_t capacity)
+        : queue(capacity), dropped(0) {
+
+        }
+
+        SPSCQueue<value_type> queue;
+        std::atomic<uint64_t> dropped;
+        std::thread thread;
+    };
+
+    Pipeline(const Pipeline&);
+    Pipeline& operator=(const Pipeline&);
+
+    template <typename Functor>
+    void run_worker(worker& current, Functor& function);
+    static void wait(size_t& iteration);
+
+    std::vector<std::unique_ptr<worker>> workers_;
+    OverflowPolicy policy_;
+    size_type next_;
+    std::atomic<uint64_t> pushed_;
+    std::atomic<bool> stopping_;
+    std::exception_ptr error_;
+    std::atomic<bool> failed_;
+};
+
+template <typename T>
+template <typename FunctorFactory>
+void Pipeline<T>::start(FunctorFactory factory) {
+    stop();
+    stopping_ = false;
+    failed_ = false;
+    error_ = std::exception_ptr();
+    for (size_type i = 0; i < workers_.size(); ++i) {
+        worker* current = workers_[i].get();
+        auto function = factory(i);
+        current->thread = std::thread([this, current, function]() mutable {
+            run_worker(*current, function);
+        });
+    }
+}
+
+template <typename T>
+bool Pipeline<T>::push(value_type&& value, size_type index) {
+    worker& current = *workers_[index];
+    size_t iteration = 0;
+    while (!failed_.load(std::memory_order_relaxed)) {
+        if (current.queue.try_push(std::move(value))) {
+            pushed_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        if (policy_ == DROP) {
+            break;
+        }
+        wait(iteration);
+    }
+    current.dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+template <typename T>
+void Pipeline<T>::stop() {
+    stopping_.store(true, std::memory_order_release);
+    for (size_type i = 0; i < workers_.size(); ++i) {
+        if (workers_[i]->thread.joinable()) {
+            workers_[i]->thread.join();
+        }
+    }
+    if (error_) {
+        std::exception_ptr error = error_;
+        error_ = std::exception_ptr();
+        std::rethrow_exception(error);
+    }
+}
+
+template <typename T>
+template <typename Functor>
+void Pipeline<T>::run_worker(worker& current, Functor& function) {
+    value_type value;
+    size_t iteration = 0;
+    try {
+        while (!failed_.load(std::memory_order_relaxed)) {
+            if (current.queue.try_pop(value)) {
+                function(value);
+                iteration = 0;
+            }
+            // Values pushed before stop was called are visible by now
+            else if (stopping_.load(std::memory_order_acquire)) {
+                if (current.queue.empty()) {
+                    break;
+                }
+            }
+            else {
+                wait(iteration);
+            }
+        }
+    }
+    catch (...) {
+        // Only the first exception is kept
+        if (!failed_.exchange(true)) {
+            error_ = std::current_exception();
+        }
+    }
+}
+
+template <typename T>
+void Pipeline<T>::wait(size_t& iteration) {
+    // Spin for a while, then back off so idle workers don't burn a core
+    ++iteration;
+    if (iteration >= 128) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+    else if (iteration >= 64) {
+        std::this_thread::yield();
+    }
+}
+
+} // Tins
+
+#endif // TINS_HAVE_CXX11
+
+#endif // TINS_PIPELINE_H
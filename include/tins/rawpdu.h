@@ -32,6 +32,10 @@
 
 #include <vector>
 #include <string>
+#include <tins/config.h>
+#ifdef TINS_HAVE_CXX11
+    #include <atomic>
+#endif // TINS_HAVE_CXX11
 #include <tins/pdu.h>
 #include <tins/macros.h>
 #include <tins/cxxstd.h>
@@ -60,6 +64,29 @@ namespace Tins {
  * // don't look like DNS
  * DNS dns = raw.to<DNS>();
  * \endcode
+ *
+ * A RawPDU can also reference the buffer it was constructed from instead
+ * of copying it. This happens when it's constructed using the 
+ * RawPDU::borrow_payload tag, or while a RawPDU::zero_copy_scope is 
+ * active on the current thread, which sniffers do when zero copy payloads
+ * are enabled. In this case, the buffer has to outlive the RawPDU. The 
+ * payload is copied into an internal buffer when RawPDU::own_payload or
+ * the non-const RawPDU::payload getter is called, or when the RawPDU is
+ * copied or cloned. RawPDU::payload_data and RawPDU::payload_size can be
+ * used to read it without copying it.
+ *
+ * Copies and clones of a RawPDU share their payload's storage until
+ * either of them modifies it, either through a setter or through the
+ * non-const RawPDU::payload getter. This makes cloning PDU chains, which
+ * happens when copying a Packet or using PDU::operator/, cheap for large
+ * payloads. As a consequence, references returned by RawPDU::payload
+ * should not be kept after the RawPDU is modified.
+ *
+ * The reference counted storage is only allocated the first time a RawPDU
+ * is copied, so RawPDUs which are never copied don't pay for it. That 
+ * first copy duplicates the payload, since the source keeps its own 
+ * buffer, but copies of copies don't. Copying never modifies the source's
+ * payload, so the same RawPDU can be copied from several threads at once.
  */
 class TINS_API RawPDU : public PDU {
 public:
@@ -73,15 +100,86 @@ public:
      */
     static const PDU::PDUType pdu_flag = PDU::RAW;
 
+    /**
+     * \brief Tag used to construct a RawPDU which references its payload.
+     */
+    struct borrow_payload { };
+
+    #ifdef TINS_HAVE_CXX11
+        /**
+         * \brief Makes RawPDUs reference the buffer they're constructed from.
+         *
+         * While an instance of this class is alive, RawPDUs constructed on
+         * the current thread using RawPDU::RawPDU(const uint8_t*, uint32_t),
+         * which is the constructor used when parsing packets, will reference
+         * the buffer instead of copying it. The previous behavior is restored
+         * when this object is destroyed.
+         */
+        class TINS_API zero_copy_scope {
+        public:
+            /**
+             * \brief Enables or disables zero copy payloads on this thread.
+             *
+             * \param enabled Whether to enable zero copy payloads.
+             */
+            explicit zero_copy_scope(bool enabled = true);
+
+            /**
+             * \brief Restores the previous behavior.
+             */
+            ~zero_copy_scope();
+
+            /**
+             * \brief Indicates whether zero copy payloads are enabled on
+             * the current thread.
+             */
+            static bool is_enabled();
+        private:
+            zero_copy_scope(const zero_copy_scope&);
+            zero_copy_scope& operator=(const zero_copy_scope&);
+
+            bool previous_;
+        };
+    #endif // TINS_HAVE_CXX11
+
     /** 
      * \brief Creates an instance of RawPDU.
      *
      * The payload is copied, therefore the original payload's memory
-     * must be freed by the user.
+     * must be freed by the user. If there's a RawPDU::zero_copy_scope 
+     * enabled on this thread, the payload is referenced instead.
+     *
      * \param pload The payload which the RawPDU will contain.
      * \param size The size of the payload.
      */
     RawPDU(const uint8_t* pload, uint32_t size);
+
+    /** 
+     * \brief Creates an instance of RawPDU which references its payload.
+     *
+     * The payload is not copied, so it has to outlive this RawPDU or 
+     * until the payload is copied by accessing it through RawPDU::payload.
+     *
+     * \param pload The payload which the RawPDU will reference.
+     * \param size The size of the payload.
+     */
+    RawPDU(const uint8_t* pload, uint32_t size, borrow_payload);
+
+    /**
+     * \brief Copy constructor.
+     *
+     * A referenced payload is always copied. Otherwise, the payload's
+     * storage is shared with the source RawPDU.
+     */
+    RawPDU(const RawPDU& other);
+
+    /**
+     * \brief Copy assignment operator.
+     *
+     * A referenced payload is always copied. Otherwise, the payload's
+     * storage is shared with the source RawPDU.
+     */
+    RawPDU& operator=(const RawPDU& other);
     
     /**
      * \brief Constructs a RawPDU from an iterator range.
@@ -94,7 +192,10 @@ public:
      */
     template<typename ForwardIterator>
     RawPDU(ForwardIterator start, ForwardIterator end) 
-    : payload_(start, end) { }
+    : payload_(start, end), shared_(0), borrowed_payload_(0), borrowed_size_(0),
+      shareable_(true) {
+
+    }
 
     /**
      * \brief Creates an instance of RawPDU from a payload_type.
@@ -104,7 +205,10 @@ public:
      * \param data The payload to use.
      */
     RawPDU(const payload_type & data)
-            : payload_(data) { }
+    : payload_(data), shared_(0), borrowed_payload_(0), borrowed_size_(0),
+      shareable_(true) {
+
+    }
 
     #if TINS_IS_CXX11
         /** 
@@ -115,9 +219,52 @@ public:
          * \param data The payload to use.
          */
         RawPDU(payload_type&& data)
-        : payload_(move(data)) { }
+        : payload_(std::move(data)), shared_(0), borrowed_payload_(0), borrowed_size_(0),
+          shareable_(true) {
+
+        }
+
+        /**
+         * \brief Move constructor.
+         *
+         * If the source RawPDU references its payload, so will this one.
+         */
+        RawPDU(RawPDU&& other) TINS_NOEXCEPT
+        : PDU(std::move(other)), payload_(std::move(other.payload_)), shared_(other.shared()),
+          borrowed_payload_(other.borrowed_payload_), borrowed_size_(other.borrowed_size_),
+          shareable_(other.shareable_) {
+            other.set_shared(0);
+            other.borrowed_payload_ = 0;
+            other.borrowed_size_ = 0;
+        }
+
+        /**
+         * \brief Move assignment operator.
+         *
+         * If the source RawPDU references its payload, so will this one.
+         */
+        RawPDU& operator=(RawPDU&& other) TINS_NOEXCEPT {
+            if (this != &other) {
+                PDU::operator=(std::move(other));
+                release_payload();
+                payload_ = std::move(other.payload_);
+                set_shared(other.shared());
+                borrowed_payload_ = other.borrowed_payload_;
+                borrowed_size_ = other.borrowed_size_;
+                shareable_ = other.shareable_;
+                other.set_shared(0);
+                other.borrowed_payload_ = 0;
+                other.borrowed_size_ = 0;
+            }
+            return *this;
+        }
     #endif // TINS_IS_CXX11
 
+    /**
+     * \brief Destructor.
+     */
+    ~RawPDU();
+
     /** 
      * \brief Creates an instance of RawPDU from an input string.
      * 
@@ -138,23 +285,67 @@ public:
      */
     template<typename ForwardIterator>
     void payload(ForwardIterator start, ForwardIterator end) {
-        payload_.assign(start, end);
+        payload_type data(start, end);
+        assign_payload(data);
     }
 
     /** 
      * \brief Const getter for the payload.
+     *
+     * This never copies the payload. If it's referenced, this throws 
+     * since there's no payload_type to return; use RawPDU::payload_data
+     * and RawPDU::payload_size, or call RawPDU::own_payload first.
+     *
+     * \throw payload_not_owned If the payload is referenced.
      * \return The RawPDU's payload.
      */
-    const payload_type& payload() const {
-        return payload_;
-    }
+    const payload_type& payload() const;
     
     /** 
      * \brief Non-const getter for the payload.
+     *
+     * If the payload is referenced or shared with a copy of this RawPDU,
+     * it's copied first. Since the returned reference can be used to
+     * modify it, copies made afterwards won't share the payload either,
+     * until a new one is set through one of the setters.
+     *
      * \return The RawPDU's payload.
      */
-    payload_type& payload() {
-        return payload_;
+    payload_type& payload();
+
+    /**
+     * \brief Getter for a pointer to the payload.
+     *
+     * Unlike RawPDU::payload, this never copies the payload.
+     */
+    const uint8_t* payload_data() const {
+        if (borrowed_payload_) {
+            return borrowed_payload_;
+        }
+        const payload_type& data = stored_payload();
+        return data.empty() ? 0 : &data[0];
+    }
+
+    /**
+     * \brief Indicates whether this RawPDU shares its payload's storage
+     * with a copy of it.
+     */
+    bool is_payload_shared() const;
+
+    /**
+     * \brief Copies a referenced payload into this RawPDU.
+     *
+     * Afterwards, the buffer this RawPDU was constructed from no longer
+     * has to outlive it. This does nothing if the payload is already owned.
+     */
+    void own_payload();
+
+    /**
+     * \brief Indicates whether this RawPDU references its payload rather
+     * than owning it.
+     */
+    bool is_payload_borrowed() const {
+        return borrowed_payload_ != 0;
     }
     
     /** 
@@ -172,7 +363,10 @@ public:
      * \return uint32_t containing the payload size.
      */
     uint32_t payload_size() const {
-        return static_cast<uint32_t>(payload_.size());
+        if (borrowed_payload_) {
+            return borrowed_size_;
+        }
+        return static_cast<uint32_t>(stored_payload().size());
     }
 
     /**
@@ -201,7 +395,7 @@ public:
      */
     template<typename T>
     T to() const {
-        return T(&payload_[0], static_cast<uint32_t>(payload_.size()));
+        return T(payload_data(), payload_size());
     }
     
     /**
@@ -211,9 +405,58 @@ public:
         return new RawPDU(*this);
     }
 private:
+    // Reference counted payload storage, shared between copies
+    struct shared_payload {
+        shared_payload(const payload_type& data) : data(data), refcount(1) { }
+
+        payload_type data;
+        #ifdef TINS_HAVE_CXX11
+            std::atomic<uint32_t> refcount;
+        #else
+            uint32_t refcount;
+        #endif // TINS_HAVE_CXX11
+    };
+
+    shared_payload* shared() const {
+        #ifdef TINS_HAVE_CXX11
+            return shared_.load(std::memory_order_acquire);
+        #else
+            return shared_;
+        #endif // TINS_HAVE_CXX11
+    }
+
+    void set_shared(shared_payload* shared) {
+        #ifdef TINS_HAVE_CXX11
+            shared_.store(shared, std::memory_order_release);
+        #else
+            shared_ = shared;
+        #endif // TINS_HAVE_CXX11
+    }
+
+    const payload_type& stored_payload() const {
+        shared_payload* shared = this->shared();
+        return shared ? shared->data : payload_;
+    }
+
     void write_serialization(uint8_t* buffer, uint32_t total_sz);
+    void assign_payload(payload_type& data);
+    void share_payload(const RawPDU& other);
+    shared_payload* acquire_shared_payload() const;
+    void release_payload();
 
+    // Empty in copies that share their payload. The RawPDU that was copied
+    // first keeps it, so copying never modifies the source's payload
     payload_type payload_;
+    // The only state copies can modify, by publishing the shared storage
+    #ifdef TINS_HAVE_CXX11
+        mutable std::atomic<shared_payload*> shared_;
+    #else
+        shared_payload* shared_;
+    #endif // TINS_HAVE_CXX11
+    const uint8_t* borrowed_payload_;
+    uint32_t borrowed_size_;
+    // False while a non-const reference to the payload may be in use
+    bool shareable_;
 };
 
 } // Tins
@@ -0,0 +1,557 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_RING_SNIFFER_H
+#define TINS_RING_SNIFFER_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_TPACKET_V3
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/packet.h>
+#include <tins/lazy_packet.h>
+#include <tins/packet_arena.h>
+#include <tins/packet_decoder.h>
+#include <tins/pdu.h>
+#include <tins/timestamp.h>
+#include <tins/exceptions.h>
+#include <tins/detail/type_traits.h>
+
+namespace Tins {
+
+class RingSniffer;
+class SnifferGroup;
+
+/**
+ * \class RingSnifferConfiguration
+ * \brief Represents the configuration of a RingSniffer object.
+ *
+ * The RX ring is made of block_count blocks of block_size bytes each.
+ * The kernel fills one block at a time and hands it over to user space
+ * either when it's full or when the block timeout expires.
+ *
+ * \code
+ * RingSnifferConfiguration config;
+ * config.set_block_size(1 << 22);
+ * config.set_block_count(128);
+ * config.set_promisc_mode(true);
+ *
+ * RingSniffer sniffer("eth0", config);
+ * \endcode
+ */
+class TINS_API RingSnifferConfiguration {
+public:
+    /**
+     * \brief The ways in which packets are spread among the sockets in a
+     * fanout group.
+     *
+     * \sa RingSnifferConfiguration::set_fanout
+     */
+    enum FanoutMode {
+        /**
+         * Packets are assigned using the kernel's flow hash. Both directions
+         * of a connection are mapped to the same socket and IP fragments
+         * are reassembled before being hashed.
+         */
+        FANOUT_HASH,
+
+        /**
+         * Packets are assigned to sockets in a round robin fashion.
+         */
+        FANOUT_ROUND_ROBIN,
+
+        /**
+         * Packets are assigned based on the CPU they were received on.
+         */
+        FANOUT_CPU
+    };
+
+    /**
+     * \brief The default block size.
+     *
+     * This is 1 MiB by default.
+     */
+    static const uint32_t DEFAULT_BLOCK_SIZE;
+
+    /**
+     * \brief The default amount of blocks in the ring.
+     *
+     * This is 64 by default.
+     */
+    static const uint32_t DEFAULT_BLOCK_COUNT;
+
+    /**
+     * \brief The default frame size.
+     *
+     * This is 2048 by default.
+     */
+    static const uint32_t DEFAULT_FRAME_SIZE;
+
+    /**
+     * \brief The default block retire timeout, in milliseconds.
+     *
+     * This is 10 by default.
+     */
+    static const uint32_t DEFAULT_BLOCK_TIMEOUT;
+
+    /**
+     * \brief The default poll timeout, in milliseconds.
+     *
+     * This is 1000 by default.
+     */
+    static const uint32_t DEFAULT_TIMEOUT;
+
+    /**
+     * Default constructs a RingSnifferConfiguration.
+     */
+    RingSnifferConfiguration();
+
+    /**
+     * \brief Sets the size of each block in the ring.
+     *
+     * This has to be a multiple of the page size and of the frame size.
+     *
+     * \param block_size The block size to be set.
+     */
+    void set_block_size(uint32_t block_size);
+
+    /**
+     * Sets the amount of blocks in the ring.
+     * \param block_count The block count to be set.
+     */
+    void set_block_count(uint32_t block_count);
+
+    /**
+     * \brief Sets the frame size.
+     *
+     * Since TPACKET_V3 packs frames with variable length inside each block,
+     * this is only used by the kernel to validate the ring's layout. It has
+     * to be a multiple of 16.
+     *
+     * \param frame_size The frame size to be set.
+     */
+    void set_frame_size(uint32_t frame_size);
+
+    /**
+     * \brief Sets the block retire timeout.
+     *
+     * A block which is not full will be handed to user space after this
+     * amount of milliseconds have elapsed since its first packet was written.
+     *
+     * \param timeout The timeout to be set, in milliseconds.
+     */
+    void set_block_timeout(uint32_t timeout);
+
+    /**
+     * \brief Sets the poll timeout.
+     *
+     * This is the maximum amount of time the sniffer will block waiting
+     * for a block. Once it expires, calls that retrieve a single frame or
+     * batch return, while sniffing loops check whether
+     * RingSniffer::stop_sniff was called and keep waiting otherwise.
+     *
+     * \param timeout The timeout to be set, in milliseconds.
+     */
+    void set_timeout(uint32_t timeout);
+
+    /**
+     * Sets the promiscuous mode option.
+     * \param enabled The promiscuous mode value.
+     */
+    void set_promisc_mode(bool enabled);
+
+    /**
+     * \brief Sets a pcap filter to use on the sniffer.
+     *
+     * The filter is compiled using libpcap and attached to the socket, so
+     * filtering happens inside the kernel. If libtins was built without
+     * libpcap, constructing a RingSniffer using a filter will throw
+     * feature_disabled.
+     *
+     * \param filter The pcap filter to be used.
+     */
+    void set_filter(const std::string& filter);
+
+    /**
+     * \brief Makes the sniffer join a PACKET_FANOUT group.
+     *
+     * Every socket bound to the same interface that joins the same group
+     * receives a disjoint subset of the packets, as determined by the
+     * fanout mode. All members of a group must use the same mode.
+     *
+     * \param group_id The identifier of the group to join.
+     * \param mode The mode used to assign packets to sockets.
+     * \sa SnifferGroup
+     */
+    void set_fanout(uint16_t group_id, FanoutMode mode);
+
+    /**
+     * \brief Makes the sniffer create a new PACKET_FANOUT group.
+     *
+     * The group's identifier isn't used by any other group, including
+     * those created by other processes. Other sniffers can join it by
+     * calling RingSnifferConfiguration::set_fanout using the identifier
+     * returned by RingSniffer::fanout_group_id.
+     *
+     * On kernels older than 4.12, which can't pick the identifier, free
+     * identifiers are probed instead. A group that another process created
+     * using the same mode on the same interface can't be told apart from a
+     * free identifier there.
+     *
+     * \param mode The mode used to assign packets to sockets.
+     * \sa SnifferGroup
+     */
+    void set_fanout(FanoutMode mode);
+
+    /**
+     * \brief Sets whether decoded PDUs are allocated from a PacketArena.
+     *
+     * This behaves just like BaseSniffer::set_arena_allocation.
+     *
+     * \param enabled Whether to use an arena or not.
+     */
+    void set_arena_allocation(bool enabled);
+
+    /**
+     * \brief Sets whether decoded payloads reference the ring's frames.
+     *
+     * If enabled, RawPDUs reference the frame they were decoded from 
+     * rather than copying it. A frame is given back to the kernel once
+     * every frame in its block has been read, so packets have to be 
+     * copied (which copies the payloads) if they're to be kept after the 
+     * next call to RingSniffer::next_packet or RingSniffer::next_packets, 
+     * or after the functor passed to RingSniffer::sniff_loop returns.
+     *
+     * \param enabled Whether to enable zero copy payloads.
+     * \sa RawPDU::zero_copy_scope
+     */
+    void set_zero_copy_payloads(bool enabled);
+
+    /**
+     * \brief Sets the last layer decoded in captured packets.
+     *
+     * This behaves just like BaseSniffer::set_max_decode_layer.
+     *
+     * \param layer The last layer to be decoded.
+     */
+    void set_max_decode_layer(PacketDecoder::Layer layer);
+private:
+    friend class RingSniffer;
+
+    uint32_t block_size_;
+    uint32_t block_count_;
+    uint32_t frame_size_;
+    uint32_t block_timeout_;
+    uint32_t timeout_;
+    bool promisc_;
+    std::string filter_;
+    bool fanout_enabled_;
+    bool fanout_new_group_;
+    uint16_t fanout_group_id_;
+    FanoutMode fanout_mode_;
+    bool arena_allocation_;
+    bool zero_copy_payloads_;
+    PacketDecoder::Layer max_decode_layer_;
+};
+
+/**
+ * \class RingSniffer
+ * \brief Captures packets using a Linux TPACKET_V3 memory mapped ring.
+ *
+ * This class opens an AF_PACKET socket and sets up a TPACKET_V3 RX ring on
+ * it, without going through libpcap. The kernel writes packets directly
+ * into the blocks of the memory mapped ring, and this class walks them in
+ * place, only copying the data when it is decoded into a PDU.
+ *
+ * Frames can be read without decoding them by using RingSniffer::next_frame.
+ * The rest of the interface mirrors BaseSniffer's, so switching from a
+ * Sniffer to a RingSniffer should only require changing the constructor:
+ *
+ * \code
+ * RingSniffer sniffer("eth0");
+ * sniffer.sniff_loop([&](Packet& packet) {
+ *     // process packet
+ *     return true;
+ * });
+ * \endcode
+ *
+ * Opening an AF_PACKET socket requires the CAP_NET_RAW capability.
+ *
+ * \sa RingSnifferConfiguration
+ */
+class TINS_API RingSniffer {
+public:
+    /**
+     * \brief Represents a frame stored in the ring.
+     *
+     * The data pointer points inside the ring, so it's only valid until
+     * the next call to RingSniffer::next_frame.
+     */
+    struct frame {
+        /**
+         * Pointer to the frame's link layer header.
+         */
+        const uint8_t* data;
+
+        /**
+         * The captured size of this frame.
+         */
+        uint32_t size;
+
+        /**
+         * The size of this frame on the wire.
+         */
+        uint32_t length;
+
+        /**
+         * The time at which this frame was captured.
+         */
+        Timestamp timestamp;
+
+        /**
+         * The time at which this frame was captured, in nanoseconds since
+         * the epoch. This keeps the full precision of the kernel's
+         * timestamp, which RingSniffer::frame::timestamp truncates to
+         * microseconds.
+         */
+        uint64_t timestamp_ns;
+    };
+
+    /**
+     * \brief Constructs an instance using the default configuration.
+     *
+     * \param device The name of the interface to sniff on.
+     */
+    RingSniffer(const std::string& device);
+
+    /**
+     * \brief Constructs an instance using the given configuration.
+     *
+     * \param device The name of the interface to sniff on.
+     * \param configuration The configuration to use.
+     */
+    RingSniffer(const std::string& device,
+                const RingSnifferConfiguration& configuration);
+
+    /**
+     * \brief Unmaps the ring and closes the socket.
+     */
+    ~RingSniffer();
+
+    /**
+     * \brief Retrieves the next frame in the ring without decoding it.
+     *
+     * This call blocks until there is a frame available or the poll
+     * timeout expires. When the last frame in a block has been read, the
+     * following call to this method will hand that block back to the kernel.
+     *
+     * If the interface's link layer is Ethernet, VLAN tags stripped by the
+     * kernel are put back into the frame, just like libpcap does.
+     *
+     * \param output The frame in which to store the frame's information.
+     * \return false if sniffing was stopped, the timeout expired or polling
+     * the socket failed, true otherwise.
+     */
+    bool next_frame(frame& output);
+
+    /**
+     * \brief Retrieves and decodes the next packet.
+     *
+     * Frames which can't be decoded are skipped.
+     *
+     * \return The captured packet. This will contain a null PDU if sniffing
+     * was stopped or the timeout expired.
+     */
+    Packet next_packet();
+
+    /**
+     * \brief Retrieves and decodes the frames in the next available block.
+     *
+     * This call blocks until there is at least one frame available, or
+     * the poll timeout expires, and then decodes every remaining frame in
+     * the current block, up to max_packets of them.
+     *
+     * \param batch The vector in which to store the packets. It will be
+     * cleared before being filled.
+     * \param max_packets The maximum amount of packets to retrieve,
+     * 0 meaning no limit.
+     * \return false if sniffing was stopped, the timeout expired or polling
+     * the socket failed, true otherwise.
+     */
+    bool next_packets(std::vector<Packet>& batch, uint32_t max_packets = 0);
+
+    /**
+     * \brief Retrieves the next packet without decoding it.
+     *
+     * The frame's bytes are copied into the given LazyPacket.
+     *
+     * \param packet The packet in which to store the frame.
+     * \return false if sniffing was stopped, the timeout expired or polling
+     * the socket failed, true otherwise.
+     * \sa BaseSniffer::next_packet(LazyPacket&)
+     */
+    bool next_packet(LazyPacket& packet);
+
+    /**
+     * \brief Starts a sniffing loop, using a callback functor for every
+     * sniffed packet.
+     *
+     * This behaves just like BaseSniffer::sniff_loop.
+     *
+     * \param function The callback functor.
+     * \param max_packets The maximum amount of packets to sniff. 0 == infinite.
+     */
+    template <typename Functor>
+    void sniff_loop(Functor function, uint32_t max_packets = 0);
+
+    /**
+     * \brief Starts a sniffing loop that delivers packets without decoding them.
+     *
+     * This behaves just like BaseSniffer::sniff_lazy_loop.
+     *
+     * \param function The callback functor.
+     * \param max_packets The maximum amount of packets to sniff. 0 == infinite.
+     */
+    template <typename Functor>
+    void sniff_lazy_loop(Functor function, uint32_t max_packets = 0);
+
+    /**
+     * \brief Stops sniffing loops.
+     *
+     * This can be called from any thread. The sniffing call blocked on
+     * the ring will return within the configured poll timeout, or once
+     * it's done with the block currently being read.
+     */
+    void stop_sniff();
+
+    /**
+     * \brief Gets the file descriptor of the underlying socket.
+     */
+    int get_fd() const;
+
+    /**
+     * \brief Gets the type of the link layer PDU that frames are decoded as.
+     */
+    PDU::PDUType link_type() const;
+
+    /**
+     * \brief Gets the identifier of the PACKET_FANOUT group this sniffer
+     * belongs to.
+     *
+     * This returns 0 if the sniffer isn't in a fanout group.
+     */
+    uint16_t fanout_group_id() const;
+private:
+    friend class SnifferGroup;
+
+    RingSniffer(const RingSniffer&);
+    RingSniffer& operator=(const RingSniffer&);
+
+    void init(const std::string& device,
+              const RingSnifferConfiguration& configuration);
+    void cleanup();
+    bool read_frame(frame& output, bool stop_on_timeout);
+    bool wait_for_block(bool stop_on_timeout);
+    void release_block();
+    PDU* decode(const uint8_t* buffer, uint32_t size) const;
+
+    int fd_;
+    uint8_t* ring_;
+    size_t ring_size_;
+    uint32_t block_size_;
+    uint32_t block_count_;
+    uint32_t current_block_;
+    uint8_t* current_frame_;
+    uint32_t frames_left_;
+    bool block_in_use_;
+    int timeout_;
+    PDU::PDUType link_type_;
+    std::atomic<bool> stop_;
+    PacketArena* arena_;
+    bool zero_copy_payloads_;
+    PacketDecoder::Layer max_decode_layer_;
+};
+
+template <typename Functor>
+void RingSniffer::sniff_loop(Functor function, uint32_t max_packets) {
+    frame current;
+    // Loops only end when they're stopped, not when the timeout expires
+    while (read_frame(current, false)) {
+        PDU* pdu = decode(current.data, current.size);
+        if (!pdu) {
+            continue;
+        }
+        Packet packet(pdu, current.timestamp, Packet::own_pdu());
+        try {
+            // If the functor returns false, we're done
+            if (!Internals::invoke_loop_cb(function, packet)) {
+                return;
+            }
+        }
+        catch(malformed_packet&) { }
+        catch(pdu_not_found&) { }
+        if (max_packets && --max_packets == 0) {
+            return;
+        }
+    }
+}
+
+template <typename Functor>
+void RingSniffer::sniff_lazy_loop(Functor function, uint32_t max_packets) {
+    LazyPacket packet;
+    // The functor is the one that decodes the packet
+    packet.set_arena(arena_);
+    frame current;
+    while (read_frame(current, false)) {
+        packet.assign(link_type_, current.data, current.size, current.timestamp);
+        packet.set_max_decode_layer(max_decode_layer_);
+        try {
+            // If the functor returns false, we're done
+            if (!function(packet)) {
+                return;
+            }
+        }
+        catch(malformed_packet&) { }
+        catch(pdu_not_found&) { }
+        if (max_packets && --max_packets == 0) {
+            return;
+        }
+    }
+}
+
+} // Tins
+
+#endif // TINS_HAVE_TPACKET_V3
+
+#endif // TINS_RING_SNIFFER_H
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_SHARED_PACKET_H
+#define TINS_SHARED_PACKET_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_CXX11
+
+#include <atomic>
+#include <mutex>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/pdu.h>
+#include <tins/packet.h>
+#include <tins/lazy_packet.h>
+#include <tins/packet_decoder.h>
+#include <tins/timestamp.h>
+#include <tins/exceptions.h>
+
+namespace Tins {
+
+/**
+ * \class SharedPacket
+ * \brief Reference counted, immutable packet.
+ *
+ * Copying a Packet clones its whole PDU chain. When the same packet has
+ * to be handed to several consumers (e.g. a TCPIP::StreamFollower, some
+ * analyzer and a PacketWriter), possibly running on different threads,
+ * that means one deep copy per consumer.
+ *
+ * Copies of a SharedPacket instead share a single PDU chain, only 
+ * incrementing an atomic reference count. The chain is deleted when the
+ * last copy is destroyed. Since it's shared, the chain can only be
+ * accessed through const references. SharedPacket::to_packet can be
+ * used to get a modifiable copy.
+ *
+ * A SharedPacket can be constructed either from an already decoded chain
+ * or from the packet's raw bytes. In the latter case, the bytes are 
+ * decoded the first time any of the copies requests the PDU chain. This
+ * is thread safe, so several threads can request it concurrently.
+ *
+ * \code
+ * SharedPacket packet(sniffer.next_packet());
+ * // No PDUs are cloned here
+ * pipeline_a.push(SharedPacket(packet));
+ * pipeline_b.push(SharedPacket(packet));
+ * \endcode
+ *
+ * Copying, assigning and destroying different SharedPacket objects that
+ * share the same chain is thread safe. A single SharedPacket object 
+ * shouldn't be modified concurrently from several threads.
+ */
+class TINS_API SharedPacket {
+public:
+    /**
+     * \brief Default constructor.
+     *
+     * The constructed object doesn't hold any packet.
+     */
+    SharedPacket();
+
+    /**
+     * \brief Constructs a SharedPacket from a Packet.
+     *
+     * The packet's PDU chain is moved, so no cloning takes place.
+     *
+     * \param packet The packet to take the PDU chain from.
+     */
+    SharedPacket(Packet&& packet);
+
+    /**
+     * \brief Constructs a SharedPacket from a PDU chain.
+     *
+     * The chain will be owned by this object and deleted once the last
+     * copy is destroyed.
+     *
+     * \param pdu The PDU chain.
+     * \param timestamp The packet's timestamp.
+     */
+    SharedPacket(PDU* pdu, const Timestamp& timestamp);
+
+    /**
+     * \brief Constructs a SharedPacket from a LazyPacket.
+     *
+     * The packet's bytes are moved. They are decoded the first time the
+     * PDU chain is requested, unless they already were.
+     *
+     * \param packet The packet to take the bytes from.
+     */
+    SharedPacket(LazyPacket&& packet);
+
+    /**
+     * \brief Constructs a SharedPacket by copying the given bytes.
+     *
+     * The bytes are decoded the first time the PDU chain is requested.
+     *
+     * \param link_type The type of the first PDU in the buffer.
+     * \param buffer The packet's bytes.
+     * \param size The size of the buffer.
+     * \param timestamp The packet's timestamp.
+     */
+    SharedPacket(PDU::PDUType link_type, const uint8_t* buffer, uint32_t size,
+                 const Timestamp& timestamp);
+
+    /**
+     * \brief Copy constructor.
+     *
+     * The packet is shared, not copied.
+     */
+    SharedPacket(const SharedPacket& rhs);
+
+    /**
+     * \brief Copy assignment operator.
+     *
+     * The packet is shared, not copied.
+     */
+    SharedPacket& operator=(const SharedPacket& rhs);
+
+    /**
+     * \brief Move constructor.
+     */
+    SharedPacket(SharedPacket&& rhs) TINS_NOEXCEPT;
+
+    /**
+     * \brief Move assignment operator.
+     */
+    SharedPacket& operator=(SharedPacket&& rhs) TINS_NOEXCEPT;
+
+    /**
+     * \brief Destructor.
+     *
+     * If this is the last copy of the packet, its PDU chain is deleted.
+     */
+    ~SharedPacket();
+
+    /**
+     * \brief Returns the PDU chain, decoding it if necessary.
+     *
+     * If this object doesn't hold a packet, the packet is malformed or
+     * its link type is unknown, a null pointer is returned.
+     */
+    const PDU* pdu() const;
+
+    /**
+     * \brief Finds a PDU of the given type in the PDU chain.
+     *
+     * \return A pointer to the PDU, or a null pointer if it's not found.
+     */
+    template<typename T>
+    const T* find_pdu() const {
+        const PDU* chain = pdu();
+        return chain ? chain->find_pdu<T>() : 0;
+    }
+
+    /**
+     * \brief Finds a PDU of the given type in the PDU chain.
+     *
+     * If the PDU is not found, a pdu_not_found exception is thrown.
+     */
+    template<typename T>
+    const T& rfind_pdu() const {
+        const T* output = find_pdu<T>();
+        if (!output) {
+            throw pdu_not_found();
+        }
+        return *output;
+    }
+
+    /**
+     * \brief Getter for the packet's timestamp.
+     */
+    const Timestamp& timestamp() const;
+
+    /**
+     * \brief Getter for a pointer to the packet's raw bytes.
+     *
+     * This is only available if the packet was constructed from its
+     * bytes. Otherwise, a null pointer is returned.
+     */
+    const uint8_t* data() const;
+
+    /**
+     * \brief Getter for the size of the packet's raw bytes.
+     *
+     * This is only available if the packet was constructed from its
+     * bytes. Otherwise, 0 is returned.
+     */
+    uint32_t size() const;
+
+    /**
+     * \brief Gets the amount of SharedPacket objects sharing this packet.
+     *
+     * If called while other threads copy or destroy them, this is only an
+     * estimate. If this object doesn't hold a packet, 0 is returned.
+     */
+    size_t use_count() const;
+
+    /**
+     * \brief Creates a Packet containing a copy of the PDU chain.
+     *
+     * The returned Packet can be freely modified. If this object doesn't
+     * hold a packet or it could not be decoded, it will contain a null
+     * PDU.
+     */
+    Packet to_packet() const;
+
+    /**
+     * \brief Indicates whether this object holds a packet.
+     */
+    operator bool() const {
+        return state_ != 0;
+    }
+private:
+    struct state;
+
+    static state* make_state(const Timestamp& timestamp);
+    void release();
+
+    state* state_;
+};
+
+} // Tins
+
+#endif // TINS_HAVE_CXX11
+
+#endif // TINS_SHARED_PACKET_H
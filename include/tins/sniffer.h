@@ -32,10 +32,14 @@
 #define TINS_SNIFFER_H
 
 #include <string>
+#include <vector>
 #include <memory>
 #include <iterator>
 #include <tins/pdu.h>
 #include <tins/packet.h>
+#include <tins/lazy_packet.h>
+#include <tins/packet_arena.h>
+#include <tins/packet_decoder.h>
 #include <tins/cxxstd.h>
 #include <tins/macros.h>
 #include <tins/exceptions.h>
@@ -49,6 +53,7 @@
 namespace Tins {
 class SnifferIterator;
 class SnifferConfiguration;
+class PacketArena;
 
 /**
  * \class BaseSniffer
@@ -133,6 +138,64 @@ public:
      */
     PtrPacket next_packet();
 
+    /**
+     * \brief Retrieves a batch of packets using a single pcap_dispatch call.
+     *
+     * Unlike BaseSniffer::next_packet, which enters the pcap sniffing loop
+     * once per packet, this drains every packet that libpcap currently has
+     * buffered (up to max_packets) in one pcap_dispatch call. The link layer
+     * type is only looked up once per batch.
+     *
+     * The batch is cleared before being filled, so the same container can be
+     * reused across calls in order to avoid reallocating its storage.
+     * Malformed packets are skipped.
+     *
+     * Note that this always uses pcap_dispatch, regardless of the sniffing
+     * method set via BaseSniffer::set_pcap_sniffing_method. If a timeout
+     * expires before any packet is captured, this returns true and the
+     * batch will be empty.
+     *
+     * Payloads are always copied into the packets in the batch, even if
+     * BaseSniffer::set_zero_copy_payloads was enabled. libpcap may reuse or
+     * hand its buffer back to the kernel before pcap_dispatch returns, so
+     * references to it wouldn't outlive the next packet in the batch.
+     *
+     * \code
+     * Sniffer sniffer("eth0");
+     * std::vector<Packet> batch;
+     * while (sniffer.next_packets(batch)) {
+     *     for (size_t i = 0; i < batch.size(); ++i) {
+     *         // Process batch[i]
+     *     }
+     * }
+     * \endcode
+     *
+     * \param batch The container in which the captured packets will be stored.
+     * \param max_packets The maximum amount of packets to read. 0 means
+     * all the buffered packets.
+     * \return false if no more packets can be read from this sniffer (e.g.
+     * an error occurred, BaseSniffer::stop_sniff was called or the end of
+     * a pcap file was reached), true otherwise.
+     */
+    bool next_packets(std::vector<Packet>& batch, uint32_t max_packets = 0);
+
+    /**
+     * \brief Retrieves the next packet without decoding it.
+     *
+     * The captured bytes are copied into the given LazyPacket along with
+     * the link layer type, and no PDU is built until LazyPacket::pdu is
+     * called. Reusing the same LazyPacket across calls avoids reallocating
+     * its buffer.
+     *
+     * If BaseSniffer::set_extract_raw_pdus was enabled, the packet's link
+     * type will be PDU::RAW.
+     *
+     * \param packet The packet in which to store the captured bytes.
+     * \return false if no more packets can be read from this sniffer,
+     * true otherwise.
+     */
+    bool next_packet(LazyPacket& packet);
+
     /**
      * \brief Starts a sniffing loop, using a callback functor for every
      * sniffed packet.
@@ -188,6 +251,47 @@ public:
     template <typename Functor>
     void sniff_loop(Functor function, uint32_t max_packets = 0);
 
+    /**
+     * \brief Starts a sniffing loop that reads packets in batches.
+     *
+     * This behaves like BaseSniffer::sniff_loop, but packets are taken out
+     * of libpcap using BaseSniffer::next_packets, so each pcap_dispatch call
+     * delivers every packet that is buffered at that time. The functor is
+     * still executed once for every sniffed packet and it accepts the same
+     * signatures as the one used in BaseSniffer::sniff_loop.
+     *
+     * If the functor returns false, the rest of the packets in the current
+     * batch are discarded.
+     *
+     * \param function The callback handler object which should process packets.
+     * \param max_packets The maximum amount of packets to sniff. 0 == infinite.
+     * \sa BaseSniffer::sniff_loop
+     */
+    template <typename Functor>
+    void sniff_batch_loop(Functor function, uint32_t max_packets = 0);
+
+    /**
+     * \brief Starts a sniffing loop that delivers packets without decoding them.
+     *
+     * This behaves like BaseSniffer::sniff_loop, but the functor is called
+     * with a LazyPacket, so the packet is only decoded if the functor
+     * requests its PDUs. The functor must implement an operator with the
+     * following signature:
+     *
+     * \code
+     * bool(LazyPacket&);
+     * \endcode
+     *
+     * The same LazyPacket object is reused for every packet, so the functor
+     * should copy it or call LazyPacket::release_pdu if it needs to keep it.
+     *
+     * \param function The callback handler object which should process packets.
+     * \param max_packets The maximum amount of packets to sniff. 0 == infinite.
+     * \sa BaseSniffer::next_packet(LazyPacket&)
+     */
+    template <typename Functor>
+    void sniff_lazy_loop(Functor function, uint32_t max_packets = 0);
+
     /**
      * \brief Sets a filter on this sniffer.
      * \param filter The filter to be set.
@@ -224,6 +328,21 @@ public:
      */
     void set_timeout(int ms);
 
+    /**
+     * \brief Sets whether this sniffer is in non-blocking mode.
+     *
+     * This calls pcap_setnonblock using the provided parameter. In 
+     * non-blocking mode, BaseSniffer::next_packets returns an empty batch
+     * right away if there are no packets available, which allows using 
+     * this sniffer along with BaseSniffer::get_fd in an event loop (see 
+     * SnifferReactor).
+     *
+     * If the mode can't be changed, pcap_error is thrown.
+     *
+     * \param value Whether to enable non-blocking mode.
+     */
+    void set_non_blocking(bool value);
+
     /**
      * \brief Sets whether to extract RawPDUs or fully parsed packets.
      *
@@ -240,6 +359,59 @@ public:
      */
     void set_extract_raw_pdus(bool value);
 
+    /**
+     * \brief Sets whether decoded PDUs are allocated from a PacketArena.
+     *
+     * If enabled, this sniffer owns a PacketArena which is given to 
+     * PacketDecoder::decode for every packet it decodes, as well as to the
+     * LazyPacket passed to the functor in BaseSniffer::sniff_lazy_loop. 
+     * Once the arena's chunks are warm, only the outermost PDU of each 
+     * decoded packet is allocated from the heap.
+     *
+     * If libtins was built without C++11 support, enabling this will 
+     * throw feature_disabled.
+     *
+     * \param value Whether to use an arena or not.
+     * \sa PacketArena
+     */
+    void set_arena_allocation(bool value);
+
+    /**
+     * \brief Sets whether decoded payloads reference the capture buffer.
+     *
+     * If enabled, the RawPDUs in the packets taken from this sniffer don't
+     * copy their payload, but reference libpcap's buffer instead (see
+     * RawPDU::zero_copy_scope). That buffer is only valid until the next 
+     * packet is read, so packets have to be copied (which copies the 
+     * payloads) if they're to be kept after that. The const RawPDU::payload
+     * getter throws payload_not_owned for these payloads.
+     *
+     * This only applies to BaseSniffer::next_packet and the loops built on
+     * top of it. BaseSniffer::next_packets and BaseSniffer::sniff_batch_loop
+     * always copy payloads, since libpcap can overwrite its buffer while 
+     * a batch is being read.
+     *
+     * If libtins was built without C++11 support, enabling this will 
+     * throw feature_disabled.
+     *
+     * \param value Whether to enable zero copy payloads.
+     */
+    void set_zero_copy_payloads(bool value);
+
+    /**
+     * \brief Sets the last layer decoded in packets taken from this sniffer.
+     *
+     * Anything past the given layer is kept as a single RawPDU (see
+     * PacketDecoder::depth_scope). This applies to LazyPacket objects 
+     * filled by this sniffer as well. By default, every layer is decoded.
+     *
+     * If libtins was built without C++11 support, using any layer other 
+     * than PacketDecoder::ALL_LAYERS will throw feature_disabled.
+     *
+     * \param layer The last layer to be decoded.
+     */
+    void set_max_decode_layer(PacketDecoder::Layer layer);
+
     /**
      * \brief function pointer for the sniffing method
      *
@@ -315,6 +487,9 @@ private:
     bpf_u_int32 mask_;
     bool extract_raw_;
     PcapSniffingMethod pcap_sniffing_method_;
+    PacketArena* arena_;
+    bool zero_copy_payloads_;
+    PacketDecoder::Layer max_decode_layer_;
 };
 
 /**
@@ -635,6 +810,13 @@ public:
      * \param value The timestamp option value.
      */
     void set_timestamp_precision(int value);
+
+    /**
+     * Sets the last layer decoded in sniffed packets.
+     * \param layer The last layer to be decoded.
+     * \sa BaseSniffer::set_max_decode_layer
+     */
+    void set_max_decode_layer(PacketDecoder::Layer layer);
 protected:
     friend class Sniffer;
     friend class FileSniffer;
@@ -648,6 +830,7 @@ protected:
         DIRECTION = 32,
         TIMESTAMP_PRECISION = 64,
         PCAP_SNIFFING_METHOD = 128,
+        MAX_DECODE_LAYER = 256
     };
 
     void configure_sniffer_pre_activation(Sniffer& sniffer) const;
@@ -666,6 +849,7 @@ protected:
     bool immediate_mode_;
     pcap_direction_t direction_;
     int timestamp_precision_;
+    PacketDecoder::Layer max_decode_layer_;
 };
 
 template <typename Functor>
@@ -691,6 +875,52 @@ void Tins::BaseSniffer::sniff_loop(Functor function, uint32_t max_packets) {
     }
 }
 
+template <typename Functor>
+void Tins::BaseSniffer::sniff_batch_loop(Functor function, uint32_t max_packets) {
+    std::vector<Packet> batch;
+    while (next_packets(batch, max_packets)) {
+        for (size_t i = 0; i < batch.size(); ++i) {
+            try {
+                // If the functor returns false, we're done
+                #if TINS_IS_CXX11 && !defined(_MSC_VER)
+                if (!Tins::Internals::invoke_loop_cb(function, batch[i])) {
+                    return;
+                }
+                #else
+                if (!function(*batch[i].pdu())) {
+                    return;
+                }
+                #endif
+            }
+            catch(malformed_packet&) { }
+            catch(pdu_not_found&) { }
+            if (max_packets && --max_packets == 0) {
+                return;
+            }
+        }
+    }
+}
+
+template <typename Functor>
+void Tins::BaseSniffer::sniff_lazy_loop(Functor function, uint32_t max_packets) {
+    LazyPacket packet;
+    // The functor is the one that decodes the packet
+    packet.set_arena(arena_);
+    while (next_packet(packet)) {
+        try {
+            // If the functor returns false, we're done
+            if (!function(packet)) {
+                return;
+            }
+        }
+        catch(malformed_packet&) { }
+        catch(pdu_not_found&) { }
+        if (max_packets && --max_packets == 0) {
+            return;
+        }
+    }
+}
+
 } // Tins
 
 #endif // TINS_HAVE_PCAP
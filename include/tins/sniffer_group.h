@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_SNIFFER_GROUP_H
+#define TINS_SNIFFER_GROUP_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_TPACKET_V3
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/ring_sniffer.h>
+
+namespace Tins {
+
+/**
+ * \class SnifferGroup
+ * \brief Captures packets on an interface using several threads.
+ *
+ * This class opens several RingSniffers on the same interface and makes
+ * all of them join the same PACKET_FANOUT group, so that the kernel
+ * spreads the captured packets among them. Each of them is then run on
+ * its own thread.
+ *
+ * When using RingSnifferConfiguration::FANOUT_HASH (the default), every
+ * packet in a given connection, in both directions, is delivered to the
+ * same member. This means each worker thread can keep its own per flow
+ * state (e.g. a TCPIP::StreamFollower) without any synchronization.
+ *
+ * SnifferGroup::sniff_loop takes a factory that is called once per member
+ * and has to return the functor that member's thread will use. The
+ * returned functors follow the same rules as the ones used in
+ * BaseSniffer::sniff_loop:
+ *
+ * \code
+ * TCPIP::StreamFollower followers[4];
+ * SnifferGroup group("eth0", 4);
+ * group.sniff_loop([&](size_t index) {
+ *     TCPIP::StreamFollower* follower = &followers[index];
+ *     return [follower](Packet& packet) {
+ *         follower->process_packet(packet);
+ *         return true;
+ *     };
+ * });
+ * \endcode
+ */
+class TINS_API SnifferGroup {
+public:
+    /**
+     * The type used to store the size of the group.
+     */
+    typedef size_t size_type;
+
+    /**
+     * \brief Constructs a group of sniffers.
+     *
+     * The first sniffer creates a new fanout group, whose identifier isn't
+     * used by any other group (see RingSnifferConfiguration::set_fanout), 
+     * and the rest join it. Any fanout settings in the configuration are
+     * overridden.
+     *
+     * \param device The name of the interface to sniff on.
+     * \param size The amount of sniffers (and threads) to use.
+     * \param mode The mode used to spread packets among the sniffers.
+     * \param configuration The configuration used by every sniffer.
+     */
+    SnifferGroup(const std::string& device, size_type size,
+                 RingSnifferConfiguration::FanoutMode mode = RingSnifferConfiguration::FANOUT_HASH,
+                 const RingSnifferConfiguration& configuration = RingSnifferConfiguration());
+
+    /**
+     * \brief Destructor.
+     */
+    ~SnifferGroup();
+
+    /**
+     * \brief Gets the amount of sniffers in this group.
+     */
+    size_type size() const;
+
+    /**
+     * \brief Gets the sniffer at the given index.
+     *
+     * \param index The index of the sniffer to retrieve.
+     */
+    RingSniffer& sniffer(size_type index);
+
+    /**
+     * \brief Runs a sniffing loop on each member, using one thread per member.
+     *
+     * The factory is called on the calling thread once for each member,
+     * using the member's index as its argument. The functor it returns
+     * is then used as that member's sniff_loop callback.
+     *
+     * This call blocks until every member's loop is done. A member's loop
+     * finishes when its functor returns false or when
+     * SnifferGroup::stop_sniff is called. If any of the callbacks throws,
+     * every member is stopped and the exception is rethrown here. Calls to
+     * SnifferGroup::stop_sniff made before this one starts have no effect.
+     *
+     * \param factory The functor factory.
+     */
+    template <typename FunctorFactory>
+    void sniff_loop(FunctorFactory factory);
+
+    /**
+     * \brief Stops every member's sniffing loop.
+     *
+     * This can be called from any thread, including the callbacks
+     * running on this group's threads.
+     */
+    void stop_sniff();
+private:
+    typedef std::function<void()> worker_type;
+
+    SnifferGroup(const SnifferGroup&);
+    SnifferGroup& operator=(const SnifferGroup&);
+
+    void run_workers(const std::vector<worker_type>& workers);
+    void cleanup();
+
+    std::vector<RingSniffer*> sniffers_;
+};
+
+template <typename FunctorFactory>
+void SnifferGroup::sniff_loop(FunctorFactory factory) {
+    std::vector<worker_type> workers;
+    for (size_type i = 0; i < sniffers_.size(); ++i) {
+        RingSniffer* sniffer = sniffers_[i];
+        auto function = factory(i);
+        workers.push_back([sniffer, function]() mutable {
+            sniffer->sniff_loop(function);
+        });
+    }
+    run_workers(workers);
+}
+
+} // Tins
+
+#endif // TINS_HAVE_TPACKET_V3
+
+#endif // TINS_SNIFFER_GROUP_H
@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_SNIFFER_REACTOR_H
+#define TINS_SNIFFER_REACTOR_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_EPOLL
+
+#include <vector>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <atomic>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/packet.h>
+
+namespace Tins {
+
+#ifdef TINS_HAVE_PCAP
+class BaseSniffer;
+#endif // TINS_HAVE_PCAP
+
+/**
+ * \class SnifferReactor
+ * \brief Drives several sniffers, file descriptors and timers from a 
+ * single thread.
+ *
+ * This class wraps an epoll instance. Sniffers, arbitrary file 
+ * descriptors (e.g. the sockets used by a PacketSender) and periodic
+ * timers are registered along with a callback, which is executed on the 
+ * thread that runs the reactor whenever the source is ready.
+ *
+ * Registered sniffers are put in non-blocking mode. Whenever one of them
+ * is readable, the packets available are retrieved in batches using 
+ * BaseSniffer::next_packets and handed to that sniffer's callback:
+ *
+ * \code
+ * Sniffer eth0("eth0"), eth1("eth1");
+ * SnifferReactor reactor;
+ * reactor.add_sniffer(eth0, [&](std::vector<Packet>& batch) {
+ *     // process batch
+ *     return true;
+ * });
+ * reactor.add_sniffer(eth1, [&](std::vector<Packet>& batch) {
+ *     // process batch
+ *     return true;
+ * });
+ * reactor.add_timer(1000, [&]() {
+ *     // expire old state once per second
+ *     return true;
+ * });
+ * reactor.run();
+ * \endcode
+ *
+ * Every callback returns a bool. Returning false removes the source from
+ * the reactor. The reactor doesn't take ownership of the sniffers or 
+ * file descriptors registered on it, which have to outlive their 
+ * registration.
+ *
+ * Except for SnifferReactor::stop, this class' methods must be called 
+ * from the thread that runs the reactor.
+ */
+class TINS_API SnifferReactor {
+public:
+    /**
+     * The type used to identify the sources registered on a reactor.
+     */
+    typedef uint64_t handle_type;
+
+    /**
+     * The type of the callbacks used for sniffers.
+     */
+    typedef std::function<bool(std::vector<Packet>&)> batch_callback_type;
+
+    /**
+     * The type of the callbacks used for file descriptors. The descriptor
+     * is provided as the argument.
+     */
+    typedef std::function<bool(int)> descriptor_callback_type;
+
+    /**
+     * The type of the callbacks used for timers.
+     */
+    typedef std::function<bool()> timer_callback_type;
+
+    /**
+     * \brief The default maximum amount of packets in a batch.
+     */
+    static const uint32_t DEFAULT_BATCH_SIZE;
+
+    /**
+     * \brief Constructs a reactor.
+     *
+     * If the epoll instance can't be created, event_loop_error is thrown.
+     */
+    SnifferReactor();
+
+    /**
+     * \brief Destructor.
+     *
+     * Closes the epoll instance and the reactor's timers.
+     */
+    ~SnifferReactor();
+
+    #ifdef TINS_HAVE_PCAP
+    /**
+     * \brief Registers a sniffer.
+     *
+     * The sniffer is put in non-blocking mode. Whenever it's readable,
+     * batches of up to batch_size packets are retrieved and handed to the
+     * callback until no more packets are available. At most 16 batches
+     * are read each time, so a busy sniffer doesn't keep the other sources
+     * from running. Any packets left are retrieved on the next iteration.
+     *
+     * If BaseSniffer::next_packets fails, the sniffer is removed.
+     *
+     * \param sniffer The sniffer to register.
+     * \param callback The callback to use for each batch.
+     * \param batch_size The maximum amount of packets in each batch.
+     * \return The handle of this source.
+     */
+    handle_type add_sniffer(BaseSniffer& sniffer, batch_callback_type callback,
+                            uint32_t batch_size = DEFAULT_BATCH_SIZE);
+    #endif // TINS_HAVE_PCAP
+
+    /**
+     * \brief Registers a file descriptor.
+     *
+     * The callback is executed whenever the descriptor is readable.
+     *
+     * \param fd The file descriptor to register.
+     * \param callback The callback to use.
+     * \return The handle of this source.
+     */
+    handle_type add_descriptor(int fd, descriptor_callback_type callback);
+
+    /**
+     * \brief Registers a periodic timer.
+     *
+     * The callback is executed once per interval. If the reactor falls 
+     * behind, missed expirations are coalesced into a single call.
+     *
+     * If the interval is 0, event_loop_error is thrown.
+     *
+     * \param interval The timer's interval, in milliseconds.
+     * \param callback The callback to use.
+     * \return The handle of this source.
+     */
+    handle_type add_timer(uint32_t interval, timer_callback_type callback);
+
+    /**
+     * \brief Removes a source.
+     *
+     * This can be called from within callbacks, including the one 
+     * belonging to the source being removed. Unknown handles are ignored.
+     *
+     * \param handle The handle of the source to remove.
+     */
+    void remove(handle_type handle);
+
+    /**
+     * \brief Gets the amount of sources registered.
+     */
+    size_t size() const;
+
+    /**
+     * \brief Waits for sources to be ready and executes their callbacks.
+     *
+     * \param timeout The maximum amount of milliseconds to wait, -1 
+     * meaning no limit.
+     * \return The amount of callbacks executed.
+     */
+    size_t run_once(int timeout = -1);
+
+    /**
+     * \brief Runs the reactor until it's stopped or there are no sources
+     * left.
+     */
+    void run();
+
+    /**
+     * \brief Stops the reactor.
+     *
+     * This can be called from any thread. If the reactor is running, 
+     * SnifferReactor::run returns after executing the callbacks for the
+     * sources that are currently ready. Otherwise, the next call to 
+     * SnifferReactor::run returns right away.
+     */
+    void stop();
+private:
+    typedef std::function<bool()> ready_callback_type;
+
+    struct source {
+        int fd;
+        bool owns_fd;
+        ready_callback_type callback;
+    };
+
+    typedef std::unordered_map<handle_type, std::shared_ptr<source> > sources_type;
+
+    SnifferReactor(const SnifferReactor&);
+    SnifferReactor& operator=(const SnifferReactor&);
+
+    handle_type add_source(int fd, bool owns_fd, ready_callback_type callback);
+    void release(const source& current);
+
+    sources_type sources_;
+    handle_type next_handle_;
+    int epoll_fd_;
+    int wakeup_fd_;
+    std::atomic<bool> stopped_;
+};
+
+} // Tins
+
+#endif // TINS_HAVE_EPOLL
+
+#endif // TINS_SNIFFER_REACTOR_H
@@ -141,11 +141,29 @@ public:
     /**
      * \brief Extracts metadata for this protocol based on the buffer provided
      *
+     * If the buffer is too short or the data offset field is either smaller
+     * than the fixed header or larger than the buffer, a malformed_packet 
+     * exception is thrown. Versions prior to 4.3 didn't check the data offset
+     * field and returned it as the header size.
+     *
      * \param buffer Pointer to a buffer
      * \param total_sz Size of the buffer pointed by buffer
      */
     static metadata extract_metadata(const uint8_t *buffer, uint32_t total_sz);
 
+    /**
+     * \brief Extracts metadata for this protocol based on the buffer provided
+     *
+     * Unlike extract_metadata, this doesn't throw if the buffer is malformed.
+     *
+     * \param buffer Pointer to a buffer
+     * \param total_sz Size of the buffer pointed by buffer
+     * \param output The object in which the metadata will be stored
+     * \return false iff the buffer doesn't contain a valid header
+     */
+    static bool try_extract_metadata(const uint8_t* buffer, uint32_t total_sz,
+                                     metadata& output);
+
     /**
      * \brief TCP constructor.
      *
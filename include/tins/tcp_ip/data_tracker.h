@@ -32,6 +32,7 @@
 
 #include <vector>
 #include <map>
+#include <functional>
 #include <stdint.h>
 #include <tins/config.h>
 #include <tins/macros.h>
@@ -46,6 +47,23 @@ namespace TCPIP {
  *
  * Stores and tracks data in a TCP stream, reassembling segments, handling 
  * out of order packets, etc.
+ *
+ * Segments are never moved around inside their buffers: the parts of 
+ * overlapping segments that were already seen are skipped rather than 
+ * erased. Whenever the payload buffer is empty, e.g. because it's cleared
+ * after every data callback, a segment that arrives in order takes its 
+ * place without being copied.
+ *
+ * Alternatively, data can be consumed as it's reassembled by passing a 
+ * data span callback when processing a payload. In that case in order data
+ * is handed to the callback directly, either from the segment's buffer or 
+ * from a buffered fragment, and it's never added to the payload buffer. Only
+ * segments that arrive after a sequence gap are kept.
+ *
+ * Data can also be accumulated without ever concatenating it, by keeping
+ * each in order segment in its own buffer (see 
+ * DataTracker::keep_payload_segments). The segments are then read through
+ * DataTracker::payload_segments.
  */
 class TINS_API DataTracker {
 public:
@@ -59,6 +77,31 @@ public:
      */
     typedef std::map<uint32_t, payload_type> buffered_payload_type;
 
+    /**
+     * \brief The type used for callbacks that receive in order data spans
+     *
+     * The arguments are a pointer to the data, its size and the offset of 
+     * the data's first byte within the stream. The pointer is only valid 
+     * during the call.
+     */
+    typedef std::function<void(const uint8_t*, size_t, uint64_t)> data_span_callback_type;
+
+    /**
+     * \brief A contiguous part of the in order data
+     *
+     * This points into a buffer owned by the tracker, so it's only valid 
+     * until the payload is cleared or more data is processed.
+     */
+    struct payload_segment {
+        const uint8_t* data;
+        uint32_t size;
+    };
+
+    /**
+     * The type used to return the in order data's segments
+     */
+    typedef std::vector<payload_segment> payload_segments_type;
+
     /**
      * Default constructs an instance
      */
@@ -87,6 +130,54 @@ public:
      */
     bool process_payload(uint32_t seq, payload_type payload);
 
+    /**
+     * \brief Processes the given payload
+     *
+     * This behaves like the overload that takes a payload_type, but data that
+     * arrives in order is appended to the payload buffer directly, without 
+     * creating an intermediate copy. Out of order data has to be copied.
+     *
+     * \brief seq The payload's sequence number
+     * \brief data A pointer to the payload to process
+     * \brief size The size of the payload
+     * \return true iff any data was added to the payload buffer
+     */
+    bool process_payload(uint32_t seq, const uint8_t* data, uint32_t size);
+
+    /**
+     * \brief Processes the given payload, handing in order data to a callback
+     *
+     * Instead of being appended to the payload buffer, every contiguous span
+     * of data that becomes available in order, including buffered fragments
+     * that stop being out of order, is passed to the given callback. Out of 
+     * order data is buffered as usual.
+     *
+     * The callback must not modify this tracker.
+     *
+     * \brief seq The payload's sequence number
+     * \brief payload The payload to process
+     * \brief callback The callback that will receive in order data
+     * \return true iff any data was passed to the callback
+     */
+    bool process_payload(uint32_t seq, payload_type payload,
+                         const data_span_callback_type& callback);
+
+    /**
+     * \brief Processes the given payload, handing in order data to a callback
+     *
+     * This behaves like the overload that takes a payload_type, but if the
+     * data arrives in order, the callback is given a pointer into it, so it
+     * isn't copied at all. Out of order data has to be copied.
+     *
+     * \brief seq The payload's sequence number
+     * \brief data A pointer to the payload to process
+     * \brief size The size of the payload
+     * \brief callback The callback that will receive in order data
+     * \return true iff any data was passed to the callback
+     */
+    bool process_payload(uint32_t seq, const uint8_t* data, uint32_t size,
+                         const data_span_callback_type& callback);
+
     /**
      * \brief Skip forward to a sequence number
      *
@@ -144,14 +235,78 @@ public:
      * Retrieves the total amount of buffered bytes
      */
     uint32_t total_buffered_bytes() const;
+
+    /**
+     * \brief Sets whether in order segments are kept in their own buffers
+     *
+     * By default, in order data is appended to the payload buffer, which 
+     * copies it unless the buffer is empty. If this is enabled, each segment
+     * that arrives in order is kept in the buffer it was processed with 
+     * instead, only skipping the bytes that were already seen, and 
+     * DataTracker::payload doesn't receive any more data. The data is then
+     * read using DataTracker::payload_segments and released using 
+     * DataTracker::clear_payload.
+     *
+     * \param value Whether to keep the segments
+     */
+    void keep_payload_segments(bool value);
+
+    /**
+     * \brief Retrieves the in order data as a list of segments
+     *
+     * The first segment is the payload buffer, if it's not empty, followed 
+     * by every segment kept because of DataTracker::keep_payload_segments,
+     * in stream order. Nothing is copied.
+     */
+    payload_segments_type payload_segments() const;
+
+    /**
+     * \brief Retrieves the amount of in order bytes
+     *
+     * This counts both the payload buffer and the kept segments.
+     */
+    uint32_t payload_size() const;
+
+    /**
+     * \brief Releases the in order data
+     *
+     * Both the payload buffer and the kept segments are cleared.
+     */
+    void clear_payload();
+
+    /**
+     * \brief Retrieves the stream offset of the next in order byte
+     *
+     * This is the amount of bytes the sequence number has moved forward
+     * since this tracker was constructed, either because data was 
+     * reassembled or because the sequence was advanced.
+     */
+    uint64_t stream_offset() const;
 private:
     void store_payload(uint32_t seq, payload_type payload);
+    bool append_payload(payload_type& payload, uint32_t offset,
+                        const data_span_callback_type& callback);
+    void deliver_span(const uint8_t* data, uint32_t size,
+                      const data_span_callback_type& callback);
+    bool process_buffered_payload(uint32_t initial_seq,
+                                  const data_span_callback_type& callback);
     buffered_payload_type::iterator erase_iterator(buffered_payload_type::iterator iter);
 
+    // An in order segment, along with the amount of bytes at its beginning
+    // that had already been seen
+    struct kept_segment {
+        payload_type data;
+        uint32_t offset;
+    };
+
     payload_type payload_;
     buffered_payload_type buffered_payload_;
+    std::vector<kept_segment> kept_segments_;
     uint32_t seq_number_;
     uint32_t total_buffered_bytes_;
+    uint32_t kept_segment_bytes_;
+    uint64_t stream_offset_;
+    bool keep_segments_;
 };
 
 } // TCPIP
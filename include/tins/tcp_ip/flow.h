@@ -91,6 +91,11 @@ public:
      */
     typedef DataTracker::buffered_payload_type buffered_payload_type;
 
+    /**
+     * The type used to return the in order data's segments
+     */
+    typedef DataTracker::payload_segments_type payload_segments_type;
+
     /**
      * The type used to store the callback called when new data is available
      */
@@ -106,6 +111,17 @@ public:
                                uint32_t,
                                const payload_type&)> flow_packet_callback_type;
 
+    /**
+     * \brief The type used to store the callback called for in order data spans
+     *
+     * The arguments are the flow, a pointer to the data, its size and the
+     * offset of the data's first byte within this flow's stream.
+     */
+    typedef std::function<void(Flow&,
+                               const uint8_t*,
+                               size_t,
+                               uint64_t)> data_span_callback_type;
+
     /** 
      * Construct a Flow from an IPv4 address
      *
@@ -146,6 +162,24 @@ public:
      */
     void out_of_order_callback(const flow_packet_callback_type& callback);
 
+    /**
+     * \brief Sets the callback that will be executed for every in order data span
+     *
+     * While this callback is set, data is not accumulated in this flow's
+     * payload and the data_callback is not executed. Instead, every newly 
+     * in order contiguous span of data is given to this callback straight
+     * from the buffer of the segment that carried it and it's not retained
+     * afterwards. Data is only buffered while there's a gap in the sequence
+     * numbers, until the missing segments arrive.
+     *
+     * The pointer given to the callback is only valid during the call, so 
+     * the data has to be copied if it's needed later on.
+     *
+     * \param callback The callback to be executed, or an empty one to go
+     * back to accumulating data in the payload
+     */
+    void data_span_callback(const data_span_callback_type& callback);
+
     /**
      * \brief Processes a packet.
      *
@@ -232,6 +266,39 @@ public:
      */
     payload_type& payload();
 
+    /**
+     * \brief Retrieves this flow's in order data as a list of segments
+     *
+     * \sa DataTracker::payload_segments
+     */
+    payload_segments_type payload_segments() const;
+
+    /**
+     * \brief Retrieves the amount of in order bytes held by this flow
+     *
+     * This counts both the payload and the kept segments.
+     */
+    uint32_t payload_size() const;
+
+    /**
+     * \brief Releases this flow's in order data
+     *
+     * This clears both the payload and the kept segments.
+     */
+    void clear_payload();
+
+    /**
+     * \brief Sets whether in order segments are kept in their own buffers
+     *
+     * If enabled, in order data isn't appended to this flow's payload. 
+     * Each segment is kept in the buffer taken from the packet that carried
+     * it instead, and it's read using Flow::payload_segments.
+     *
+     * \param value Whether to keep the segments
+     * \sa DataTracker::keep_payload_segments
+     */
+    void keep_payload_segments(bool value);
+
     /** 
      * Retrieves this flow's state
      */
@@ -330,6 +397,7 @@ private:
     uint16_t dest_port_;
     data_available_callback_type on_data_callback_;
     flow_packet_callback_type on_out_of_order_callback_;
+    data_span_callback_type on_data_span_callback_;
     State state_;
     int mss_;
     flags flags_;
@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TCP_IP_FLOW_INDEX_H
+#define TINS_TCP_IP_FLOW_INDEX_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <map>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/pdu.h>
+#include <tins/tcp_ip/stream_identifier.h>
+
+namespace Tins {
+namespace Internals {
+class MappedFile;
+} // Internals
+
+namespace TCPIP {
+
+/**
+ * \class FlowIndex
+ * \brief Maps TCP and UDP flows to the offsets of their records within
+ * a pcap file.
+ *
+ * A flow index is a sidecar file that stores, for every TCP and UDP flow
+ * in a pcap file, the offsets of the records that belong to it. Flows are
+ * identified using a StreamIdentifier and the transport protocol, so both
+ * directions of a flow map to the same entry. The flow table is sorted, 
+ * so looking up a flow is a binary search over the memory mapped index.
+ *
+ * The offsets found can be read using PcapFileReader::sniff_records, 
+ * which only touches the records that belong to the flow:
+ *
+ * \code
+ * FlowIndex::build("capture.pcap", "capture.pcap.flows");
+ *
+ * FlowIndex index("capture.pcap.flows");
+ * PcapFileReader reader("capture.pcap");
+ * std::vector<uint64_t> offsets = index.find(identifier, FlowIndex::TCP_FLOW);
+ * reader.sniff_records([&](Packet& packet) {
+ *     // process packet
+ *     return true;
+ * }, offsets.begin(), offsets.end());
+ * \endcode
+ *
+ * Records that are not TCP or UDP, as well as IP fragments, are not 
+ * indexed.
+ */
+class TINS_API FlowIndex {
+public:
+    /**
+     * The transport protocols that flows are indexed for.
+     */
+    enum Protocol {
+        TCP_FLOW = 6,
+        UDP_FLOW = 17
+    };
+
+    /**
+     * The type used to store record offsets.
+     */
+    typedef std::vector<uint64_t> offsets_type;
+
+    /**
+     * \brief Opens an index file.
+     *
+     * If the file can't be opened, file_open_error is thrown. If it's not
+     * a flow index file, invalid_file_format is thrown.
+     *
+     * \param file_name The path of the index file.
+     */
+    FlowIndex(const std::string& file_name);
+
+    /**
+     * \brief Unmaps the index file.
+     */
+    ~FlowIndex();
+
+    /**
+     * \brief Builds the index for an existing pcap file.
+     *
+     * \param capture_file_name The path of the pcap file to index.
+     * \param index_file_name The path of the index file to write.
+     */
+    static void build(const std::string& capture_file_name,
+                      const std::string& index_file_name);
+
+    /**
+     * \brief Finds the records that belong to a flow.
+     *
+     * \param identifier The flow's identifier.
+     * \param protocol The flow's transport protocol.
+     * \return The offsets of the flow's records, in file order. This is
+     * empty if the flow is not in the index.
+     */
+    offsets_type find(const StreamIdentifier& identifier, Protocol protocol) const;
+
+    /**
+     * \brief Finds the records that belong to the same flow as a packet.
+     *
+     * \param packet The packet whose flow is looked up.
+     * \return The offsets of the flow's records, in file order. This is
+     * empty if the packet is not TCP or UDP or if its flow is not in the
+     * index.
+     */
+    offsets_type find(const PDU& packet) const;
+
+    /**
+     * \brief Gets the amount of flows in this index.
+     */
+    uint64_t size() const;
+private:
+    FlowIndex(const FlowIndex&);
+    FlowIndex& operator=(const FlowIndex&);
+
+    Internals::MappedFile* file_;
+    uint64_t flow_count_;
+    uint64_t offset_count_;
+};
+
+/**
+ * \class FlowIndexWriter
+ * \brief Builds a FlowIndex.
+ *
+ * Every record in the capture file has to be reported, in order, using 
+ * FlowIndexWriter::add_record. The flow table is kept in memory and 
+ * written by FlowIndexWriter::write.
+ */
+class TINS_API FlowIndexWriter {
+public:
+    /**
+     * \brief Reports a record in the capture file.
+     *
+     * Records which are not TCP or UDP are ignored.
+     *
+     * \param link_type The type of the record's link layer.
+     * \param data The record's data.
+     * \param size The record's size.
+     * \param offset The offset of the record's header within the capture
+     * file.
+     * \return true if the record was added to the index.
+     */
+    bool add_record(PDU::PDUType link_type, const uint8_t* data, uint32_t size,
+                    uint64_t offset);
+
+    /**
+     * \brief Adds a record to a flow.
+     *
+     * \param identifier The flow's identifier.
+     * \param protocol The flow's transport protocol.
+     * \param offset The offset of the record's header within the capture
+     * file.
+     */
+    void add_record(const StreamIdentifier& identifier, FlowIndex::Protocol protocol,
+                    uint64_t offset);
+
+    /**
+     * \brief Gets the amount of flows added so far.
+     */
+    size_t size() const;
+
+    /**
+     * \brief Writes the index.
+     *
+     * If the file can't be opened, file_open_error is thrown. If it can't
+     * be written, file_write_error is thrown.
+     *
+     * \param file_name The path of the index file.
+     */
+    void write(const std::string& file_name) const;
+private:
+    typedef std::pair<uint8_t, StreamIdentifier> key_type;
+    typedef std::map<key_type, FlowIndex::offsets_type> flows_type;
+
+    flows_type flows_;
+};
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
+#endif // TINS_TCP_IP_FLOW_INDEX_H
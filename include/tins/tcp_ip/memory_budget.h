@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TCP_IP_MEMORY_BUDGET_H
+#define TINS_TCP_IP_MEMORY_BUDGET_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+#include <tins/macros.h>
+
+namespace Tins {
+namespace TCPIP {
+
+/**
+ * \brief Limits the memory used to reassemble streams
+ *
+ * A budget keeps track of the amount of bytes held by every StreamFollower
+ * that uses it, counting both the payload that's ready to be read and the 
+ * out of order data that is buffered. A single budget can be shared by 
+ * several followers, e.g. by every shard in a ParallelStreamFollower, so 
+ * the limit applies to all of them. Unless told otherwise, every follower 
+ * uses the process wide budget returned by MemoryBudget::process_budget.
+ * All methods are thread safe.
+ *
+ * \sa StreamFollower::memory_budget
+ */
+class TINS_API MemoryBudget {
+public:
+    /**
+     * \brief Constructs a memory budget
+     *
+     * \param limit The maximum amount of bytes to be used
+     */
+    MemoryBudget(uint64_t limit);
+
+    /**
+     * \brief Retrieves the process wide memory budget
+     *
+     * This is the budget used by default by every StreamFollower and 
+     * ParallelStreamFollower. It has no limit until one is set.
+     */
+    static std::shared_ptr<MemoryBudget> process_budget();
+
+    /**
+     * Retrieves the maximum amount of bytes to be used
+     */
+    uint64_t limit() const;
+
+    /**
+     * \brief Sets the maximum amount of bytes to be used
+     *
+     * \param value The new limit
+     */
+    void limit(uint64_t value);
+
+    /**
+     * Retrieves the amount of bytes currently in use
+     */
+    uint64_t usage() const;
+
+    /**
+     * Indicates whether the usage is above the limit
+     */
+    bool exceeded() const;
+
+    /**
+     * \brief Updates the amount of bytes in use
+     *
+     * \param previous_size The amount of bytes previously used by a stream
+     * \param size The amount of bytes now used by that stream
+     */
+    void update(uint64_t previous_size, uint64_t size);
+private:
+    MemoryBudget(const MemoryBudget&);
+    MemoryBudget& operator=(const MemoryBudget&);
+
+    std::atomic<uint64_t> limit_;
+    std::atomic<uint64_t> usage_;
+};
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
+
+#endif // TINS_TCP_IP_MEMORY_BUDGET_H
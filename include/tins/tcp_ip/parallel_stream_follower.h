@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TCP_IP_PARALLEL_STREAM_FOLLOWER_H
+#define TINS_TCP_IP_PARALLEL_STREAM_FOLLOWER_H
+
+#include <tins/config.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <tins/packet.h>
+#include <tins/pipeline.h>
+#include <tins/tcp_ip/stream_follower.h>
+#include <tins/tcp_ip/memory_budget.h>
+
+namespace Tins {
+
+class PDU;
+
+namespace TCPIP {
+
+/**
+ * \brief Follows TCP streams using several threads
+ *
+ * This class owns several StreamFollower shards, each of them running on 
+ * its own worker thread. Packets are handed over to the shard picked by 
+ * hashing their stream identifier (see StreamIdentifier::hash), which is
+ * the same for both directions of a stream. This means every packet in a 
+ * stream is always processed by the same shard, so reassembly doesn't 
+ * require any synchronization.
+ *
+ * The callbacks work just like the ones in StreamFollower, except that
+ * they're executed on the thread of the shard that owns the stream. This
+ * means callbacks for different streams can run concurrently, so any
+ * state they share has to be synchronized.
+ *
+ * The shards' threads are started when the first packet is processed and
+ * they keep running until ParallelStreamFollower::stop is called. Every
+ * configuration method has to be called while the shards aren't running.
+ *
+ * \code
+ * Sniffer sniffer("eth0");
+ * ParallelStreamFollower follower(4);
+ * follower.new_stream_callback([](Stream& stream) {
+ *     // Executed on the thread of the shard that owns this stream
+ * });
+ * while (Packet packet = sniffer.next_packet()) {
+ *     follower.process_packet(std::move(packet));
+ * }
+ * follower.stop();
+ * \endcode
+ */
+class TINS_API ParallelStreamFollower {
+public:
+    /**
+     * The type used to store the amount of shards
+     */
+    typedef size_t size_type;
+
+    /**
+     * The type used for callbacks
+     */
+    typedef StreamFollower::stream_callback_type stream_callback_type;
+
+    /**
+     * The type used for stream termination callbacks
+     */
+    typedef StreamFollower::stream_termination_callback_type stream_termination_callback_type;
+
+    /**
+     * The default capacity of each shard's packet queue
+     */
+    static const size_t DEFAULT_QUEUE_CAPACITY = Pipeline<Packet>::DEFAULT_QUEUE_CAPACITY;
+
+    /**
+     * \brief Constructs a ParallelStreamFollower
+     *
+     * \param size The amount of shards to use, which can't be 0
+     * \param queue_capacity The capacity of each shard's packet queue. 
+     * Processing a packet blocks while the queue of the shard it belongs
+     * to is full.
+     */
+    ParallelStreamFollower(size_type size, size_t queue_capacity = DEFAULT_QUEUE_CAPACITY);
+
+    /**
+     * \brief Destructor
+     *
+     * If the shards are still running, they are stopped. Any exception
+     * thrown by them is discarded.
+     */
+    ~ParallelStreamFollower();
+
+    /**
+     * Gets the amount of shards
+     */
+    size_type size() const;
+
+    /**
+     * \brief Processes a packet
+     *
+     * The packet is cloned and timestamped using the current time.
+     *
+     * \param packet The packet to be processed
+     * \sa StreamFollower::process_packet
+     */
+    void process_packet(const PDU& packet);
+
+    /**
+     * \brief Processes a packet
+     *
+     * The packet is copied before handing it over to its shard.
+     *
+     * \param packet The packet to be processed
+     * \sa StreamFollower::process_packet
+     */
+    void process_packet(const Packet& packet);
+
+    /**
+     * \brief Processes a packet
+     *
+     * Payloads borrowed from the capture's buffer, e.g. when zero copy
+     * payloads are enabled on the sniffer or file reader the packet came 
+     * from, are copied before handing the packet over to its shard.
+     *
+     * \param packet The packet to be processed
+     * \sa StreamFollower::process_packet
+     * \sa RawPDU::zero_copy_scope
+     */
+    void process_packet(Packet&& packet);
+
+    /**
+     * \brief Stops the shards
+     *
+     * Each shard processes the packets left in its queue before stopping.
+     * This blocks until every shard's thread is done. If any callback threw
+     * an exception, it is rethrown here.
+     *
+     * Streams are kept, so processing more packets afterwards resumes
+     * following them.
+     */
+    void stop();
+
+    /**
+     * \brief Gets the shard that handles a packet
+     *
+     * \param packet The packet, which must contain a TCP layer
+     * \return The index of the shard
+     */
+    size_type shard_index(const PDU& packet) const;
+
+    /**
+     * \brief Sets the callback to be executed when a new stream is captured
+     *
+     * \param callback The callback to be set
+     * \sa StreamFollower::new_stream_callback
+     */
+    void new_stream_callback(const stream_callback_type& callback);
+
+    /**
+     * \brief Sets the stream termination callback
+     *
+     * \param callback The callback to be executed on stream termination
+     * \sa StreamFollower::stream_termination_callback
+     */
+    void stream_termination_callback(const stream_termination_callback_type& callback);
+
+    /**
+     * \brief Sets the maximum time a stream will be followed without capturing
+     * packets that belong to it.
+     *
+     * \param keep_alive The maximum time to keep unseen streams
+     * \sa StreamFollower::stream_keep_alive
+     */
+    template <typename Rep, typename Period>
+    void stream_keep_alive(const std::chrono::duration<Rep, Period>& keep_alive) {
+        for (size_type i = 0; i < followers_.size(); ++i) {
+            followers_[i]->stream_keep_alive(keep_alive);
+        }
+    }
+
+    /**
+     * \brief Indicates whether partial streams should be followed.
+     *
+     * \param value Whether following partial stream is allowed.
+     * \sa StreamFollower::follow_partial_streams
+     */
+    void follow_partial_streams(bool value);
+
+    /**
+     * \brief Sets the maximum amount of memory used to reassemble streams
+     *
+     * This sets the limit of the budget shared by all shards. By default 
+     * that's the process wide budget returned by 
+     * MemoryBudget::process_budget, so the limit also applies to every 
+     * other follower using it. Whenever it's exceeded, the shard that just
+     * processed a packet terminates its least recently seen streams, using
+     * the StreamFollower::MEMORY_PRESSURE reason, until it frees its share
+     * of the excess. Each shard's share is proportional to the amount of 
+     * bytes it holds.
+     *
+     * Unlike other configuration methods, this can be called while the 
+     * shards are running.
+     *
+     * \param max_bytes The maximum amount of bytes to use
+     * \sa StreamFollower::memory_budget
+     */
+    void memory_budget(uint64_t max_bytes);
+
+    /**
+     * \brief Sets the memory budget shared by all shards
+     *
+     * \param budget The budget to use
+     * \sa StreamFollower::memory_budget
+     */
+    void memory_budget(const std::shared_ptr<MemoryBudget>& budget);
+
+    /**
+     * Retrieves the memory budget shared by all shards
+     */
+    const std::shared_ptr<MemoryBudget>& memory_budget() const;
+
+    /**
+     * \brief Retrieves the amount of bytes used in the shards' memory budget
+     *
+     * Note that this includes the bytes held by any other follower that 
+     * shares the same budget, which by default is the process wide one.
+     * This can be called while the shards are running.
+     */
+    uint64_t buffered_bytes() const;
+private:
+    ParallelStreamFollower(const ParallelStreamFollower&);
+    ParallelStreamFollower& operator=(const ParallelStreamFollower&);
+
+    void start();
+
+    std::vector<std::unique_ptr<StreamFollower>> followers_;
+    Pipeline<Packet> pipeline_;
+    std::shared_ptr<MemoryBudget> memory_budget_;
+    bool has_new_stream_callback_;
+    bool running_;
+};
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
+
+#endif // TINS_TCP_IP_PARALLEL_STREAM_FOLLOWER_H
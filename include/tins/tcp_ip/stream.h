@@ -99,6 +99,19 @@ public:
                                uint32_t,
                                const payload_type&)> stream_packet_callback_type;
 
+    /**
+     * \brief The type used for data span callbacks
+     *
+     * The arguments are the stream, a pointer to the data, its size and the
+     * offset of the data's first byte within the flow's stream.
+     *
+     * \sa Flow::data_span_callback
+     */
+    typedef std::function<void(Stream&,
+                               const uint8_t*,
+                               size_t,
+                               uint64_t)> stream_data_span_callback_type;
+
     /**
      * The type used to store hardware addresses
      */
@@ -296,6 +309,30 @@ public:
      */
     void server_out_of_order_callback(const stream_packet_callback_type& callback);
 
+    /**
+     * \brief Sets the callback to be executed for every in order span of 
+     * client data
+     *
+     * While this callback is set, client data is not accumulated in the 
+     * client payload and the client data callback is not executed.
+     *
+     * \sa Flow::data_span_callback
+     * \param callback The callback to be set
+     */
+    void client_data_span_callback(const stream_data_span_callback_type& callback);
+
+    /**
+     * \brief Sets the callback to be executed for every in order span of 
+     * server data
+     *
+     * While this callback is set, server data is not accumulated in the 
+     * server payload and the server data callback is not executed.
+     *
+     * \sa Flow::data_span_callback
+     * \param callback The callback to be set
+     */
+    void server_data_span_callback(const stream_data_span_callback_type& callback);
+
     /**
      * \brief Indicates that the data packets sent by the client should be 
      * ignored
@@ -329,11 +366,13 @@ public:
      * erased. 
      *
      * If this property is false, then the payload <b>will not</b> be erased
-     * and the user is responsible for clearing the payload vector. 
+     * and the user is responsible for clearing it (see Flow::clear_payload).
      *
      * Setting this property to false is useful if it's desired to hold all 
      * of the data sent on the stream before processing it. Note that this
-     * can lead to the memory growing a lot.
+     * can lead to the memory growing a lot. Making the flows keep their 
+     * segments (see Flow::keep_payload_segments) avoids concatenating the
+     * data as it's held.
      *
      * This property is true by default. 
      *
@@ -429,6 +468,10 @@ private:
 
     void on_client_flow_data(const Flow& flow);
     void on_server_flow_data(const Flow& flow);
+    void on_client_flow_data_span(const Flow& flow, const uint8_t* data,
+                                  size_t size, uint64_t offset);
+    void on_server_flow_data_span(const Flow& flow, const uint8_t* data,
+                                  size_t size, uint64_t offset);
     void on_client_out_of_order(const Flow& flow,
                                 uint32_t seq,
                                 const payload_type& payload);
@@ -453,6 +496,8 @@ private:
     stream_callback_type on_server_data_callback_;
     stream_packet_callback_type on_client_out_of_order_callback_;
     stream_packet_callback_type on_server_out_of_order_callback_;
+    stream_data_span_callback_type on_client_data_span_callback_;
+    stream_data_span_callback_type on_server_data_span_callback_;
     hwaddress_type client_hw_addr_;
     hwaddress_type server_hw_addr_;
     timestamp_type create_time_;
@@ -34,9 +34,12 @@
 
 #ifdef TINS_HAVE_TCPIP
 
-#include <map>
+#include <list>
+#include <memory>
+#include <unordered_map>
 #include <tins/tcp_ip/stream.h>
 #include <tins/tcp_ip/stream_identifier.h>
+#include <tins/tcp_ip/memory_budget.h>
 
 namespace Tins {
 
@@ -93,7 +96,8 @@ public:
     enum TerminationReason {
         TIMEOUT, ///< The stream was terminated due to a timeout
         BUFFERED_DATA, ///< The stream was terminated because it had too much buffered data
-        SACKED_SEGMENTS ///< The stream was terminated because it had too many SACKed segments
+        SACKED_SEGMENTS, ///< The stream was terminated because it had too many SACKed segments
+        MEMORY_PRESSURE ///< The stream was terminated because the memory budget was exceeded
     };
 
     /**
@@ -108,6 +112,33 @@ public:
      */
     StreamFollower();
 
+    /**
+     * \brief Copy constructor
+     *
+     * The streams being followed are copied and the new follower uses
+     * the same memory budget as the original one.
+     *
+     * \param other The follower to be copied
+     */
+    StreamFollower(const StreamFollower& other);
+
+    /**
+     * \brief Copy assignment operator
+     *
+     * The streams being followed are copied and this follower starts 
+     * using the same memory budget as the original one.
+     *
+     * \param other The follower to be copied
+     */
+    StreamFollower& operator=(const StreamFollower& other);
+
+    /**
+     * \brief Destructor
+     *
+     * Releases the memory held by this follower's streams from its budget.
+     */
+    ~StreamFollower();
+
     /** 
      * \brief Processes a packet
      *
@@ -147,6 +178,8 @@ public:
      *
      * * It contains too much buffered data.
      * * No packets have been seen for some time interval.
+     * * The memory budget is exceeded and it's one of the least recently 
+     * seen streams.
      *
      * \param callback The callback to be executed on stream termination
      * \sa StreamFollower::stream_keep_alive
@@ -157,6 +190,13 @@ public:
      * \brief Sets the maximum time a stream will be followed without capturing
      * packets that belong to it.
      *
+     * Streams are kept sorted by the time they were last seen, so expired
+     * streams are removed as packets are processed, without having to
+     * go through every stream being followed. Packets don't have to be
+     * processed in time order (e.g. when merging several captures), but
+     * the further back in time a packet is, the longer it takes to find
+     * its stream's position.
+     *
      * \param keep_alive The maximum time to keep unseen streams
      */
     template <typename Rep, typename Period>
@@ -205,6 +245,52 @@ public:
      * \sa Stream::enable_recovery_mode
      */
     void follow_partial_streams(bool value);
+
+    /**
+     * \brief Sets the maximum amount of memory used to reassemble streams
+     *
+     * This gives this follower its own budget, which limits the amount of
+     * bytes held by its streams, counting both each flow's payload and its
+     * buffered out of order data. Whenever the limit is exceeded after 
+     * processing a packet, the least recently seen streams that hold any 
+     * data are terminated, using the MEMORY_PRESSURE reason, until the 
+     * usage is below the limit again.
+     *
+     * By default every follower uses the process wide budget returned by
+     * MemoryBudget::process_budget, which has no limit until one is set.
+     * When a budget is shared by several followers, the one that finds
+     * it exceeded only frees its share of the excess, proportional to the 
+     * amount of bytes it holds. The rest is freed by the other followers 
+     * as they process packets.
+     *
+     * \param max_bytes The maximum amount of bytes to use
+     */
+    void memory_budget(uint64_t max_bytes);
+
+    /**
+     * \brief Sets a memory budget shared with other followers
+     *
+     * Sharing a budget makes the limit apply to all followers that use
+     * it combined. Each follower only terminates its own streams, freeing
+     * its share of the excess.
+     *
+     * \param budget The budget to use
+     * \sa StreamFollower::memory_budget
+     */
+    void memory_budget(const std::shared_ptr<MemoryBudget>& budget);
+
+    /**
+     * Retrieves the memory budget used by this follower
+     */
+    const std::shared_ptr<MemoryBudget>& memory_budget() const;
+
+    /**
+     * \brief Retrieves the amount of bytes held by this follower's streams
+     *
+     * This is the amount of bytes this follower accounts for in its memory
+     * budget.
+     */
+    uint64_t buffered_bytes() const;
 private:
     typedef Stream::timestamp_type timestamp_type;
 
@@ -213,19 +299,46 @@ private:
     static const uint32_t DEFAULT_MAX_BUFFERED_BYTES;
     static const timestamp_type DEFAULT_KEEP_ALIVE;
 
-    typedef std::map<stream_id, Stream> streams_type;
+    struct stream_entry;
+
+    // The followed streams' map entries, sorted by the time they were last
+    // seen. Entries don't move while they're in the map, so these stay valid
+    typedef std::list<std::pair<const stream_id, stream_entry>*> expiry_list_type;
+
+    struct stream_entry {
+        stream_entry(const Stream& stream, expiry_list_type::iterator position)
+        : stream(stream), position(position), memory_usage(0) {
+
+        }
+
+        Stream stream;
+        expiry_list_type::iterator position;
+        uint64_t memory_usage;
+    };
+
+    // Streams must not be moved around once inserted, as their flows'
+    // callbacks point back to them, so this has to be a node based container
+    typedef std::unordered_map<stream_id, stream_entry> streams_type;
 
     Stream& find_stream(const stream_id& id);
     void process_packet(PDU& packet, const timestamp_type& ts);
+    void update_expiry_position(stream_entry& entry, const timestamp_type& ts);
+    void update_memory_usage(stream_entry& entry);
+    void erase_stream(streams_type::iterator iter);
     void cleanup_streams(const timestamp_type& now);
+    void evict_streams();
+    void copy_streams(const StreamFollower& other);
+    void clear_streams();
 
     streams_type streams_;
+    expiry_list_type expiry_list_;
     stream_callback_type on_new_connection_;
     stream_termination_callback_type on_stream_termination_;
     size_t max_buffered_chunks_;
     uint32_t max_buffered_bytes_;
-    timestamp_type last_cleanup_;
     timestamp_type stream_keep_alive_;
+    std::shared_ptr<MemoryBudget> memory_budget_;
+    uint64_t buffered_bytes_;
     bool attach_to_flows_;
 };
 
@@ -35,6 +35,8 @@
 #ifdef TINS_HAVE_TCPIP
 
 #include <array>
+#include <functional>
+#include <cstddef>
 #include <stdint.h>
 
 namespace Tins {
@@ -54,7 +56,9 @@ class Stream;
  * addresses/ports in a stream to match packets coming from any of the 2 endpoints
  * into the same object.
  *
- * This struct implements operator< so it can be used as a key on std::maps
+ * This struct implements operator< so it can be used as a key on std::maps.
+ * It can also be used as a key on std::unordered_maps, as std::hash is
+ * specialized for it.
  */
 struct StreamIdentifier {
     /**
@@ -88,6 +92,14 @@ struct StreamIdentifier {
      */ 
     bool operator==(const StreamIdentifier& rhs) const;
 
+    /**
+     * \brief Computes a hash of this stream identifier
+     *
+     * Since identifiers are built out of the sorted endpoints, both
+     * directions of a stream produce the same hash value.
+     */
+    std::size_t hash() const;
+
     address_type min_address;
     address_type max_address;
     uint16_t min_address_port;
@@ -102,6 +114,17 @@ struct StreamIdentifier {
 } // TCPIP
 } // Tins
 
+namespace std {
+
+template<>
+struct hash<Tins::TCPIP::StreamIdentifier> {
+    size_t operator()(const Tins::TCPIP::StreamIdentifier& identifier) const {
+        return identifier.hash();
+    }
+};
+
+} // std
+
 #endif // TINS_HAVE_TCPIP
 #endif // TINS_TCP_IP_STREAM_ID_H
 
@@ -0,0 +1,208 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef TINS_TIMESTAMP_INDEX_H
+#define TINS_TIMESTAMP_INDEX_H
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <stdint.h>
+#include <tins/macros.h>
+#include <tins/timestamp.h>
+
+namespace Tins {
+namespace Internals {
+class MappedFile;
+} // Internals
+
+/**
+ * \class TimestampIndex
+ * \brief Maps timestamps to record offsets within a pcap file.
+ *
+ * A timestamp index is a sidecar file that contains one entry every few
+ * records of a pcap file. Each entry stores the offset of a record and 
+ * the highest timestamp seen up to and including that record. Since these
+ * are never decreasing, even when the capture's records are slightly out
+ * of order, looking up a timestamp is a binary search over the memory 
+ * mapped index.
+ *
+ * Indexes can be built for existing files using TimestampIndex::build or
+ * while a file is being written, using TimestampIndexWriter (see 
+ * PacketWriter::set_timestamp_index). They can then be used to jump to
+ * a point in time using PcapFileReader:
+ *
+ * \code
+ * TimestampIndex::build("capture.pcap", "capture.pcap.idx");
+ *
+ * TimestampIndex index("capture.pcap.idx");
+ * PcapFileReader reader("capture.pcap");
+ * reader.sniff_time_range([&](Packet& packet) {
+ *     // process packet
+ *     return true;
+ * }, start, end, index);
+ * \endcode
+ *
+ * The index stores its values in little endian, so it can be moved 
+ * along with its capture file to hosts using a different byte order.
+ */
+class TINS_API TimestampIndex {
+public:
+    /**
+     * \brief The default amount of records per index entry.
+     */
+    static const uint32_t DEFAULT_INTERVAL;
+
+    /**
+     * \brief Opens an index file.
+     *
+     * If the file can't be opened, file_open_error is thrown. If it's not
+     * an index file, invalid_file_format is thrown.
+     *
+     * \param file_name The path of the index file.
+     */
+    TimestampIndex(const std::string& file_name);
+
+    /**
+     * \brief Unmaps the index file.
+     */
+    ~TimestampIndex();
+
+    /**
+     * \brief Builds the index for an existing pcap file.
+     *
+     * \param capture_file_name The path of the pcap file to index.
+     * \param index_file_name The path of the index file to write.
+     * \param interval The amount of records per index entry.
+     */
+    static void build(const std::string& capture_file_name,
+                      const std::string& index_file_name,
+                      uint32_t interval = DEFAULT_INTERVAL);
+
+    /**
+     * \brief Finds the offset from which to look for a timestamp.
+     *
+     * Every record before the returned offset has a timestamp lower
+     * than the given one. Records between this offset and the first one
+     * at or after the timestamp have to be skipped by the caller.
+     *
+     * \param timestamp The timestamp to look for.
+     * \return The offset of a record in the capture file, or 0 if the 
+     * index is empty.
+     */
+    uint64_t find(const Timestamp& timestamp) const;
+
+    /**
+     * \brief Gets the amount of entries in this index.
+     */
+    uint64_t size() const;
+
+    /**
+     * \brief Gets the amount of records per entry used when building 
+     * this index.
+     */
+    uint32_t interval() const;
+
+    /**
+     * \brief Converts a timestamp into the representation used by 
+     * index entries.
+     *
+     * \param timestamp The timestamp to convert.
+     * \return The amount of microseconds since the epoch.
+     */
+    static uint64_t to_microseconds(const Timestamp& timestamp);
+private:
+    TimestampIndex(const TimestampIndex&);
+    TimestampIndex& operator=(const TimestampIndex&);
+
+    uint64_t entry_timestamp(uint64_t index) const;
+    uint64_t entry_offset(uint64_t index) const;
+
+    Internals::MappedFile* file_;
+    uint64_t size_;
+    uint32_t interval_;
+};
+
+/**
+ * \class TimestampIndexWriter
+ * \brief Writes a TimestampIndex while its capture file is written.
+ *
+ * Every record written to the capture file has to be reported, in order,
+ * using TimestampIndexWriter::add_record. Entries are buffered and 
+ * written in batches, so TimestampIndexWriter::flush has to be called
+ * before opening the index while the capture is still being written.
+ */
+class TINS_API TimestampIndexWriter {
+public:
+    /**
+     * \brief Creates an index file.
+     *
+     * If the file already exists, it's truncated. If it can't be opened,
+     * file_open_error is thrown.
+     *
+     * \param file_name The path of the index file.
+     * \param interval The amount of records per index entry.
+     */
+    TimestampIndexWriter(const std::string& file_name,
+                         uint32_t interval = TimestampIndex::DEFAULT_INTERVAL);
+
+    /**
+     * \brief Flushes any buffered entries and closes the file.
+     */
+    ~TimestampIndexWriter();
+
+    /**
+     * \brief Reports a record written to the capture file.
+     *
+     * \param timestamp The record's timestamp.
+     * \param offset The offset of the record's header within the 
+     * capture file.
+     */
+    void add_record(const Timestamp& timestamp, uint64_t offset);
+
+    /**
+     * \brief Writes any buffered entries to the file.
+     *
+     * Throws file_write_error if the entries can't be written.
+     */
+    void flush();
+private:
+    TimestampIndexWriter(const TimestampIndexWriter&);
+    TimestampIndexWriter& operator=(const TimestampIndexWriter&);
+
+    std::FILE* file_;
+    std::vector<uint8_t> buffer_;
+    uint64_t max_timestamp_;
+    uint32_t interval_;
+    uint32_t pending_records_;
+};
+
+} // Tins
+
+#endif // TINS_TIMESTAMP_INDEX_H
@@ -80,5 +80,20 @@
 #include <tins/ip_reassembler.h>
 
 #include <tins/pdu_iterator.h>
+#include <tins/lazy_packet.h>
+#include <tins/packet_view.h>
+#include <tins/packet_arena.h>
+#include <tins/packet_decoder.h>
+#include <tins/packet_queue.h>
+#include <tins/pipeline.h>
+#include <tins/shared_packet.h>
+#include <tins/pcap_file_reader.h>
+#include <tins/pcapng_reader.h>
+#include <tins/pcapng_writer.h>
+#include <tins/parallel_file_processor.h>
+#include <tins/timestamp_index.h>
+#include <tins/ring_sniffer.h>
+#include <tins/sniffer_group.h>
+#include <tins/sniffer_reactor.h>
 
 #endif // TINS_TINS_H
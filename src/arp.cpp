@@ -34,17 +34,27 @@
 #include <tins/constants.h>
 #include <tins/exceptions.h>
 #include <tins/memory_helpers.h>
+#include <tins/detail/pdu_helpers.h>
 
 using Tins::Memory::InputMemoryStream;
 using Tins::Memory::OutputMemoryStream;
 
 namespace Tins {
 
-PDU::metadata ARP::extract_metadata(const uint8_t* /*buffer*/, uint32_t total_sz) {
-    if (TINS_UNLIKELY(total_sz < sizeof(arp_header))) {
+PDU::metadata ARP::extract_metadata(const uint8_t* buffer, uint32_t total_sz) {
+    metadata output;
+    if (TINS_UNLIKELY(!try_extract_metadata(buffer, total_sz, output))) {
         throw malformed_packet();
     }
-    return metadata(sizeof(arp_header), pdu_flag, PDU::UNKNOWN);
+    return output;
+}
+
+bool ARP::try_extract_metadata(const uint8_t* /*buffer*/, uint32_t total_sz, metadata& output) {
+    if (TINS_UNLIKELY(total_sz < sizeof(arp_header))) {
+        return false;
+    }
+    output = metadata(sizeof(arp_header), pdu_flag, PDU::UNKNOWN);
+    return true;
 }
 
 ARP::ARP(ipaddress_type target_ip, 
@@ -63,8 +73,11 @@ ARP::ARP(ipaddress_type target_ip,
 }
 
 ARP::ARP(const uint8_t* buffer, uint32_t total_sz) {
+    Internals::header_check header_check(buffer);
     InputMemoryStream stream(buffer, total_sz);
-    stream.read(header_);
+    if (!header_check.check(stream.try_read(header_))) {
+        return;
+    }
     if (stream) {
         inner_pdu(new RawPDU(stream.pointer(), stream.size()));
     }
@@ -227,7 +227,7 @@ struct RC4Key {
 
     static RC4Key from_packet(const Dot11Data& dot11, const RawPDU& raw,
                               const vector<uint8_t>& ptk) { 
-        const RawPDU::payload_type& pload = raw.payload();
+        const uint8_t* pload = raw.payload_data();
         const uint8_t* tk = &ptk[0] + 32;
         Internals::byte_array<16> rc4_key;
         uint16_t ppk[6];
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifndef _WIN32
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <cerrno>
+    #include <cstring>
+#else
+    #include <fstream>
+#endif // _WIN32
+#include <tins/detail/mapped_file.h>
+#include <tins/exceptions.h>
+
+using std::string;
+
+namespace Tins {
+namespace Internals {
+
+#ifndef _WIN32
+
+MappedFile::MappedFile(const string& file_name)
+: data_(0), size_(0) {
+    int fd = open(file_name.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw file_open_error(file_name + ": " + strerror(errno));
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) == -1) {
+        const string error = strerror(errno);
+        close(fd);
+        throw file_open_error(file_name + ": " + error);
+    }
+    size_ = static_cast<uint64_t>(file_stat.st_size);
+    // Mapping 0 bytes fails, empty files just have no data
+    if (size_ > 0) {
+        void* mapping = mmap(0, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            const string error = strerror(errno);
+            close(fd);
+            throw file_open_error(file_name + ": " + error);
+        }
+        data_ = static_cast<const uint8_t*>(mapping);
+    }
+    // The mapping stays valid after closing the descriptor
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (data_) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+    }
+}
+
+void MappedFile::advise(AccessHint hint) const {
+    if (!data_) {
+        return;
+    }
+    int advice = MADV_NORMAL;
+    if (hint == SEQUENTIAL_ACCESS) {
+        advice = MADV_SEQUENTIAL;
+    }
+    else if (hint == RANDOM_ACCESS) {
+        advice = MADV_RANDOM;
+    }
+    // This is just a hint, failing is harmless
+    madvise(const_cast<uint8_t*>(data_), size_, advice);
+}
+
+void MappedFile::prefetch(uint64_t offset, uint64_t size) const {
+    if (offset >= size_) {
+        return;
+    }
+    // madvise needs a page aligned address
+    static const uint64_t page_size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    const uint64_t start = offset - offset % page_size;
+    const uint64_t end = (size > size_ - offset) ? size_ : offset + size;
+    madvise(const_cast<uint8_t*>(data_) + start, end - start, MADV_WILLNEED);
+}
+
+#else
+
+MappedFile::MappedFile(const string& file_name)
+: data_(0), size_(0) {
+    std::ifstream input(file_name.c_str(), std::ios::binary);
+    if (!input) {
+        throw file_open_error(file_name + ": failed to open file");
+    }
+    input.seekg(0, std::ios::end);
+    buffer_.resize(static_cast<size_t>(input.tellg()));
+    input.seekg(0, std::ios::beg);
+    if (!buffer_.empty()) {
+        input.read(reinterpret_cast<char*>(&buffer_[0]), buffer_.size());
+        data_ = &buffer_[0];
+    }
+    size_ = buffer_.size();
+}
+
+MappedFile::~MappedFile() {
+
+}
+
+void MappedFile::advise(AccessHint) const {
+
+}
+
+void MappedFile::prefetch(uint64_t, uint64_t) const {
+
+}
+
+#endif // _WIN32
+
+} // Internals
+} // Tins
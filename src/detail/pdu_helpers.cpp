@@ -44,6 +44,7 @@
 #include <tins/loopback.h>
 #include <tins/sll.h>
 #include <tins/ppi.h>
+#include <tins/pktap.h>
 #include <tins/icmpv6.h>
 #include <tins/mpls.h>
 #include <tins/arp.h>
@@ -52,75 +53,209 @@
 #include <tins/dot1q.h>
 #include <tins/pppoe.h>
 #include <tins/pdu_allocator.h>
+#include <tins/exceptions.h>
 
 namespace Tins {
 namespace Internals {
 
+#ifdef TINS_HAVE_CXX11
+bool& truncated_layer_flag() {
+    static thread_local bool flag = false;
+    return flag;
+}
+
+namespace {
+
+// The innermost header_check::scope not yet claimed by a PDU
+thread_local header_check::scope* pending_header_check = 0;
+
+// The arena given to the PacketDecoder::decode call running on this thread
+thread_local PacketArena* current_decode_arena = 0;
+
+} // anonymous namespace
+
+decode_arena::scope::scope(PacketArena* arena)
+: previous_(current_decode_arena) {
+    current_decode_arena = arena;
+}
+
+decode_arena::scope::~scope() {
+    current_decode_arena = previous_;
+}
+
+PacketArena* decode_arena::current() {
+    return current_decode_arena;
+}
+
+header_check::scope::scope(const uint8_t* buffer)
+: buffer_(buffer), failed_(false), previous_(pending_header_check) {
+    pending_header_check = this;
+}
+
+header_check::scope::~scope() {
+    pending_header_check = previous_;
+}
+
+header_check::header_check(const uint8_t* buffer)
+: failed_(0) {
+    // Layers that don't check their header (e.g. Loopback) construct their
+    // inner PDUs directly, so those have to be told apart by their buffer
+    scope* pending = pending_header_check;
+    if (pending && pending->buffer_ == buffer) {
+        failed_ = &pending->failed_;
+        pending_header_check = 0;
+    }
+}
+
+#else
+
+decode_arena::scope::scope(PacketArena* /*arena*/)
+: previous_(0) {
+
+}
+
+decode_arena::scope::~scope() {
+
+}
+
+PacketArena* decode_arena::current() {
+    return 0;
+}
+
+header_check::scope::scope(const uint8_t* buffer)
+: buffer_(buffer), failed_(false), previous_(0) {
+
+}
+
+header_check::scope::~scope() {
+
+}
+
+header_check::header_check(const uint8_t* /*buffer*/)
+: failed_(0) {
+
+}
+
+#endif // TINS_HAVE_CXX11
+
+bool header_check::fail() {
+    if (!failed_) {
+        throw malformed_packet();
+    }
+    *failed_ = true;
+    return false;
+}
+
+// Inner layers which don't have a valid header are kept as a RawPDU, rather
+// than letting their constructor throw and discard the whole packet
+template <typename T>
+PDU* allocate_inner_pdu(const uint8_t* buffer, uint32_t size) {
+    #ifdef TINS_HAVE_CXX11
+        header_check::scope scope(buffer);
+        PDU* pdu = decode_arena::allocate<T>(buffer, size);
+        if (TINS_LIKELY(!scope.failed())) {
+            return pdu;
+        }
+        decode_arena::destroy(pdu);
+        truncated_layer_flag() = true;
+        return decode_arena::allocate<RawPDU>(buffer, size);
+    #else
+        // Without thread locals, constructors can only report errors by 
+        // throwing, so the header is checked beforehand
+        PDU::metadata metadata;
+        if (TINS_UNLIKELY(!T::try_extract_metadata(buffer, size, metadata))) {
+            return new RawPDU(buffer, size);
+        }
+        return new T(buffer, size);
+    #endif // TINS_HAVE_CXX11
+}
+
+// Tags and encapsulations are link layer PDUs, anything else carried by
+// an ethertype is considered to be in the network layer
+PacketDecoder::Layer ether_type_layer(Constants::Ethernet::e flag) {
+    switch (flag) {
+        case Constants::Ethernet::VLAN:
+        case Constants::Ethernet::QINQ:
+        case Constants::Ethernet::OLD_QINQ:
+        case Constants::Ethernet::MPLS:
+        case Constants::Ethernet::PPPOED:
+        case Constants::Ethernet::PPPOES:
+            return PacketDecoder::LINK_LAYER;
+        default:
+            return PacketDecoder::NETWORK_LAYER;
+    }
+}
+
+// Tunneled IP datagrams stay in the network layer
+PacketDecoder::Layer ip_type_layer(Constants::IP::e flag) {
+    switch (flag) {
+        case Constants::IP::PROTO_IPIP:
+        case Constants::IP::PROTO_IPV6:
+            return PacketDecoder::NETWORK_LAYER;
+        default:
+            return PacketDecoder::TRANSPORT_LAYER;
+    }
+}
+
+PDU* allocate_eapol(const uint8_t* buffer, uint32_t size) {
+    return EAPOL::from_bytes(buffer, size);
+}
+
+void builtin_allocators(pdu_tag<uint16_t>,
+                        std::vector<std::pair<uint16_t, allocator_function> >& output) {
+    typedef std::pair<uint16_t, allocator_function> entry;
+    output.push_back(entry(Constants::Ethernet::IP, &allocate_inner_pdu<IP>));
+    output.push_back(entry(Constants::Ethernet::IPV6, &allocate_inner_pdu<IPv6>));
+    output.push_back(entry(Constants::Ethernet::ARP, &allocate_inner_pdu<ARP>));
+    output.push_back(entry(Constants::Ethernet::PPPOED, &decode_arena::allocate<PPPoE>));
+    output.push_back(entry(Constants::Ethernet::PPPOES, &decode_arena::allocate<PPPoE>));
+    output.push_back(entry(Constants::Ethernet::EAPOL, &allocate_eapol));
+    output.push_back(entry(Constants::Ethernet::VLAN, &allocate_inner_pdu<Dot1Q>));
+    output.push_back(entry(Constants::Ethernet::QINQ, &allocate_inner_pdu<Dot1Q>));
+    output.push_back(entry(Constants::Ethernet::OLD_QINQ, &allocate_inner_pdu<Dot1Q>));
+    output.push_back(entry(Constants::Ethernet::MPLS, &decode_arena::allocate<MPLS>));
+}
+
+void builtin_allocators(pdu_tag<uint8_t>,
+                        std::vector<std::pair<uint8_t, allocator_function> >& output) {
+    typedef std::pair<uint8_t, allocator_function> entry;
+    output.push_back(entry(Constants::IP::PROTO_IPIP, &allocate_inner_pdu<IP>));
+    output.push_back(entry(Constants::IP::PROTO_TCP, &allocate_inner_pdu<TCP>));
+    output.push_back(entry(Constants::IP::PROTO_UDP, &allocate_inner_pdu<UDP>));
+    output.push_back(entry(Constants::IP::PROTO_ICMP, &allocate_inner_pdu<ICMP>));
+    output.push_back(entry(Constants::IP::PROTO_ICMPV6, &decode_arena::allocate<ICMPv6>));
+    output.push_back(entry(Constants::IP::PROTO_IPV6, &allocate_inner_pdu<IPv6>));
+    output.push_back(entry(Constants::IP::PROTO_AH, &decode_arena::allocate<IPSecAH>));
+    output.push_back(entry(Constants::IP::PROTO_ESP, &decode_arena::allocate<IPSecESP>));
+}
+
+// Both built-in and registered protocols are looked up in PDUAllocator's tables
 Tins::PDU* pdu_from_flag(Constants::Ethernet::e flag,
                          const uint8_t* buffer,
                          uint32_t size,
                          bool rawpdu_on_no_match) {
-    switch (flag) {
-        case Tins::Constants::Ethernet::IP:
-            return new IP(buffer, size);
-        case Constants::Ethernet::IPV6:
-            return new IPv6(buffer, size);
-        case Tins::Constants::Ethernet::ARP:
-            return new ARP(buffer, size);
-        case Tins::Constants::Ethernet::PPPOED:
-        case Tins::Constants::Ethernet::PPPOES:
-            return new PPPoE(buffer, size);
-        case Tins::Constants::Ethernet::EAPOL:
-            return EAPOL::from_bytes(buffer, size);
-        case Tins::Constants::Ethernet::VLAN:
-        case Tins::Constants::Ethernet::QINQ:
-        case Tins::Constants::Ethernet::OLD_QINQ:
-            return new Dot1Q(buffer, size);
-        case Tins::Constants::Ethernet::MPLS:
-            return new MPLS(buffer, size);
-        default:
-            {
-                PDU* pdu = Internals::allocate<EthernetII>(
-                    static_cast<uint16_t>(flag),
-                    buffer,
-                    size
-                );
-                if (pdu) {
-                    return pdu;
-                }
-            }
-            return rawpdu_on_no_match ? new RawPDU(buffer, size) : 0;
-    };
+    if (TINS_UNLIKELY(is_past_decode_depth(ether_type_layer(flag)))) {
+        return decode_arena::allocate<RawPDU>(buffer, size);
+    }
+    PDU* pdu = Internals::allocate<EthernetII>(static_cast<uint16_t>(flag), buffer, size);
+    if (pdu) {
+        return pdu;
+    }
+    return rawpdu_on_no_match ? decode_arena::allocate<RawPDU>(buffer, size) : 0;
 }
 
 Tins::PDU* pdu_from_flag(Constants::IP::e flag,
                          const uint8_t* buffer,
                          uint32_t size,
                          bool rawpdu_on_no_match) {
-    switch (flag) {
-        case Constants::IP::PROTO_IPIP:
-            return new Tins::IP(buffer, size);
-        case Constants::IP::PROTO_TCP:
-            return new Tins::TCP(buffer, size);
-        case Constants::IP::PROTO_UDP:
-            return new Tins::UDP(buffer, size);
-        case Constants::IP::PROTO_ICMP:
-            return new Tins::ICMP(buffer, size);
-        case Constants::IP::PROTO_ICMPV6:
-            return new Tins::ICMPv6(buffer, size);
-        case Constants::IP::PROTO_IPV6:
-            return new Tins::IPv6(buffer, size);
-        case Constants::IP::PROTO_AH:
-            return new Tins::IPSecAH(buffer, size);
-        case Constants::IP::PROTO_ESP:
-            return new Tins::IPSecESP(buffer, size);
-        default:
-            break;
+    if (TINS_UNLIKELY(is_past_decode_depth(ip_type_layer(flag)))) {
+        return decode_arena::allocate<RawPDU>(buffer, size);
     }
-    if (rawpdu_on_no_match) {
-        return new Tins::RawPDU(buffer, size);
+    PDU* pdu = Internals::allocate<IP>(static_cast<uint8_t>(flag), buffer, size);
+    if (pdu) {
+        return pdu;
     }
-    return 0;
+    return rawpdu_on_no_match ? decode_arena::allocate<RawPDU>(buffer, size) : 0;
 }
 
 #ifdef TINS_HAVE_PCAP
@@ -155,6 +290,56 @@ PDU* pdu_from_dlt_flag(int flag,
 }
 #endif // TINS_HAVE_PCAP
 
+PDU::PDUType capture_link_type_to_pdu_type(uint32_t link_type) {
+    // These don't depend on the platform, unlike libpcap's DLT_* values
+    switch (link_type) {
+        case 0:
+            return PDU::LOOPBACK;
+        case 1:
+            return PDU::ETHERNET_II;
+        case 101:
+        case 228:
+        case 229:
+            return PDU::IP;
+        case 105:
+            return PDU::DOT11;
+        case 113:
+            return PDU::SLL;
+        case 127:
+            return PDU::RADIOTAP;
+        case 192:
+            return PDU::PPI;
+        case 258:
+            return PDU::PKTAP;
+        default:
+            return PDU::UNKNOWN;
+    }
+}
+
+uint32_t pdu_type_to_capture_link_type(PDU::PDUType type) {
+    switch (type) {
+        case PDU::LOOPBACK:
+            return 0;
+        case PDU::ETHERNET_II:
+            return 1;
+        case PDU::IP:
+        case PDU::IPv6:
+            return 101;
+        case PDU::DOT11:
+            return 105;
+        case PDU::SLL:
+            return 113;
+        case PDU::RADIOTAP:
+            return 127;
+        case PDU::PPI:
+            return 192;
+        case PDU::PKTAP:
+            return 258;
+        default:
+            return 0xffffffff;
+    }
+}
+
 Tins::PDU* pdu_from_flag(PDU::PDUType type, const uint8_t* buffer, uint32_t size) {
     switch(type) {
         case Tins::PDU::ETHERNET_II:
@@ -169,6 +354,18 @@ Tins::PDU* pdu_from_flag(PDU::PDUType type, const uint8_t* buffer, uint32_t size
             return new Tins::IEEE802_3(buffer, size);
         case Tins::PDU::PPPOE:
             return new Tins::PPPoE(buffer, size);
+        case Tins::PDU::LOOPBACK:
+            return new Tins::Loopback(buffer, size);
+        case Tins::PDU::SLL:
+            return new Tins::SLL(buffer, size);
+        case Tins::PDU::RAW:
+            return new Tins::RawPDU(buffer, size);
+        #ifdef TINS_HAVE_PCAP
+            case Tins::PDU::PPI:
+                return new Tins::PPI(buffer, size);
+            case Tins::PDU::PKTAP:
+                return new Tins::PKTAP(buffer, size);
+        #endif // TINS_HAVE_PCAP
         #ifdef TINS_HAVE_DOT11
             case Tins::PDU::RADIOTAP:
                 return new Tins::RadioTap(buffer, size);
@@ -201,6 +398,26 @@ Tins::PDU* pdu_from_flag(PDU::PDUType type, const uint8_t* buffer, uint32_t size
     };
 }
 
+Tins::PDU* pdu_from_link_type(PDU::PDUType type, const uint8_t* buffer, uint32_t size) {
+    switch (type) {
+        case Tins::PDU::ETHERNET_II:
+            if (is_dot3(buffer, size)) {
+                return new Tins::Dot3(buffer, size);
+            }
+            return new Tins::EthernetII(buffer, size);
+        case Tins::PDU::IP:
+        case Tins::PDU::IPv6:
+            // Raw captures can contain either version, so look at the header.
+            // Empty buffers are rejected by IP's constructor
+            if (size > 0 && (buffer[0] >> 4) == 6) {
+                return new Tins::IPv6(buffer, size);
+            }
+            return new Tins::IP(buffer, size);
+        default:
+            return pdu_from_flag(type, buffer, size);
+    }
+}
+
 Constants::Ethernet::e pdu_flag_to_ether_type(PDU::PDUType flag) {
     switch (flag) {
         case PDU::IP:
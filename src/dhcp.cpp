@@ -42,11 +42,20 @@ using Tins::Memory::OutputMemoryStream;
 
 namespace Tins {
 
-PDU::metadata DHCP::extract_metadata(const uint8_t* /*buffer*/, uint32_t total_sz) {
-    if (TINS_UNLIKELY(total_sz < sizeof(bootp_header))) {
+PDU::metadata DHCP::extract_metadata(const uint8_t* buffer, uint32_t total_sz) {
+    metadata output;
+    if (TINS_UNLIKELY(!try_extract_metadata(buffer, total_sz, output))) {
         throw malformed_packet();
     }
-    return metadata(total_sz, pdu_flag, PDU::UNKNOWN);
+    return output;
+}
+
+bool DHCP::try_extract_metadata(const uint8_t* /*buffer*/, uint32_t total_sz, metadata& output) {
+    if (TINS_UNLIKELY(total_sz < sizeof(bootp_header))) {
+        return false;
+    }
+    output = metadata(total_sz, pdu_flag, PDU::UNKNOWN);
+    return true;
 }
 
 // Magic cookie: uint32_t. 
@@ -90,11 +90,20 @@ OutputType option2class_option_data(const uint8_t* ptr, uint32_t total_sz) {
 
 } // Internals 
 
-PDU::metadata DHCPv6::extract_metadata(const uint8_t* /*buffer*/, uint32_t total_sz) {
-    if (TINS_UNLIKELY(total_sz < 2)) {
+PDU::metadata DHCPv6::extract_metadata(const uint8_t* buffer, uint32_t total_sz) {
+    metadata output;
+    if (TINS_UNLIKELY(!try_extract_metadata(buffer, total_sz, output))) {
         throw malformed_packet();
     }
-    return metadata(total_sz, pdu_flag, PDU::UNKNOWN);
+    return output;
+}
+
+bool DHCPv6::try_extract_metadata(const uint8_t* /*buffer*/, uint32_t total_sz, metadata& output) {
+    if (TINS_UNLIKELY(total_sz < 2)) {
+        return false;
+    }
+    output = metadata(total_sz, pdu_flag, PDU::UNKNOWN);
+    return true;
 }
 
 DHCPv6::DHCPv6() 
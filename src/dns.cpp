@@ -45,11 +45,20 @@ using Tins::Memory::OutputMemoryStream;
 
 namespace Tins {
 
-PDU::metadata DNS::extract_metadata(const uint8_t* /*buffer*/, uint32_t total_sz) {
-    if (TINS_UNLIKELY(total_sz < sizeof(dns_header))) {
+PDU::metadata DNS::extract_metadata(const uint8_t* buffer, uint32_t total_sz) {
+    metadata output;
+    if (TINS_UNLIKELY(!try_extract_metadata(buffer, total_sz, output))) {
         throw malformed_packet();
     }
-    return metadata(total_sz, pdu_flag, PDU::UNKNOWN);
+    return output;
+}
+
+bool DNS::try_extract_metadata(const uint8_t* /*buffer*/, uint32_t total_sz, metadata& output) {
+    if (TINS_UNLIKELY(total_sz < sizeof(dns_header))) {
+        return false;
+    }
+    output = metadata(total_sz, pdu_flag, PDU::UNKNOWN);
+    return true;
 }
 
 DNS::DNS() 
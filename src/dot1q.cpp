@@ -38,11 +38,23 @@ using Tins::Memory::OutputMemoryStream;
 
 namespace Tins {
 
-PDU::metadata Dot1Q::extract_metadata(const uint8_t* /*buffer*/, uint32_t total_sz) {
-    if (TINS_UNLIKELY(total_sz < sizeof(dot1q_header))) {
+PDU::metadata Dot1Q::extract_metadata(const uint8_t* buffer, uint32_t total_sz) {
+    metadata output;
+    if (TINS_UNLIKELY(!try_extract_metadata(buffer, total_sz, output))) {
         throw malformed_packet();
     }
-    return metadata(sizeof(dot1q_header), pdu_flag, PDU::UNKNOWN);
+    return output;
+}
+
+bool Dot1Q::try_extract_metadata(const uint8_t* buffer, uint32_t total_sz, metadata& output) {
+    if (TINS_UNLIKELY(total_sz < sizeof(dot1q_header))) {
+        return false;
+    }
+    const dot1q_header* header = (const dot1q_header*)buffer;
+    PDUType next_type = Internals::ether_type_to_pdu_flag(
+        static_cast<Constants::Ethernet::e>(Endian::be_to_host(header->type)));
+    output = metadata(sizeof(dot1q_header), pdu_flag, next_type);
+    return true;
 }
 
 Dot1Q::Dot1Q(small_uint<12> tag_id, bool append_pad)
@@ -52,8 +64,11 @@ Dot1Q::Dot1Q(small_uint<12> tag_id, bool append_pad)
 
 Dot1Q::Dot1Q(const uint8_t* buffer, uint32_t total_sz)
 : append_padding_() {
+    Internals::header_check header_check(buffer);
     InputMemoryStream stream(buffer, total_sz);
-    stream.read(header_);
+    if (!header_check.check(stream.try_read(header_))) {
+        return;
+    }
 
     if (stream) {
         inner_pdu(
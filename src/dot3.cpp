@@ -43,6 +43,7 @@
 #include <tins/llc.h>
 #include <tins/exceptions.h>
 #include <tins/memory_helpers.h>
+#include <tins/detail/pdu_helpers.h>
 
 using std::copy;
 using std::equal;
@@ -54,11 +55,20 @@ namespace Tins {
 
 const Dot3::address_type Dot3::BROADCAST("ff:ff:ff:ff:ff:ff");
 
-PDU::metadata Dot3::extract_metadata(const uint8_t* /*buffer*/, uint32_t total_sz) {
-    if (TINS_UNLIKELY(total_sz < sizeof(dot3_header))) {
+PDU::metadata Dot3::extract_metadata(const uint8_t* buffer, uint32_t total_sz) {
+    metadata output;
+    if (TINS_UNLIKELY(!try_extract_metadata(buffer, total_sz, output))) {
         throw malformed_packet();
     }
-    return metadata(sizeof(dot3_header), pdu_flag, PDU::UNKNOWN);
+    return output;
+}
+
+bool Dot3::try_extract_metadata(const uint8_t* /*buffer*/, uint32_t total_sz, metadata& output) {
+    if (TINS_UNLIKELY(total_sz < sizeof(dot3_header))) {
+        return false;
+    }
+    output = metadata(sizeof(dot3_header), pdu_flag, PDU::UNKNOWN);
+    return true;
 }
 
 Dot3::Dot3(const address_type& dst_hw_addr, const address_type& src_hw_addr)
@@ -68,8 +78,11 @@ Dot3::Dot3(const address_type& dst_hw_addr, const address_type& src_hw_addr)
 }
 
 Dot3::Dot3(const uint8_t* buffer, uint32_t total_sz) {
+    Internals::header_check header_check(buffer);
     InputMemoryStream stream(buffer, total_sz);
-    stream.read(header_);
+    if (!header_check.check(stream.try_read(header_))) {
+        return;
+    }
     if (stream) {
         inner_pdu(new Tins::LLC(stream.pointer(), stream.size()));
     }
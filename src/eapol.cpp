@@ -41,14 +41,23 @@ using Tins::Memory::OutputMemoryStream;
 
 namespace Tins {
 
-PDU::metadata EAPOL::extract_metadata(const uint8_t *buffer, uint32_t total_sz) {
-    if (TINS_UNLIKELY(total_sz < sizeof(eapol_header))) {
+PDU::metadata EAPOL::extract_metadata(const uint8_t* buffer, uint32_t total_sz) {
+    metadata output;
+    if (TINS_UNLIKELY(!try_extract_metadata(buffer, total_sz, output))) {
         throw malformed_packet();
     }
+    return output;
+}
+
+bool EAPOL::try_extract_metadata(const uint8_t* buffer, uint32_t total_sz, metadata& output) {
+    if (TINS_UNLIKELY(total_sz < sizeof(eapol_header))) {
+        return false;
+    }
     const eapol_header* header = (const eapol_header*)buffer;
     uint32_t advertised_size = Endian::be_to_host<uint16_t>(header->length) + 4;
     const uint32_t actual_size = (total_sz < advertised_size) ? total_sz : advertised_size;
-    return metadata(actual_size, pdu_flag, PDU::UNKNOWN);
+    output = metadata(actual_size, pdu_flag, PDU::UNKNOWN);
+    return true;
 }
 
 EAPOL::EAPOL(uint8_t packet_type, EAPOLTYPE type) 
@@ -54,14 +54,23 @@ namespace Tins {
 
 const EthernetII::address_type EthernetII::BROADCAST("ff:ff:ff:ff:ff:ff");
 
-PDU::metadata EthernetII::extract_metadata(const uint8_t *buffer, uint32_t total_sz) {
-    if (TINS_UNLIKELY(total_sz < sizeof(ethernet_header))) {
+PDU::metadata EthernetII::extract_metadata(const uint8_t* buffer, uint32_t total_sz) {
+    metadata output;
+    if (TINS_UNLIKELY(!try_extract_metadata(buffer, total_sz, output))) {
         throw malformed_packet();
     }
+    return output;
+}
+
+bool EthernetII::try_extract_metadata(const uint8_t* buffer, uint32_t total_sz, metadata& output) {
+    if (TINS_UNLIKELY(total_sz < sizeof(ethernet_header))) {
+        return false;
+    }
     const ethernet_header* header = (const ethernet_header*)buffer;
     PDUType next_type = Internals::ether_type_to_pdu_flag(
         static_cast<Constants::Ethernet::e>(Endian::be_to_host(header->payload_type)));
-    return metadata(sizeof(ethernet_header), pdu_flag, next_type); 
+    output = metadata(sizeof(ethernet_header), pdu_flag, next_type);
+    return true;
 }
 
 EthernetII::EthernetII(const address_type& dst_hw_addr, 
@@ -72,8 +81,11 @@ EthernetII::EthernetII(const address_type& dst_hw_addr,
 }
 
 EthernetII::EthernetII(const uint8_t* buffer, uint32_t total_sz) {
+    Internals::header_check header_check(buffer);
     InputMemoryStream stream(buffer, total_sz);
-    stream.read(header_);
+    if (!header_check.check(stream.try_read(header_))) {
+        return;
+    }
     // If there's any size left
     if (stream) {
         inner_pdu(
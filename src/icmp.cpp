@@ -37,6 +37,7 @@
 #include <tins/memory_helpers.h>
 #include <tins/detail/icmp_extension_helpers.h>
 #include <tins/utils/checksum_utils.h>
+#include <tins/detail/pdu_helpers.h>
 
 using std::memset;
 
@@ -45,11 +46,20 @@ using Tins::Memory::OutputMemoryStream;
 
 namespace Tins {
 
-PDU::metadata ICMP::extract_metadata(const uint8_t* /*buffer*/, uint32_t total_sz) {
-    if (TINS_UNLIKELY(total_sz < sizeof(icmp_header))) {
+PDU::metadata ICMP::extract_metadata(const uint8_t* buffer, uint32_t total_sz) {
+    metadata output;
+    if (TINS_UNLIKELY(!try_extract_metadata(buffer, total_sz, output))) {
         throw malformed_packet();
     }
-    return metadata(sizeof(icmp_header), pdu_flag, PDU::UNKNOWN);
+    return output;
+}
+
+bool ICMP::try_extract_metadata(const uint8_t* /*buffer*/, uint32_t total_sz, metadata& output) {
+    if (TINS_UNLIKELY(total_sz < sizeof(icmp_header))) {
+        return false;
+    }
+    output = metadata(sizeof(icmp_header), pdu_flag, PDU::UNKNOWN);
+    return true;
 }
 
 ICMP::ICMP(Flags flag) 
@@ -60,8 +70,11 @@ ICMP::ICMP(Flags flag)
 
 ICMP::ICMP(const uint8_t* buffer, uint32_t total_sz) 
 : orig_timestamp_or_address_mask_(), recv_timestamp_(), trans_timestamp_() {
+    Internals::header_check header_check(buffer);
     InputMemoryStream stream(buffer, total_sz);
-    stream.read(header_);
+    if (!header_check.check(stream.try_read(header_))) {
+        return;
+    }
     if (type() == TIMESTAMP_REQUEST || type() == TIMESTAMP_REPLY) {
         original_timestamp(stream.read<uint32_t>());
         receive_timestamp(stream.read<uint32_t>());
@@ -57,14 +57,31 @@ namespace Tins {
 
 const uint8_t IP::DEFAULT_TTL = 128;
 
-PDU::metadata IP::extract_metadata(const uint8_t *buffer, uint32_t total_sz) {
-    if (TINS_UNLIKELY(total_sz < sizeof(ip_header))) {
+PDU::metadata IP::extract_metadata(const uint8_t* buffer, uint32_t total_sz) {
+    metadata output;
+    if (TINS_UNLIKELY(!try_extract_metadata(buffer, total_sz, output))) {
         throw malformed_packet();
     }
+    return output;
+}
+
+bool IP::try_extract_metadata(const uint8_t* buffer, uint32_t total_sz, metadata& output) {
+    if (TINS_UNLIKELY(total_sz < sizeof(ip_header))) {
+        return false;
+    }
     const ip_header* header = (const ip_header*)buffer;
-    PDUType next_type = Internals::ip_type_to_pdu_flag(
+    const uint32_t header_size = header->ihl * sizeof(uint32_t);
+    if (TINS_UNLIKELY(header_size < sizeof(ip_header) || header_size > total_sz)) {
+        return false;
+    }
+    // Fragmented payloads are not decoded, just like the constructor does
+    const uint16_t fragment_field = Endian::be_to_host(header->frag_off);
+    const bool is_fragmented = ((fragment_field >> 13) & MORE_FRAGMENTS) ||
+                               (fragment_field & 0x1fff) != 0;
+    PDUType next_type = is_fragmented ? PDU::RAW : Internals::ip_type_to_pdu_flag(
         static_cast<Constants::IP::e>(header->protocol));
-    return metadata(header->ihl * 4, pdu_flag, next_type);
+    output = metadata(header_size, pdu_flag, next_type);
+    return true;
 }
 
 IP::IP(address_type ip_dst, address_type ip_src) {
@@ -74,13 +91,13 @@ IP::IP(address_type ip_dst, address_type ip_src) {
 }
 
 IP::IP(const uint8_t* buffer, uint32_t total_sz) {
+    Internals::header_check header_check(buffer);
     InputMemoryStream stream(buffer, total_sz);
-    stream.read(header_);
-
     // Make sure we have enough size for options and not less than we should
-    if (TINS_UNLIKELY(head_len() * sizeof(uint32_t) > total_sz || 
-                      head_len() * sizeof(uint32_t) < sizeof(header_))) {
-        throw malformed_packet();
+    if (!header_check.check(stream.try_read(header_) &&
+                            head_len() * sizeof(uint32_t) <= total_sz &&
+                            head_len() * sizeof(uint32_t) >= sizeof(header_))) {
+        return;
     }
     const uint8_t* options_end = buffer + head_len() * sizeof(uint32_t);
     
@@ -138,22 +155,9 @@ IP::IP(const uint8_t* buffer, uint32_t total_sz) {
                 Internals::pdu_from_flag(
                     static_cast<Constants::IP::e>(header_.protocol),
                     stream.pointer(), 
-                    total_sz,
-                    false
+                    total_sz
                 )
             );
-            if (!inner_pdu()) {
-                inner_pdu(
-                    Internals::allocate<IP>(
-                        header_.protocol,
-                        stream.pointer(), 
-                        total_sz
-                    )
-                );
-                if (!inner_pdu()) {
-                    inner_pdu(new RawPDU(stream.pointer(), total_sz));
-                }
-            }
         }
         else {
             // It's fragmented, just use RawPDU
@@ -51,23 +51,45 @@ using Tins::Memory::OutputMemoryStream;
 
 namespace Tins {
 
-PDU::metadata IPv6::extract_metadata(const uint8_t *buffer, uint32_t total_sz) {
-    if (TINS_UNLIKELY(total_sz < sizeof(ipv6_header))) {
+PDU::metadata IPv6::extract_metadata(const uint8_t* buffer, uint32_t total_sz) {
+    metadata output;
+    if (TINS_UNLIKELY(!try_extract_metadata(buffer, total_sz, output))) {
         throw malformed_packet();
     }
+    return output;
+}
+
+bool IPv6::try_extract_metadata(const uint8_t* buffer, uint32_t total_sz, metadata& output) {
+    if (TINS_UNLIKELY(total_sz < sizeof(ipv6_header))) {
+        return false;
+    }
     InputMemoryStream stream(buffer, total_sz);
     const ipv6_header* header = (const ipv6_header*)buffer;
     uint32_t header_size = sizeof(ipv6_header);
     uint8_t current_header = header->next_header;
+    bool is_fragmented = false;
     stream.skip(sizeof(ipv6_header));
-    while (is_extension_header(current_header)) {
-        current_header = stream.read<uint8_t>();
-        const uint32_t ext_size = (static_cast<uint32_t>(stream.read<uint8_t>()) + 1) * 8;
+    // Like the constructor, stop once there's nothing left to read
+    while (stream && is_extension_header(current_header)) {
+        if (current_header == FRAGMENT) {
+            is_fragmented = true;
+        }
+        uint8_t ext_length;
+        if (!stream.try_read(current_header) || !stream.try_read(ext_length)) {
+            return false;
+        }
+        const uint32_t ext_size = (static_cast<uint32_t>(ext_length) + 1) * 8;
         const uint32_t payload_size = ext_size - sizeof(uint8_t) * 2;
+        if (!stream.try_skip(payload_size)) {
+            return false;
+        }
         header_size += ext_size;
-        stream.skip(payload_size);
     }
-    return metadata(header_size, pdu_flag, PDU::UNKNOWN);
+    // Fragmented payloads are not decoded, just like the constructor does
+    PDUType next_type = is_fragmented ? PDU::RAW : Internals::ip_type_to_pdu_flag(
+        static_cast<Constants::IP::e>(current_header));
+    output = metadata(header_size, pdu_flag, next_type);
+    return true;
 }
 
 IPv6::hop_by_hop_header IPv6::hop_by_hop_header::from_extension_header(const ext_header& hdr) {
@@ -121,8 +143,11 @@ IPv6::IPv6(address_type ip_dst, address_type ip_src, PDU* /*child*/)
 }
 
 IPv6::IPv6(const uint8_t* buffer, uint32_t total_sz) {
+    Internals::header_check header_check(buffer);
     InputMemoryStream stream(buffer, total_sz);
-    stream.read(header_);
+    if (!header_check.check(stream.try_read(header_))) {
+        return;
+    }
     uint8_t current_header = header_.next_header;
     uint32_t actual_payload_length = payload_length();
     bool is_payload_fragmented = false;
@@ -131,13 +156,18 @@ IPv6::IPv6(const uint8_t* buffer, uint32_t total_sz) {
             if (current_header == FRAGMENT) {
                 is_payload_fragmented = true;
             }
-            const uint8_t ext_type = stream.read<uint8_t>();
+            uint8_t ext_type = 0;
+            uint8_t ext_length = 0;
+            if (!header_check.check(stream.try_read(ext_type) &&
+                                    stream.try_read(ext_length))) {
+                return;
+            }
             // every ext header is at least 8 bytes long
             // minus one, from the next_header field.
-            const uint32_t ext_size = (static_cast<uint32_t>(stream.read<uint8_t>()) + 1) * 8;
+            const uint32_t ext_size = (static_cast<uint32_t>(ext_length) + 1) * 8;
             const uint32_t payload_size = ext_size - sizeof(uint8_t) * 2;
-            if (!stream.can_read(payload_size)) {
-                throw malformed_packet();
+            if (!header_check.check(stream.can_read(payload_size))) {
+                return;
             }
             // Add a header using the current header type (e.g. what we saw as the next
             // header type in the previous)
@@ -177,22 +207,9 @@ IPv6::IPv6(const uint8_t* buffer, uint32_t total_sz) {
                     Internals::pdu_from_flag(
                         static_cast<Constants::IP::e>(current_header),
                         stream.pointer(), 
-                        actual_payload_length,
-                        false
+                        actual_payload_length
                     )
                 );
-                if (!inner_pdu()) {
-                    inner_pdu(
-                        Internals::allocate<IPv6>(
-                            current_header,
-                            stream.pointer(), 
-                            actual_payload_length
-                        )
-                    );
-                    if (!inner_pdu()) {
-                        inner_pdu(new Tins::RawPDU(stream.pointer(), actual_payload_length));
-                    }
-                }
             }
             // We got to an actual PDU, we're done
             break;
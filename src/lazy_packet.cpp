@@ -0,0 +1,194 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/lazy_packet.h>
+#include <tins/rawpdu.h>
+#include <tins/packet_decoder.h>
+
+namespace Tins {
+
+LazyPacket::LazyPacket()
+: link_type_(PDU::RAW), max_decode_layer_(PacketDecoder::ALL_LAYERS), arena_(0), pdu_(0),
+  decoded_layer_(PacketDecoder::ALL_LAYERS), decoded_(false) {
+
+}
+
+LazyPacket::LazyPacket(PDU::PDUType link_type, const uint8_t* buffer, uint32_t size,
+                       const Timestamp& timestamp)
+: buffer_(buffer, buffer + size), ts_(timestamp), link_type_(link_type),
+  max_decode_layer_(PacketDecoder::ALL_LAYERS), arena_(0), pdu_(0),
+  decoded_layer_(PacketDecoder::ALL_LAYERS), decoded_(false) {
+
+}
+
+LazyPacket::LazyPacket(const LazyPacket& rhs)
+: buffer_(rhs.buffer_), ts_(rhs.ts_), link_type_(rhs.link_type_),
+  max_decode_layer_(rhs.max_decode_layer_), arena_(0), pdu_(0),
+  decoded_layer_(PacketDecoder::ALL_LAYERS), decoded_(false) {
+
+}
+
+LazyPacket& LazyPacket::operator=(const LazyPacket& rhs) {
+    if (this != &rhs) {
+        assign(rhs.link_type_, rhs.data(), rhs.size(), rhs.ts_);
+        max_decode_layer_ = rhs.max_decode_layer_;
+    }
+    return *this;
+}
+
+#if TINS_IS_CXX11
+LazyPacket::LazyPacket(LazyPacket&& rhs) TINS_NOEXCEPT
+: buffer_(std::move(rhs.buffer_)), ts_(rhs.ts_), link_type_(rhs.link_type_),
+  max_decode_layer_(rhs.max_decode_layer_), arena_(0), pdu_(rhs.pdu_),
+  previous_pdus_(std::move(rhs.previous_pdus_)), decoded_layer_(rhs.decoded_layer_),
+  decoded_(rhs.decoded_) {
+    rhs.pdu_ = 0;
+    rhs.previous_pdus_.clear();
+    rhs.decoded_ = false;
+}
+
+LazyPacket& LazyPacket::operator=(LazyPacket&& rhs) TINS_NOEXCEPT {
+    if (this != &rhs) {
+        clear_pdu();
+        buffer_ = std::move(rhs.buffer_);
+        ts_ = rhs.ts_;
+        link_type_ = rhs.link_type_;
+        max_decode_layer_ = rhs.max_decode_layer_;
+        pdu_ = rhs.pdu_;
+        previous_pdus_.swap(rhs.previous_pdus_);
+        decoded_layer_ = rhs.decoded_layer_;
+        decoded_ = rhs.decoded_;
+        rhs.pdu_ = 0;
+        rhs.decoded_ = false;
+    }
+    return *this;
+}
+#endif // TINS_IS_CXX11
+
+LazyPacket::~LazyPacket() {
+    clear_pdu();
+}
+
+void LazyPacket::assign(PDU::PDUType link_type, const uint8_t* buffer, uint32_t size,
+                        const Timestamp& timestamp) {
+    clear_pdu();
+    buffer_.assign(buffer, buffer + size);
+    ts_ = timestamp;
+    link_type_ = link_type;
+}
+
+void LazyPacket::set_max_decode_layer(PacketDecoder::Layer layer) {
+    if (layer != max_decode_layer_) {
+        clear_pdu();
+        max_decode_layer_ = layer;
+    }
+}
+
+PDU* LazyPacket::pdu() {
+    return decode();
+}
+
+const PDU* LazyPacket::pdu() const {
+    return decode();
+}
+
+PDU* LazyPacket::release_pdu() {
+    decode();
+    PDU* output = pdu_;
+    pdu_ = 0;
+    decoded_ = false;
+    // Payloads reference our buffer, so they have to be copied now
+    for (PDU* current = output; current; current = current->inner_pdu()) {
+        if (current->pdu_type() == PDU::RAW) {
+            static_cast<RawPDU*>(current)->own_payload();
+        }
+    }
+    return output;
+}
+
+Packet LazyPacket::to_packet() const {
+    const PDU* chain = pdu();
+    return chain ? Packet(chain, ts_) : Packet();
+}
+
+PDU* LazyPacket::decode(PacketDecoder::Layer layer) const {
+    #if TINS_IS_CXX11
+        // Nothing past the transport layer is left undecoded, so decoding
+        // up to it is the same as decoding everything
+        if (layer == PacketDecoder::TRANSPORT_LAYER) {
+            layer = PacketDecoder::ALL_LAYERS;
+        }
+        if (layer > max_decode_layer_) {
+            layer = max_decode_layer_;
+        }
+    #else
+        layer = PacketDecoder::ALL_LAYERS;
+    #endif // TINS_IS_CXX11
+    if (decoded_) {
+        // Only try once, malformed packets will keep a null PDU
+        if (!pdu_ || decoded_layer_ >= layer) {
+            return pdu_;
+        }
+        // PDUs found in the previous chain stay valid until it's cleared
+        previous_pdus_.push_back(pdu_);
+        pdu_ = 0;
+    }
+    decoded_ = true;
+    decoded_layer_ = layer;
+    if (buffer_.empty()) {
+        return 0;
+    }
+    #if TINS_IS_CXX11
+    // The chain never outlives the buffer unless it's released or cloned
+    RawPDU::zero_copy_scope zero_copy;
+    PacketDecoder::depth_scope depth(layer);
+    #endif // TINS_IS_CXX11
+    pdu_ = PacketDecoder::decode(link_type_, &buffer_[0], size(), arena_);
+    // If the last PDU isn't a RawPDU, nothing was left undecoded
+    const PDU* last = pdu_;
+    while (last && last->inner_pdu()) {
+        last = last->inner_pdu();
+    }
+    if (last && last->pdu_type() != PDU::RAW) {
+        decoded_layer_ = PacketDecoder::ALL_LAYERS;
+    }
+    return pdu_;
+}
+
+void LazyPacket::clear_pdu() {
+    delete pdu_;
+    pdu_ = 0;
+    for (size_t i = 0; i < previous_pdus_.size(); ++i) {
+        delete previous_pdus_[i];
+    }
+    previous_pdus_.clear();
+    decoded_ = false;
+}
+
+} // Tins
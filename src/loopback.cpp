@@ -46,6 +46,7 @@
 #include <tins/rawpdu.h>
 #include <tins/exceptions.h>
 #include <tins/memory_helpers.h>
+#include <tins/detail/pdu_helpers.h>
 
 #if !defined(PF_LLC)
     // compilation fix, nasty but at least works on BSD
@@ -67,12 +68,27 @@ Loopback::Loopback(const uint8_t* buffer, uint32_t total_sz) {
     family_ = stream.read<uint32_t>();
 
     if (total_sz) {
+        if (family_ != PF_LLC &&
+            Internals::is_past_decode_depth(PacketDecoder::NETWORK_LAYER)) {
+            inner_pdu(new Tins::RawPDU(stream.pointer(), stream.size()));
+            return;
+        }
+        // Invalid IP headers are kept as a RawPDU, just like after an
+        // Ethernet header
         switch (family_) {
             case PF_INET:
-                inner_pdu(new Tins::IP(stream.pointer(), stream.size()));
+                inner_pdu(
+                    Internals::pdu_from_flag(
+                        Constants::Ethernet::IP, stream.pointer(), stream.size()
+                    )
+                );
                 break;
             case PF_INET6:
-                inner_pdu(new Tins::IPv6(stream.pointer(), stream.size()));
+                inner_pdu(
+                    Internals::pdu_from_flag(
+                        Constants::Ethernet::IPV6, stream.pointer(), stream.size()
+                    )
+                );
                 break;
             case PF_LLC:
                 inner_pdu(new Tins::LLC(stream.pointer(), stream.size()));
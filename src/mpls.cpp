@@ -33,6 +33,7 @@
 #include <tins/rawpdu.h>
 #include <tins/memory_helpers.h>
 #include <tins/icmp_extension.h>
+#include <tins/detail/pdu_helpers.h>
 
 using Tins::Memory::InputMemoryStream;
 using Tins::Memory::OutputMemoryStream;
@@ -55,7 +56,10 @@ MPLS::MPLS(const uint8_t* buffer, uint32_t total_sz) {
         // If this is the last MPLS, then construct an IP
         if (bottom_of_stack()) {
             uint8_t version = (*stream.pointer() >> 4) & 0x0f;
-            if (version == 4) {
+            if (Internals::is_past_decode_depth(PacketDecoder::NETWORK_LAYER)) {
+                inner_pdu(new Tins::RawPDU(stream.pointer(), stream.size()));
+            }
+            else if (version == 4) {
                 inner_pdu(new Tins::IP(stream.pointer(), stream.size()));
             }
             else if (version == 6) {
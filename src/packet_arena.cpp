@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/packet_arena.h>
+
+#ifdef TINS_HAVE_CXX11
+
+#include <new>
+#include <atomic>
+
+namespace Tins {
+namespace {
+
+// Every arena allocation is preceded by a header pointing to its chunk, or
+// null if it didn't fit in one and was taken from the heap. This keeps 
+// allocations aligned to 16 bytes
+const size_t alignment = 16;
+
+struct allocation_header {
+    void* owner;
+};
+
+const size_t header_size = (sizeof(allocation_header) + alignment - 1) & ~(alignment - 1);
+
+size_t align(size_t size) {
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+void* allocate_from_heap(size_t size) {
+    uint8_t* buffer = static_cast<uint8_t*>(::operator new(header_size + size));
+    reinterpret_cast<allocation_header*>(buffer)->owner = 0;
+    return buffer + header_size;
+}
+
+} // anonymous namespace
+
+// The arena holds one reference on each of its chunks and every live object
+// holds another one. A chunk that only has the arena's reference is empty,
+// so it can be rewound. Objects may be released on any thread, but only the
+// arena's owner thread allocates from a chunk
+struct PacketArena::chunk {
+    std::atomic<size_t> references;
+    size_t used;
+    size_t capacity;
+
+    static chunk* create(size_t total_size) {
+        void* buffer = ::operator new(total_size);
+        chunk* output = new (buffer) chunk();
+        output->references.store(1, std::memory_order_relaxed);
+        output->used = 0;
+        output->capacity = total_size - data_offset();
+        return output;
+    }
+
+    static size_t data_offset() {
+        return align(sizeof(chunk));
+    }
+
+    void release() {
+        if (references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->~chunk();
+            ::operator delete(this);
+        }
+    }
+
+    bool is_empty() const {
+        return references.load(std::memory_order_acquire) == 1;
+    }
+
+    uint8_t* data() {
+        return reinterpret_cast<uint8_t*>(this) + data_offset();
+    }
+
+    const uint8_t* data() const {
+        return reinterpret_cast<const uint8_t*>(this) + data_offset();
+    }
+};
+
+PacketArena::PacketArena(size_t chunk_size)
+: current_chunk_(0), chunk_size_(chunk_size) {
+
+}
+
+PacketArena::~PacketArena() {
+    for (size_t i = 0; i < chunks_.size(); ++i) {
+        chunks_[i]->release();
+    }
+}
+
+void* PacketArena::allocate(size_t size) {
+    const size_t total_size = header_size + align(size);
+    if (total_size + chunk::data_offset() > chunk_size_) {
+        return allocate_from_heap(size);
+    }
+    chunk* target = current_chunk_;
+    if (target && target->is_empty()) {
+        target->used = 0;
+    }
+    if (!target || target->capacity - target->used < total_size) {
+        target = find_chunk();
+    }
+    uint8_t* buffer = target->data() + target->used;
+    target->used += total_size;
+    target->references.fetch_add(1, std::memory_order_relaxed);
+    reinterpret_cast<allocation_header*>(buffer)->owner = target;
+    return buffer + header_size;
+}
+
+PacketArena::chunk* PacketArena::find_chunk() {
+    // Reuse any chunk which has no live objects left
+    for (size_t i = 0; i < chunks_.size(); ++i) {
+        if (chunks_[i]->is_empty()) {
+            chunks_[i]->used = 0;
+            current_chunk_ = chunks_[i];
+            return current_chunk_;
+        }
+    }
+    chunk* output = chunk::create(chunk_size_);
+    try {
+        chunks_.push_back(output);
+    }
+    catch (...) {
+        output->release();
+        throw;
+    }
+    current_chunk_ = output;
+    return output;
+}
+
+void PacketArena::deallocate(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    uint8_t* buffer = static_cast<uint8_t*>(ptr) - header_size;
+    chunk* owner = static_cast<chunk*>(reinterpret_cast<allocation_header*>(buffer)->owner);
+    if (owner) {
+        owner->release();
+    }
+    else {
+        ::operator delete(buffer);
+    }
+}
+
+bool PacketArena::owns(const void* ptr) const {
+    const uint8_t* address = static_cast<const uint8_t*>(ptr);
+    for (size_t i = 0; i < chunks_.size(); ++i) {
+        const uint8_t* data = chunks_[i]->data();
+        if (address >= data && address < data + chunks_[i]->capacity) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // Tins
+
+#endif // TINS_HAVE_CXX11
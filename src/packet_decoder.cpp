@@ -0,0 +1,155 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/packet_decoder.h>
+#include <tins/exceptions.h>
+#include <tins/detail/pdu_helpers.h>
+
+namespace Tins {
+namespace {
+
+#ifdef TINS_HAVE_CXX11
+thread_local PacketDecoder::Layer max_decode_layer = PacketDecoder::ALL_LAYERS;
+#endif // TINS_HAVE_CXX11
+
+// Raw IP captures can only contain IPv4 or IPv6 datagrams
+bool has_valid_ip_version(PDU::PDUType link_type, const uint8_t* buffer, uint32_t size) {
+    if (link_type != PDU::IP && link_type != PDU::IPv6) {
+        return true;
+    }
+    const uint8_t version = size > 0 ? buffer[0] >> 4 : 4;
+    return version == 4 || version == 6;
+}
+
+} // anonymous namespace
+
+#ifdef TINS_HAVE_CXX11
+
+PacketDecoder::depth_scope::depth_scope(Layer max_layer)
+: previous_(max_decode_layer) {
+    max_decode_layer = max_layer;
+}
+
+PacketDecoder::depth_scope::~depth_scope() {
+    max_decode_layer = previous_;
+}
+
+PacketDecoder::Layer PacketDecoder::depth_scope::max_layer() {
+    return max_decode_layer;
+}
+
+#endif // TINS_HAVE_CXX11
+
+PacketDecoder::Status PacketDecoder::decode(PDU::PDUType link_type, const uint8_t* buffer,
+                                            uint32_t size, PDU*& output) {
+    return decode(link_type, buffer, size, output, 0);
+}
+
+PacketDecoder::Status PacketDecoder::decode(PDU::PDUType link_type, const uint8_t* buffer,
+                                            uint32_t size, PDU*& output, PacketArena* arena) {
+    output = 0;
+    if (!has_valid_ip_version(link_type, buffer, size)) {
+        return MALFORMED;
+    }
+    #ifdef TINS_HAVE_CXX11
+    bool& truncated = Internals::truncated_layer_flag();
+    truncated = false;
+    #endif // TINS_HAVE_CXX11
+    // Link layer headers are validated by their constructors. Those which
+    // can't report it through this scope throw instead
+    Internals::header_check::scope header_scope(buffer);
+    // The outermost PDU is handed to the caller, so only the inner ones 
+    // are taken from the arena
+    Internals::decode_arena::scope arena_scope(arena);
+    try {
+        output = Internals::pdu_from_link_type(link_type, buffer, size);
+    }
+    catch (malformed_packet&) {
+        return MALFORMED;
+    }
+    if (header_scope.failed()) {
+        delete output;
+        output = 0;
+        return MALFORMED;
+    }
+    if (!output) {
+        return UNSUPPORTED;
+    }
+    // Analysis code usually looks up several layers on each packet
+    Internals::decode_arena::build_layer_index(*output, arena);
+    #ifdef TINS_HAVE_CXX11
+    if (truncated) {
+        return TRUNCATED;
+    }
+    #endif // TINS_HAVE_CXX11
+    return DECODED;
+}
+
+PacketDecoder::Layer PacketDecoder::layer_of(PDU::PDUType type) {
+    switch (type) {
+        case PDU::IP:
+        case PDU::IPv6:
+        case PDU::ARP:
+        case PDU::EAPOL:
+        case PDU::RC4EAPOL:
+        case PDU::RSNEAPOL:
+            return NETWORK_LAYER;
+        case PDU::TCP:
+        case PDU::UDP:
+        case PDU::ICMP:
+        case PDU::ICMPv6:
+        case PDU::IPSEC_AH:
+        case PDU::IPSEC_ESP:
+            return TRANSPORT_LAYER;
+        case PDU::RAW:
+        case PDU::BOOTP:
+        case PDU::DHCP:
+        case PDU::DNS:
+        case PDU::DHCPv6:
+        case PDU::UNKNOWN:
+        case PDU::USER_DEFINED_PDU:
+            return ALL_LAYERS;
+        default:
+            // User defined types are above USER_DEFINED_PDU
+            return type > PDU::USER_DEFINED_PDU ? ALL_LAYERS : LINK_LAYER;
+    }
+}
+
+PDU* PacketDecoder::decode(PDU::PDUType link_type, const uint8_t* buffer, uint32_t size) {
+    return decode(link_type, buffer, size, static_cast<PacketArena*>(0));
+}
+
+PDU* PacketDecoder::decode(PDU::PDUType link_type, const uint8_t* buffer, uint32_t size,
+                           PacketArena* arena) {
+    PDU* output = 0;
+    decode(link_type, buffer, size, output, arena);
+    return output;
+}
+
+} // Tins
@@ -0,0 +1,246 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/packet_view.h>
+#include <tins/ethernetII.h>
+#include <tins/dot3.h>
+#include <tins/dot1q.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/arp.h>
+#include <tins/icmp.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/exceptions.h>
+#include <tins/detail/pdu_helpers.h>
+
+namespace Tins {
+namespace {
+
+const uint32_t ipv6_fixed_header_size = 40;
+
+// Returns the smallest valid header size for the given type, or 0 if the 
+// type is not supported by PacketView
+uint32_t minimum_header_size(PDU::PDUType type) {
+    switch (type) {
+        case PDU::ETHERNET_II:
+        case PDU::IEEE802_3:
+            return 14;
+        case PDU::DOT1Q:
+        case PDU::DOT1AD:
+            return 4;
+        case PDU::IP:
+            return 20;
+        case PDU::IPv6:
+            return ipv6_fixed_header_size;
+        case PDU::ARP:
+            return 28;
+        case PDU::ICMP:
+            return 8;
+        case PDU::TCP:
+            return 20;
+        case PDU::UDP:
+            return 8;
+        default:
+            return 0;
+    }
+}
+
+bool extract_metadata(PDU::PDUType type, const uint8_t* buffer, uint32_t size,
+                      PDU::metadata& output) {
+    switch (type) {
+        case PDU::ETHERNET_II:
+            return EthernetII::try_extract_metadata(buffer, size, output);
+        case PDU::IEEE802_3:
+            return Dot3::try_extract_metadata(buffer, size, output);
+        case PDU::DOT1Q:
+        case PDU::DOT1AD:
+            return Dot1Q::try_extract_metadata(buffer, size, output);
+        case PDU::IP:
+            return IP::try_extract_metadata(buffer, size, output);
+        case PDU::IPv6:
+            return IPv6::try_extract_metadata(buffer, size, output);
+        case PDU::ARP:
+            return ARP::try_extract_metadata(buffer, size, output);
+        case PDU::ICMP:
+            return ICMP::try_extract_metadata(buffer, size, output);
+        case PDU::TCP:
+            return TCP::try_extract_metadata(buffer, size, output);
+        case PDU::UDP:
+            return UDP::try_extract_metadata(buffer, size, output);
+        default:
+            return false;
+    }
+}
+
+} // anonymous namespace
+
+PacketView::PacketView()
+: buffer_(0), layer_count_(0), payload_offset_(0), payload_end_(0), malformed_(false) {
+
+}
+
+PacketView::PacketView(PDU::PDUType link_type, const uint8_t* buffer, uint32_t size) {
+    parse(link_type, buffer, size);
+}
+
+bool PacketView::parse(PDU::PDUType link_type, const uint8_t* buffer, uint32_t size) {
+    buffer_ = buffer;
+    layer_count_ = 0;
+    payload_offset_ = 0;
+    payload_end_ = size;
+    malformed_ = false;
+
+    PDU::PDUType type = link_type;
+    if (type == PDU::ETHERNET_II && Internals::is_dot3(buffer, size)) {
+        type = PDU::IEEE802_3;
+    }
+    else if (type == PDU::IP || type == PDU::IPv6) {
+        if (size == 0) {
+            malformed_ = true;
+            return false;
+        }
+        const uint8_t version = buffer[0] >> 4;
+        type = (version == 6) ? PDU::IPv6 : PDU::IP;
+    }
+
+    while (layer_count_ < MAX_LAYERS) {
+        const uint32_t min_size = minimum_header_size(type);
+        if (min_size == 0) {
+            break;
+        }
+        const uint8_t* ptr = buffer_ + payload_offset_;
+        const uint32_t remaining = payload_end_ - payload_offset_;
+        if (remaining < min_size) {
+            malformed_ = true;
+            break;
+        }
+        PDU::metadata meta;
+        if (!extract_metadata(type, ptr, remaining, meta) ||
+            !add_layer(type, meta.header_size)) {
+            malformed_ = true;
+            break;
+        }
+        type = meta.next_pdu_type;
+    }
+    return !malformed_;
+}
+
+bool PacketView::add_layer(PDU::PDUType type, uint32_t header_size) {
+    const uint32_t remaining = payload_end_ - payload_offset_;
+    if (header_size < minimum_header_size(type) || header_size > remaining) {
+        return false;
+    }
+    const uint8_t* ptr = buffer_ + payload_offset_;
+    // Ignore link layer padding by honoring the network layer's length. A 
+    // length of 0 is used when offloading segmentation or for jumbograms, 
+    // so the buffer's size is used in that case
+    uint32_t network_size = 0;
+    if (type == PDU::IP) {
+        network_size = ip_header(ptr).tot_len();
+    }
+    else if (type == PDU::IPv6) {
+        const uint32_t payload_length = ipv6_header(ptr).payload_length();
+        if (payload_length > 0) {
+            network_size = ipv6_fixed_header_size + payload_length;
+        }
+    }
+    if (network_size != 0) {
+        if (network_size < header_size) {
+            return false;
+        }
+        if (network_size < remaining) {
+            payload_end_ = payload_offset_ + network_size;
+        }
+    }
+    layer& current = layers_[layer_count_++];
+    current.type = type;
+    current.offset = payload_offset_;
+    current.header_size = header_size;
+    payload_offset_ += header_size;
+    return true;
+}
+
+const PacketView::layer* PacketView::find_layer(PDU::PDUType type) const {
+    for (size_t i = 0; i < layer_count_; ++i) {
+        if (layers_[i].type == type) {
+            return &layers_[i];
+        }
+    }
+    return 0;
+}
+
+const uint8_t* PacketView::layer_data(PDU::PDUType type) const {
+    const layer* found = find_layer(type);
+    if (!found) {
+        throw pdu_not_found();
+    }
+    return buffer_ + found->offset;
+}
+
+PacketView::ethernet_header PacketView::ethernet() const {
+    return ethernet_header(layer_data(PDU::ETHERNET_II));
+}
+
+PacketView::dot1q_header PacketView::dot1q() const {
+    const layer* found = find_layer(PDU::DOT1Q);
+    if (!found) {
+        found = find_layer(PDU::DOT1AD);
+        if (!found) {
+            throw pdu_not_found();
+        }
+    }
+    return dot1q_header(buffer_ + found->offset);
+}
+
+PacketView::ip_header PacketView::ip() const {
+    return ip_header(layer_data(PDU::IP));
+}
+
+PacketView::ipv6_header PacketView::ipv6() const {
+    return ipv6_header(layer_data(PDU::IPv6));
+}
+
+PacketView::arp_header PacketView::arp() const {
+    return arp_header(layer_data(PDU::ARP));
+}
+
+PacketView::icmp_header PacketView::icmp() const {
+    return icmp_header(layer_data(PDU::ICMP));
+}
+
+PacketView::tcp_header PacketView::tcp() const {
+    return tcp_header(layer_data(PDU::TCP));
+}
+
+PacketView::udp_header PacketView::udp() const {
+    return udp_header(layer_data(PDU::UDP));
+}
+
+} // Tins
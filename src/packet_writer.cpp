@@ -45,10 +45,7 @@ PacketWriter::PacketWriter(const string& file_name, LinkType lt) {
 }
 
 PacketWriter::~PacketWriter() {
-    if (dumper_ && handle_) {
-        pcap_dump_close(dumper_);
-        pcap_close(handle_);
-    }
+    close();
 }
 
 void PacketWriter::write(PDU& pdu) {
@@ -69,6 +66,12 @@ void PacketWriter::write(Packet& packet) {
     write(*packet.pdu(), tv);
 }
 
+void PacketWriter::set_timestamp_index(const string& file_name, uint32_t interval) {
+    TimestampIndexWriter* index = new TimestampIndexWriter(file_name, interval);
+    delete index_;
+    index_ = index;
+}
+
 void PacketWriter::write(PDU& pdu, const struct timeval& tv) {
     struct pcap_pkthdr header;
     memset(&header, 0, sizeof(header));
@@ -76,10 +79,14 @@ void PacketWriter::write(PDU& pdu, const struct timeval& tv) {
     header.len = static_cast<bpf_u_int32>(pdu.advertised_size());
     PDU::serialization_type buffer = pdu.serialize();
     header.caplen = static_cast<bpf_u_int32>(buffer.size());
+    if (index_) {
+        index_->add_record(Timestamp(tv), pcap_dump_ftell(dumper_));
+    }
     pcap_dump((u_char*)dumper_, &header, &buffer[0]);
 }
 
 void PacketWriter::init(const string& file_name, int link_type) {
+    index_ = 0;
     handle_ = pcap_open_dead(link_type, 65535);
     if (!handle_) {
         throw pcap_open_failed();
@@ -92,4 +99,16 @@ void PacketWriter::init(const string& file_name, int link_type) {
     }
 }
 
+void PacketWriter::close() {
+    if (dumper_ && handle_) {
+        pcap_dump_close(dumper_);
+        pcap_close(handle_);
+    }
+    // Flushes whatever the index still has buffered
+    delete index_;
+    handle_ = 0;
+    dumper_ = 0;
+    index_ = 0;
+}
+
 } // Tins
@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/parallel_file_processor.h>
+
+#ifdef TINS_HAVE_CXX11
+
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <tins/packet_view.h>
+#include <tins/constants.h>
+
+using std::string;
+using std::vector;
+using std::thread;
+using std::mutex;
+using std::lock_guard;
+using std::exception_ptr;
+
+namespace Tins {
+namespace {
+
+// FNV-1a over an endpoint's address and port
+uint32_t endpoint_hash(const uint8_t* address, uint32_t address_size, uint16_t port) {
+    uint32_t output = 2166136261U;
+    for (uint32_t i = 0; i < address_size; ++i) {
+        output = (output ^ address[i]) * 16777619U;
+    }
+    output = (output ^ (port & 0xff)) * 16777619U;
+    output = (output ^ (port >> 8)) * 16777619U;
+    return output;
+}
+
+} // anonymous namespace
+
+ParallelFileProcessor::ParallelFileProcessor(const string& file_name, size_type size,
+                                             PartitionMode mode)
+: mode_(mode), stopped_(false) {
+    try {
+        for (size_type i = 0; i < size; ++i) {
+            readers_.push_back(new PcapFileReader(file_name));
+        }
+    }
+    catch (...) {
+        cleanup();
+        throw;
+    }
+    if (readers_.empty()) {
+        return;
+    }
+    const PcapFileReader& reader = *readers_[0];
+    range whole_file = { reader.offset(), reader.file_size() };
+    if (mode_ == FLOW_HASH) {
+        ranges_.assign(size, whole_file);
+        return;
+    }
+    // Split the file into chunks of the same size and then move each 
+    // split point forward to the next record
+    const uint64_t data_size = whole_file.end - whole_file.begin;
+    uint64_t begin = whole_file.begin;
+    for (size_type i = 1; i < size; ++i) {
+        uint64_t end = whole_file.begin + data_size / size * i;
+        end = reader.find_record_boundary(end < begin ? begin : end);
+        range current = { begin, end };
+        ranges_.push_back(current);
+        begin = end;
+    }
+    range last = { begin, whole_file.end };
+    ranges_.push_back(last);
+}
+
+ParallelFileProcessor::~ParallelFileProcessor() {
+    cleanup();
+}
+
+ParallelFileProcessor::size_type ParallelFileProcessor::size() const {
+    return readers_.size();
+}
+
+ParallelFileProcessor::PartitionMode ParallelFileProcessor::partition_mode() const {
+    return mode_;
+}
+
+const ParallelFileProcessor::range& ParallelFileProcessor::worker_range(size_type index) const {
+    return ranges_[index];
+}
+
+void ParallelFileProcessor::set_zero_copy_payloads(bool value) {
+    for (size_type i = 0; i < readers_.size(); ++i) {
+        readers_[i]->set_zero_copy_payloads(value);
+    }
+}
+
+void ParallelFileProcessor::set_max_decode_layer(PacketDecoder::Layer layer) {
+    for (size_type i = 0; i < readers_.size(); ++i) {
+        readers_[i]->set_max_decode_layer(layer);
+    }
+}
+
+void ParallelFileProcessor::stop() {
+    stopped_ = true;
+}
+
+uint32_t ParallelFileProcessor::flow_hash(PDU::PDUType link_type, const uint8_t* data,
+                                          uint32_t size) {
+    PacketView view(link_type, data, size);
+    const uint8_t* src_address;
+    const uint8_t* dst_address;
+    uint32_t address_size;
+    uint8_t protocol;
+    if (const PacketView::layer* ip = view.find_layer(PDU::IP)) {
+        src_address = data + ip->offset + 12;
+        dst_address = data + ip->offset + 16;
+        address_size = 4;
+        protocol = data[ip->offset + 9];
+    }
+    else if (const PacketView::layer* ipv6 = view.find_layer(PDU::IPv6)) {
+        src_address = data + ipv6->offset + 8;
+        dst_address = data + ipv6->offset + 24;
+        address_size = 16;
+        protocol = data[ipv6->offset + 6];
+    }
+    else {
+        return 0;
+    }
+    uint16_t sport = 0;
+    uint16_t dport = 0;
+    if (view.has_layer(PDU::TCP)) {
+        sport = view.tcp().sport();
+        dport = view.tcp().dport();
+        protocol = Constants::IP::PROTO_TCP;
+    }
+    else if (view.has_layer(PDU::UDP)) {
+        sport = view.udp().sport();
+        dport = view.udp().dport();
+        protocol = Constants::IP::PROTO_UDP;
+    }
+    // Adding both endpoints' hashes makes this the same in both directions
+    uint32_t output = endpoint_hash(src_address, address_size, sport) +
+                      endpoint_hash(dst_address, address_size, dport);
+    output ^= protocol;
+    output ^= output >> 16;
+    output *= 0x85ebca6b;
+    output ^= output >> 13;
+    output *= 0xc2b2ae35;
+    output ^= output >> 16;
+    return output;
+}
+
+bool ParallelFileProcessor::is_assigned(size_type index,
+                                        const PcapFileReader::record& current) const {
+    if (mode_ == CHUNKS) {
+        return true;
+    }
+    const PDU::PDUType link_type = readers_[index]->link_type();
+    return flow_hash(link_type, current.data, current.size) % readers_.size() == index;
+}
+
+void ParallelFileProcessor::run_workers(const vector<worker_type>& workers) {
+    vector<thread> threads;
+    mutex error_mutex;
+    exception_ptr error;
+    stopped_ = false;
+    for (size_type i = 0; i < workers.size(); ++i) {
+        const worker_type& worker = workers[i];
+        threads.push_back(thread([&, worker]() {
+            try {
+                worker();
+            }
+            catch (...) {
+                lock_guard<mutex> _(error_mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                stop();
+            }
+        }));
+    }
+    for (size_type i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void ParallelFileProcessor::cleanup() {
+    for (size_type i = 0; i < readers_.size(); ++i) {
+        delete readers_[i];
+    }
+    readers_.clear();
+}
+
+} // Tins
+
+#endif // TINS_HAVE_CXX11
@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifdef _WIN32
+    #include <winsock2.h>
+#else
+    #include <sys/time.h>
+#endif // _WIN32
+#include <cstring>
+#include <tins/pcap_file_reader.h>
+#include <tins/rawpdu.h>
+#include <tins/endianness.h>
+#include <tins/detail/mapped_file.h>
+#include <tins/detail/pdu_helpers.h>
+#ifdef TINS_HAVE_PCAP
+    #include <tins/offline_packet_filter.h>
+#endif // TINS_HAVE_PCAP
+
+using std::string;
+using std::vector;
+
+using Tins::Internals::MappedFile;
+
+namespace Tins {
+namespace {
+
+const uint32_t MICROSECOND_MAGIC = 0xa1b2c3d4;
+const uint32_t NANOSECOND_MAGIC = 0xa1b23c4d;
+const uint32_t FILE_HEADER_SIZE = 24;
+const uint32_t RECORD_HEADER_SIZE = 16;
+
+} // anonymous namespace
+
+const uint32_t PcapFileReader::DEFAULT_PREFETCH_SIZE = 4 * 1024 * 1024;
+const uint32_t PcapFileReader::RECORD_BOUNDARY_CHAIN = 16;
+
+PcapFileReader::PcapFileReader(const string& file_name)
+: file_(new MappedFile(file_name)),
+  #ifdef TINS_HAVE_PCAP
+  filter_(0),
+  #endif // TINS_HAVE_PCAP
+  offset_(FILE_HEADER_SIZE), prefetched_offset_(0),
+  prefetch_size_(DEFAULT_PREFETCH_SIZE), data_link_type_(0), snap_len_(0),
+  link_type_(PDU::UNKNOWN), swapped_(false), nanosecond_timestamps_(false),
+  zero_copy_payloads_(false), max_decode_layer_(PacketDecoder::ALL_LAYERS) {
+    if (file_->size() < FILE_HEADER_SIZE) {
+        delete file_;
+        throw invalid_file_format();
+    }
+    uint32_t magic;
+    memcpy(&magic, file_->data(), sizeof(magic));
+    if (magic == MICROSECOND_MAGIC || magic == NANOSECOND_MAGIC) {
+        swapped_ = false;
+    }
+    else if (Endian::change_endian(magic) == MICROSECOND_MAGIC ||
+             Endian::change_endian(magic) == NANOSECOND_MAGIC) {
+        swapped_ = true;
+        magic = Endian::change_endian(magic);
+    }
+    else {
+        delete file_;
+        throw invalid_file_format();
+    }
+    nanosecond_timestamps_ = magic == NANOSECOND_MAGIC;
+    snap_len_ = read_uint32(file_->data() + 16);
+    // The upper bits may contain FCS information
+    data_link_type_ = read_uint32(file_->data() + 20) & 0xffff;
+    link_type_ = Internals::capture_link_type_to_pdu_type(data_link_type_);
+    file_->advise(MappedFile::SEQUENTIAL_ACCESS);
+}
+
+PcapFileReader::~PcapFileReader() {
+    #ifdef TINS_HAVE_PCAP
+    delete filter_;
+    #endif // TINS_HAVE_PCAP
+    delete file_;
+}
+
+bool PcapFileReader::next_record(record& output) {
+    while (read_record(output)) {
+        if (matches_filter(output)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PcapFileReader::record_at(uint64_t offset, record& output) {
+    if (offset < FILE_HEADER_SIZE || offset > file_->size()) {
+        return false;
+    }
+    return parse_record(offset, output);
+}
+
+Packet PcapFileReader::next_packet() {
+    record current;
+    while (next_record(current)) {
+        PDU* pdu = decode_record(current);
+        if (pdu) {
+            return Packet(pdu, current.timestamp, Packet::own_pdu());
+        }
+    }
+    return Packet();
+}
+
+bool PcapFileReader::next_packets(vector<Packet>& batch, uint32_t max_packets) {
+    batch.clear();
+    record current;
+    bool found_record = false;
+    while ((max_packets == 0 || batch.size() < max_packets) && next_record(current)) {
+        found_record = true;
+        PDU* pdu = decode_record(current);
+        if (pdu) {
+            batch.push_back(Packet(pdu, current.timestamp, Packet::own_pdu()));
+        }
+    }
+    return found_record;
+}
+
+bool PcapFileReader::next_packet(LazyPacket& packet) {
+    record current;
+    if (!next_record(current)) {
+        return false;
+    }
+    packet.assign(link_type_, current.data, current.size, current.timestamp);
+    packet.set_max_decode_layer(max_decode_layer_);
+    return true;
+}
+
+PDU* PcapFileReader::decode_record(const record& input) const {
+    if (link_type_ == PDU::UNKNOWN) {
+        throw unknown_link_type();
+    }
+    #ifdef TINS_HAVE_CXX11
+    RawPDU::zero_copy_scope zero_copy(zero_copy_payloads_);
+    PacketDecoder::depth_scope depth(max_decode_layer_);
+    #endif // TINS_HAVE_CXX11
+    return PacketDecoder::decode(link_type_, input.data, input.size);
+}
+
+void PcapFileReader::rewind() {
+    seek(FILE_HEADER_SIZE);
+}
+
+uint64_t PcapFileReader::offset() const {
+    return offset_;
+}
+
+void PcapFileReader::seek(uint64_t offset) {
+    if (offset < FILE_HEADER_SIZE) {
+        offset = FILE_HEADER_SIZE;
+    }
+    offset_ = offset > file_->size() ? file_->size() : offset;
+    prefetched_offset_ = 0;
+}
+
+void PcapFileReader::seek(const Timestamp& timestamp, const TimestampIndex& index) {
+    const uint64_t value = TimestampIndex::to_microseconds(timestamp);
+    seek(index.find(timestamp));
+    record current;
+    uint64_t current_offset = offset_;
+    while (read_record(current)) {
+        if (TimestampIndex::to_microseconds(current.timestamp) >= value) {
+            offset_ = current_offset;
+            return;
+        }
+        current_offset = offset_;
+    }
+}
+
+uint64_t PcapFileReader::find_record_boundary(uint64_t offset) const {
+    const uint64_t file_size = file_->size();
+    if (offset < FILE_HEADER_SIZE) {
+        offset = FILE_HEADER_SIZE;
+    }
+    for (; offset < file_size; ++offset) {
+        uint64_t current = offset;
+        uint32_t chain = 0;
+        while (chain < RECORD_BOUNDARY_CHAIN && current != file_size &&
+               is_valid_record_header(current)) {
+            current += RECORD_HEADER_SIZE + read_uint32(file_->data() + current + 8);
+            ++chain;
+        }
+        if (chain == RECORD_BOUNDARY_CHAIN || (chain > 0 && current == file_size)) {
+            return offset;
+        }
+    }
+    return file_size;
+}
+
+uint64_t PcapFileReader::file_size() const {
+    return file_->size();
+}
+
+#ifdef TINS_HAVE_PCAP
+void PcapFileReader::set_filter(const OfflinePacketFilter& filter) {
+    OfflinePacketFilter* new_filter = new OfflinePacketFilter(filter);
+    delete filter_;
+    filter_ = new_filter;
+}
+
+void PcapFileReader::clear_filter() {
+    delete filter_;
+    filter_ = 0;
+}
+#endif // TINS_HAVE_PCAP
+
+void PcapFileReader::set_zero_copy_payloads(bool value) {
+    #ifndef TINS_HAVE_CXX11
+        if (value) {
+            throw feature_disabled();
+        }
+    #endif // TINS_HAVE_CXX11
+    zero_copy_payloads_ = value;
+}
+
+void PcapFileReader::set_max_decode_layer(PacketDecoder::Layer layer) {
+    #ifndef TINS_HAVE_CXX11
+        if (layer != PacketDecoder::ALL_LAYERS) {
+            throw feature_disabled();
+        }
+    #endif // TINS_HAVE_CXX11
+    max_decode_layer_ = layer;
+}
+
+void PcapFileReader::set_prefetch_size(uint32_t size) {
+    prefetch_size_ = size;
+}
+
+PDU::PDUType PcapFileReader::link_type() const {
+    return link_type_;
+}
+
+uint32_t PcapFileReader::data_link_type() const {
+    return data_link_type_;
+}
+
+uint32_t PcapFileReader::snap_len() const {
+    return snap_len_;
+}
+
+bool PcapFileReader::has_nanosecond_timestamps() const {
+    return nanosecond_timestamps_;
+}
+
+uint32_t PcapFileReader::read_uint32(const uint8_t* ptr) const {
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return swapped_ ? Endian::change_endian(value) : value;
+}
+
+bool PcapFileReader::read_record(record& output) {
+    if (!parse_record(offset_, output)) {
+        return false;
+    }
+    // Keep the pages ahead of us on their way in
+    if (prefetch_size_ > 0 && offset_ + prefetch_size_ / 2 >= prefetched_offset_) {
+        const uint64_t start = prefetched_offset_ > offset_ ? prefetched_offset_ : offset_;
+        file_->prefetch(start, prefetch_size_);
+        prefetched_offset_ = start + prefetch_size_;
+    }
+    offset_ += RECORD_HEADER_SIZE + output.size;
+    return true;
+}
+
+bool PcapFileReader::parse_record(uint64_t offset, record& output) const {
+    const uint64_t file_size = file_->size();
+    if (file_size - offset < RECORD_HEADER_SIZE) {
+        return false;
+    }
+    const uint8_t* header = file_->data() + offset;
+    const uint32_t captured_size = read_uint32(header + 8);
+    if (file_size - offset - RECORD_HEADER_SIZE < captured_size) {
+        return false;
+    }
+    timeval tv;
+    tv.tv_sec = read_uint32(header);
+    const uint32_t fraction = read_uint32(header + 4);
+    tv.tv_usec = nanosecond_timestamps_ ? fraction / 1000 : fraction;
+    output.data = header + RECORD_HEADER_SIZE;
+    output.size = captured_size;
+    output.length = read_uint32(header + 12);
+    output.timestamp = Timestamp(tv);
+    return true;
+}
+
+bool PcapFileReader::is_valid_record_header(uint64_t offset) const {
+    const uint64_t file_size = file_->size();
+    if (file_size - offset < RECORD_HEADER_SIZE) {
+        return false;
+    }
+    const uint8_t* header = file_->data() + offset;
+    const uint32_t fraction = read_uint32(header + 4);
+    const uint32_t captured_size = read_uint32(header + 8);
+    const uint32_t length = read_uint32(header + 12);
+    if (fraction >= (nanosecond_timestamps_ ? 1000000000U : 1000000U)) {
+        return false;
+    }
+    if (captured_size > length || (snap_len_ != 0 && captured_size > snap_len_)) {
+        return false;
+    }
+    return file_size - offset - RECORD_HEADER_SIZE >= captured_size;
+}
+
+bool PcapFileReader::matches_filter(const record& current) const {
+    #ifdef TINS_HAVE_PCAP
+    if (filter_) {
+        return filter_->matches_filter(current.data, current.size);
+    }
+    #else
+    (void)current;
+    #endif // TINS_HAVE_PCAP
+    return true;
+}
+
+} // Tins
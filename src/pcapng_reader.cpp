@@ -0,0 +1,414 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#ifdef _WIN32
+    #include <winsock2.h>
+#else
+    #include <sys/time.h>
+#endif // _WIN32
+#include <cstring>
+#include <tins/pcapng_reader.h>
+#include <tins/rawpdu.h>
+#include <tins/endianness.h>
+#include <tins/detail/mapped_file.h>
+#include <tins/detail/pdu_helpers.h>
+
+using std::string;
+using std::vector;
+
+using Tins::Internals::MappedFile;
+
+namespace Tins {
+namespace {
+
+const uint32_t SECTION_HEADER_BLOCK = 0x0a0d0d0a;
+const uint32_t INTERFACE_DESCRIPTION_BLOCK = 1;
+const uint32_t PACKET_BLOCK = 2;
+const uint32_t SIMPLE_PACKET_BLOCK = 3;
+const uint32_t ENHANCED_PACKET_BLOCK = 6;
+const uint32_t BYTE_ORDER_MAGIC = 0x1a2b3c4d;
+// Type, length and the trailing length
+const uint32_t BLOCK_OVERHEAD = 12;
+
+const uint16_t OPTION_END = 0;
+const uint16_t OPTION_IF_NAME = 2;
+const uint16_t OPTION_IF_TSRESOL = 9;
+const uint16_t OPTION_IF_TSOFFSET = 14;
+
+const uint8_t DEFAULT_TIMESTAMP_RESOLUTION = 6;
+const uint64_t NANOSECONDS_IN_SECOND = 1000000000ULL;
+
+uint64_t power_of_ten(uint8_t exponent) {
+    uint64_t output = 1;
+    while (exponent--) {
+        output *= 10;
+    }
+    return output;
+}
+
+} // anonymous namespace
+
+const uint32_t PcapNgReader::DEFAULT_PREFETCH_SIZE = 4 * 1024 * 1024;
+
+PcapNgReader::PcapNgReader(const string& file_name)
+: file_(new MappedFile(file_name)), offset_(0), prefetched_offset_(0),
+  prefetch_size_(DEFAULT_PREFETCH_SIZE), swapped_(false), zero_copy_payloads_(false),
+  max_decode_layer_(PacketDecoder::ALL_LAYERS) {
+    if (!read_section_header()) {
+        delete file_;
+        throw invalid_file_format();
+    }
+    read_leading_interfaces();
+    file_->advise(MappedFile::SEQUENTIAL_ACCESS);
+}
+
+PcapNgReader::~PcapNgReader() {
+    delete file_;
+}
+
+bool PcapNgReader::next_record(record& output) {
+    block current;
+    while (next_block(current)) {
+        switch (current.type) {
+            case SECTION_HEADER_BLOCK:
+                // Move back so the header is parsed along with its byte order
+                offset_ -= current.size + BLOCK_OVERHEAD;
+                if (!read_section_header()) {
+                    return false;
+                }
+                break;
+            case INTERFACE_DESCRIPTION_BLOCK:
+                if (!add_interface(current)) {
+                    return false;
+                }
+                break;
+            case PACKET_BLOCK:
+            case SIMPLE_PACKET_BLOCK:
+            case ENHANCED_PACKET_BLOCK:
+                if (make_record(current, output)) {
+                    return true;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    return false;
+}
+
+Packet PcapNgReader::next_packet() {
+    record current;
+    while (next_record(current)) {
+        PDU* pdu = decode(current);
+        if (pdu) {
+            return Packet(pdu, current.timestamp, Packet::own_pdu());
+        }
+    }
+    return Packet();
+}
+
+bool PcapNgReader::next_packets(vector<Packet>& batch, uint32_t max_packets) {
+    batch.clear();
+    record current;
+    bool found_record = false;
+    while ((max_packets == 0 || batch.size() < max_packets) && next_record(current)) {
+        found_record = true;
+        PDU* pdu = decode(current);
+        if (pdu) {
+            batch.push_back(Packet(pdu, current.timestamp, Packet::own_pdu()));
+        }
+    }
+    return found_record;
+}
+
+bool PcapNgReader::next_packet(LazyPacket& packet) {
+    record current;
+    while (next_record(current)) {
+        const PDU::PDUType link_type = interfaces_[current.interface_id].link_type;
+        // These could never be decoded, just like next_packet skips them
+        if (link_type == PDU::UNKNOWN) {
+            continue;
+        }
+        packet.assign(link_type, current.data, current.size, current.timestamp);
+        packet.set_max_decode_layer(max_decode_layer_);
+        return true;
+    }
+    return false;
+}
+
+void PcapNgReader::rewind() {
+    offset_ = 0;
+    prefetched_offset_ = 0;
+    // This already succeeded when the file was opened
+    read_section_header();
+    read_leading_interfaces();
+}
+
+void PcapNgReader::set_zero_copy_payloads(bool value) {
+    #ifndef TINS_HAVE_CXX11
+        if (value) {
+            throw feature_disabled();
+        }
+    #endif // TINS_HAVE_CXX11
+    zero_copy_payloads_ = value;
+}
+
+void PcapNgReader::set_max_decode_layer(PacketDecoder::Layer layer) {
+    #ifndef TINS_HAVE_CXX11
+        if (layer != PacketDecoder::ALL_LAYERS) {
+            throw feature_disabled();
+        }
+    #endif // TINS_HAVE_CXX11
+    max_decode_layer_ = layer;
+}
+
+void PcapNgReader::set_prefetch_size(uint32_t size) {
+    prefetch_size_ = size;
+}
+
+size_t PcapNgReader::interface_count() const {
+    return interfaces_.size();
+}
+
+const PcapNgReader::interface_info& PcapNgReader::interface_at(uint32_t index) const {
+    if (index >= interfaces_.size()) {
+        throw invalid_interface();
+    }
+    return interfaces_[index];
+}
+
+uint16_t PcapNgReader::read_uint16(const uint8_t* ptr) const {
+    uint16_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return swapped_ ? Endian::change_endian(value) : value;
+}
+
+uint32_t PcapNgReader::read_uint32(const uint8_t* ptr) const {
+    uint32_t value;
+    memcpy(&value, ptr, sizeof(value));
+    return swapped_ ? Endian::change_endian(value) : value;
+}
+
+bool PcapNgReader::next_block(block& output) {
+    const uint64_t file_size = file_->size();
+    if (file_size - offset_ < BLOCK_OVERHEAD) {
+        return false;
+    }
+    const uint8_t* ptr = file_->data() + offset_;
+    // The block type is the same in both byte orders
+    output.type = read_uint32(ptr);
+    if (output.type == SECTION_HEADER_BLOCK) {
+        uint32_t magic;
+        memcpy(&magic, ptr + 8, sizeof(magic));
+        if (magic == BYTE_ORDER_MAGIC) {
+            swapped_ = false;
+        }
+        else if (Endian::change_endian(magic) == BYTE_ORDER_MAGIC) {
+            swapped_ = true;
+        }
+        else {
+            return false;
+        }
+    }
+    const uint32_t total_size = read_uint32(ptr + 4);
+    if (total_size < BLOCK_OVERHEAD || total_size % 4 != 0 ||
+        total_size > file_size - offset_) {
+        return false;
+    }
+    // Keep the pages ahead of us on their way in
+    if (prefetch_size_ > 0 && offset_ + prefetch_size_ / 2 >= prefetched_offset_) {
+        const uint64_t start = prefetched_offset_ > offset_ ? prefetched_offset_ : offset_;
+        file_->prefetch(start, prefetch_size_);
+        prefetched_offset_ = start + prefetch_size_;
+    }
+    output.body = ptr + 8;
+    output.size = total_size - BLOCK_OVERHEAD;
+    offset_ += total_size;
+    return true;
+}
+
+bool PcapNgReader::read_section_header() {
+    block current;
+    // Byte order magic, version and section length
+    if (!next_block(current) || current.type != SECTION_HEADER_BLOCK ||
+        current.size < 16 || read_uint16(current.body + 4) != 1) {
+        return false;
+    }
+    interfaces_.clear();
+    return true;
+}
+
+void PcapNgReader::read_leading_interfaces() {
+    block current;
+    while (true) {
+        const uint64_t offset = offset_;
+        const bool swapped = swapped_;
+        if (!next_block(current) || current.type != INTERFACE_DESCRIPTION_BLOCK ||
+            !add_interface(current)) {
+            offset_ = offset;
+            swapped_ = swapped;
+            return;
+        }
+    }
+}
+
+bool PcapNgReader::add_interface(const block& current) {
+    if (current.size < 8) {
+        return false;
+    }
+    interface_info info;
+    info.data_link_type = read_uint16(current.body);
+    info.link_type = Internals::capture_link_type_to_pdu_type(info.data_link_type);
+    info.snap_len = read_uint32(current.body + 4);
+    info.timestamp_resolution = DEFAULT_TIMESTAMP_RESOLUTION;
+    info.timestamp_offset = 0;
+    const uint8_t* ptr = current.body + 8;
+    const uint8_t* end = current.body + current.size;
+    while (end - ptr >= 4) {
+        const uint16_t code = read_uint16(ptr);
+        const uint16_t length = read_uint16(ptr + 2);
+        ptr += 4;
+        if (code == OPTION_END || end - ptr < length) {
+            break;
+        }
+        if (code == OPTION_IF_NAME) {
+            info.name.assign(ptr, ptr + length);
+            // The name may be null terminated
+            info.name.erase(info.name.find_last_not_of('\0') + 1);
+        }
+        else if (code == OPTION_IF_TSRESOL && length == 1) {
+            info.timestamp_resolution = *ptr;
+        }
+        else if (code == OPTION_IF_TSOFFSET && length == 8) {
+            uint64_t value;
+            memcpy(&value, ptr, sizeof(value));
+            info.timestamp_offset = static_cast<int64_t>(
+                swapped_ ? Endian::change_endian(value) : value
+            );
+        }
+        // Options are padded to 32 bits
+        const uint32_t padded_length = (length + 3) & ~3u;
+        if (end - ptr < padded_length) {
+            break;
+        }
+        ptr += padded_length;
+    }
+    interfaces_.push_back(info);
+    return true;
+}
+
+bool PcapNgReader::make_record(const block& current, record& output) const {
+    uint64_t timestamp = 0;
+    uint32_t header_size;
+    if (current.type == SIMPLE_PACKET_BLOCK) {
+        // These don't have timestamps and always belong to the first interface
+        if (current.size < 4 || interfaces_.empty()) {
+            return false;
+        }
+        header_size = 4;
+        output.interface_id = 0;
+        output.length = read_uint32(current.body);
+        output.size = output.length;
+        if (interfaces_[0].snap_len != 0 && interfaces_[0].snap_len < output.size) {
+            output.size = interfaces_[0].snap_len;
+        }
+        if (current.size - header_size < output.size) {
+            output.size = current.size - header_size;
+        }
+    }
+    else {
+        header_size = 20;
+        if (current.size < header_size) {
+            return false;
+        }
+        // The obsolete packet block uses a 16 bit interface id and drop count
+        output.interface_id = current.type == ENHANCED_PACKET_BLOCK ?
+                              read_uint32(current.body) :
+                              read_uint16(current.body);
+        timestamp = (static_cast<uint64_t>(read_uint32(current.body + 4)) << 32) |
+                    read_uint32(current.body + 8);
+        output.size = read_uint32(current.body + 12);
+        output.length = read_uint32(current.body + 16);
+        if (output.interface_id >= interfaces_.size() ||
+            current.size - header_size < output.size) {
+            return false;
+        }
+    }
+    output.data = current.body + header_size;
+    output.timestamp_ns = to_nanoseconds(interfaces_[output.interface_id], timestamp);
+    timeval tv;
+    tv.tv_sec = static_cast<long>(output.timestamp_ns / NANOSECONDS_IN_SECOND);
+    tv.tv_usec = static_cast<long>((output.timestamp_ns % NANOSECONDS_IN_SECOND) / 1000);
+    output.timestamp = Timestamp(tv);
+    return true;
+}
+
+uint64_t PcapNgReader::to_nanoseconds(const interface_info& info, uint64_t value) const {
+    const uint8_t exponent = info.timestamp_resolution & 0x7f;
+    uint64_t output;
+    if (info.timestamp_resolution & 0x80) {
+        // The resolution is a negative power of 2
+        if (exponent >= 64) {
+            output = 0;
+        }
+        else {
+            const uint64_t seconds = value >> exponent;
+            uint64_t fraction = value & ((1ULL << exponent) - 1);
+            uint8_t shift = exponent;
+            // Keep the multiplication below from overflowing
+            if (shift > 32) {
+                fraction >>= shift - 32;
+                shift = 32;
+            }
+            output = seconds * NANOSECONDS_IN_SECOND +
+                     ((fraction * NANOSECONDS_IN_SECOND) >> shift);
+        }
+    }
+    else if (exponent <= 9) {
+        output = value * power_of_ten(9 - exponent);
+    }
+    else {
+        output = exponent - 9 >= 20 ? 0 : value / power_of_ten(exponent - 9);
+    }
+    return output + static_cast<uint64_t>(info.timestamp_offset) * NANOSECONDS_IN_SECOND;
+}
+
+PDU* PcapNgReader::decode(const record& current) const {
+    const PDU::PDUType link_type = interfaces_[current.interface_id].link_type;
+    if (link_type == PDU::UNKNOWN) {
+        return 0;
+    }
+    #ifdef TINS_HAVE_CXX11
+    RawPDU::zero_copy_scope zero_copy(zero_copy_payloads_);
+    PacketDecoder::depth_scope depth(max_decode_layer_);
+    #endif // TINS_HAVE_CXX11
+    return PacketDecoder::decode(link_type, current.data, current.size);
+}
+
+} // Tins
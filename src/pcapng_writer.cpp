@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <cstring>
+#include <cerrno>
+#include <tins/pcapng_writer.h>
+#include <tins/timestamp.h>
+#include <tins/exceptions.h>
+#include <tins/detail/pdu_helpers.h>
+
+using std::string;
+
+namespace Tins {
+namespace {
+
+const uint32_t SECTION_HEADER_BLOCK = 0x0a0d0d0a;
+const uint32_t INTERFACE_DESCRIPTION_BLOCK = 1;
+const uint32_t ENHANCED_PACKET_BLOCK = 6;
+const uint32_t BYTE_ORDER_MAGIC = 0x1a2b3c4d;
+
+const uint16_t OPTION_END = 0;
+const uint16_t OPTION_IF_NAME = 2;
+const uint16_t OPTION_IF_TSRESOL = 9;
+
+// Timestamps are always stored in nanoseconds
+const uint8_t NANOSECOND_RESOLUTION = 9;
+const uint64_t NANOSECONDS_IN_SECOND = 1000000000ULL;
+
+uint64_t to_nanoseconds(const Timestamp& timestamp) {
+    return static_cast<uint64_t>(timestamp.seconds()) * NANOSECONDS_IN_SECOND +
+           static_cast<uint64_t>(timestamp.microseconds()) * 1000;
+}
+
+} // anonymous namespace
+
+const uint32_t PcapNgWriter::DEFAULT_BUFFER_SIZE = 1024 * 1024;
+
+PcapNgWriter::PcapNgWriter(const string& file_name, uint32_t buffer_size)
+: file_(fopen(file_name.c_str(), "wb")), buffer_size_(buffer_size) {
+    if (!file_) {
+        throw file_open_error(file_name + ": " + strerror(errno));
+    }
+    buffer_.reserve(buffer_size_);
+    const size_t start = buffer_.size();
+    append_uint32(SECTION_HEADER_BLOCK);
+    append_uint32(0);
+    append_uint32(BYTE_ORDER_MAGIC);
+    // Version 1.0
+    append_uint16(1);
+    append_uint16(0);
+    // The section's length is not specified
+    append_uint32(0xffffffff);
+    append_uint32(0xffffffff);
+    end_block(start);
+}
+
+PcapNgWriter::~PcapNgWriter() {
+    try {
+        flush();
+    }
+    catch (file_write_error&) {
+        // Nothing we can do here
+    }
+    fclose(file_);
+}
+
+uint32_t PcapNgWriter::add_interface(PDU::PDUType link_type, uint32_t snap_len,
+                                     const string& name) {
+    const uint32_t data_link_type = Internals::pdu_type_to_capture_link_type(link_type);
+    if (data_link_type == 0xffffffff) {
+        throw unknown_link_type();
+    }
+    const size_t start = buffer_.size();
+    append_uint32(INTERFACE_DESCRIPTION_BLOCK);
+    append_uint32(0);
+    append_uint16(static_cast<uint16_t>(data_link_type));
+    append_uint16(0);
+    append_uint32(snap_len);
+    if (!name.empty()) {
+        append_option(OPTION_IF_NAME, name.data(), static_cast<uint16_t>(name.size()));
+    }
+    append_option(OPTION_IF_TSRESOL, &NANOSECOND_RESOLUTION, sizeof(NANOSECOND_RESOLUTION));
+    append_option(OPTION_END, 0, 0);
+    end_block(start);
+    snap_lens_.push_back(snap_len);
+    return static_cast<uint32_t>(snap_lens_.size() - 1);
+}
+
+void PcapNgWriter::write(PDU& pdu) {
+    write(pdu, 0);
+}
+
+void PcapNgWriter::write(PDU& pdu, uint32_t interface_id) {
+    write_pdu(pdu, interface_id, to_nanoseconds(Timestamp::current_time()));
+}
+
+void PcapNgWriter::write(Packet& packet) {
+    write(packet, 0);
+}
+
+void PcapNgWriter::write(Packet& packet, uint32_t interface_id) {
+    write_pdu(*packet.pdu(), interface_id, to_nanoseconds(packet.timestamp()));
+}
+
+void PcapNgWriter::write_record(uint32_t interface_id, uint64_t timestamp_ns,
+                                const uint8_t* data, uint32_t size, uint32_t length) {
+    if (interface_id >= snap_lens_.size()) {
+        throw invalid_interface();
+    }
+    if (snap_lens_[interface_id] != 0 && size > snap_lens_[interface_id]) {
+        size = snap_lens_[interface_id];
+    }
+    const size_t start = buffer_.size();
+    append_uint32(ENHANCED_PACKET_BLOCK);
+    append_uint32(0);
+    append_uint32(interface_id);
+    append_uint32(static_cast<uint32_t>(timestamp_ns >> 32));
+    append_uint32(static_cast<uint32_t>(timestamp_ns & 0xffffffff));
+    append_uint32(size);
+    append_uint32(length);
+    append(data, size);
+    append_padding(size);
+    end_block(start);
+}
+
+void PcapNgWriter::flush() {
+    if (buffer_.empty()) {
+        return;
+    }
+    const size_t written = fwrite(&buffer_[0], 1, buffer_.size(), file_);
+    const bool failed = written != buffer_.size();
+    buffer_.clear();
+    if (failed) {
+        throw file_write_error(strerror(errno));
+    }
+}
+
+void PcapNgWriter::write_pdu(PDU& pdu, uint32_t interface_id, uint64_t timestamp_ns) {
+    const PDU::serialization_type buffer = pdu.serialize();
+    write_record(
+        interface_id,
+        timestamp_ns,
+        buffer.empty() ? 0 : &buffer[0],
+        static_cast<uint32_t>(buffer.size()),
+        static_cast<uint32_t>(pdu.advertised_size())
+    );
+}
+
+void PcapNgWriter::append(const void* data, uint32_t size) {
+    const uint8_t* ptr = static_cast<const uint8_t*>(data);
+    buffer_.insert(buffer_.end(), ptr, ptr + size);
+}
+
+void PcapNgWriter::append_uint16(uint16_t value) {
+    append(&value, sizeof(value));
+}
+
+void PcapNgWriter::append_uint32(uint32_t value) {
+    append(&value, sizeof(value));
+}
+
+void PcapNgWriter::append_padding(uint32_t size) {
+    // Everything is aligned to 32 bits
+    buffer_.resize(buffer_.size() + ((4 - size % 4) % 4), 0);
+}
+
+void PcapNgWriter::append_option(uint16_t code, const void* data, uint16_t size) {
+    append_uint16(code);
+    append_uint16(size);
+    append(data, size);
+    append_padding(size);
+}
+
+void PcapNgWriter::end_block(size_t start) {
+    // The total length is stored both after the type and at the end
+    const uint32_t total_size = static_cast<uint32_t>(buffer_.size() - start + 4);
+    memcpy(&buffer_[start + 4], &total_size, sizeof(total_size));
+    append_uint32(total_size);
+    if (buffer_.size() >= buffer_size_) {
+        flush();
+    }
+}
+
+} // Tins
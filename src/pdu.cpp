@@ -27,8 +27,11 @@
  *
  */
  
+#include <cstring>
+#include <new>
 #include <tins/pdu.h>
 #include <tins/packet_sender.h>
+#include <tins/packet_arena.h>
 
 using std::swap;
 using std::vector;
@@ -45,25 +48,78 @@ PDU::metadata::metadata(uint32_t header_size, PDUType current_type, PDUType next
 
 }
 
+// PDU::layer_index
+
+struct PDU::layer_index {
+    // Unknown and user defined types are above this one
+    static const uint32_t MAX_TYPES = 64;
+    static const uint32_t MAX_LAYERS = 16;
+
+    PDU* layers[MAX_LAYERS];
+    // 1 based positions of the first and last layer of each type, 0 if none
+    uint8_t first[MAX_TYPES];
+    uint8_t last[MAX_TYPES];
+    // Whether the index was allocated from a PacketArena
+    bool from_arena;
+};
+
+namespace {
+
+// PDUs of other types match these flags as well (e.g. every Dot11Data 
+// subclass matches PDU::DOT11_DATA), so they can't be looked up by type
+bool is_base_flag(PDU::PDUType flag) {
+    switch (flag) {
+        case PDU::DOT11:
+        case PDU::DOT11_CONTROL:
+        case PDU::DOT11_DATA:
+        case PDU::DOT11_MANAGEMENT:
+        case PDU::EAPOL:
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // anonymous namespace
+
 // PDU
 
 PDU::PDU()
-: inner_pdu_(), parent_pdu_() {
-
+: inner_pdu_(), parent_pdu_(), layer_index_() {
+    #ifdef TINS_HAVE_CXX11
+        arena_allocated_ = false;
+    #endif // TINS_HAVE_CXX11
 }
 
 PDU::PDU(const PDU& other) 
-: inner_pdu_(), parent_pdu_() {
+: inner_pdu_(), parent_pdu_(), layer_index_() {
+    #ifdef TINS_HAVE_CXX11
+        arena_allocated_ = false;
+    #endif // TINS_HAVE_CXX11
     copy_inner_pdu(other);
 }
 
 PDU& PDU::operator=(const PDU& other) {
+    invalidate_layer_index();
     copy_inner_pdu(other);
     return* this;
 }
 
 PDU::~PDU() {
-    delete inner_pdu_;
+    free_layer_index();
+    destroy(inner_pdu_);
+}
+
+void PDU::destroy(PDU* pdu) {
+    #ifdef TINS_HAVE_CXX11
+        // Decoded PDUs may have been constructed in an arena
+        if (pdu && pdu->arena_allocated_) {
+            pdu->~PDU();
+            PacketArena::deallocate(pdu);
+            return;
+        }
+    #endif // TINS_HAVE_CXX11
+    delete pdu;
 }
 
 void PDU::copy_inner_pdu(const PDU& pdu) {
@@ -106,7 +162,8 @@ bool PDU::matches_response(const uint8_t* /*ptr*/, uint32_t /*total_sz*/) const
 }
 
 void PDU::inner_pdu(PDU* next_pdu) {
-    delete inner_pdu_;
+    invalidate_layer_index();
+    destroy(inner_pdu_);
     inner_pdu_ = next_pdu;
     if (inner_pdu_) {
         inner_pdu_->parent_pdu(this);
@@ -118,10 +175,26 @@ void PDU::inner_pdu(const PDU& next_pdu) {
 }
 
 PDU* PDU::release_inner_pdu() {
+    invalidate_layer_index();
     PDU* result = 0;
     swap(result, inner_pdu_);
     if (result) {
         result->parent_pdu(0);
+        #ifdef TINS_HAVE_CXX11
+            // The caller will use operator delete on it
+            if (result->arena_allocated_) {
+                PDU* copy = 0;
+                try {
+                    copy = result->clone();
+                }
+                catch (...) {
+                    destroy(result);
+                    throw;
+                }
+                destroy(result);
+                result = copy;
+            }
+        #endif // TINS_HAVE_CXX11
     }
     return result;
 }
@@ -149,4 +222,72 @@ void PDU::parent_pdu(PDU* parent) {
     parent_pdu_ = parent;
 }
 
+void PDU::build_layer_index() {
+    build_layer_index(0);
+}
+
+void PDU::build_layer_index(PacketArena* arena) {
+    if (layer_index_) {
+        return;
+    }
+    layer_index index;
+    memset(index.first, 0, sizeof(index.first));
+    memset(index.last, 0, sizeof(index.last));
+    uint32_t position = 0;
+    for (PDU* pdu = this; pdu; pdu = pdu->inner_pdu()) {
+        const uint32_t type = pdu->pdu_type();
+        if (position == layer_index::MAX_LAYERS || type >= layer_index::MAX_TYPES) {
+            return;
+        }
+        index.layers[position++] = pdu;
+        if (!index.first[type]) {
+            index.first[type] = static_cast<uint8_t>(position);
+        }
+        index.last[type] = static_cast<uint8_t>(position);
+    }
+    index.from_arena = false;
+    #ifdef TINS_HAVE_CXX11
+        index.from_arena = arena != 0;
+        void* storage = arena ? arena->allocate(sizeof(layer_index)) 
+                              : ::operator new(sizeof(layer_index));
+    #else
+        (void)arena;
+        void* storage = ::operator new(sizeof(layer_index));
+    #endif // TINS_HAVE_CXX11
+    layer_index_ = new (storage) layer_index(index);
+}
+
+bool PDU::find_indexed_pdu(PDUType type, bool last, PDU*& output) const {
+    if (static_cast<uint32_t>(type) >= layer_index::MAX_TYPES || is_base_flag(type)) {
+        return false;
+    }
+    const uint8_t position = last ? layer_index_->last[type] : layer_index_->first[type];
+    output = position ? layer_index_->layers[position - 1] : 0;
+    return true;
+}
+
+void PDU::free_layer_index() {
+    if (!layer_index_) {
+        return;
+    }
+    #ifdef TINS_HAVE_CXX11
+        if (layer_index_->from_arena) {
+            PacketArena::deallocate(layer_index_);
+        }
+        else {
+            ::operator delete(layer_index_);
+        }
+    #else
+        ::operator delete(layer_index_);
+    #endif // TINS_HAVE_CXX11
+    layer_index_ = 0;
+}
+
+void PDU::invalidate_layer_index() {
+    // Any ancestor's index covers this PDU's chain too
+    for (PDU* pdu = this; pdu; pdu = pdu->parent_pdu_) {
+        pdu->free_layer_index();
+    }
+}
+
 } // Tins
@@ -29,35 +29,195 @@
 
 #include <tins/rawpdu.h>
 #include <tins/memory_helpers.h>
+#include <tins/exceptions.h>
 
 using Tins::Memory::OutputMemoryStream;
 
 namespace Tins {
+
+#ifdef TINS_HAVE_CXX11
+
+namespace {
+
+thread_local bool zero_copy_enabled = false;
+
+} // anonymous namespace
+
+RawPDU::zero_copy_scope::zero_copy_scope(bool enabled)
+: previous_(zero_copy_enabled) {
+    zero_copy_enabled = enabled;
+}
+
+RawPDU::zero_copy_scope::~zero_copy_scope() {
+    zero_copy_enabled = previous_;
+}
+
+bool RawPDU::zero_copy_scope::is_enabled() {
+    return zero_copy_enabled;
+}
+
+#endif // TINS_HAVE_CXX11
+
 RawPDU::RawPDU(const uint8_t* pload, uint32_t size) 
-: payload_(pload, pload + size) {
-    
+: shared_(0), borrowed_payload_(0), borrowed_size_(0), shareable_(true) {
+    #ifdef TINS_HAVE_CXX11
+        if (zero_copy_enabled && size > 0) {
+            borrowed_payload_ = pload;
+            borrowed_size_ = size;
+            return;
+        }
+    #endif // TINS_HAVE_CXX11
+    payload_.assign(pload, pload + size);
+}
+
+RawPDU::RawPDU(const uint8_t* pload, uint32_t size, borrow_payload)
+: shared_(0), borrowed_payload_(size > 0 ? pload : 0), borrowed_size_(size),
+  shareable_(true) {
+
 }
 
 RawPDU::RawPDU(const std::string& data) 
-: payload_(data.begin(), data.end()) {
-    
+: payload_(data.begin(), data.end()), shared_(0), borrowed_payload_(0), borrowed_size_(0),
+  shareable_(true) {
+
+}
+
+RawPDU::RawPDU(const RawPDU& other)
+: PDU(other), shared_(0), borrowed_payload_(0), borrowed_size_(0), shareable_(true) {
+    share_payload(other);
+}
+
+RawPDU& RawPDU::operator=(const RawPDU& other) {
+    if (this != &other) {
+        PDU::operator=(other);
+        share_payload(other);
+    }
+    return *this;
+}
+
+RawPDU::~RawPDU() {
+    release_payload();
 }
 
 uint32_t RawPDU::header_size() const {
-    return static_cast<uint32_t>(payload_.size());
+    return payload_size();
 }
 
 void RawPDU::write_serialization(uint8_t* buffer, uint32_t total_sz) {
     OutputMemoryStream stream(buffer, total_sz);
-    stream.write(payload_.begin(), payload_.end());
+    stream.write(payload_data(), payload_size());
 }
 
 void RawPDU::payload(const payload_type& pload) {
-    payload_ = pload;
+    payload_type copy(pload);
+    assign_payload(copy);
+}
+
+const RawPDU::payload_type& RawPDU::payload() const {
+    if (borrowed_payload_) {
+        throw payload_not_owned();
+    }
+    return stored_payload();
+}
+
+RawPDU::payload_type& RawPDU::payload() {
+    own_payload();
+    shared_payload* shared = this->shared();
+    if (shared) {
+        // The RawPDU that was copied first still has its own payload. Copies
+        // take it back, copying it if other copies are still using it
+        if (payload_.empty()) {
+            if (shared->refcount > 1) {
+                payload_ = shared->data;
+            }
+            else {
+                payload_.swap(shared->data);
+            }
+        }
+        release_payload();
+    }
+    shareable_ = false;
+    return payload_;
+}
+
+void RawPDU::own_payload() {
+    if (borrowed_payload_) {
+        payload_type data(borrowed_payload_, borrowed_payload_ + borrowed_size_);
+        assign_payload(data);
+    }
+}
+
+bool RawPDU::is_payload_shared() const {
+    shared_payload* shared = this->shared();
+    return shared && shared->refcount > 1;
 }
 
 bool RawPDU::matches_response(const uint8_t* /*ptr*/, uint32_t /*total_sz*/) const {
     return true;
 }
 
+void RawPDU::assign_payload(payload_type& data) {
+    release_payload();
+    payload_.swap(data);
+    borrowed_payload_ = 0;
+    borrowed_size_ = 0;
+    // References to the previous payload can't be used to modify this one
+    shareable_ = true;
+}
+
+void RawPDU::share_payload(const RawPDU& other) {
+    #ifdef TINS_HAVE_CXX11
+        // Borrowed payloads are copied, since the buffer may not outlive the copy
+        if (!other.borrowed_payload_ && other.shareable_ && other.payload_size() > 0) {
+            shared_payload* shared = other.acquire_shared_payload();
+            release_payload();
+            payload_type().swap(payload_);
+            set_shared(shared);
+            borrowed_payload_ = 0;
+            borrowed_size_ = 0;
+            shareable_ = true;
+            return;
+        }
+    #endif // TINS_HAVE_CXX11
+    payload_type data(other.payload_data(), other.payload_data() + other.payload_size());
+    assign_payload(data);
+}
+
+RawPDU::shared_payload* RawPDU::acquire_shared_payload() const {
+    #ifdef TINS_HAVE_CXX11
+        shared_payload* shared = shared_.load(std::memory_order_acquire);
+        if (!shared) {
+            // Several threads may be copying this RawPDU, so the storage is 
+            // published atomically and only the first one to do so is kept.
+            // The new reference belongs to this RawPDU
+            shared_payload* created = new shared_payload(payload_);
+            if (shared_.compare_exchange_strong(shared, created, std::memory_order_acq_rel,
+                                                std::memory_order_acquire)) {
+                shared = created;
+            }
+            else {
+                delete created;
+            }
+        }
+        shared->refcount.fetch_add(1, std::memory_order_relaxed);
+        return shared;
+    #else
+        return 0;
+    #endif // TINS_HAVE_CXX11
+}
+
+void RawPDU::release_payload() {
+    shared_payload* shared = this->shared();
+    if (shared) {
+        #ifdef TINS_HAVE_CXX11
+            if (shared->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete shared;
+            }
+        #else
+            delete shared;
+        #endif // TINS_HAVE_CXX11
+        set_shared(0);
+    }
+}
+
 } // Tins
@@ -0,0 +1,550 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/ring_sniffer.h>
+
+#ifdef TINS_HAVE_TPACKET_V3
+
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/time.h>
+#include <poll.h>
+#include <unistd.h>
+#include <net/if.h>
+#include <net/if_arp.h>
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+#ifdef TINS_HAVE_PCAP
+    #include <pcap.h>
+#endif // TINS_HAVE_PCAP
+#include <tins/network_interface.h>
+#include <tins/rawpdu.h>
+#include <tins/packet_decoder.h>
+#include <tins/endianness.h>
+
+using std::string;
+using std::vector;
+
+namespace Tins {
+
+// RingSnifferConfiguration
+
+const uint32_t RingSnifferConfiguration::DEFAULT_BLOCK_SIZE = 1 << 20;
+const uint32_t RingSnifferConfiguration::DEFAULT_BLOCK_COUNT = 64;
+const uint32_t RingSnifferConfiguration::DEFAULT_FRAME_SIZE = 2048;
+const uint32_t RingSnifferConfiguration::DEFAULT_BLOCK_TIMEOUT = 10;
+const uint32_t RingSnifferConfiguration::DEFAULT_TIMEOUT = 1000;
+
+RingSnifferConfiguration::RingSnifferConfiguration()
+: block_size_(DEFAULT_BLOCK_SIZE), block_count_(DEFAULT_BLOCK_COUNT),
+  frame_size_(DEFAULT_FRAME_SIZE), block_timeout_(DEFAULT_BLOCK_TIMEOUT),
+  timeout_(DEFAULT_TIMEOUT), promisc_(false), fanout_enabled_(false),
+  fanout_new_group_(false), fanout_group_id_(0), fanout_mode_(FANOUT_HASH), arena_allocation_(false),
+  zero_copy_payloads_(false), max_decode_layer_(PacketDecoder::ALL_LAYERS) {
+
+}
+
+void RingSnifferConfiguration::set_block_size(uint32_t block_size) {
+    block_size_ = block_size;
+}
+
+void RingSnifferConfiguration::set_block_count(uint32_t block_count) {
+    block_count_ = block_count;
+}
+
+void RingSnifferConfiguration::set_frame_size(uint32_t frame_size) {
+    frame_size_ = frame_size;
+}
+
+void RingSnifferConfiguration::set_block_timeout(uint32_t timeout) {
+    block_timeout_ = timeout;
+}
+
+void RingSnifferConfiguration::set_timeout(uint32_t timeout) {
+    timeout_ = timeout;
+}
+
+void RingSnifferConfiguration::set_promisc_mode(bool enabled) {
+    promisc_ = enabled;
+}
+
+void RingSnifferConfiguration::set_filter(const string& filter) {
+    filter_ = filter;
+}
+
+void RingSnifferConfiguration::set_fanout(uint16_t group_id, FanoutMode mode) {
+    fanout_enabled_ = true;
+    fanout_new_group_ = false;
+    fanout_group_id_ = group_id;
+    fanout_mode_ = mode;
+}
+
+void RingSnifferConfiguration::set_fanout(FanoutMode mode) {
+    fanout_enabled_ = true;
+    fanout_new_group_ = true;
+    fanout_group_id_ = 0;
+    fanout_mode_ = mode;
+}
+
+void RingSnifferConfiguration::set_arena_allocation(bool enabled) {
+    arena_allocation_ = enabled;
+}
+
+void RingSnifferConfiguration::set_zero_copy_payloads(bool enabled) {
+    zero_copy_payloads_ = enabled;
+}
+
+void RingSnifferConfiguration::set_max_decode_layer(PacketDecoder::Layer layer) {
+    max_decode_layer_ = layer;
+}
+
+// RingSniffer
+
+namespace {
+
+// The kernel strips VLAN tags off, they're put back right after the
+// Ethernet addresses
+const uint32_t vlan_tag_offset = 2 * ETH_ALEN;
+const uint32_t vlan_tag_size = 4;
+
+string ring_error_string(const string& operation) {
+    return operation + ": " + strerror(errno);
+}
+
+PDU::PDUType link_type_from_hardware_type(int hardware_type) {
+    switch (hardware_type) {
+        case ARPHRD_ETHER:
+        case ARPHRD_LOOPBACK:
+            return PDU::ETHERNET_II;
+        case ARPHRD_NONE:
+        case ARPHRD_PPP:
+            return PDU::IP;
+        #ifdef TINS_HAVE_DOT11
+            case ARPHRD_IEEE80211_RADIOTAP:
+                return PDU::RADIOTAP;
+        #endif // TINS_HAVE_DOT11
+        default:
+            throw unknown_link_type();
+    }
+}
+
+// Free identifiers probed before giving up, on kernels that can't pick one
+const uint32_t max_fanout_probes = 1024;
+
+int fanout_type(RingSnifferConfiguration::FanoutMode mode) {
+    switch (mode) {
+        case RingSnifferConfiguration::FANOUT_HASH:
+            return PACKET_FANOUT_HASH | PACKET_FANOUT_FLAG_DEFRAG;
+        case RingSnifferConfiguration::FANOUT_ROUND_ROBIN:
+            return PACKET_FANOUT_LB;
+        case RingSnifferConfiguration::FANOUT_CPU:
+            return PACKET_FANOUT_CPU;
+    }
+    return 0;
+}
+
+bool join_fanout_group(int fd, uint16_t group_id, int type) {
+    int fanout = group_id | (type << 16);
+    return setsockopt(fd, SOL_PACKET, PACKET_FANOUT, &fanout, sizeof(fanout)) == 0;
+}
+
+void create_fanout_group(int fd, int type) {
+    #ifdef PACKET_FANOUT_FLAG_UNIQUEID
+        // The kernel picks an identifier no other group is using
+        if (join_fanout_group(fd, 0, type | PACKET_FANOUT_FLAG_UNIQUEID)) {
+            return;
+        }
+        if (errno != EINVAL) {
+            throw socket_open_error(ring_error_string("Failed to create fanout group"));
+        }
+    #endif // PACKET_FANOUT_FLAG_UNIQUEID
+    // Joining a group that uses other settings or another interface fails, 
+    // so keep probing until one is created. The pid and a counter keep 
+    // groups created by this and other processes apart
+    static std::atomic<uint16_t> counter(0);
+    const uint16_t first_id = static_cast<uint16_t>(getpid()) + counter++;
+    for (uint32_t i = 0; i < max_fanout_probes; ++i) {
+        if (join_fanout_group(fd, static_cast<uint16_t>(first_id + i), type)) {
+            return;
+        }
+        if (errno != EINVAL && errno != EEXIST) {
+            break;
+        }
+    }
+    throw socket_open_error(ring_error_string("Failed to create fanout group"));
+}
+
+#ifdef TINS_HAVE_PCAP
+void attach_filter(int fd, const string& filter) {
+    pcap_t* handle = pcap_open_dead(DLT_EN10MB, 65535);
+    if (!handle) {
+        throw invalid_pcap_filter("Failed to open pcap handle");
+    }
+    bpf_program program;
+    if (pcap_compile(handle, &program, filter.c_str(), 1, 0xffffffff) == -1) {
+        string error = pcap_geterr(handle);
+        pcap_close(handle);
+        throw invalid_pcap_filter(error.c_str());
+    }
+    pcap_close(handle);
+    sock_fprog socket_program;
+    socket_program.len = program.bf_len;
+    socket_program.filter = reinterpret_cast<sock_filter*>(program.bf_insns);
+    int result = setsockopt(fd, SOL_SOCKET, SO_ATTACH_FILTER, &socket_program,
+                            sizeof(socket_program));
+    pcap_freecode(&program);
+    if (result == -1) {
+        throw socket_open_error(ring_error_string("Failed to attach filter"));
+    }
+}
+#endif // TINS_HAVE_PCAP
+
+bool has_vlan_tag(const tpacket3_hdr& header) {
+    #ifdef TP_STATUS_VLAN_VALID
+        return (header.tp_status & TP_STATUS_VLAN_VALID) != 0;
+    #else
+        return header.hv1.tp_vlan_tci != 0;
+    #endif // TP_STATUS_VLAN_VALID
+}
+
+uint16_t vlan_tag_protocol(const tpacket3_hdr& header) {
+    #ifdef TP_STATUS_VLAN_TPID_VALID
+        if ((header.tp_status & TP_STATUS_VLAN_TPID_VALID) != 0) {
+            return header.hv1.tp_vlan_tpid;
+        }
+    #endif // TP_STATUS_VLAN_TPID_VALID
+    return ETH_P_8021Q;
+}
+
+} // anonymous namespace
+
+RingSniffer::RingSniffer(const string& device)
+: fd_(-1), ring_(0), ring_size_(0), block_size_(0), block_count_(0), current_block_(0),
+  current_frame_(0), frames_left_(0), block_in_use_(false), timeout_(0),
+  link_type_(PDU::ETHERNET_II), stop_(false), arena_(0),
+  zero_copy_payloads_(false), max_decode_layer_(PacketDecoder::ALL_LAYERS) {
+    init(device, RingSnifferConfiguration());
+}
+
+RingSniffer::RingSniffer(const string& device,
+                         const RingSnifferConfiguration& configuration)
+: fd_(-1), ring_(0), ring_size_(0), block_size_(0), block_count_(0), current_block_(0),
+  current_frame_(0), frames_left_(0), block_in_use_(false), timeout_(0),
+  link_type_(PDU::ETHERNET_II), stop_(false), arena_(0),
+  zero_copy_payloads_(false), max_decode_layer_(PacketDecoder::ALL_LAYERS) {
+    init(device, configuration);
+}
+
+RingSniffer::~RingSniffer() {
+    cleanup();
+}
+
+void RingSniffer::init(const string& device,
+                       const RingSnifferConfiguration& configuration) {
+    #ifndef TINS_HAVE_PCAP
+        if (!configuration.filter_.empty()) {
+            throw feature_disabled();
+        }
+    #endif // TINS_HAVE_PCAP
+    const NetworkInterface iface(device);
+    block_size_ = configuration.block_size_;
+    block_count_ = configuration.block_count_;
+    timeout_ = static_cast<int>(configuration.timeout_);
+    // Don't bind to any protocol until the ring and filter are set up,
+    // otherwise we'd capture packets from every interface in the meantime
+    fd_ = socket(AF_PACKET, SOCK_RAW, 0);
+    if (fd_ == -1) {
+        throw socket_open_error(ring_error_string("Failed to open socket"));
+    }
+    try {
+        ifreq request;
+        memset(&request, 0, sizeof(request));
+        strncpy(request.ifr_name, iface.name().c_str(), IFNAMSIZ - 1);
+        if (ioctl(fd_, SIOCGIFHWADDR, &request) == -1) {
+            throw socket_open_error(ring_error_string("Failed to get hardware type"));
+        }
+        link_type_ = link_type_from_hardware_type(request.ifr_hwaddr.sa_family);
+
+        int version = TPACKET_V3;
+        if (setsockopt(fd_, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) == -1) {
+            throw socket_open_error(ring_error_string("Failed to set TPACKET_V3"));
+        }
+
+        // Leave room in front of each frame to put VLAN tags back
+        int reserve = vlan_tag_size;
+        if (setsockopt(fd_, SOL_PACKET, PACKET_RESERVE, &reserve, sizeof(reserve)) == -1) {
+            throw socket_open_error(ring_error_string("Failed to reserve frame headroom"));
+        }
+
+        tpacket_req3 ring_request;
+        memset(&ring_request, 0, sizeof(ring_request));
+        ring_request.tp_block_size = block_size_;
+        ring_request.tp_block_nr = block_count_;
+        ring_request.tp_frame_size = configuration.frame_size_;
+        ring_request.tp_frame_nr = (block_size_ / configuration.frame_size_) * block_count_;
+        ring_request.tp_retire_blk_tov = configuration.block_timeout_;
+        ring_request.tp_feature_req_word = TP_FT_REQ_FILL_RXHASH;
+        if (setsockopt(fd_, SOL_PACKET, PACKET_RX_RING, &ring_request,
+                       sizeof(ring_request)) == -1) {
+            throw socket_open_error(ring_error_string("Failed to set up RX ring"));
+        }
+
+        ring_size_ = static_cast<size_t>(block_size_) * block_count_;
+        void* ring = mmap(0, ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (ring == MAP_FAILED) {
+            ring_size_ = 0;
+            throw socket_open_error(ring_error_string("Failed to map RX ring"));
+        }
+        ring_ = static_cast<uint8_t*>(ring);
+
+        #ifdef TINS_HAVE_PCAP
+            if (!configuration.filter_.empty()) {
+                attach_filter(fd_, configuration.filter_);
+            }
+        #endif // TINS_HAVE_PCAP
+
+        sockaddr_ll address;
+        memset(&address, 0, sizeof(address));
+        address.sll_family = AF_PACKET;
+        address.sll_protocol = htons(ETH_P_ALL);
+        address.sll_ifindex = iface.id();
+        if (bind(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == -1) {
+            throw socket_open_error(ring_error_string("Failed to bind socket"));
+        }
+
+        if (configuration.promisc_) {
+            packet_mreq membership;
+            memset(&membership, 0, sizeof(membership));
+            membership.mr_ifindex = iface.id();
+            membership.mr_type = PACKET_MR_PROMISC;
+            if (setsockopt(fd_, SOL_PACKET, PACKET_ADD_MEMBERSHIP, &membership,
+                           sizeof(membership)) == -1) {
+                throw socket_open_error(ring_error_string("Failed to set promisc mode"));
+            }
+        }
+
+        // This has to be done after binding, as the group is tied to the interface
+        if (configuration.fanout_enabled_) {
+            const int type = fanout_type(configuration.fanout_mode_);
+            if (configuration.fanout_new_group_) {
+                create_fanout_group(fd_, type);
+            }
+            else if (!join_fanout_group(fd_, configuration.fanout_group_id_, type)) {
+                throw socket_open_error(ring_error_string("Failed to join fanout group"));
+            }
+        }
+
+        if (configuration.arena_allocation_) {
+            arena_ = new PacketArena();
+        }
+        zero_copy_payloads_ = configuration.zero_copy_payloads_;
+        max_decode_layer_ = configuration.max_decode_layer_;
+    }
+    catch (...) {
+        cleanup();
+        throw;
+    }
+}
+
+void RingSniffer::cleanup() {
+    delete arena_;
+    arena_ = 0;
+    if (ring_) {
+        munmap(ring_, ring_size_);
+        ring_ = 0;
+    }
+    if (fd_ != -1) {
+        close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool RingSniffer::wait_for_block(bool stop_on_timeout) {
+    tpacket_block_desc* block = reinterpret_cast<tpacket_block_desc*>(
+        ring_ + static_cast<size_t>(current_block_) * block_size_
+    );
+    while (true) {
+        // This is checked even if the block is ready, otherwise a busy ring
+        // could never be stopped
+        if (stop_.exchange(false)) {
+            return false;
+        }
+        if ((block->hdr.bh1.block_status & TP_STATUS_USER) != 0) {
+            break;
+        }
+        pollfd descriptor;
+        descriptor.fd = fd_;
+        descriptor.events = POLLIN | POLLERR;
+        descriptor.revents = 0;
+        const int result = poll(&descriptor, 1, timeout_);
+        if (result == 0 && stop_on_timeout) {
+            return false;
+        }
+        if (result == -1 && errno != EINTR) {
+            return false;
+        }
+    }
+    // Make sure we don't read the block's contents before its status
+    std::atomic_thread_fence(std::memory_order_acquire);
+    block_in_use_ = true;
+    frames_left_ = block->hdr.bh1.num_pkts;
+    current_frame_ = reinterpret_cast<uint8_t*>(block) + block->hdr.bh1.offset_to_first_pkt;
+    return true;
+}
+
+void RingSniffer::release_block() {
+    tpacket_block_desc* block = reinterpret_cast<tpacket_block_desc*>(
+        ring_ + static_cast<size_t>(current_block_) * block_size_
+    );
+    // We're done reading this block, make sure that happens before the
+    // kernel is allowed to overwrite it
+    std::atomic_thread_fence(std::memory_order_release);
+    block->hdr.bh1.block_status = TP_STATUS_KERNEL;
+    block_in_use_ = false;
+    current_block_ = (current_block_ + 1) % block_count_;
+}
+
+bool RingSniffer::next_frame(frame& output) {
+    return read_frame(output, true);
+}
+
+bool RingSniffer::read_frame(frame& output, bool stop_on_timeout) {
+    while (frames_left_ == 0) {
+        if (block_in_use_) {
+            release_block();
+        }
+        if (!wait_for_block(stop_on_timeout)) {
+            return false;
+        }
+    }
+    tpacket3_hdr* header = reinterpret_cast<tpacket3_hdr*>(current_frame_);
+    uint8_t* data = current_frame_ + header->tp_mac;
+    output.size = header->tp_snaplen;
+    output.length = header->tp_len;
+    // Put the VLAN tag back in place, just like libpcap does. There's room
+    // for it in front of the frame since we asked for it using PACKET_RESERVE
+    if (link_type_ == PDU::ETHERNET_II && has_vlan_tag(*header) &&
+        output.size >= vlan_tag_offset) {
+        data -= vlan_tag_size;
+        memmove(data, data + vlan_tag_size, vlan_tag_offset);
+        const uint16_t tag[] = {
+            Endian::host_to_be(vlan_tag_protocol(*header)),
+            Endian::host_to_be(static_cast<uint16_t>(header->hv1.tp_vlan_tci))
+        };
+        memcpy(data + vlan_tag_offset, tag, sizeof(tag));
+        output.size += vlan_tag_size;
+        output.length += vlan_tag_size;
+    }
+    output.data = data;
+    output.timestamp_ns = static_cast<uint64_t>(header->tp_sec) * 1000000000 +
+                          header->tp_nsec;
+    timeval tv;
+    tv.tv_sec = header->tp_sec;
+    tv.tv_usec = header->tp_nsec / 1000;
+    output.timestamp = Timestamp(tv);
+    current_frame_ += header->tp_next_offset;
+    frames_left_--;
+    return true;
+}
+
+Packet RingSniffer::next_packet() {
+    frame current;
+    while (next_frame(current)) {
+        if (PDU* pdu = decode(current.data, current.size)) {
+            return Packet(pdu, current.timestamp, Packet::own_pdu());
+        }
+    }
+    return Packet();
+}
+
+bool RingSniffer::next_packets(vector<Packet>& batch, uint32_t max_packets) {
+    batch.clear();
+    frame current;
+    if (!next_frame(current)) {
+        return false;
+    }
+    while (true) {
+        if (PDU* pdu = decode(current.data, current.size)) {
+            batch.push_back(Packet(pdu, current.timestamp, Packet::own_pdu()));
+        }
+        // Only keep going while there's frames in this block
+        if ((max_packets != 0 && batch.size() >= max_packets) || frames_left_ == 0) {
+            break;
+        }
+        next_frame(current);
+    }
+    return true;
+}
+
+bool RingSniffer::next_packet(LazyPacket& packet) {
+    frame current;
+    if (!next_frame(current)) {
+        return false;
+    }
+    packet.assign(link_type_, current.data, current.size, current.timestamp);
+    packet.set_max_decode_layer(max_decode_layer_);
+    return true;
+}
+
+void RingSniffer::stop_sniff() {
+    stop_ = true;
+}
+
+int RingSniffer::get_fd() const {
+    return fd_;
+}
+
+PDU::PDUType RingSniffer::link_type() const {
+    return link_type_;
+}
+
+uint16_t RingSniffer::fanout_group_id() const {
+    int fanout = 0;
+    socklen_t length = sizeof(fanout);
+    if (getsockopt(fd_, SOL_PACKET, PACKET_FANOUT, &fanout, &length) == -1) {
+        throw socket_open_error(ring_error_string("Failed to get fanout group"));
+    }
+    // The mode and flags are stored in the upper bits
+    return static_cast<uint16_t>(fanout & 0xffff);
+}
+
+PDU* RingSniffer::decode(const uint8_t* buffer, uint32_t size) const {
+    RawPDU::zero_copy_scope zero_copy(zero_copy_payloads_);
+    PacketDecoder::depth_scope depth(max_decode_layer_);
+    return PacketDecoder::decode(link_type_, buffer, size, arena_);
+}
+
+} // Tins
+
+#endif // TINS_HAVE_TPACKET_V3
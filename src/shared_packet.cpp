@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/shared_packet.h>
+
+#ifdef TINS_HAVE_CXX11
+
+#include <tins/rawpdu.h>
+
+namespace Tins {
+
+struct SharedPacket::state {
+    state(const Timestamp& timestamp)
+    : refcount(1), pdu(0), ts(timestamp) {
+
+    }
+
+    ~state() {
+        delete pdu;
+    }
+
+    std::atomic<size_t> refcount;
+    LazyPacket lazy;
+    PDU* pdu;
+    Timestamp ts;
+    std::once_flag decoded;
+};
+
+namespace {
+
+// Borrowed payloads point into the packet's buffer, which may be reused,
+// so they have to be copied before the chain is shared
+void own_payloads(PDU* pdu) {
+    for (PDU* current = pdu; current; current = current->inner_pdu()) {
+        if (current->pdu_type() == PDU::RAW) {
+            static_cast<RawPDU*>(current)->own_payload();
+        }
+    }
+}
+
+} // anonymous namespace
+
+SharedPacket::SharedPacket()
+: state_(0) {
+
+}
+
+SharedPacket::SharedPacket(Packet&& packet)
+: state_(make_state(packet.timestamp())) {
+    state_->pdu = packet.release_pdu();
+    own_payloads(state_->pdu);
+}
+
+SharedPacket::SharedPacket(PDU* pdu, const Timestamp& timestamp)
+: state_(make_state(timestamp)) {
+    state_->pdu = pdu;
+    own_payloads(state_->pdu);
+}
+
+SharedPacket::SharedPacket(LazyPacket&& packet)
+: state_(make_state(packet.timestamp())) {
+    state_->lazy = std::move(packet);
+}
+
+SharedPacket::SharedPacket(PDU::PDUType link_type, const uint8_t* buffer, uint32_t size,
+                           const Timestamp& timestamp)
+: state_(make_state(timestamp)) {
+    state_->lazy.assign(link_type, buffer, size, timestamp);
+}
+
+SharedPacket::SharedPacket(const SharedPacket& rhs)
+: state_(rhs.state_) {
+    if (state_) {
+        state_->refcount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+SharedPacket& SharedPacket::operator=(const SharedPacket& rhs) {
+    state* other = rhs.state_;
+    if (other) {
+        other->refcount.fetch_add(1, std::memory_order_relaxed);
+    }
+    release();
+    state_ = other;
+    return *this;
+}
+
+SharedPacket::SharedPacket(SharedPacket&& rhs) TINS_NOEXCEPT
+: state_(rhs.state_) {
+    rhs.state_ = 0;
+}
+
+SharedPacket& SharedPacket::operator=(SharedPacket&& rhs) TINS_NOEXCEPT {
+    if (this != &rhs) {
+        release();
+        state_ = rhs.state_;
+        rhs.state_ = 0;
+    }
+    return *this;
+}
+
+SharedPacket::~SharedPacket() {
+    release();
+}
+
+const PDU* SharedPacket::pdu() const {
+    if (!state_) {
+        return 0;
+    }
+    state* current = state_;
+    std::call_once(current->decoded, [current]() {
+        if (!current->pdu) {
+            current->pdu = current->lazy.release_pdu();
+            own_payloads(current->pdu);
+        }
+    });
+    return current->pdu;
+}
+
+const Timestamp& SharedPacket::timestamp() const {
+    static const Timestamp empty;
+    return state_ ? state_->ts : empty;
+}
+
+const uint8_t* SharedPacket::data() const {
+    return state_ ? state_->lazy.data() : 0;
+}
+
+uint32_t SharedPacket::size() const {
+    return state_ ? state_->lazy.size() : 0;
+}
+
+size_t SharedPacket::use_count() const {
+    return state_ ? state_->refcount.load(std::memory_order_relaxed) : 0;
+}
+
+Packet SharedPacket::to_packet() const {
+    const PDU* chain = pdu();
+    return chain ? Packet(chain, timestamp()) : Packet();
+}
+
+SharedPacket::state* SharedPacket::make_state(const Timestamp& timestamp) {
+    return new state(timestamp);
+}
+
+void SharedPacket::release() {
+    if (state_ && state_->refcount.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete state_;
+    }
+    state_ = 0;
+}
+
+} // Tins
+
+#endif // TINS_HAVE_CXX11
@@ -34,25 +34,17 @@
 #endif // _WIN32
 
 #include <tins/sniffer.h>
-#include <tins/dot11/dot11_base.h>
-#include <tins/ethernetII.h>
-#include <tins/radiotap.h>
-#include <tins/loopback.h>
 #include <tins/rawpdu.h>
-#include <tins/dot3.h>
-#include <tins/pktap.h>
-#include <tins/sll.h>
-#include <tins/ppi.h>
-#include <tins/ip.h>
-#include <tins/ipv6.h>
-#include <tins/detail/pdu_helpers.h>
+#include <tins/packet_decoder.h>
 
 using std::string;
+using std::vector;
 
 namespace Tins {
 
 BaseSniffer::BaseSniffer() 
-: handle_(0), mask_(0), extract_raw_(false) {
+: handle_(0), mask_(0), extract_raw_(false), arena_(0), zero_copy_payloads_(false),
+  max_decode_layer_(PacketDecoder::ALL_LAYERS) {
     
 }
     
@@ -60,6 +52,9 @@ BaseSniffer::~BaseSniffer() {
     if (handle_) {
         pcap_close(handle_);
     }
+    #ifdef TINS_HAVE_CXX11
+    delete arena_;
+    #endif // TINS_HAVE_CXX11
 }
 
 void BaseSniffer::set_pcap_handle(pcap_t* pcap_handle) {
@@ -85,144 +80,176 @@ bpf_u_int32 BaseSniffer::get_if_mask() const {
 struct sniff_data {
     struct timeval tv;
     PDU* pdu;
+    PDU::PDUType link_type;
+    PacketArena* arena;
     bool packet_processed;
 
-sniff_data() : tv(), pdu(0), packet_processed(true) { }
+sniff_data(PDU::PDUType link_type, PacketArena* arena)
+: tv(), pdu(0), link_type(link_type), arena(arena), packet_processed(true) { }
 };
 
-template<typename T>
-T* safe_alloc(const u_char* bytes, bpf_u_int32 len) {
-    try {
-        return new T((const uint8_t*)bytes, len);
+struct batch_sniff_data {
+    vector<Packet>* batch;
+    PDU::PDUType link_type;
+    PacketArena* arena;
+
+batch_sniff_data(vector<Packet>* batch, PDU::PDUType link_type, PacketArena* arena)
+: batch(batch), link_type(link_type), arena(arena) { }
+};
+
+struct lazy_sniff_data {
+    LazyPacket* packet;
+    PDU::PDUType link_type;
+    bool packet_processed;
+
+lazy_sniff_data(LazyPacket* packet, PDU::PDUType link_type)
+: packet(packet), link_type(link_type), packet_processed(false) { }
+};
+
+PDU::PDUType make_link_type(int iface_type, bool extract_raw) {
+    if (extract_raw) {
+        return PDU::RAW;
     }
-    catch (malformed_packet&) {
-        return 0;
+    switch (iface_type) {
+        case DLT_EN10MB:
+            return PDU::ETHERNET_II;
+        case DLT_NULL:
+            return PDU::LOOPBACK;
+        case DLT_LINUX_SLL:
+            return PDU::SLL;
+        case DLT_PPI:
+            return PDU::PPI;
+        case DLT_RAW:
+            return PDU::IP;
+
+        // Dot11 related protocols
+        #ifdef TINS_HAVE_DOT11
+        case DLT_IEEE802_11_RADIO:
+            return PDU::RADIOTAP;
+        case DLT_IEEE802_11:
+            return PDU::DOT11;
+        #else
+        case DLT_IEEE802_11_RADIO:
+        case DLT_IEEE802_11:
+            throw protocol_disabled();
+        #endif // TINS_HAVE_DOT11
+
+        #ifdef DLT_PKTAP
+        case DLT_PKTAP:
+            return PDU::PKTAP;
+        #endif // DLT_PKTAP
+
+        default:
+            throw unknown_link_type();
     }
 }
 
-template<typename T>
 void sniff_loop_handler(u_char* user, const struct pcap_pkthdr* h, const u_char* bytes) {
     sniff_data* data = (sniff_data*)user;
     data->packet_processed = true;
     data->tv = h->ts;
-    data->pdu = safe_alloc<T>(bytes, h->caplen);
+    data->pdu = PacketDecoder::decode(data->link_type, (const uint8_t*)bytes, h->caplen,
+                                      data->arena);
 }
 
-void sniff_loop_eth_handler(u_char* user, const struct pcap_pkthdr* h, const u_char* bytes) {
-    sniff_data* data = (sniff_data*)user;
-    data->packet_processed = true;
-    data->tv = h->ts;
-    if (Internals::is_dot3((const uint8_t*)bytes, h->caplen)) {
-        data->pdu = safe_alloc<Dot3>((const uint8_t*)bytes, h->caplen);
-    }
-    else {
-        data->pdu = safe_alloc<EthernetII>((const uint8_t*)bytes, h->caplen);
+void batch_sniff_handler(u_char* user, const struct pcap_pkthdr* h, const u_char* bytes) {
+    batch_sniff_data* data = (batch_sniff_data*)user;
+    PDU* pdu = PacketDecoder::decode(data->link_type, (const uint8_t*)bytes, h->caplen,
+                                     data->arena);
+    // Malformed packets are skipped, just like BaseSniffer::next_packet does
+    if (pdu) {
+        data->batch->push_back(Packet(pdu, h->ts, Packet::own_pdu()));
     }
 }
 
-void sniff_loop_raw_handler(u_char* user, const struct pcap_pkthdr* h, const u_char* bytes) {
-    TINS_BEGIN_PACK
-    struct base_ip_header {
-    #if TINS_IS_LITTLE_ENDIAN
-        uint8_t ihl:4,
-                version:4;
-    #else
-        uint8_t version:4,
-                ihl:4;
-    #endif
-    } TINS_END_PACK;
-
-    sniff_data* data = (sniff_data*)user;
-    const base_ip_header* header = (const base_ip_header*)bytes;
-    data->packet_processed = true;
-    data->tv = h->ts;
-    switch (header->version) {
-        case 4:
-            data->pdu = safe_alloc<IP>((const uint8_t*)bytes, h->caplen);
-            break;
-        case 6:
-            data->pdu = safe_alloc<IPv6>((const uint8_t*)bytes, h->caplen);
-            break;
-    };
-}
-
-#ifdef TINS_HAVE_DOT11
-void sniff_loop_dot11_handler(u_char* user, const struct pcap_pkthdr* h, const u_char* bytes) {
-    sniff_data* data = (sniff_data*)user;
+void lazy_sniff_handler(u_char* user, const struct pcap_pkthdr* h, const u_char* bytes) {
+    lazy_sniff_data* data = (lazy_sniff_data*)user;
     data->packet_processed = true;
-    data->tv = h->ts;
-    try {
-        data->pdu = Dot11::from_bytes(bytes, h->caplen);
-    }
-    catch(malformed_packet&) {
-        
-    }
+    data->packet->assign(data->link_type, (const uint8_t*)bytes, h->caplen, h->ts);
 }
-#endif
 
 PtrPacket BaseSniffer::next_packet() {
-    sniff_data data;
-    const int iface_type = pcap_datalink(handle_);
-    pcap_handler handler = 0;
-    if (extract_raw_) {
-        handler = &sniff_loop_handler<RawPDU>;
-    }
-    else {
-        switch (iface_type) {
-            case DLT_EN10MB:
-                handler = &sniff_loop_eth_handler;
-                break;
-            case DLT_NULL:
-                handler = &sniff_loop_handler<Tins::Loopback>;
-                break;
-            case DLT_LINUX_SLL:
-                handler = &sniff_loop_handler<SLL>;
-                break; 
-            case DLT_PPI:
-                handler = &sniff_loop_handler<PPI>;
-                break;
-            case DLT_RAW:
-                handler = &sniff_loop_raw_handler;
-                break;
-
-            // Dot11 related protocols
-            #ifdef TINS_HAVE_DOT11
-            case DLT_IEEE802_11_RADIO:
-                handler = &sniff_loop_handler<RadioTap>;
-                break;
-            case DLT_IEEE802_11:
-                handler = &sniff_loop_dot11_handler;
-                break;
-            #else
-            case DLT_IEEE802_11_RADIO:
-            case DLT_IEEE802_11:
-                throw protocol_disabled();
-            #endif // TINS_HAVE_DOT11
-
-            #ifdef DLT_PKTAP
-            case DLT_PKTAP:
-                handler = &sniff_loop_handler<PKTAP>;
-                break;
-            #endif // DLT_PKTAP
-
-            default:
-                throw unknown_link_type();
-        }
-    }
+    sniff_data data(make_link_type(pcap_datalink(handle_), extract_raw_), arena_);
+    #ifdef TINS_HAVE_CXX11
+    RawPDU::zero_copy_scope zero_copy(zero_copy_payloads_);
+    PacketDecoder::depth_scope depth(max_decode_layer_);
+    #endif // TINS_HAVE_CXX11
     // keep calling pcap_loop until a well-formed packet is found.
     while (data.pdu == 0 && data.packet_processed) {
         data.packet_processed = false;
-        if (pcap_sniffing_method_(handle_, 1, handler, (u_char*)&data) < 0) {
+        if (pcap_sniffing_method_(handle_, 1, &sniff_loop_handler, (u_char*)&data) < 0) {
             return PtrPacket(0, Timestamp());
         }
     }
     return PtrPacket(data.pdu, data.tv);
 }
 
+bool BaseSniffer::next_packets(vector<Packet>& batch, uint32_t max_packets) {
+    batch.clear();
+    // The link type is resolved once for the whole batch
+    batch_sniff_data data(&batch, make_link_type(pcap_datalink(handle_), extract_raw_), arena_);
+    #ifdef TINS_HAVE_CXX11
+    // Zero copy isn't used here: libpcap reuses its buffer for every record
+    // in a savefile and hands TPACKET_V3 blocks back to the kernel in the 
+    // middle of a dispatch, so earlier packets in the batch would dangle
+    PacketDecoder::depth_scope depth(max_decode_layer_);
+    #endif // TINS_HAVE_CXX11
+    const int count = max_packets == 0 ? -1 : static_cast<int>(max_packets);
+    const int result = pcap_dispatch(handle_, count, &batch_sniff_handler, (u_char*)&data);
+    if (result < 0) {
+        return false;
+    }
+    // On savefiles, reading 0 packets means we've reached the end of the file
+    return result > 0 || pcap_file(handle_) == 0;
+}
+
+bool BaseSniffer::next_packet(LazyPacket& packet) {
+    lazy_sniff_data data(&packet, make_link_type(pcap_datalink(handle_), extract_raw_));
+    packet.set_max_decode_layer(max_decode_layer_);
+    if (pcap_sniffing_method_(handle_, 1, &lazy_sniff_handler, (u_char*)&data) < 0) {
+        return false;
+    }
+    return data.packet_processed;
+}
+
 void BaseSniffer::set_extract_raw_pdus(bool value) {
     extract_raw_ = value;
 }
 
+void BaseSniffer::set_arena_allocation(bool value) {
+    #ifdef TINS_HAVE_CXX11
+        if (value && !arena_) {
+            arena_ = new PacketArena();
+        }
+        else if (!value) {
+            delete arena_;
+            arena_ = 0;
+        }
+    #else
+        if (value) {
+            throw feature_disabled();
+        }
+    #endif // TINS_HAVE_CXX11
+}
+
+void BaseSniffer::set_zero_copy_payloads(bool value) {
+    #ifndef TINS_HAVE_CXX11
+        if (value) {
+            throw feature_disabled();
+        }
+    #endif // TINS_HAVE_CXX11
+    zero_copy_payloads_ = value;
+}
+
+void BaseSniffer::set_max_decode_layer(PacketDecoder::Layer layer) {
+    #ifndef TINS_HAVE_CXX11
+        if (layer != PacketDecoder::ALL_LAYERS) {
+            throw feature_disabled();
+        }
+    #endif // TINS_HAVE_CXX11
+    max_decode_layer_ = layer;
+}
+
 void BaseSniffer::set_pcap_sniffing_method(PcapSniffingMethod method) {
     if (method == 0) {
         throw std::runtime_error("Sniffing method cannot be null");
@@ -268,6 +295,13 @@ void BaseSniffer::set_timeout(int ms) {
     pcap_set_timeout(handle_, ms);
 }
 
+void BaseSniffer::set_non_blocking(bool value) {
+    char error[PCAP_ERRBUF_SIZE];
+    if (pcap_setnonblock(handle_, value ? 1 : 0, error) == -1) {
+        throw pcap_error(error);
+    }
+}
+
 bool BaseSniffer::set_direction(pcap_direction_t d) {
 	bool result = pcap_setdirection(handle_, d) != -1;
 	return result;
@@ -429,7 +463,7 @@ SnifferConfiguration::SnifferConfiguration()
 : flags_(0), snap_len_(DEFAULT_SNAP_LEN), buffer_size_(0),
   pcap_sniffing_method_(pcap_loop), timeout_(DEFAULT_TIMEOUT), promisc_(false),
   rfmon_(false), immediate_mode_(false), direction_(PCAP_D_INOUT),
-  timestamp_precision_(0) {
+  timestamp_precision_(0), max_decode_layer_(PacketDecoder::ALL_LAYERS) {
 
 }
 
@@ -452,6 +486,9 @@ void SnifferConfiguration::configure_sniffer_pre_activation(Sniffer& sniffer) co
     if ((flags_ & TIMESTAMP_PRECISION) != 0) {
         sniffer.set_timestamp_precision(timestamp_precision_);
     }
+    if ((flags_ & MAX_DECODE_LAYER) != 0) {
+        sniffer.set_max_decode_layer(max_decode_layer_);
+    }
 }
 
 void SnifferConfiguration::configure_sniffer_pre_activation(FileSniffer& sniffer) const {
@@ -461,6 +498,9 @@ void SnifferConfiguration::configure_sniffer_pre_activation(FileSniffer& sniffer
         }
     }
     sniffer.set_pcap_sniffing_method(pcap_sniffing_method_);
+    if ((flags_ & MAX_DECODE_LAYER) != 0) {
+        sniffer.set_max_decode_layer(max_decode_layer_);
+    }
 }
 
 void SnifferConfiguration::configure_sniffer_post_activation(Sniffer& sniffer) const {
@@ -527,4 +567,9 @@ void SnifferConfiguration::set_direction(pcap_direction_t direction) {
     flags_ |= DIRECTION;
 }
 
+void SnifferConfiguration::set_max_decode_layer(PacketDecoder::Layer layer) {
+    flags_ |= MAX_DECODE_LAYER;
+    max_decode_layer_ = layer;
+}
+
 } // Tins
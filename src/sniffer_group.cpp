@@ -0,0 +1,139 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/sniffer_group.h>
+
+#ifdef TINS_HAVE_TPACKET_V3
+
+#include <thread>
+#include <mutex>
+#include <exception>
+
+using std::string;
+using std::vector;
+using std::thread;
+using std::mutex;
+using std::lock_guard;
+using std::exception_ptr;
+
+namespace Tins {
+
+SnifferGroup::SnifferGroup(const string& device, size_type size,
+                           RingSnifferConfiguration::FanoutMode mode,
+                           const RingSnifferConfiguration& configuration) {
+    RingSnifferConfiguration member_configuration = configuration;
+    try {
+        // The first member creates the group and the rest join it
+        member_configuration.set_fanout(mode);
+        for (size_type i = 0; i < size; ++i) {
+            sniffers_.push_back(new RingSniffer(device, member_configuration));
+            if (i == 0) {
+                member_configuration.set_fanout(sniffers_[0]->fanout_group_id(), mode);
+            }
+        }
+    }
+    catch (...) {
+        cleanup();
+        throw;
+    }
+}
+
+SnifferGroup::~SnifferGroup() {
+    cleanup();
+}
+
+SnifferGroup::size_type SnifferGroup::size() const {
+    return sniffers_.size();
+}
+
+RingSniffer& SnifferGroup::sniffer(size_type index) {
+    return *sniffers_[index];
+}
+
+void SnifferGroup::stop_sniff() {
+    for (size_type i = 0; i < sniffers_.size(); ++i) {
+        sniffers_[i]->stop_sniff();
+    }
+}
+
+void SnifferGroup::run_workers(const vector<worker_type>& workers) {
+    // A member whose loop had already finished when SnifferGroup::stop_sniff
+    // was last called would otherwise stop right away
+    for (size_type i = 0; i < sniffers_.size(); ++i) {
+        sniffers_[i]->stop_ = false;
+    }
+    vector<thread> threads;
+    // Moving a thread into the vector can't throw once it's reserved
+    threads.reserve(workers.size());
+    mutex error_mutex;
+    exception_ptr error;
+    try {
+        for (size_type i = 0; i < workers.size(); ++i) {
+            const worker_type& worker = workers[i];
+            threads.push_back(thread([&, worker]() {
+                try {
+                    worker();
+                }
+                catch (...) {
+                    lock_guard<mutex> _(error_mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    stop_sniff();
+                }
+            }));
+        }
+    }
+    catch (...) {
+        // Destroying a joinable thread terminates, so stop and join the
+        // ones that were already started
+        stop_sniff();
+        for (size_type i = 0; i < threads.size(); ++i) {
+            threads[i].join();
+        }
+        throw;
+    }
+    for (size_type i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void SnifferGroup::cleanup() {
+    for (size_type i = 0; i < sniffers_.size(); ++i) {
+        delete sniffers_[i];
+    }
+    sniffers_.clear();
+}
+
+} // Tins
+
+#endif // TINS_HAVE_TPACKET_V3
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/sniffer_reactor.h>
+
+#ifdef TINS_HAVE_EPOLL
+
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <tins/exceptions.h>
+#ifdef TINS_HAVE_PCAP
+    #include <tins/sniffer.h>
+#endif // TINS_HAVE_PCAP
+
+using std::string;
+using std::vector;
+using std::shared_ptr;
+using std::make_shared;
+
+namespace Tins {
+namespace {
+
+// The wakeup descriptor always uses this handle
+const SnifferReactor::handle_type WAKEUP_HANDLE = 0;
+const int MAX_EVENTS = 64;
+// Batches read from a sniffer each time it's ready, so a busy one can't
+// starve the rest of the sources
+const int MAX_BATCHES_PER_EVENT = 16;
+
+string reactor_error_string(const string& message) {
+    return message + ": " + strerror(errno);
+}
+
+} // anonymous namespace
+
+const uint32_t SnifferReactor::DEFAULT_BATCH_SIZE = 64;
+
+SnifferReactor::SnifferReactor()
+: next_handle_(WAKEUP_HANDLE + 1), epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+  wakeup_fd_(-1), stopped_(false) {
+    if (epoll_fd_ == -1) {
+        throw event_loop_error(reactor_error_string("Failed to create epoll instance"));
+    }
+    wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeup_fd_ == -1) {
+        close(epoll_fd_);
+        throw event_loop_error(reactor_error_string("Failed to create eventfd"));
+    }
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u64 = WAKEUP_HANDLE;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, wakeup_fd_, &event) == -1) {
+        close(wakeup_fd_);
+        close(epoll_fd_);
+        throw event_loop_error(reactor_error_string("Failed to register eventfd"));
+    }
+}
+
+SnifferReactor::~SnifferReactor() {
+    for (sources_type::iterator iter = sources_.begin(); iter != sources_.end(); ++iter) {
+        if (iter->second->owns_fd) {
+            close(iter->second->fd);
+        }
+    }
+    close(wakeup_fd_);
+    close(epoll_fd_);
+}
+
+#ifdef TINS_HAVE_PCAP
+SnifferReactor::handle_type SnifferReactor::add_sniffer(BaseSniffer& sniffer,
+                                                        batch_callback_type callback,
+                                                        uint32_t batch_size) {
+    sniffer.set_non_blocking(true);
+    BaseSniffer* sniffer_ptr = &sniffer;
+    // The batch is kept around so its storage is reused
+    shared_ptr<vector<Packet> > batch = make_shared<vector<Packet> >();
+    return add_source(sniffer.get_fd(), false, [=]() {
+        // Descriptors are level triggered, so if there's anything left
+        // after the last batch the sniffer will be reported again
+        for (int i = 0; i < MAX_BATCHES_PER_EVENT; ++i) {
+            if (!sniffer_ptr->next_packets(*batch, batch_size)) {
+                return false;
+            }
+            if (batch->empty()) {
+                return true;
+            }
+            if (!callback(*batch)) {
+                return false;
+            }
+        }
+        return true;
+    });
+}
+#endif // TINS_HAVE_PCAP
+
+SnifferReactor::handle_type SnifferReactor::add_descriptor(int fd,
+                                                           descriptor_callback_type callback) {
+    return add_source(fd, false, [=]() {
+        return callback(fd);
+    });
+}
+
+SnifferReactor::handle_type SnifferReactor::add_timer(uint32_t interval,
+                                                      timer_callback_type callback) {
+    if (interval == 0) {
+        throw event_loop_error("Timer interval must be greater than zero");
+    }
+    const int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd == -1) {
+        throw event_loop_error(reactor_error_string("Failed to create timer"));
+    }
+    itimerspec spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.it_interval.tv_sec = interval / 1000;
+    spec.it_interval.tv_nsec = static_cast<long>(interval % 1000) * 1000000;
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(fd, 0, &spec, 0) == -1) {
+        close(fd);
+        throw event_loop_error(reactor_error_string("Failed to arm timer"));
+    }
+    try {
+        return add_source(fd, true, [=]() {
+            uint64_t expirations;
+            if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+                // Spurious wakeup
+                return true;
+            }
+            return callback();
+        });
+    }
+    catch (...) {
+        close(fd);
+        throw;
+    }
+}
+
+void SnifferReactor::remove(handle_type handle) {
+    sources_type::iterator iter = sources_.find(handle);
+    if (iter == sources_.end()) {
+        return;
+    }
+    release(*iter->second);
+    // If this source is being dispatched, run_once keeps it alive
+    sources_.erase(iter);
+}
+
+size_t SnifferReactor::size() const {
+    return sources_.size();
+}
+
+size_t SnifferReactor::run_once(int timeout) {
+    epoll_event events[MAX_EVENTS];
+    const int count = epoll_wait(epoll_fd_, events, MAX_EVENTS, timeout);
+    if (count == -1) {
+        if (errno == EINTR) {
+            return 0;
+        }
+        throw event_loop_error(reactor_error_string("Failed to wait for events"));
+    }
+    size_t executed = 0;
+    for (int i = 0; i < count; ++i) {
+        const handle_type handle = events[i].data.u64;
+        if (handle == WAKEUP_HANDLE) {
+            uint64_t value;
+            if (read(wakeup_fd_, &value, sizeof(value)) < 0) {
+                // Someone else already drained it
+            }
+            continue;
+        }
+        sources_type::iterator iter = sources_.find(handle);
+        // It may have been removed by a previous callback
+        if (iter == sources_.end()) {
+            continue;
+        }
+        shared_ptr<source> current = iter->second;
+        ++executed;
+        if (!current->callback()) {
+            remove(handle);
+        }
+    }
+    return executed;
+}
+
+void SnifferReactor::run() {
+    while (!stopped_ && !sources_.empty()) {
+        run_once();
+    }
+    stopped_ = false;
+}
+
+void SnifferReactor::stop() {
+    stopped_ = true;
+    const uint64_t value = 1;
+    if (write(wakeup_fd_, &value, sizeof(value)) < 0) {
+        // The counter is already non zero, so the reactor will wake up
+    }
+}
+
+SnifferReactor::handle_type SnifferReactor::add_source(int fd, bool owns_fd,
+                                                       ready_callback_type callback) {
+    const handle_type handle = next_handle_++;
+    epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.u64 = handle;
+    if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) == -1) {
+        throw event_loop_error(reactor_error_string("Failed to register descriptor"));
+    }
+    shared_ptr<source> new_source = make_shared<source>();
+    new_source->fd = fd;
+    new_source->owns_fd = owns_fd;
+    new_source->callback = callback;
+    sources_[handle] = new_source;
+    return handle;
+}
+
+void SnifferReactor::release(const source& current) {
+    epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, current.fd, 0);
+    if (current.owns_fd) {
+        close(current.fd);
+    }
+}
+
+} // Tins
+
+#endif // TINS_HAVE_EPOLL
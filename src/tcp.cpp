@@ -36,6 +36,7 @@
 #include <tins/exceptions.h>
 #include <tins/memory_helpers.h>
 #include <tins/utils/checksum_utils.h>
+#include <tins/detail/pdu_helpers.h>
 
 using std::vector;
 using std::pair;
@@ -47,12 +48,25 @@ namespace Tins {
 
 const uint16_t TCP::DEFAULT_WINDOW = 32678;
 
-PDU::metadata TCP::extract_metadata(const uint8_t *buffer, uint32_t total_sz) {
-    if (TINS_UNLIKELY(total_sz < sizeof(tcp_header))) {
+PDU::metadata TCP::extract_metadata(const uint8_t* buffer, uint32_t total_sz) {
+    metadata output;
+    if (TINS_UNLIKELY(!try_extract_metadata(buffer, total_sz, output))) {
         throw malformed_packet();
     }
+    return output;
+}
+
+bool TCP::try_extract_metadata(const uint8_t* buffer, uint32_t total_sz, metadata& output) {
+    if (TINS_UNLIKELY(total_sz < sizeof(tcp_header))) {
+        return false;
+    }
     const tcp_header* header = (const tcp_header*)buffer;
-    return metadata(header->doff * 4, pdu_flag, PDU::UNKNOWN);
+    const uint32_t header_size = header->doff * sizeof(uint32_t);
+    if (TINS_UNLIKELY(header_size < sizeof(tcp_header) || header_size > total_sz)) {
+        return false;
+    }
+    output = metadata(header_size, pdu_flag, PDU::UNKNOWN);
+    return true;
 }
 
 TCP::TCP(uint16_t dport, uint16_t sport) 
@@ -64,12 +78,13 @@ TCP::TCP(uint16_t dport, uint16_t sport)
 }
 
 TCP::TCP(const uint8_t* buffer, uint32_t total_sz) {
+    Internals::header_check header_check(buffer);
     InputMemoryStream stream(buffer, total_sz);
-    stream.read(header_);
     // Check that we have at least the amount of bytes we need and not less
-    if (TINS_UNLIKELY(data_offset() * sizeof(uint32_t) > total_sz || 
-                      data_offset() * sizeof(uint32_t) < sizeof(tcp_header))) {
-        throw malformed_packet();
+    if (!header_check.check(stream.try_read(header_) &&
+                            data_offset() * sizeof(uint32_t) <= total_sz &&
+                            data_offset() * sizeof(uint32_t) >= sizeof(tcp_header))) {
+        return;
     }
     const uint8_t* header_end = buffer + (data_offset() * sizeof(uint32_t));
 
@@ -118,7 +133,7 @@ TCP::TCP(const uint8_t* buffer, uint32_t total_sz) {
     }
     // If we still have any bytes left
     if (stream) {
-        inner_pdu(new RawPDU(stream.pointer(), stream.size()));
+        inner_pdu(Internals::decode_arena::allocate<RawPDU>(stream.pointer(), stream.size()));
     }
 }
 
@@ -41,71 +41,72 @@ namespace Tins {
 namespace TCPIP {
 
 DataTracker::DataTracker() 
-: seq_number_(0), total_buffered_bytes_(0) {
+: seq_number_(0), total_buffered_bytes_(0), kept_segment_bytes_(0), stream_offset_(0),
+  keep_segments_(false) {
 
 }
 
 DataTracker::DataTracker(uint32_t seq_number)
-: seq_number_(seq_number), total_buffered_bytes_(0) {
+: seq_number_(seq_number), total_buffered_bytes_(0), kept_segment_bytes_(0), stream_offset_(0),
+  keep_segments_(false) {
 
 }
 
 bool DataTracker::process_payload(uint32_t seq, payload_type payload) {
+    return process_payload(seq, move(payload), data_span_callback_type());
+}
+
+bool DataTracker::process_payload(uint32_t seq, const uint8_t* data, uint32_t size) {
+    return process_payload(seq, data, size, data_span_callback_type());
+}
+
+bool DataTracker::process_payload(uint32_t seq, payload_type payload,
+                                  const data_span_callback_type& callback) {
     const uint32_t chunk_end = seq + payload.size();
     // If the end of the chunk ends before current sequence number, ignore it.
     if (seq_compare(chunk_end, seq_number_) < 0) {
         return false;
     }
-    // If it starts before our sequence number, slice it
-    if (seq_compare(seq, seq_number_) < 0) {
-        const uint32_t diff = seq_number_ - seq;
-        payload.erase(
-            payload.begin(),
-            payload.begin() + diff
-        );
-        seq = seq_number_;
+    if (seq_compare(seq, seq_number_) > 0) {
+        store_payload(seq, move(payload));
+        return false;
     }
+    const uint32_t initial_seq = seq_number_;
+    // If it starts before our sequence number, skip the part we've already seen
+    const bool added_some = append_payload(payload, seq_number_ - seq, callback);
+    return process_buffered_payload(initial_seq, callback) || added_some;
+}
+
+bool DataTracker::process_payload(uint32_t seq, const uint8_t* data, uint32_t size,
+                                  const data_span_callback_type& callback) {
+    const uint32_t chunk_end = seq + size;
+    if (seq_compare(chunk_end, seq_number_) < 0) {
+        return false;
+    }
+    if (seq_compare(seq, seq_number_) > 0) {
+        store_payload(seq, payload_type(data, data + size));
+        return false;
+    }
+    const uint32_t initial_seq = seq_number_;
+    const uint32_t offset = seq_number_ - seq;
     bool added_some = false;
-    // Store this payload
-    store_payload(seq, move(payload));
-    // Keep looping while the fragments seq is lower or equal to our seq
-    buffered_payload_type::iterator iter = buffered_payload_.find(seq_number_);
-    while (iter != buffered_payload_.end() && seq_compare(iter->first, seq_number_) <= 0) {
-        // Does this fragment start before our sequence number?
-        if (seq_compare(iter->first, seq_number_) < 0) {
-            uint32_t fragment_end = iter->first + iter->second.size();
-            int comparison = seq_compare(fragment_end, seq_number_);
-            // Does it end after our sequence number? 
-            if (comparison > 0) {
-                // Then slice it
-                payload_type& payload = iter->second;
-                // First update this counter
-                total_buffered_bytes_ -= payload.size();
-                payload.erase(
-                    payload.begin(),
-                    payload.begin() + (seq_number_ - iter->first)
-                );
-                store_payload(seq_number_, move(iter->second));
-                iter = erase_iterator(iter);
-            }
-            else {
-                // Otherwise, we've seen this part of the payload. Erase it.
-                iter = erase_iterator(iter);
-            }
+    if (offset < size) {
+        if (callback) {
+            deliver_span(data + offset, size - offset, callback);
+        }
+        else if (keep_segments_) {
+            // The data isn't ours, so it has to be copied once
+            payload_type segment(data + offset, data + size);
+            append_payload(segment, 0, callback);
         }
         else {
-            // They're equal. Add this payload.
-            payload_.insert(
-                payload_.end(),
-                iter->second.begin(), 
-                iter->second.end()
-            );
-            seq_number_ += iter->second.size();
-            iter = erase_iterator(iter);
-            added_some = true;
+            payload_.insert(payload_.end(), data + offset, data + size);
+            seq_number_ += size - offset;
+            stream_offset_ += size - offset;
         }
+        added_some = true;
     }
-    return added_some;
+    return process_buffered_payload(initial_seq, callback) || added_some;
 }
 
 void DataTracker::advance_sequence(uint32_t seq) {
@@ -122,6 +123,7 @@ void DataTracker::advance_sequence(uint32_t seq) {
         }
     }
 
+    stream_offset_ += seq - seq_number_;
     seq_number_ = seq;
 }
 
@@ -153,6 +155,42 @@ uint32_t DataTracker::total_buffered_bytes() const {
     return total_buffered_bytes_;
 }
 
+uint64_t DataTracker::stream_offset() const {
+    return stream_offset_;
+}
+
+void DataTracker::keep_payload_segments(bool value) {
+    keep_segments_ = value;
+}
+
+DataTracker::payload_segments_type DataTracker::payload_segments() const {
+    payload_segments_type output;
+    output.reserve(kept_segments_.size() + 1);
+    if (!payload_.empty()) {
+        payload_segment segment = { &payload_[0], static_cast<uint32_t>(payload_.size()) };
+        output.push_back(segment);
+    }
+    for (size_t i = 0; i < kept_segments_.size(); ++i) {
+        const kept_segment& kept = kept_segments_[i];
+        payload_segment segment = {
+            &kept.data[kept.offset],
+            static_cast<uint32_t>(kept.data.size() - kept.offset)
+        };
+        output.push_back(segment);
+    }
+    return output;
+}
+
+uint32_t DataTracker::payload_size() const {
+    return static_cast<uint32_t>(payload_.size()) + kept_segment_bytes_;
+}
+
+void DataTracker::clear_payload() {
+    payload_.clear();
+    kept_segments_.clear();
+    kept_segment_bytes_ = 0;
+}
+
 void DataTracker::store_payload(uint32_t seq, payload_type payload) {
     buffered_payload_type::iterator iter = buffered_payload_.find(seq);
     // New segment, store it
@@ -169,10 +207,75 @@ void DataTracker::store_payload(uint32_t seq, payload_type payload) {
     }
 }
 
+bool DataTracker::append_payload(payload_type& payload, uint32_t offset,
+                                 const data_span_callback_type& callback) {
+    if (offset >= payload.size()) {
+        return false;
+    }
+    if (callback) {
+        deliver_span(&payload[offset], payload.size() - offset, callback);
+        return true;
+    }
+    seq_number_ += payload.size() - offset;
+    stream_offset_ += payload.size() - offset;
+    if (keep_segments_) {
+        // Only the offset is kept, so nothing is moved around
+        kept_segment_bytes_ += payload.size() - offset;
+        kept_segments_.push_back(kept_segment());
+        kept_segments_.back().data.swap(payload);
+        kept_segments_.back().offset = offset;
+    }
+    else if (payload_.empty() && offset == 0) {
+        // Nothing is pending, so just take over the segment's buffer
+        payload_.swap(payload);
+    }
+    else {
+        payload_.insert(payload_.end(), payload.begin() + offset, payload.end());
+    }
+    return true;
+}
+
+void DataTracker::deliver_span(const uint8_t* data, uint32_t size,
+                               const data_span_callback_type& callback) {
+    const uint64_t offset = stream_offset_;
+    seq_number_ += size;
+    stream_offset_ += size;
+    callback(data, size, offset);
+}
+
+bool DataTracker::process_buffered_payload(uint32_t initial_seq,
+                                           const data_span_callback_type& callback) {
+    bool added_some = false;
+    if (buffered_payload_.empty()) {
+        return added_some;
+    }
+    // Fragments are visited in sequence number order, starting from the
+    // sequence number we had before adding any data
+    buffered_payload_type::iterator iter = buffered_payload_.lower_bound(initial_seq);
+    if (iter == buffered_payload_.end()) {
+        iter = buffered_payload_.begin();
+    }
+    // Keep looping while the fragments seq is lower or equal to our seq
+    while (iter != buffered_payload_.end() && seq_compare(iter->first, seq_number_) <= 0) {
+        // Take the fragment out of the map before using it, so the map
+        // stays consistent even if a data span callback throws
+        const uint32_t offset = seq_number_ - iter->first;
+        payload_type fragment;
+        fragment.swap(iter->second);
+        total_buffered_bytes_ -= fragment.size();
+        iter = erase_iterator(iter);
+        // Fragments that start before our sequence number are sliced by 
+        // skipping what we've already seen, which may be all of it
+        if (append_payload(fragment, offset, callback)) {
+            added_some = true;
+        }
+    }
+    return added_some;
+}
+
 DataTracker::buffered_payload_type::iterator
 DataTracker::erase_iterator(buffered_payload_type::iterator iter) {
     buffered_payload_type::iterator output = iter;
-    total_buffered_bytes_ -= iter->second.size();
     ++output;
     buffered_payload_.erase(iter);
     if (output == buffered_payload_.end()) {
@@ -43,6 +43,7 @@
 #include <tins/memory_helpers.h>
 
 using std::make_pair;
+using std::move;
 using std::bind;
 using std::pair;
 using std::numeric_limits;
@@ -85,6 +86,10 @@ void Flow::out_of_order_callback(const flow_packet_callback_type& callback) {
     on_out_of_order_callback_ = callback;
 }
 
+void Flow::data_span_callback(const data_span_callback_type& callback) {
+    on_data_span_callback_ = callback;
+}
+
 void Flow::process_packet(PDU& pdu) {
     TCP* tcp = pdu.find_pdu<TCP>();
     RawPDU* raw = pdu.find_pdu<RawPDU>(); 
@@ -114,11 +119,37 @@ void Flow::process_packet(PDU& pdu) {
         }
     }
 
-    // can process either way, since it will abort immediately if not needed
-    if (data_tracker_.process_payload(tcp->seq(), move(raw->payload()))) {
-        if (on_data_callback_) {
-            on_data_callback_(*this);
+    if (on_data_span_callback_) {
+        const DataTracker::data_span_callback_type callback = 
+            [this](const uint8_t* data, size_t size, uint64_t offset) {
+                on_data_span_callback_(*this, data, size, offset);
+            };
+        // In order data is handed over straight from the segment, while out
+        // of order data is moved into the buffer
+        if (seq_compare(tcp->seq(), current_seq) > 0) {
+            data_tracker_.process_payload(tcp->seq(), move(raw->payload()), callback);
         }
+        else {
+            data_tracker_.process_payload(tcp->seq(), raw->payload_data(),
+                                          raw->payload_size(), callback);
+        }
+        return;
+    }
+
+    // can process either way, since it will abort immediately if not needed
+    bool has_new_data;
+    // Payloads owned by this packet are moved, so the tracker can take the
+    // vector over. Borrowed or shared ones are read through the pointer, 
+    // since taking them would copy them anyway
+    if (!raw->is_payload_borrowed() && !raw->is_payload_shared()) {
+        has_new_data = data_tracker_.process_payload(tcp->seq(), move(raw->payload()));
+    }
+    else {
+        has_new_data = data_tracker_.process_payload(tcp->seq(), raw->payload_data(),
+                                                     raw->payload_size());
+    }
+    if (has_new_data && on_data_callback_) {
+        on_data_callback_(*this);
     }
 }
 
@@ -221,6 +252,22 @@ Flow::payload_type& Flow::payload() {
     return data_tracker_.payload();
 }
 
+Flow::payload_segments_type Flow::payload_segments() const {
+    return data_tracker_.payload_segments();
+}
+
+uint32_t Flow::payload_size() const {
+    return data_tracker_.payload_size();
+}
+
+void Flow::clear_payload() {
+    data_tracker_.clear_payload();
+}
+
+void Flow::keep_payload_segments(bool value) {
+    data_tracker_.keep_payload_segments(value);
+}
+
 void Flow::state(State new_state) {
     state_ = new_state;
 }
@@ -0,0 +1,277 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/tcp_ip/flow_index.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <tins/packet_view.h>
+#include <tins/pcap_file_reader.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/endianness.h>
+#include <tins/exceptions.h>
+#include <tins/detail/mapped_file.h>
+
+using std::string;
+using std::vector;
+
+using Tins::Internals::MappedFile;
+
+namespace Tins {
+namespace TCPIP {
+namespace {
+
+// "FIDX", when read as a little endian integer
+const uint32_t INDEX_MAGIC = 0x58444946;
+const uint16_t INDEX_VERSION = 1;
+const uint32_t INDEX_HEADER_SIZE = 24;
+// Protocol, both addresses, both ports and padding
+const uint32_t KEY_SIZE = 40;
+const uint32_t FLOW_ENTRY_SIZE = KEY_SIZE + 16;
+
+template <typename T>
+T read_le(const uint8_t* ptr) {
+    T value;
+    memcpy(&value, ptr, sizeof(value));
+    return Endian::le_to_host(value);
+}
+
+template <typename T>
+void append_le(vector<uint8_t>& buffer, T value) {
+    value = Endian::host_to_le(value);
+    const uint8_t* ptr = reinterpret_cast<const uint8_t*>(&value);
+    buffer.insert(buffer.end(), ptr, ptr + sizeof(value));
+}
+
+// Keys are serialized so that comparing them using memcmp gives the same
+// order as the writer's map
+void serialize_key(uint8_t* output, uint8_t protocol, const StreamIdentifier& identifier) {
+    memset(output, 0, KEY_SIZE);
+    output[0] = protocol;
+    memcpy(output + 1, identifier.min_address.data(), identifier.min_address.size());
+    memcpy(output + 17, identifier.max_address.data(), identifier.max_address.size());
+    const uint16_t min_port = Endian::host_to_be(identifier.min_address_port);
+    const uint16_t max_port = Endian::host_to_be(identifier.max_address_port);
+    memcpy(output + 33, &min_port, sizeof(min_port));
+    memcpy(output + 35, &max_port, sizeof(max_port));
+}
+
+} // anonymous namespace
+
+// FlowIndex
+
+FlowIndex::FlowIndex(const string& file_name)
+: file_(new MappedFile(file_name)), flow_count_(0), offset_count_(0) {
+    const uint64_t file_size = file_->size();
+    if (file_size < INDEX_HEADER_SIZE ||
+        read_le<uint32_t>(file_->data()) != INDEX_MAGIC ||
+        read_le<uint16_t>(file_->data() + 4) != INDEX_VERSION) {
+        delete file_;
+        throw invalid_file_format();
+    }
+    flow_count_ = read_le<uint64_t>(file_->data() + 8);
+    offset_count_ = read_le<uint64_t>(file_->data() + 16);
+    const uint64_t available = file_size - INDEX_HEADER_SIZE;
+    if (flow_count_ > available / FLOW_ENTRY_SIZE ||
+        offset_count_ > (available - flow_count_ * FLOW_ENTRY_SIZE) / sizeof(uint64_t)) {
+        delete file_;
+        throw invalid_file_format();
+    }
+    file_->advise(MappedFile::RANDOM_ACCESS);
+}
+
+FlowIndex::~FlowIndex() {
+    delete file_;
+}
+
+void FlowIndex::build(const string& capture_file_name, const string& index_file_name) {
+    PcapFileReader reader(capture_file_name);
+    FlowIndexWriter writer;
+    PcapFileReader::record current;
+    uint64_t offset = reader.offset();
+    while (reader.next_record(current)) {
+        writer.add_record(reader.link_type(), current.data, current.size, offset);
+        offset = reader.offset();
+    }
+    writer.write(index_file_name);
+}
+
+FlowIndex::offsets_type FlowIndex::find(const StreamIdentifier& identifier,
+                                        Protocol protocol) const {
+    uint8_t key[KEY_SIZE];
+    serialize_key(key, protocol, identifier);
+    const uint8_t* flows = file_->data() + INDEX_HEADER_SIZE;
+    uint64_t low = 0;
+    uint64_t high = flow_count_;
+    while (low < high) {
+        const uint64_t middle = low + (high - low) / 2;
+        const uint8_t* entry = flows + middle * FLOW_ENTRY_SIZE;
+        const int result = memcmp(entry, key, KEY_SIZE);
+        if (result < 0) {
+            low = middle + 1;
+        }
+        else if (result > 0) {
+            high = middle;
+        }
+        else {
+            const uint64_t first = read_le<uint64_t>(entry + KEY_SIZE);
+            const uint64_t count = read_le<uint64_t>(entry + KEY_SIZE + 8);
+            if (first > offset_count_ || count > offset_count_ - first) {
+                throw invalid_file_format();
+            }
+            const uint8_t* offsets = flows + flow_count_ * FLOW_ENTRY_SIZE;
+            offsets_type output(count);
+            for (uint64_t i = 0; i < count; ++i) {
+                output[i] = read_le<uint64_t>(offsets + (first + i) * sizeof(uint64_t));
+            }
+            return output;
+        }
+    }
+    return offsets_type();
+}
+
+FlowIndex::offsets_type FlowIndex::find(const PDU& packet) const {
+    Protocol protocol;
+    if (packet.find_pdu<TCP>()) {
+        protocol = TCP_FLOW;
+    }
+    else if (packet.find_pdu<UDP>()) {
+        protocol = UDP_FLOW;
+    }
+    else {
+        return offsets_type();
+    }
+    try {
+        return find(StreamIdentifier::make_identifier(packet), protocol);
+    }
+    catch (invalid_packet&) {
+        return offsets_type();
+    }
+}
+
+uint64_t FlowIndex::size() const {
+    return flow_count_;
+}
+
+// FlowIndexWriter
+
+bool FlowIndexWriter::add_record(PDU::PDUType link_type, const uint8_t* data, uint32_t size,
+                                 uint64_t offset) {
+    PacketView view(link_type, data, size);
+    FlowIndex::Protocol protocol;
+    uint16_t sport;
+    uint16_t dport;
+    if (view.has_layer(PDU::TCP)) {
+        protocol = FlowIndex::TCP_FLOW;
+        sport = view.tcp().sport();
+        dport = view.tcp().dport();
+    }
+    else if (view.has_layer(PDU::UDP)) {
+        protocol = FlowIndex::UDP_FLOW;
+        sport = view.udp().sport();
+        dport = view.udp().dport();
+    }
+    else {
+        return false;
+    }
+    if (view.has_layer(PDU::IP)) {
+        const PacketView::ip_header ip = view.ip();
+        add_record(StreamIdentifier(StreamIdentifier::serialize(ip.src_addr()), sport,
+                                    StreamIdentifier::serialize(ip.dst_addr()), dport),
+                   protocol, offset);
+    }
+    else if (view.has_layer(PDU::IPv6)) {
+        const PacketView::ipv6_header ipv6 = view.ipv6();
+        add_record(StreamIdentifier(StreamIdentifier::serialize(ipv6.src_addr()), sport,
+                                    StreamIdentifier::serialize(ipv6.dst_addr()), dport),
+                   protocol, offset);
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+void FlowIndexWriter::add_record(const StreamIdentifier& identifier,
+                                 FlowIndex::Protocol protocol, uint64_t offset) {
+    flows_[key_type(static_cast<uint8_t>(protocol), identifier)].push_back(offset);
+}
+
+size_t FlowIndexWriter::size() const {
+    return flows_.size();
+}
+
+void FlowIndexWriter::write(const string& file_name) const {
+    vector<uint8_t> buffer;
+    uint64_t offset_count = 0;
+    for (flows_type::const_iterator iter = flows_.begin(); iter != flows_.end(); ++iter) {
+        offset_count += iter->second.size();
+    }
+    buffer.reserve(INDEX_HEADER_SIZE + flows_.size() * FLOW_ENTRY_SIZE +
+                   offset_count * sizeof(uint64_t));
+    append_le<uint32_t>(buffer, INDEX_MAGIC);
+    append_le<uint16_t>(buffer, INDEX_VERSION);
+    append_le<uint16_t>(buffer, 0);
+    append_le<uint64_t>(buffer, flows_.size());
+    append_le<uint64_t>(buffer, offset_count);
+    uint64_t first = 0;
+    for (flows_type::const_iterator iter = flows_.begin(); iter != flows_.end(); ++iter) {
+        uint8_t key[KEY_SIZE];
+        serialize_key(key, iter->first.first, iter->first.second);
+        buffer.insert(buffer.end(), key, key + KEY_SIZE);
+        append_le<uint64_t>(buffer, first);
+        append_le<uint64_t>(buffer, iter->second.size());
+        first += iter->second.size();
+    }
+    for (flows_type::const_iterator iter = flows_.begin(); iter != flows_.end(); ++iter) {
+        for (size_t i = 0; i < iter->second.size(); ++i) {
+            append_le<uint64_t>(buffer, iter->second[i]);
+        }
+    }
+    std::FILE* file = fopen(file_name.c_str(), "wb");
+    if (!file) {
+        throw file_open_error(file_name + ": " + strerror(errno));
+    }
+    const size_t written = fwrite(&buffer[0], 1, buffer.size(), file);
+    const bool failed = fclose(file) != 0 || written != buffer.size();
+    if (failed) {
+        throw file_write_error(strerror(errno));
+    }
+}
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/tcp_ip/memory_budget.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <limits>
+
+using std::memory_order_relaxed;
+using std::shared_ptr;
+using std::make_shared;
+using std::numeric_limits;
+
+namespace Tins {
+namespace TCPIP {
+
+MemoryBudget::MemoryBudget(uint64_t limit)
+: limit_(limit), usage_(0) {
+
+}
+
+shared_ptr<MemoryBudget> MemoryBudget::process_budget() {
+    static const shared_ptr<MemoryBudget> budget =
+        make_shared<MemoryBudget>(numeric_limits<uint64_t>::max());
+    return budget;
+}
+
+uint64_t MemoryBudget::limit() const {
+    return limit_.load(memory_order_relaxed);
+}
+
+void MemoryBudget::limit(uint64_t value) {
+    limit_.store(value, memory_order_relaxed);
+}
+
+uint64_t MemoryBudget::usage() const {
+    return usage_.load(memory_order_relaxed);
+}
+
+bool MemoryBudget::exceeded() const {
+    return usage() > limit();
+}
+
+void MemoryBudget::update(uint64_t previous_size, uint64_t size) {
+    if (size > previous_size) {
+        usage_.fetch_add(size - previous_size, memory_order_relaxed);
+    }
+    else if (size < previous_size) {
+        usage_.fetch_sub(previous_size - size, memory_order_relaxed);
+    }
+}
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
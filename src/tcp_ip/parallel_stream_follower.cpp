@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <tins/tcp_ip/parallel_stream_follower.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <tins/tcp.h>
+#include <tins/rawpdu.h>
+#include <tins/exceptions.h>
+#include <tins/tcp_ip/stream_identifier.h>
+
+using std::move;
+using std::shared_ptr;
+
+namespace Tins {
+namespace TCPIP {
+namespace {
+
+// Borrowed payloads point into the capture's buffer, which is reused once
+// the next packet is read, so they can't be handed over to a shard
+void own_borrowed_payloads(PDU* pdu) {
+    for (PDU* current = pdu; current; current = current->inner_pdu()) {
+        if (current->pdu_type() == PDU::RAW) {
+            static_cast<RawPDU*>(current)->own_payload();
+        }
+    }
+}
+
+} // anonymous namespace
+
+const size_t ParallelStreamFollower::DEFAULT_QUEUE_CAPACITY;
+
+ParallelStreamFollower::ParallelStreamFollower(size_type size, size_t queue_capacity)
+: pipeline_(size, queue_capacity),
+  memory_budget_(MemoryBudget::process_budget()),
+  has_new_stream_callback_(false), running_(false) {
+    for (size_type i = 0; i < size; ++i) {
+        followers_.emplace_back(new StreamFollower());
+        followers_.back()->memory_budget(memory_budget_);
+    }
+}
+
+ParallelStreamFollower::~ParallelStreamFollower() {
+    try {
+        stop();
+    }
+    catch (...) {
+
+    }
+}
+
+ParallelStreamFollower::size_type ParallelStreamFollower::size() const {
+    return followers_.size();
+}
+
+void ParallelStreamFollower::process_packet(const PDU& packet) {
+    process_packet(Packet(packet));
+}
+
+void ParallelStreamFollower::process_packet(const Packet& packet) {
+    process_packet(Packet(packet));
+}
+
+void ParallelStreamFollower::process_packet(Packet&& packet) {
+    if (!packet.pdu() || !packet.pdu()->find_pdu<TCP>()) {
+        return;
+    }
+    const size_type index = shard_index(*packet.pdu());
+    if (!running_) {
+        start();
+    }
+    own_borrowed_payloads(packet.pdu());
+    pipeline_.push(move(packet), index);
+}
+
+void ParallelStreamFollower::stop() {
+    if (running_) {
+        running_ = false;
+        pipeline_.stop();
+    }
+}
+
+ParallelStreamFollower::size_type ParallelStreamFollower::shard_index(const PDU& packet) const {
+    return StreamIdentifier::make_identifier(packet).hash() % followers_.size();
+}
+
+void ParallelStreamFollower::new_stream_callback(const stream_callback_type& callback) {
+    has_new_stream_callback_ = static_cast<bool>(callback);
+    for (size_type i = 0; i < followers_.size(); ++i) {
+        followers_[i]->new_stream_callback(callback);
+    }
+}
+
+void ParallelStreamFollower::stream_termination_callback(
+    const stream_termination_callback_type& callback) {
+    for (size_type i = 0; i < followers_.size(); ++i) {
+        followers_[i]->stream_termination_callback(callback);
+    }
+}
+
+void ParallelStreamFollower::follow_partial_streams(bool value) {
+    for (size_type i = 0; i < followers_.size(); ++i) {
+        followers_[i]->follow_partial_streams(value);
+    }
+}
+
+void ParallelStreamFollower::memory_budget(uint64_t max_bytes) {
+    memory_budget_->limit(max_bytes);
+}
+
+void ParallelStreamFollower::memory_budget(const shared_ptr<MemoryBudget>& budget) {
+    memory_budget_ = budget;
+    for (size_type i = 0; i < followers_.size(); ++i) {
+        followers_[i]->memory_budget(budget);
+    }
+}
+
+const shared_ptr<MemoryBudget>& ParallelStreamFollower::memory_budget() const {
+    return memory_budget_;
+}
+
+uint64_t ParallelStreamFollower::buffered_bytes() const {
+    return memory_budget_->usage();
+}
+
+void ParallelStreamFollower::start() {
+    // Fail here rather than on a shard's thread
+    if (!has_new_stream_callback_) {
+        throw callback_not_set();
+    }
+    pipeline_.start([&](size_type index) {
+        StreamFollower* follower = followers_[index].get();
+        return [follower](Packet& packet) {
+            follower->process_packet(packet);
+        };
+    });
+    running_ = true;
+}
+
+} // TCPIP
+} // Tins
+
+#endif // TINS_HAVE_TCPIP
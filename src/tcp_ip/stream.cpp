@@ -117,6 +117,16 @@ void Stream::server_out_of_order_callback(const stream_packet_callback_type& cal
     on_server_out_of_order_callback_ = callback;
 }
 
+void Stream::client_data_span_callback(const stream_data_span_callback_type& callback) {
+    on_client_data_span_callback_ = callback;
+    setup_flows_callbacks();
+}
+
+void Stream::server_data_span_callback(const stream_data_span_callback_type& callback) {
+    on_server_data_span_callback_ = callback;
+    setup_flows_callbacks();
+}
+
 void Stream::ignore_client_data() {
     client_flow().ignore_data_packets();
 }
@@ -239,6 +249,21 @@ void Stream::setup_flows_callbacks() {
                                             this, _1, _2, _3));
     server_flow_.out_of_order_callback(bind(&Stream::on_server_out_of_order,
                                             this, _1, _2, _3));
+    // Flows only stop accumulating data if there's a span callback to use
+    if (on_client_data_span_callback_) {
+        client_flow_.data_span_callback(bind(&Stream::on_client_flow_data_span,
+                                             this, _1, _2, _3, _4));
+    }
+    else {
+        client_flow_.data_span_callback(Flow::data_span_callback_type());
+    }
+    if (on_server_data_span_callback_) {
+        server_flow_.data_span_callback(bind(&Stream::on_server_flow_data_span,
+                                             this, _1, _2, _3, _4));
+    }
+    else {
+        server_flow_.data_span_callback(Flow::data_span_callback_type());
+    }
 }
 
 void Stream::auto_cleanup_payloads(bool value) {
@@ -287,7 +312,7 @@ void Stream::on_client_flow_data(const Flow& /*flow*/) {
         on_client_data_callback_(*this);
     }
     if (auto_cleanup_client_) {
-        client_payload().clear();
+        client_flow().clear_payload();
     }
 }
 
@@ -296,10 +321,20 @@ void Stream::on_server_flow_data(const Flow& /*flow*/) {
         on_server_data_callback_(*this);
     }
     if (auto_cleanup_server_) {
-        server_payload().clear();
+        server_flow().clear_payload();
     }
 }
 
+void Stream::on_client_flow_data_span(const Flow& /*flow*/, const uint8_t* data,
+                                      size_t size, uint64_t offset) {
+    on_client_data_span_callback_(*this, data, size, offset);
+}
+
+void Stream::on_server_flow_data_span(const Flow& /*flow*/, const uint8_t* data,
+                                      size_t size, uint64_t offset) {
+    on_server_data_span_callback_(*this, data, size, offset);
+}
+
 void Stream::on_client_out_of_order(const Flow& /*flow*/, uint32_t seq, const payload_type& payload) {
     if (on_client_out_of_order_callback_) {
         on_client_out_of_order_callback_(*this, seq, payload);
@@ -31,7 +31,8 @@
 
 #ifdef TINS_HAVE_TCPIP
 
-#include <limits>
+#include <algorithm>
+#include <cmath>
 #include <tins/ip_address.h>
 #include <tins/ipv6_address.h>
 #include <tins/tcp.h>
@@ -42,9 +43,12 @@
 #include <tins/exceptions.h>
 
 using std::make_pair;
+using std::make_shared;
+using std::shared_ptr;
 using std::bind;
 using std::pair;
-using std::numeric_limits;
+using std::min;
+using std::ceil;
 using std::chrono::system_clock;
 using std::chrono::minutes;
 using std::chrono::duration_cast;
@@ -59,11 +63,43 @@ const StreamFollower::timestamp_type StreamFollower::DEFAULT_KEEP_ALIVE = minute
 
 StreamFollower::StreamFollower() 
 : max_buffered_chunks_(DEFAULT_MAX_BUFFERED_CHUNKS),
-  max_buffered_bytes_(DEFAULT_MAX_BUFFERED_BYTES), last_cleanup_(0),
-  stream_keep_alive_(DEFAULT_KEEP_ALIVE), attach_to_flows_(false) {
+  max_buffered_bytes_(DEFAULT_MAX_BUFFERED_BYTES),
+  stream_keep_alive_(DEFAULT_KEEP_ALIVE),
+  memory_budget_(MemoryBudget::process_budget()),
+  buffered_bytes_(0), attach_to_flows_(false) {
 
 }
 
+StreamFollower::StreamFollower(const StreamFollower& other)
+: on_new_connection_(other.on_new_connection_),
+  on_stream_termination_(other.on_stream_termination_),
+  max_buffered_chunks_(other.max_buffered_chunks_),
+  max_buffered_bytes_(other.max_buffered_bytes_),
+  stream_keep_alive_(other.stream_keep_alive_),
+  memory_budget_(other.memory_budget_),
+  buffered_bytes_(0), attach_to_flows_(other.attach_to_flows_) {
+    copy_streams(other);
+}
+
+StreamFollower& StreamFollower::operator=(const StreamFollower& other) {
+    if (this != &other) {
+        clear_streams();
+        on_new_connection_ = other.on_new_connection_;
+        on_stream_termination_ = other.on_stream_termination_;
+        max_buffered_chunks_ = other.max_buffered_chunks_;
+        max_buffered_bytes_ = other.max_buffered_bytes_;
+        stream_keep_alive_ = other.stream_keep_alive_;
+        memory_budget_ = other.memory_budget_;
+        attach_to_flows_ = other.attach_to_flows_;
+        copy_streams(other);
+    }
+    return *this;
+}
+
+StreamFollower::~StreamFollower() {
+    memory_budget_->update(buffered_bytes_, 0);
+}
+
 void StreamFollower::process_packet(PDU& packet) {
     // Use current time
     const system_clock::duration ts = system_clock::now().time_since_epoch();
@@ -87,32 +123,39 @@ void StreamFollower::process_packet(PDU& packet, const timestamp_type& ts) {
         // Start on client's SYN, not on server's SYN+ACK
         const bool is_syn = tcp->has_flags(TCP::SYN) && !tcp->has_flags(TCP::ACK);
         if (is_syn || (attach_to_flows_ && tcp->find_pdu<RawPDU>() != 0)) {
-            iter = streams_.insert(make_pair(identifier, Stream(packet, ts))).first;
-            iter->second.setup_flows_callbacks();
+            iter = streams_.insert(
+                make_pair(identifier, stream_entry(Stream(packet, ts), expiry_list_.end()))
+            ).first;
+            iter->second.position = expiry_list_.insert(expiry_list_.end(), &*iter);
+            update_expiry_position(iter->second, ts);
+            Stream& stream = iter->second.stream;
+            stream.setup_flows_callbacks();
             if (on_new_connection_) {
-                on_new_connection_(iter->second);
+                on_new_connection_(stream);
             }
             else {
                 throw callback_not_set();
             }
             if (!is_syn) {
                 // assume the connection is established
-                iter->second.client_flow().state(Flow::ESTABLISHED);
-                iter->second.server_flow().state(Flow::ESTABLISHED);
+                stream.client_flow().state(Flow::ESTABLISHED);
+                stream.server_flow().state(Flow::ESTABLISHED);
             }
         }
         else {
             // no stream found and no stream was created
-            if (last_cleanup_ + stream_keep_alive_ <= ts) {
-                cleanup_streams(ts);
-            }
+            cleanup_streams(ts);
             return;
         }
     }
+    else {
+        update_expiry_position(iter->second, ts);
+    }
     // We'll process it if we had already seen this stream or if we just attached to
     // it and it contains payload
-    Stream& stream = iter->second;
+    Stream& stream = iter->second.stream;
     stream.process_packet(packet, ts);
+    update_memory_usage(iter->second);
     // Check for different potential termination
     size_t total_chunks = stream.client_flow().buffered_payload().size() +
                           stream.server_flow().buffered_payload().size();
@@ -135,11 +178,11 @@ void StreamFollower::process_packet(PDU& packet, const timestamp_type& ts) {
         if (terminate_stream && on_stream_termination_) {
             on_stream_termination_(stream, reason);
         }
-        streams_.erase(iter);
+        erase_stream(iter);
     }
-
-    if (last_cleanup_ + stream_keep_alive_ <= ts) {
-        cleanup_streams(ts);
+    cleanup_streams(ts);
+    if (memory_budget_->exceeded()) {
+        evict_streams();
     }
 }
 
@@ -171,7 +214,7 @@ Stream& StreamFollower::find_stream(const stream_id& id) {
         throw stream_not_found();
     }
     else {
-        return iter->second;
+        return iter->second.stream;
     }
 }
 
@@ -179,21 +222,130 @@ void StreamFollower::follow_partial_streams(bool value) {
     attach_to_flows_ = value;
 }
 
+void StreamFollower::memory_budget(uint64_t max_bytes) {
+    memory_budget(make_shared<MemoryBudget>(max_bytes));
+}
+
+void StreamFollower::memory_budget(const shared_ptr<MemoryBudget>& budget) {
+    // Move what we're using over to the new budget
+    memory_budget_->update(buffered_bytes_, 0);
+    memory_budget_ = budget;
+    memory_budget_->update(0, buffered_bytes_);
+}
+
+const shared_ptr<MemoryBudget>& StreamFollower::memory_budget() const {
+    return memory_budget_;
+}
+
+uint64_t StreamFollower::buffered_bytes() const {
+    return buffered_bytes_;
+}
+
+void StreamFollower::update_expiry_position(stream_entry& entry, const timestamp_type& ts) {
+    // Captures are mostly sorted by time, so the stream usually goes right 
+    // at the end. Otherwise, walk back until a stream seen before it is found
+    expiry_list_type::iterator position = expiry_list_.end();
+    while (position != expiry_list_.begin()) {
+        expiry_list_type::iterator previous = position;
+        --previous;
+        if (previous != entry.position && (*previous)->second.stream.last_seen() <= ts) {
+            break;
+        }
+        position = previous;
+    }
+    expiry_list_.splice(position, expiry_list_, entry.position);
+}
+
+void StreamFollower::update_memory_usage(stream_entry& entry) {
+    const Flow& client_flow = entry.stream.client_flow();
+    const Flow& server_flow = entry.stream.server_flow();
+    const uint64_t usage = client_flow.payload_size() + client_flow.total_buffered_bytes() +
+                           server_flow.payload_size() + server_flow.total_buffered_bytes();
+    if (usage != entry.memory_usage) {
+        buffered_bytes_ = buffered_bytes_ - entry.memory_usage + usage;
+        memory_budget_->update(entry.memory_usage, usage);
+        entry.memory_usage = usage;
+    }
+}
+
+void StreamFollower::erase_stream(streams_type::iterator iter) {
+    buffered_bytes_ -= iter->second.memory_usage;
+    memory_budget_->update(iter->second.memory_usage, 0);
+    expiry_list_.erase(iter->second.position);
+    streams_.erase(iter);
+}
+
 void StreamFollower::cleanup_streams(const timestamp_type& now) {
-    streams_type::iterator iter = streams_.begin();
-    while (iter != streams_.end()) {
-        if (iter->second.last_seen() + stream_keep_alive_ <= now) {
-            // If we have a termination callback, execute it
+    // Streams are sorted by the time they were last seen, so we can stop
+    // as soon as we find one that hasn't expired
+    while (!expiry_list_.empty()) {
+        stream_entry& entry = expiry_list_.front()->second;
+        if (entry.stream.last_seen() + stream_keep_alive_ > now) {
+            break;
+        }
+        // If we have a termination callback, execute it
+        if (on_stream_termination_) {
+            on_stream_termination_(entry.stream, TIMEOUT);
+        }
+        erase_stream(streams_.find(expiry_list_.front()->first));
+    }
+}
+
+void StreamFollower::evict_streams() {
+    // The budget may be shared with other followers, so only free this 
+    // follower's share of the excess, proportional to the amount of bytes it
+    // holds. Otherwise a follower holding little data would terminate all
+    // of its streams to make up for the ones holding most of it
+    const uint64_t usage = memory_budget_->usage();
+    const uint64_t limit = memory_budget_->limit();
+    if (usage <= limit || buffered_bytes_ == 0) {
+        return;
+    }
+    uint64_t bytes_to_free = usage - limit;
+    if (buffered_bytes_ < usage) {
+        const double share = static_cast<double>(buffered_bytes_) / usage;
+        bytes_to_free = static_cast<uint64_t>(ceil(bytes_to_free * share));
+    }
+    bytes_to_free = min(bytes_to_free, buffered_bytes_);
+    const uint64_t target_bytes = buffered_bytes_ - bytes_to_free;
+    // Terminate the least recently seen streams first. Streams without any
+    // data wouldn't free anything, so they're kept
+    expiry_list_type::iterator position = expiry_list_.begin();
+    while (position != expiry_list_.end() && buffered_bytes_ > target_bytes) {
+        streams_type::value_type& entry = **position;
+        ++position;
+        if (entry.second.memory_usage > 0) {
             if (on_stream_termination_) {
-                on_stream_termination_(iter->second, TIMEOUT);
+                on_stream_termination_(entry.second.stream, MEMORY_PRESSURE);
             }
-            streams_.erase(iter++);
-        }
-        else {
-            ++iter;
+            erase_stream(streams_.find(entry.first));
         }
     }
-    last_cleanup_ = now;
+}
+
+void StreamFollower::copy_streams(const StreamFollower& other) {
+    // Keep the same expiry order. Each stream's flows must call back into
+    // the copy rather than the original stream
+    expiry_list_type::const_iterator position = other.expiry_list_.begin();
+    for (; position != other.expiry_list_.end(); ++position) {
+        const stream_entry& entry = (*position)->second;
+        streams_type::iterator iter = streams_.insert(
+            make_pair((*position)->first, stream_entry(entry.stream, expiry_list_.end()))
+        ).first;
+        stream_entry& new_entry = iter->second;
+        new_entry.position = expiry_list_.insert(expiry_list_.end(), &*iter);
+        new_entry.stream.setup_flows_callbacks();
+        new_entry.memory_usage = entry.memory_usage;
+        buffered_bytes_ += entry.memory_usage;
+    }
+    memory_budget_->update(0, buffered_bytes_);
+}
+
+void StreamFollower::clear_streams() {
+    memory_budget_->update(buffered_bytes_, 0);
+    buffered_bytes_ = 0;
+    streams_.clear();
+    expiry_list_.clear();
 }
 
 } // TCPIP
@@ -33,6 +33,7 @@
 
 #include <algorithm>
 #include <tuple>
+#include <cstring>
 #include <tins/memory_helpers.h>
 #include <tins/tcp.h>
 #include <tins/udp.h>
@@ -81,6 +82,22 @@ bool StreamIdentifier::operator==(const StreamIdentifier& rhs) const {
            tie(rhs.min_address, rhs.min_address_port, rhs.max_address, rhs.max_address_port);
 }
 
+size_t StreamIdentifier::hash() const {
+    // Mix each 64 bit word of the identifier into the result
+    uint64_t words[4];
+    memcpy(words, min_address.data(), min_address.size());
+    memcpy(words + 2, max_address.data(), max_address.size());
+    uint64_t output = (static_cast<uint64_t>(min_address_port) << 16) | max_address_port;
+    for (size_t i = 0; i < 4; ++i) {
+        output ^= words[i] + 0x9e3779b97f4a7c15ULL + (output << 6) + (output >> 2);
+    }
+    // Final avalanche so the low bits depend on every input bit
+    output ^= output >> 33;
+    output *= 0xff51afd7ed558ccdULL;
+    output ^= output >> 33;
+    return static_cast<size_t>(output);
+}
+
 StreamIdentifier StreamIdentifier::make_identifier(const PDU& packet) {
     uint16_t source_port;
     uint16_t dest_port;
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2017, Matias Fontanini
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ * * Redistributions of source code must retain the above copyright
+ *   notice, this list of conditions and the following disclaimer.
+ * * Redistributions in binary form must reproduce the above
+ *   copyright notice, this list of conditions and the following disclaimer
+ *   in the documentation and/or other materials provided with the
+ *   distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ * OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ * DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ * THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ * OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+
+#include <cstring>
+#include <cerrno>
+#include <tins/timestamp_index.h>
+#include <tins/pcap_file_reader.h>
+#include <tins/endianness.h>
+#include <tins/exceptions.h>
+#include <tins/detail/mapped_file.h>
+
+using std::string;
+
+using Tins::Internals::MappedFile;
+
+namespace Tins {
+namespace {
+
+// "TIDX", when read as a little endian integer
+const uint32_t INDEX_MAGIC = 0x58444954;
+const uint16_t INDEX_VERSION = 1;
+const uint32_t INDEX_HEADER_SIZE = 16;
+const uint32_t INDEX_ENTRY_SIZE = 16;
+const uint32_t WRITE_BUFFER_SIZE = 64 * 1024;
+
+template <typename T>
+T read_le(const uint8_t* ptr) {
+    T value;
+    memcpy(&value, ptr, sizeof(value));
+    return Endian::le_to_host(value);
+}
+
+template <typename T>
+void append_le(std::vector<uint8_t>& buffer, T value) {
+    value = Endian::host_to_le(value);
+    const uint8_t* ptr = reinterpret_cast<const uint8_t*>(&value);
+    buffer.insert(buffer.end(), ptr, ptr + sizeof(value));
+}
+
+} // anonymous namespace
+
+// TimestampIndex
+
+const uint32_t TimestampIndex::DEFAULT_INTERVAL = 64;
+
+TimestampIndex::TimestampIndex(const string& file_name)
+: file_(new MappedFile(file_name)), size_(0), interval_(0) {
+    if (file_->size() < INDEX_HEADER_SIZE ||
+        read_le<uint32_t>(file_->data()) != INDEX_MAGIC ||
+        read_le<uint16_t>(file_->data() + 4) != INDEX_VERSION) {
+        delete file_;
+        throw invalid_file_format();
+    }
+    interval_ = read_le<uint32_t>(file_->data() + 8);
+    // A partially written entry at the end is ignored
+    size_ = (file_->size() - INDEX_HEADER_SIZE) / INDEX_ENTRY_SIZE;
+    file_->advise(MappedFile::RANDOM_ACCESS);
+}
+
+TimestampIndex::~TimestampIndex() {
+    delete file_;
+}
+
+void TimestampIndex::build(const string& capture_file_name, const string& index_file_name,
+                           uint32_t interval) {
+    PcapFileReader reader(capture_file_name);
+    TimestampIndexWriter writer(index_file_name, interval);
+    PcapFileReader::record current;
+    uint64_t offset = reader.offset();
+    while (reader.next_record(current)) {
+        writer.add_record(current.timestamp, offset);
+        offset = reader.offset();
+    }
+    writer.flush();
+}
+
+uint64_t TimestampIndex::find(const Timestamp& timestamp) const {
+    if (size_ == 0) {
+        return 0;
+    }
+    const uint64_t value = to_microseconds(timestamp);
+    // Find the first entry whose highest timestamp is not lower than the 
+    // one we're looking for
+    uint64_t low = 0;
+    uint64_t high = size_;
+    while (low < high) {
+        const uint64_t middle = low + (high - low) / 2;
+        if (entry_timestamp(middle) < value) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+    // Records between the previous entry and this one may be at or after 
+    // the timestamp, so start from the previous one
+    return entry_offset(low == 0 ? 0 : low - 1);
+}
+
+uint64_t TimestampIndex::size() const {
+    return size_;
+}
+
+uint32_t TimestampIndex::interval() const {
+    return interval_;
+}
+
+uint64_t TimestampIndex::to_microseconds(const Timestamp& timestamp) {
+    return static_cast<uint64_t>(timestamp.seconds()) * 1000000 +
+           static_cast<uint64_t>(timestamp.microseconds());
+}
+
+uint64_t TimestampIndex::entry_timestamp(uint64_t index) const {
+    return read_le<uint64_t>(file_->data() + INDEX_HEADER_SIZE + index * INDEX_ENTRY_SIZE);
+}
+
+uint64_t TimestampIndex::entry_offset(uint64_t index) const {
+    return read_le<uint64_t>(file_->data() + INDEX_HEADER_SIZE + index * INDEX_ENTRY_SIZE + 8);
+}
+
+// TimestampIndexWriter
+
+TimestampIndexWriter::TimestampIndexWriter(const string& file_name, uint32_t interval)
+: file_(fopen(file_name.c_str(), "wb")), max_timestamp_(0),
+  interval_(interval == 0 ? 1 : interval), pending_records_(0) {
+    if (!file_) {
+        throw file_open_error(file_name + ": " + strerror(errno));
+    }
+    buffer_.reserve(WRITE_BUFFER_SIZE);
+    append_le<uint32_t>(buffer_, INDEX_MAGIC);
+    append_le<uint16_t>(buffer_, INDEX_VERSION);
+    append_le<uint16_t>(buffer_, 0);
+    append_le<uint32_t>(buffer_, interval_);
+    append_le<uint32_t>(buffer_, 0);
+}
+
+TimestampIndexWriter::~TimestampIndexWriter() {
+    try {
+        flush();
+    }
+    catch (file_write_error&) {
+        // Nothing we can do here
+    }
+    fclose(file_);
+}
+
+void TimestampIndexWriter::add_record(const Timestamp& timestamp, uint64_t offset) {
+    const uint64_t value = TimestampIndex::to_microseconds(timestamp);
+    if (value > max_timestamp_) {
+        max_timestamp_ = value;
+    }
+    if (pending_records_ == 0) {
+        append_le<uint64_t>(buffer_, max_timestamp_);
+        append_le<uint64_t>(buffer_, offset);
+        if (buffer_.size() >= WRITE_BUFFER_SIZE) {
+            flush();
+        }
+    }
+    pending_records_ = (pending_records_ + 1) % interval_;
+}
+
+void TimestampIndexWriter::flush() {
+    if (buffer_.empty()) {
+        return;
+    }
+    const size_t written = fwrite(&buffer_[0], 1, buffer_.size(), file_);
+    const bool failed = written != buffer_.size() || fflush(file_) != 0;
+    buffer_.clear();
+    if (failed) {
+        throw file_write_error(strerror(errno));
+    }
+}
+
+} // Tins
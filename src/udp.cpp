@@ -36,17 +36,27 @@
 #include <tins/exceptions.h>
 #include <tins/memory_helpers.h>
 #include <tins/utils/checksum_utils.h>
+#include <tins/detail/pdu_helpers.h>
 
 using Tins::Memory::InputMemoryStream;
 using Tins::Memory::OutputMemoryStream;
 
 namespace Tins {
 
-PDU::metadata UDP::extract_metadata(const uint8_t* /*buffer*/, uint32_t total_sz) {
-    if (TINS_UNLIKELY(total_sz < sizeof(udp_header))) {
+PDU::metadata UDP::extract_metadata(const uint8_t* buffer, uint32_t total_sz) {
+    metadata output;
+    if (TINS_UNLIKELY(!try_extract_metadata(buffer, total_sz, output))) {
         throw malformed_packet();
     }
-    return metadata(sizeof(udp_header), pdu_flag, PDU::UNKNOWN);
+    return output;
+}
+
+bool UDP::try_extract_metadata(const uint8_t* /*buffer*/, uint32_t total_sz, metadata& output) {
+    if (TINS_UNLIKELY(total_sz < sizeof(udp_header))) {
+        return false;
+    }
+    output = metadata(sizeof(udp_header), pdu_flag, PDU::UNKNOWN);
+    return true;
 }
 
 UDP::UDP(uint16_t dport, uint16_t sport)
@@ -55,11 +65,14 @@ UDP::UDP(uint16_t dport, uint16_t sport)
     this->sport(sport);
 }
 
-UDP::UDP(const uint8_t* buffer, uint32_t total_sz)  {
+UDP::UDP(const uint8_t* buffer, uint32_t total_sz) {
+    Internals::header_check header_check(buffer);
     InputMemoryStream stream(buffer, total_sz);
-    stream.read(header_);
+    if (!header_check.check(stream.try_read(header_))) {
+        return;
+    }
     if (stream) {
-        inner_pdu(new RawPDU(stream.pointer(), stream.size()));
+        inner_pdu(Internals::decode_arena::allocate<RawPDU>(stream.pointer(), stream.size()));
     }
 }
 
@@ -0,0 +1,76 @@
+#ifndef TINS_TEST_PCAP_FILE_H
+#define TINS_TEST_PCAP_FILE_H
+
+#include <stdint.h>
+#include <fstream>
+#include <vector>
+#include <tins/pdu.h>
+#include <tins/endianness.h>
+
+// Builds pcap captures in memory. The file readers don't depend on libpcap,
+// so their tests can't use PacketWriter to write their captures
+class PcapFileBuilder {
+public:
+    typedef std::vector<uint8_t> buffer_type;
+
+    // Captures are written in host byte order unless swap is set
+    explicit PcapFileBuilder(uint32_t link_type = 1, uint32_t magic = 0xa1b2c3d4,
+                             bool swap = false)
+    : swap_(swap) {
+        write_uint32(magic);
+        write_uint16(2);
+        write_uint16(4);
+        write_uint32(0);
+        write_uint32(0);
+        write_uint32(65535);
+        write_uint32(link_type);
+    }
+
+    // Adds a record and returns its offset in the file. The record's
+    // original length is extra_length bytes longer than its data
+    uint64_t add_record(const Tins::PDU::serialization_type& data, uint32_t seconds,
+                        uint32_t fraction = 0, uint32_t extra_length = 0) {
+        const uint64_t offset = contents_.size();
+        write_uint32(seconds);
+        write_uint32(fraction);
+        write_uint32(static_cast<uint32_t>(data.size()));
+        write_uint32(static_cast<uint32_t>(data.size()) + extra_length);
+        contents_.insert(contents_.end(), data.begin(), data.end());
+        return offset;
+    }
+
+    uint64_t add_record(Tins::PDU& pdu, uint32_t seconds, uint32_t fraction = 0) {
+        return add_record(pdu.serialize(), seconds, fraction);
+    }
+
+    // Malformed captures are built by editing these
+    buffer_type& contents() {
+        return contents_;
+    }
+
+    void write(const char* file_name) const {
+        std::ofstream output(file_name, std::ios::binary);
+        output.write((const char*)&contents_[0], contents_.size());
+    }
+private:
+    void write_uint32(uint32_t value) {
+        if (swap_) {
+            value = Tins::Endian::change_endian(value);
+        }
+        const uint8_t* ptr = (const uint8_t*)&value;
+        contents_.insert(contents_.end(), ptr, ptr + sizeof(value));
+    }
+
+    void write_uint16(uint16_t value) {
+        if (swap_) {
+            value = Tins::Endian::change_endian(value);
+        }
+        const uint8_t* ptr = (const uint8_t*)&value;
+        contents_.insert(contents_.end(), ptr, ptr + sizeof(value));
+    }
+
+    buffer_type contents_;
+    bool swap_;
+};
+
+#endif // TINS_TEST_PCAP_FILE_H
@@ -2,6 +2,11 @@
 #include <vector>
 #include <algorithm>
 #include <stdint.h>
+#include <tins/config.h>
+#ifdef TINS_HAVE_CXX11
+    #include <thread>
+    #include <atomic>
+#endif // TINS_HAVE_CXX11
 #include <tins/pdu_allocator.h>
 #include <tins/ethernetII.h>
 #include <tins/snap.h>
@@ -120,3 +125,57 @@ TEST_F(AllocatorsTest, IPv6) {
         EXPECT_EQ(pkt.serialize(), ipv6_data);
     }
 }
+
+TEST_F(AllocatorsTest, ReplaceAllocator) {
+    std::vector<uint8_t> ipv4_data(
+        ipv4_data_buffer,
+        ipv4_data_buffer + sizeof(ipv4_data_buffer)
+    );
+    Allocators::register_allocator<IP, DummyPDU<4> >(255);
+    {
+        EthernetII pkt(&ipv4_data[0], (uint32_t)ipv4_data.size());
+        EXPECT_TRUE(pkt.find_pdu<DummyPDU<4> >() != NULL);
+    }
+    Allocators::register_allocator<IP, DummyPDU<5> >(255);
+    {
+        EthernetII pkt(&ipv4_data[0], (uint32_t)ipv4_data.size());
+        EXPECT_TRUE(pkt.find_pdu<DummyPDU<4> >() == NULL);
+        EXPECT_TRUE(pkt.find_pdu<DummyPDU<5> >() != NULL);
+        EXPECT_EQ(pkt.serialize(), ipv4_data);
+    }
+    EXPECT_TRUE(Internals::pdu_type_registered<IP>(DummyPDU<5>::pdu_flag));
+    EXPECT_EQ(255, Internals::pdu_type_to_id<IP>(DummyPDU<5>::pdu_flag));
+    EXPECT_FALSE(Internals::pdu_type_registered<IP>(DummyPDU<6>::pdu_flag));
+}
+
+#ifdef TINS_HAVE_CXX11
+
+TEST_F(AllocatorsTest, RegisterWhileDecoding) {
+    std::vector<uint8_t> link_layer_data(
+        link_layer_data_buffer,
+        link_layer_data_buffer + sizeof(link_layer_data_buffer)
+    );
+    std::atomic<bool> done(false);
+    std::atomic<size_t> decoded(0);
+    std::thread decoder([&]() {
+        while (!done) {
+            EthernetII pkt(&link_layer_data[0], (uint32_t)link_layer_data.size());
+            if (pkt.find_pdu<DummyPDU<7> >()) {
+                decoded++;
+            }
+        }
+    });
+    for (uint16_t i = 0; i < 64; ++i) {
+        Allocators::register_allocator<EthernetII, DummyPDU<8> >(0x7000 + i);
+    }
+    Allocators::register_allocator<EthernetII, DummyPDU<7> >(1638);
+    while (decoded == 0) {
+        std::this_thread::yield();
+    }
+    done = true;
+    decoder.join();
+    EthernetII pkt(&link_layer_data[0], (uint32_t)link_layer_data.size());
+    EXPECT_TRUE(pkt.find_pdu<DummyPDU<7> >() != NULL);
+}
+
+#endif // TINS_HAVE_CXX11
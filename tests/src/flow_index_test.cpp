@@ -0,0 +1,172 @@
+#include <tins/config.h>
+#include <gtest/gtest.h>
+
+#ifdef TINS_HAVE_TCPIP
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <tins/tcp_ip/flow_index.h>
+#include <tins/pcap_file_reader.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/arp.h>
+#include <tins/exceptions.h>
+#include "tests/pcap_file.h"
+
+using namespace std;
+using namespace Tins;
+using namespace Tins::TCPIP;
+
+class FlowIndexTest : public testing::Test {
+public:
+    static const char* capture_file_name;
+    static const char* index_file_name;
+
+    void TearDown() {
+        remove(capture_file_name);
+        remove(index_file_name);
+    }
+
+    static StreamIdentifier make_identifier(const string& client, uint16_t client_port,
+                                            const string& server, uint16_t server_port) {
+        return StreamIdentifier(StreamIdentifier::serialize(IPv4Address(client)), client_port,
+                                StreamIdentifier::serialize(IPv4Address(server)), server_port);
+    }
+};
+
+const char* FlowIndexTest::capture_file_name = "flow_index_test.pcap";
+const char* FlowIndexTest::index_file_name = "flow_index_test.pcap.flows";
+
+TEST_F(FlowIndexTest, BuildAndFind) {
+    PcapFileBuilder builder;
+    vector<uint64_t> tcp_offsets;
+    vector<uint64_t> udp_offsets;
+    for (uint32_t i = 0; i < 10; ++i) {
+        // Alternate directions on the TCP flow
+        EthernetII tcp = i % 2 == 0 ?
+            EthernetII() / IP("10.0.0.2", "10.0.0.1") / TCP(80, 1234) :
+            EthernetII() / IP("10.0.0.1", "10.0.0.2") / TCP(1234, 80);
+        tcp_offsets.push_back(builder.add_record(tcp, i));
+        // Same addresses and ports, but on UDP
+        EthernetII udp = EthernetII() / IP("10.0.0.2", "10.0.0.1") / UDP(80, 1234);
+        if (i % 3 == 0) {
+            udp_offsets.push_back(builder.add_record(udp, i));
+        }
+        EthernetII other = EthernetII() / IP("10.0.0.3", "10.0.0.1") / TCP(80, 1000 + i);
+        builder.add_record(other, i);
+        EthernetII arp = EthernetII() / ARP();
+        builder.add_record(arp, i);
+    }
+    builder.write(capture_file_name);
+
+    FlowIndex::build(capture_file_name, index_file_name);
+    FlowIndex index(index_file_name);
+    // 1 TCP flow, 1 UDP flow and 10 other TCP flows
+    EXPECT_EQ(12U, index.size());
+    const StreamIdentifier identifier = make_identifier("10.0.0.1", 1234, "10.0.0.2", 80);
+    EXPECT_EQ(tcp_offsets, index.find(identifier, FlowIndex::TCP_FLOW));
+    EXPECT_EQ(udp_offsets, index.find(identifier, FlowIndex::UDP_FLOW));
+    EXPECT_EQ(1UL, index.find(make_identifier("10.0.0.1", 1005, "10.0.0.3", 80),
+                              FlowIndex::TCP_FLOW).size());
+    EXPECT_TRUE(index.find(make_identifier("10.0.0.1", 1234, "10.0.0.9", 80),
+                           FlowIndex::TCP_FLOW).empty());
+    EXPECT_TRUE(index.find(make_identifier("10.0.0.1", 1010, "10.0.0.3", 80),
+                           FlowIndex::UDP_FLOW).empty());
+}
+
+TEST_F(FlowIndexTest, SniffFlowRecords) {
+    PcapFileBuilder builder;
+    for (uint32_t i = 0; i < 20; ++i) {
+        EthernetII eth = EthernetII() / IP("10.0.0.2", "10.0.0.1") / TCP(80, 1000 + i % 4);
+        builder.add_record(eth, i);
+    }
+    builder.write(capture_file_name);
+    FlowIndex::build(capture_file_name, index_file_name);
+
+    FlowIndex index(index_file_name);
+    EthernetII query = EthernetII() / IP("10.0.0.1", "10.0.0.2") / TCP(1002, 80);
+    FlowIndex::offsets_type offsets = index.find(query);
+    ASSERT_EQ(5UL, offsets.size());
+
+    PcapFileReader reader(capture_file_name);
+    vector<int> seconds;
+    reader.sniff_records([&](Packet& packet) {
+        EXPECT_EQ(1002, packet.pdu()->rfind_pdu<TCP>().sport());
+        seconds.push_back(packet.timestamp().seconds());
+        return true;
+    }, offsets.begin(), offsets.end());
+    ASSERT_EQ(5UL, seconds.size());
+    EXPECT_EQ(2, seconds[0]);
+    EXPECT_EQ(18, seconds[4]);
+    // The reader's position isn't affected
+    EXPECT_EQ(24U, reader.offset());
+}
+
+TEST_F(FlowIndexTest, IPv6Flows) {
+    PcapFileBuilder builder;
+    EthernetII first = EthernetII() / IPv6("::1", "::2") / TCP(80, 1234);
+    EthernetII second = EthernetII() / IPv6("::2", "::1") / TCP(1234, 80);
+    const uint64_t first_offset = builder.add_record(first, 0);
+    const uint64_t second_offset = builder.add_record(second, 1);
+    builder.write(capture_file_name);
+    FlowIndex::build(capture_file_name, index_file_name);
+    FlowIndex index(index_file_name);
+    EXPECT_EQ(1U, index.size());
+    FlowIndex::offsets_type offsets = index.find(second);
+    ASSERT_EQ(2UL, offsets.size());
+    EXPECT_EQ(first_offset, offsets[0]);
+    EXPECT_EQ(second_offset, offsets[1]);
+}
+
+TEST_F(FlowIndexTest, Writer) {
+    FlowIndexWriter writer;
+    EthernetII tcp = EthernetII() / IP("10.0.0.2", "10.0.0.1") / TCP(80, 1234);
+    EthernetII arp = EthernetII() / ARP();
+    PDU::serialization_type tcp_data = tcp.serialize();
+    PDU::serialization_type arp_data = arp.serialize();
+    EXPECT_TRUE(writer.add_record(PDU::ETHERNET_II, &tcp_data[0], tcp_data.size(), 100));
+    EXPECT_FALSE(writer.add_record(PDU::ETHERNET_II, &arp_data[0], arp_data.size(), 200));
+    writer.add_record(make_identifier("1.1.1.1", 1, "2.2.2.2", 2), FlowIndex::UDP_FLOW, 300);
+    EXPECT_EQ(2UL, writer.size());
+    writer.write(index_file_name);
+
+    FlowIndex index(index_file_name);
+    EXPECT_EQ(2U, index.size());
+    EXPECT_EQ(FlowIndex::offsets_type(1, 100), index.find(tcp));
+    EXPECT_EQ(FlowIndex::offsets_type(1, 300),
+              index.find(make_identifier("2.2.2.2", 2, "1.1.1.1", 1), FlowIndex::UDP_FLOW));
+    EXPECT_TRUE(index.find(arp).empty());
+}
+
+TEST_F(FlowIndexTest, EmptyIndex) {
+    FlowIndexWriter().write(index_file_name);
+    FlowIndex index(index_file_name);
+    EXPECT_EQ(0U, index.size());
+    EXPECT_TRUE(index.find(make_identifier("1.1.1.1", 1, "2.2.2.2", 2),
+                           FlowIndex::TCP_FLOW).empty());
+}
+
+TEST_F(FlowIndexTest, InvalidFiles) {
+    EXPECT_THROW(FlowIndex("/ishallnotexist.flows"), file_open_error);
+    EXPECT_THROW(FlowIndexWriter().write("/ishallnotexist/file.flows"), file_open_error);
+    PcapFileBuilder().write(capture_file_name);
+    EXPECT_THROW(FlowIndex index(capture_file_name), invalid_file_format);
+    // Claims to have more flows than it contains
+    FlowIndexWriter writer;
+    writer.add_record(make_identifier("1.1.1.1", 1, "2.2.2.2", 2), FlowIndex::UDP_FLOW, 300);
+    writer.write(index_file_name);
+    {
+        fstream file(index_file_name, ios::in | ios::out | ios::binary);
+        file.seekp(8);
+        const uint64_t flow_count = 1000;
+        file.write((const char*)&flow_count, sizeof(flow_count));
+    }
+    EXPECT_THROW(FlowIndex index(index_file_name), invalid_file_format);
+}
+
+#endif // TINS_HAVE_TCPIP
@@ -0,0 +1,226 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+#include <tins/lazy_packet.h>
+#include <tins/packet_arena.h>
+#include <tins/ethernetII.h>
+#include <tins/dot3.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/exceptions.h>
+
+using namespace std;
+using namespace Tins;
+
+class LazyPacketTest : public testing::Test {
+public:
+    static PDU::serialization_type make_tcp_packet() {
+        EthernetII eth = EthernetII() / IP("1.2.3.4", "5.6.7.8") / TCP(80, 1234) /
+                         RawPDU("hello");
+        return eth.serialize();
+    }
+
+    static Timestamp make_timestamp() {
+        timeval tv;
+        tv.tv_sec = 1500000000;
+        tv.tv_usec = 1234;
+        return Timestamp(tv);
+    }
+};
+
+TEST_F(LazyPacketTest, DefaultConstructor) {
+    LazyPacket packet;
+    EXPECT_EQ(PDU::RAW, packet.link_type());
+    EXPECT_EQ(0U, packet.size());
+    EXPECT_FALSE(packet.is_decoded());
+    EXPECT_TRUE(packet.pdu() == 0);
+}
+
+TEST_F(LazyPacketTest, DecodesOnDemand) {
+    PDU::serialization_type buffer = make_tcp_packet();
+    LazyPacket packet(PDU::ETHERNET_II, &buffer[0], buffer.size(), make_timestamp());
+    EXPECT_FALSE(packet.is_decoded());
+    EXPECT_EQ(buffer.size(), packet.size());
+    EXPECT_EQ(buffer, packet.buffer());
+    EXPECT_EQ(1500000000, packet.timestamp().seconds());
+    EXPECT_EQ(1234, packet.timestamp().microseconds());
+    EXPECT_FALSE(packet.is_decoded());
+
+    const TCP* tcp = packet.find_pdu<TCP>();
+    ASSERT_TRUE(tcp != 0);
+    EXPECT_TRUE(packet.is_decoded());
+    EXPECT_EQ(80, tcp->dport());
+    EXPECT_EQ(1234, tcp->sport());
+    EXPECT_EQ(IPv4Address("1.2.3.4"), packet.rfind_pdu<IP>().dst_addr());
+    EXPECT_TRUE(packet.find_pdu<UDP>() == 0);
+    EXPECT_THROW(packet.rfind_pdu<UDP>(), pdu_not_found);
+    // Decoding only happens once
+    EXPECT_EQ(packet.pdu(), packet.pdu());
+}
+
+TEST_F(LazyPacketTest, RawIPLinkType) {
+    PDU::serialization_type buffer = (IP("1.2.3.4", "5.6.7.8") / UDP(53, 1000)).serialize();
+    LazyPacket packet(PDU::IP, &buffer[0], buffer.size(), make_timestamp());
+    EXPECT_TRUE(packet.find_pdu<IP>() != 0);
+    EXPECT_TRUE(packet.find_pdu<UDP>() != 0);
+
+    buffer = (IPv6("::1", "::2") / UDP(53, 1000)).serialize();
+    packet.assign(PDU::IP, &buffer[0], buffer.size(), make_timestamp());
+    EXPECT_FALSE(packet.is_decoded());
+    EXPECT_TRUE(packet.find_pdu<IP>() == 0);
+    EXPECT_TRUE(packet.find_pdu<IPv6>() != 0);
+}
+
+TEST_F(LazyPacketTest, Dot3) {
+    PDU::serialization_type buffer = Dot3().serialize();
+    LazyPacket packet(PDU::ETHERNET_II, &buffer[0], buffer.size(), make_timestamp());
+    EXPECT_TRUE(packet.find_pdu<Dot3>() != 0);
+}
+
+TEST_F(LazyPacketTest, MalformedPacket) {
+    PDU::serialization_type buffer = make_tcp_packet();
+    LazyPacket packet(PDU::ETHERNET_II, &buffer[0], 5, make_timestamp());
+    EXPECT_TRUE(packet.pdu() == 0);
+    EXPECT_TRUE(packet.is_decoded());
+    EXPECT_TRUE(packet.find_pdu<TCP>() == 0);
+}
+
+TEST_F(LazyPacketTest, AssignReplacesDecodedChain) {
+    PDU::serialization_type buffer = make_tcp_packet();
+    LazyPacket packet(PDU::ETHERNET_II, &buffer[0], buffer.size(), make_timestamp());
+    ASSERT_TRUE(packet.find_pdu<TCP>() != 0);
+
+    PDU::serialization_type other = (EthernetII() / IP() / UDP(1, 2)).serialize();
+    packet.assign(PDU::ETHERNET_II, &other[0], other.size(), Timestamp());
+    EXPECT_FALSE(packet.is_decoded());
+    EXPECT_EQ(other, packet.buffer());
+    EXPECT_TRUE(packet.find_pdu<TCP>() == 0);
+    EXPECT_TRUE(packet.find_pdu<UDP>() != 0);
+}
+
+TEST_F(LazyPacketTest, CopyConstructor) {
+    PDU::serialization_type buffer = make_tcp_packet();
+    LazyPacket packet1(PDU::ETHERNET_II, &buffer[0], buffer.size(), make_timestamp());
+    ASSERT_TRUE(packet1.pdu() != 0);
+    LazyPacket packet2(packet1);
+    EXPECT_FALSE(packet2.is_decoded());
+    EXPECT_EQ(packet1.buffer(), packet2.buffer());
+    EXPECT_EQ(packet1.timestamp().seconds(), packet2.timestamp().seconds());
+    EXPECT_EQ(packet1.timestamp().microseconds(), packet2.timestamp().microseconds());
+    ASSERT_TRUE(packet2.pdu() != 0);
+    EXPECT_NE(packet1.pdu(), packet2.pdu());
+}
+
+TEST_F(LazyPacketTest, CopyAssignment) {
+    PDU::serialization_type buffer = make_tcp_packet();
+    LazyPacket packet1(PDU::ETHERNET_II, &buffer[0], buffer.size(), make_timestamp());
+    LazyPacket packet2;
+    packet2 = packet1;
+    EXPECT_EQ(PDU::ETHERNET_II, packet2.link_type());
+    EXPECT_EQ(packet1.buffer(), packet2.buffer());
+    EXPECT_TRUE(packet2.find_pdu<TCP>() != 0);
+}
+
+#if TINS_IS_CXX11
+TEST_F(LazyPacketTest, MoveConstructor) {
+    PDU::serialization_type buffer = make_tcp_packet();
+    LazyPacket packet1(PDU::ETHERNET_II, &buffer[0], buffer.size(), make_timestamp());
+    PDU* pdu = packet1.pdu();
+    LazyPacket packet2(std::move(packet1));
+    EXPECT_TRUE(packet2.is_decoded());
+    EXPECT_EQ(pdu, packet2.pdu());
+    EXPECT_FALSE(packet1.is_decoded());
+}
+#endif // TINS_IS_CXX11
+
+TEST_F(LazyPacketTest, ReleasePDU) {
+    PDU::serialization_type buffer = make_tcp_packet();
+    LazyPacket packet(PDU::ETHERNET_II, &buffer[0], buffer.size(), make_timestamp());
+    PDU* pdu = packet.release_pdu();
+    ASSERT_TRUE(pdu != 0);
+    EXPECT_FALSE(packet.is_decoded());
+    EXPECT_NE(pdu, packet.pdu());
+    // The released chain can't reference the packet's buffer
+    EXPECT_FALSE(pdu->rfind_pdu<RawPDU>().is_payload_borrowed());
+    delete pdu;
+}
+
+TEST_F(LazyPacketTest, PayloadReferencesBuffer) {
+    PDU::serialization_type buffer = make_tcp_packet();
+    LazyPacket packet(PDU::ETHERNET_II, &buffer[0], buffer.size(), make_timestamp());
+    const RawPDU* raw = packet.find_pdu<RawPDU>();
+    ASSERT_TRUE(raw != 0);
+    #ifdef TINS_HAVE_CXX11
+    EXPECT_TRUE(raw->is_payload_borrowed());
+    EXPECT_EQ(packet.data() + 14 + 20 + 20, raw->payload_data());
+    #endif // TINS_HAVE_CXX11
+    EXPECT_EQ("hello", string(raw->payload_data(), raw->payload_data() + raw->payload_size()));
+}
+
+#ifdef TINS_HAVE_CXX11
+TEST_F(LazyPacketTest, MaxDecodeLayer) {
+    PDU::serialization_type buffer = make_tcp_packet();
+    LazyPacket packet(PDU::ETHERNET_II, &buffer[0], buffer.size(), make_timestamp());
+    EXPECT_EQ(PacketDecoder::ALL_LAYERS, packet.max_decode_layer());
+    packet.set_max_decode_layer(PacketDecoder::NETWORK_LAYER);
+    ASSERT_TRUE(packet.find_pdu<IP>() != 0);
+    EXPECT_TRUE(packet.find_pdu<TCP>() == 0);
+    // The TCP header and its payload
+    EXPECT_EQ(20U + 5U, packet.rfind_pdu<RawPDU>().payload_size());
+
+    LazyPacket copy(packet);
+    EXPECT_EQ(PacketDecoder::NETWORK_LAYER, copy.max_decode_layer());
+    EXPECT_TRUE(copy.find_pdu<TCP>() == 0);
+
+    // Changing the layer decodes the packet again
+    packet.set_max_decode_layer(PacketDecoder::ALL_LAYERS);
+    EXPECT_FALSE(packet.is_decoded());
+    EXPECT_TRUE(packet.find_pdu<TCP>() != 0);
+}
+
+TEST_F(LazyPacketTest, DecodesUpToRequestedLayer) {
+    PDU::serialization_type buffer = make_tcp_packet();
+    LazyPacket packet(PDU::ETHERNET_II, &buffer[0], buffer.size(), make_timestamp());
+    const IP* ip = packet.find_pdu<IP>();
+    ASSERT_TRUE(ip != 0);
+    // The transport layer is left undecoded
+    ASSERT_TRUE(ip->inner_pdu() != 0);
+    EXPECT_EQ(PDU::RAW, ip->inner_pdu()->pdu_type());
+
+    // Going deeper decodes the packet again, PDUs found before stay valid
+    const TCP* tcp = packet.find_pdu<TCP>();
+    ASSERT_TRUE(tcp != 0);
+    EXPECT_EQ(80, tcp->dport());
+    EXPECT_EQ(IPv4Address("1.2.3.4"), ip->dst_addr());
+    EXPECT_EQ(tcp, packet.find_pdu<TCP>());
+    EXPECT_EQ(packet.pdu(), packet.pdu());
+    EXPECT_EQ(tcp, packet.pdu()->find_pdu<TCP>());
+}
+
+TEST_F(LazyPacketTest, Arena) {
+    PDU::serialization_type buffer = make_tcp_packet();
+    PacketArena arena;
+    LazyPacket packet(PDU::ETHERNET_II, &buffer[0], buffer.size(), make_timestamp());
+    packet.set_arena(&arena);
+    ASSERT_TRUE(packet.find_pdu<TCP>() != 0);
+    EXPECT_TRUE(arena.owns(packet.find_pdu<TCP>()));
+
+    // Copies don't keep the arena
+    LazyPacket copy(packet);
+    ASSERT_TRUE(copy.find_pdu<TCP>() != 0);
+    EXPECT_FALSE(arena.owns(copy.find_pdu<TCP>()));
+}
+#endif // TINS_HAVE_CXX11
+
+TEST_F(LazyPacketTest, ToPacket) {
+    PDU::serialization_type buffer = make_tcp_packet();
+    LazyPacket lazy(PDU::ETHERNET_II, &buffer[0], buffer.size(), make_timestamp());
+    Packet packet = lazy.to_packet();
+    ASSERT_TRUE(packet.pdu() != 0);
+    EXPECT_EQ(lazy.timestamp().seconds(), packet.timestamp().seconds());
+    EXPECT_EQ(lazy.timestamp().microseconds(), packet.timestamp().microseconds());
+    EXPECT_EQ(buffer, packet.pdu()->serialize());
+}
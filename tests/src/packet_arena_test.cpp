@@ -0,0 +1,141 @@
+#include <tins/config.h>
+#include <gtest/gtest.h>
+
+#ifdef TINS_HAVE_CXX11
+
+#include <memory>
+#include <thread>
+#include <tins/packet_arena.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/packet_decoder.h>
+
+using namespace std;
+using namespace Tins;
+
+class PacketArenaTest : public testing::Test {
+public:
+    static PDU::serialization_type make_packet() {
+        EthernetII eth = EthernetII() / IP("1.2.3.4", "5.6.7.8") / TCP(80, 1234) /
+                         RawPDU("hello");
+        return eth.serialize();
+    }
+
+    static PDU* decode(const PDU::serialization_type& buffer, PacketArena& arena) {
+        return PacketDecoder::decode(PDU::ETHERNET_II, &buffer[0], buffer.size(), &arena);
+    }
+};
+
+TEST_F(PacketArenaTest, PDUsUseHeapByDefault) {
+    PDU::serialization_type buffer = make_packet();
+    PacketArena arena;
+    unique_ptr<PDU> pdu(new IP());
+    EXPECT_FALSE(arena.owns(pdu.get()));
+    unique_ptr<EthernetII> eth(new EthernetII(&buffer[0], buffer.size()));
+    EXPECT_FALSE(arena.owns(eth->find_pdu<IP>()));
+    unique_ptr<PDU> decoded(PacketDecoder::decode(PDU::ETHERNET_II, &buffer[0], 
+                                                  buffer.size()));
+    EXPECT_FALSE(arena.owns(decoded->find_pdu<IP>()));
+    EXPECT_EQ(0U, arena.chunk_count());
+}
+
+TEST_F(PacketArenaTest, DecodedPDUsUseArena) {
+    PDU::serialization_type buffer = make_packet();
+    PacketArena arena;
+    unique_ptr<PDU> eth(decode(buffer, arena));
+    ASSERT_TRUE(eth.get() != 0);
+    // The caller owns the outermost PDU, so it's allocated using new
+    EXPECT_FALSE(arena.owns(eth.get()));
+    EXPECT_TRUE(arena.owns(eth->find_pdu<IP>()));
+    EXPECT_TRUE(arena.owns(eth->find_pdu<TCP>()));
+    EXPECT_TRUE(arena.owns(eth->find_pdu<RawPDU>()));
+    unique_ptr<PDU> clone(eth->clone());
+    EXPECT_FALSE(arena.owns(clone->find_pdu<IP>()));
+    EXPECT_EQ(buffer, clone->serialize());
+    EXPECT_EQ(1U, arena.chunk_count());
+}
+
+TEST_F(PacketArenaTest, ChunksAreReused) {
+    PDU::serialization_type buffer = make_packet();
+    PacketArena arena(1024);
+    unique_ptr<PDU> previous;
+    for (size_t i = 0; i < 1000; ++i) {
+        // Keep the previous packet alive, like a SnifferIterator does
+        unique_ptr<PDU> pdu(decode(buffer, arena));
+        EXPECT_TRUE(arena.owns(pdu->inner_pdu()));
+        previous = move(pdu);
+    }
+    EXPECT_LE(arena.chunk_count(), 2U);
+}
+
+TEST_F(PacketArenaTest, LargeAllocationsUseHeap) {
+    PacketArena arena(256);
+    void* small = arena.allocate(16);
+    void* large = arena.allocate(1024);
+    EXPECT_TRUE(arena.owns(small));
+    EXPECT_FALSE(arena.owns(large));
+    EXPECT_EQ(0U, reinterpret_cast<size_t>(small) % 16);
+    EXPECT_EQ(0U, reinterpret_cast<size_t>(large) % 16);
+    PacketArena::deallocate(small);
+    PacketArena::deallocate(large);
+    PacketArena::deallocate(0);
+}
+
+TEST_F(PacketArenaTest, PDUsOutliveArena) {
+    PDU::serialization_type buffer = make_packet();
+    unique_ptr<PDU> pdu;
+    {
+        PacketArena arena;
+        pdu.reset(decode(buffer, arena));
+    }
+    EXPECT_EQ(buffer, pdu->serialize());
+}
+
+TEST_F(PacketArenaTest, DeallocateOnOtherThread) {
+    PDU::serialization_type buffer = make_packet();
+    PacketArena arena;
+    PDU* pdu = decode(buffer, arena);
+    thread([&] {
+        delete pdu;
+    }).join();
+    unique_ptr<PDU> other(decode(buffer, arena));
+    EXPECT_TRUE(arena.owns(other->inner_pdu()));
+    EXPECT_EQ(1U, arena.chunk_count());
+}
+
+TEST_F(PacketArenaTest, ReleasedInnerPDUsUseHeap) {
+    PDU::serialization_type buffer = make_packet();
+    PacketArena arena;
+    unique_ptr<PDU> eth(decode(buffer, arena));
+    unique_ptr<PDU> ip(eth->release_inner_pdu());
+    EXPECT_FALSE(arena.owns(ip.get()));
+    EXPECT_TRUE(eth->inner_pdu() == 0);
+    EXPECT_TRUE(ip->parent_pdu() == 0);
+    EXPECT_EQ("1.2.3.4", ip->rfind_pdu<IP>().dst_addr().to_string());
+    EXPECT_TRUE(ip->find_pdu<RawPDU>() != 0);
+}
+
+TEST_F(PacketArenaTest, ReplaceInnerPDUs) {
+    PDU::serialization_type buffer = make_packet();
+    PacketArena arena;
+    unique_ptr<PDU> eth(decode(buffer, arena));
+    eth->rfind_pdu<IP>().inner_pdu(new UDP(53, 1234));
+    EXPECT_TRUE(eth->find_pdu<TCP>() == 0);
+    EXPECT_TRUE(eth->find_pdu<UDP>() != 0);
+
+    unique_ptr<PDU> copied(decode(buffer, arena));
+    copied->rfind_pdu<IP>() = IP("4.3.2.1") / UDP(1, 2);
+    EXPECT_TRUE(copied->find_pdu<TCP>() == 0);
+    EXPECT_FALSE(arena.owns(copied->find_pdu<UDP>()));
+
+    unique_ptr<PDU> moved(decode(buffer, arena));
+    IP replacement = IP("4.3.2.1") / UDP(1, 2);
+    moved->rfind_pdu<IP>() = move(replacement);
+    EXPECT_TRUE(moved->find_pdu<TCP>() == 0);
+    EXPECT_TRUE(moved->find_pdu<UDP>() != 0);
+}
+
+#endif // TINS_HAVE_CXX11
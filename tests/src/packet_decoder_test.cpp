@@ -0,0 +1,268 @@
+#include <gtest/gtest.h>
+#include <memory>
+#include <tins/packet_decoder.h>
+#include <tins/ethernetII.h>
+#include <tins/loopback.h>
+#include <tins/sll.h>
+#include <tins/dot1q.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/constants.h>
+#include <tins/exceptions.h>
+
+using namespace std;
+using namespace Tins;
+
+class PacketDecoderTest : public testing::Test {
+public:
+    static PDU::serialization_type make_packet() {
+        EthernetII eth = EthernetII() / IP("1.2.3.4", "5.6.7.8") / TCP(80, 1234) /
+                         RawPDU("hello");
+        return eth.serialize();
+    }
+};
+
+TEST_F(PacketDecoderTest, Decoded) {
+    PDU::serialization_type buffer = make_packet();
+    PDU* output = 0;
+    PacketDecoder::Status status = PacketDecoder::decode(PDU::ETHERNET_II, &buffer[0],
+                                                         buffer.size(), output);
+    unique_ptr<PDU> pdu(output);
+    EXPECT_EQ(PacketDecoder::DECODED, status);
+    ASSERT_TRUE(pdu.get() != 0);
+    const TCP& tcp = pdu->rfind_pdu<TCP>();
+    EXPECT_EQ(80, tcp.dport());
+    const RawPDU& raw = pdu->rfind_pdu<RawPDU>();
+    EXPECT_EQ("hello", string(raw.payload().begin(), raw.payload().end()));
+}
+
+TEST_F(PacketDecoderTest, DecodedIPLinkType) {
+    IPv6 ipv6 = IPv6("::1", "::2") / UDP(53, 1234);
+    PDU::serialization_type buffer = ipv6.serialize();
+    PDU* output = 0;
+    PacketDecoder::Status status = PacketDecoder::decode(PDU::IP, &buffer[0],
+                                                         buffer.size(), output);
+    unique_ptr<PDU> pdu(output);
+    EXPECT_EQ(PacketDecoder::DECODED, status);
+    ASSERT_TRUE(pdu.get() != 0);
+    EXPECT_EQ(PDU::IPv6, pdu->pdu_type());
+    EXPECT_TRUE(pdu->find_pdu<UDP>() != 0);
+}
+
+#ifdef TINS_HAVE_CXX11
+
+TEST_F(PacketDecoderTest, TruncatedTransportLayer) {
+    IP ip = IP("1.2.3.4", "5.6.7.8") / TCP(80, 1234);
+    PDU::serialization_type buffer = ip.serialize();
+    // Leave only half of the TCP header
+    buffer.resize(buffer.size() - 10);
+    PDU* output = 0;
+    PacketDecoder::Status status = PacketDecoder::decode(PDU::IP, &buffer[0],
+                                                         buffer.size(), output);
+    unique_ptr<PDU> pdu(output);
+    EXPECT_EQ(PacketDecoder::TRUNCATED, status);
+    ASSERT_TRUE(pdu.get() != 0);
+    EXPECT_TRUE(pdu->find_pdu<TCP>() == 0);
+    const RawPDU* raw = pdu->find_pdu<RawPDU>();
+    ASSERT_TRUE(raw != 0);
+    EXPECT_EQ(10U, raw->payload_size());
+}
+
+TEST_F(PacketDecoderTest, TruncatedStatusIsReset) {
+    IP ip = IP("1.2.3.4", "5.6.7.8") / TCP(80, 1234);
+    PDU::serialization_type truncated = ip.serialize();
+    truncated.resize(truncated.size() - 10);
+    delete PacketDecoder::decode(PDU::IP, &truncated[0], truncated.size());
+
+    PDU::serialization_type buffer = make_packet();
+    PDU* output = 0;
+    PacketDecoder::Status status = PacketDecoder::decode(PDU::ETHERNET_II, &buffer[0],
+                                                         buffer.size(), output);
+    delete output;
+    EXPECT_EQ(PacketDecoder::DECODED, status);
+}
+
+TEST_F(PacketDecoderTest, TruncatedIPv6ExtensionHeader) {
+    EthernetII eth = EthernetII() / IPv6("::1", "::2");
+    PDU::serialization_type buffer = eth.serialize();
+    // A hop by hop header which only contains its next header field
+    buffer[14 + 6] = IPv6::HOP_BY_HOP;
+    buffer.push_back(Constants::IP::PROTO_UDP);
+    PDU* output = 0;
+    PacketDecoder::Status status = PacketDecoder::decode(PDU::ETHERNET_II, &buffer[0],
+                                                         buffer.size(), output);
+    unique_ptr<PDU> pdu(output);
+    EXPECT_EQ(PacketDecoder::TRUNCATED, status);
+    ASSERT_TRUE(pdu.get() != 0);
+    EXPECT_TRUE(pdu->find_pdu<IPv6>() == 0);
+    EXPECT_EQ(buffer.size() - 14, pdu->rfind_pdu<RawPDU>().payload_size());
+
+    // The same header is malformed when it's the link layer
+    EXPECT_TRUE(PacketDecoder::decode(PDU::IP, &buffer[14], buffer.size() - 14) == 0);
+    // Constructing it directly still throws
+    EXPECT_THROW(IPv6(&buffer[14], buffer.size() - 14), malformed_packet);
+}
+
+TEST_F(PacketDecoderTest, TruncatedIPAfterLoopback) {
+    Loopback loopback = Loopback() / IP("1.2.3.4", "5.6.7.8") / TCP(80, 1234);
+    PDU::serialization_type buffer = loopback.serialize();
+    // Leave only half of the IP header
+    buffer.resize(4 + 10);
+    PDU* output = 0;
+    PacketDecoder::Status status = PacketDecoder::decode(PDU::LOOPBACK, &buffer[0],
+                                                         buffer.size(), output);
+    unique_ptr<PDU> pdu(output);
+    EXPECT_EQ(PacketDecoder::TRUNCATED, status);
+    ASSERT_TRUE(pdu.get() != 0);
+    EXPECT_EQ(PDU::LOOPBACK, pdu->pdu_type());
+    EXPECT_TRUE(pdu->find_pdu<IP>() == 0);
+    EXPECT_EQ(10U, pdu->rfind_pdu<RawPDU>().payload_size());
+}
+
+TEST_F(PacketDecoderTest, TruncatedIPAfterSLL) {
+    SLL sll = SLL() / IP("1.2.3.4", "5.6.7.8") / TCP(80, 1234);
+    PDU::serialization_type buffer = sll.serialize();
+    const uint32_t sll_size = sll.header_size();
+    buffer.resize(sll_size + 10);
+    PDU* output = 0;
+    PacketDecoder::Status status = PacketDecoder::decode(PDU::SLL, &buffer[0],
+                                                         buffer.size(), output);
+    unique_ptr<PDU> pdu(output);
+    EXPECT_EQ(PacketDecoder::TRUNCATED, status);
+    ASSERT_TRUE(pdu.get() != 0);
+    EXPECT_EQ(PDU::SLL, pdu->pdu_type());
+    EXPECT_TRUE(pdu->find_pdu<IP>() == 0);
+    EXPECT_EQ(10U, pdu->rfind_pdu<RawPDU>().payload_size());
+}
+
+#endif // TINS_HAVE_CXX11
+
+TEST_F(PacketDecoderTest, MalformedLinkLayer) {
+    PDU::serialization_type buffer = make_packet();
+    PDU* output = 0;
+    PacketDecoder::Status status = PacketDecoder::decode(PDU::ETHERNET_II, &buffer[0],
+                                                         10, output);
+    EXPECT_EQ(PacketDecoder::MALFORMED, status);
+    EXPECT_TRUE(output == 0);
+}
+
+TEST_F(PacketDecoderTest, MalformedIPVersion) {
+    IP ip = IP("1.2.3.4", "5.6.7.8") / UDP(53, 1234);
+    PDU::serialization_type buffer = ip.serialize();
+    buffer[0] = (buffer[0] & 0x0f) | 0x50;
+    PDU* output = 0;
+    PacketDecoder::Status status = PacketDecoder::decode(PDU::IP, &buffer[0],
+                                                         buffer.size(), output);
+    EXPECT_EQ(PacketDecoder::MALFORMED, status);
+    EXPECT_TRUE(output == 0);
+}
+
+TEST_F(PacketDecoderTest, MalformedIPHeaderLength) {
+    IP ip = IP("1.2.3.4", "5.6.7.8") / UDP(53, 1234);
+    PDU::serialization_type buffer = ip.serialize();
+    // An IHL of 2 is shorter than the fixed header
+    buffer[0] = (buffer[0] & 0xf0) | 0x02;
+    EXPECT_TRUE(PacketDecoder::decode(PDU::IP, &buffer[0], buffer.size()) == 0);
+}
+
+TEST_F(PacketDecoderTest, Unsupported) {
+    PDU::serialization_type buffer = make_packet();
+    PDU* output = 0;
+    PacketDecoder::Status status = PacketDecoder::decode(PDU::UNKNOWN, &buffer[0],
+                                                         buffer.size(), output);
+    EXPECT_EQ(PacketDecoder::UNSUPPORTED, status);
+    EXPECT_TRUE(output == 0);
+}
+
+TEST_F(PacketDecoderTest, ConvenienceOverload) {
+    PDU::serialization_type buffer = make_packet();
+    unique_ptr<PDU> pdu(PacketDecoder::decode(PDU::ETHERNET_II, &buffer[0],
+                                              buffer.size()));
+    ASSERT_TRUE(pdu.get() != 0);
+    EXPECT_TRUE(pdu->find_pdu<TCP>() != 0);
+    EXPECT_TRUE(PacketDecoder::decode(PDU::ETHERNET_II, &buffer[0], 5) == 0);
+}
+
+#ifdef TINS_HAVE_CXX11
+
+TEST_F(PacketDecoderTest, DepthScope) {
+    EXPECT_EQ(PacketDecoder::ALL_LAYERS, PacketDecoder::depth_scope::max_layer());
+    {
+        PacketDecoder::depth_scope scope1(PacketDecoder::NETWORK_LAYER);
+        EXPECT_EQ(PacketDecoder::NETWORK_LAYER, PacketDecoder::depth_scope::max_layer());
+        {
+            PacketDecoder::depth_scope scope2(PacketDecoder::LINK_LAYER);
+            EXPECT_EQ(PacketDecoder::LINK_LAYER, PacketDecoder::depth_scope::max_layer());
+        }
+        EXPECT_EQ(PacketDecoder::NETWORK_LAYER, PacketDecoder::depth_scope::max_layer());
+    }
+    EXPECT_EQ(PacketDecoder::ALL_LAYERS, PacketDecoder::depth_scope::max_layer());
+}
+
+TEST_F(PacketDecoderTest, DecodeUpToLinkLayer) {
+    EthernetII eth = EthernetII() / Dot1Q(10) / IP("1.2.3.4", "5.6.7.8") /
+                     TCP(80, 1234);
+    PDU::serialization_type buffer = eth.serialize();
+    PacketDecoder::depth_scope depth(PacketDecoder::LINK_LAYER);
+    PDU* output = 0;
+    PacketDecoder::Status status = PacketDecoder::decode(PDU::ETHERNET_II, &buffer[0],
+                                                         buffer.size(), output);
+    unique_ptr<PDU> pdu(output);
+    // Skipped layers are not reported as truncated
+    EXPECT_EQ(PacketDecoder::DECODED, status);
+    ASSERT_TRUE(pdu.get() != 0);
+    ASSERT_TRUE(pdu->find_pdu<Dot1Q>() != 0);
+    EXPECT_TRUE(pdu->find_pdu<IP>() == 0);
+    EXPECT_EQ(PDU::RAW, pdu->rfind_pdu<Dot1Q>().inner_pdu()->pdu_type());
+}
+
+TEST_F(PacketDecoderTest, DecodeUpToNetworkLayer) {
+    EthernetII eth = EthernetII() / IP("1.2.3.4", "5.6.7.8") /
+                     IPv6("::1", "::2") / UDP(53, 1234);
+    PDU::serialization_type buffer = eth.serialize();
+    PacketDecoder::depth_scope depth(PacketDecoder::NETWORK_LAYER);
+    unique_ptr<PDU> pdu(PacketDecoder::decode(PDU::ETHERNET_II, &buffer[0],
+                                              buffer.size()));
+    ASSERT_TRUE(pdu.get() != 0);
+    // Tunneled datagrams are in the network layer as well
+    EXPECT_TRUE(pdu->find_pdu<IP>() != 0);
+    ASSERT_TRUE(pdu->find_pdu<IPv6>() != 0);
+    EXPECT_TRUE(pdu->find_pdu<UDP>() == 0);
+    EXPECT_EQ(8U, pdu->rfind_pdu<RawPDU>().payload_size());
+}
+
+TEST_F(PacketDecoderTest, DecodeUpToTransportLayer) {
+    PDU::serialization_type buffer = make_packet();
+    PacketDecoder::depth_scope depth(PacketDecoder::TRANSPORT_LAYER);
+    unique_ptr<PDU> pdu(PacketDecoder::decode(PDU::ETHERNET_II, &buffer[0],
+                                              buffer.size()));
+    ASSERT_TRUE(pdu.get() != 0);
+    EXPECT_TRUE(pdu->find_pdu<TCP>() != 0);
+}
+
+TEST_F(PacketDecoderTest, FirstLayerIsAlwaysDecoded) {
+    IP ip = IP("1.2.3.4", "5.6.7.8") / TCP(80, 1234);
+    PDU::serialization_type buffer = ip.serialize();
+    PacketDecoder::depth_scope depth(PacketDecoder::LINK_LAYER);
+    unique_ptr<PDU> pdu(PacketDecoder::decode(PDU::IP, &buffer[0], buffer.size()));
+    ASSERT_TRUE(pdu.get() != 0);
+    EXPECT_EQ(PDU::IP, pdu->pdu_type());
+    EXPECT_TRUE(pdu->find_pdu<TCP>() == 0);
+}
+
+#endif // TINS_HAVE_CXX11
+
+TEST_F(PacketDecoderTest, LayerOf) {
+    EXPECT_EQ(PacketDecoder::LINK_LAYER, PacketDecoder::layer_of(PDU::ETHERNET_II));
+    EXPECT_EQ(PacketDecoder::LINK_LAYER, PacketDecoder::layer_of(PDU::DOT1Q));
+    EXPECT_EQ(PacketDecoder::NETWORK_LAYER, PacketDecoder::layer_of(PDU::IP));
+    EXPECT_EQ(PacketDecoder::NETWORK_LAYER, PacketDecoder::layer_of(PDU::ARP));
+    EXPECT_EQ(PacketDecoder::TRANSPORT_LAYER, PacketDecoder::layer_of(PDU::TCP));
+    EXPECT_EQ(PacketDecoder::ALL_LAYERS, PacketDecoder::layer_of(PDU::DNS));
+    EXPECT_EQ(PacketDecoder::ALL_LAYERS, PacketDecoder::layer_of(PDU::RAW));
+    EXPECT_EQ(PacketDecoder::ALL_LAYERS,
+              PacketDecoder::layer_of(static_cast<PDU::PDUType>(PDU::USER_DEFINED_PDU + 5)));
+}
@@ -0,0 +1,168 @@
+#include <tins/config.h>
+#include <gtest/gtest.h>
+
+#ifdef TINS_HAVE_CXX11
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <tins/packet_queue.h>
+#include <tins/packet.h>
+#include <tins/lazy_packet.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/udp.h>
+
+using namespace std;
+using namespace Tins;
+
+class PacketQueueTest : public testing::Test {
+public:
+    static Packet make_packet(uint16_t port) {
+        EthernetII eth = EthernetII() / IP("1.2.3.4", "5.6.7.8") / UDP(port, 1234);
+        return Packet(eth.clone(), Timestamp(), Packet::own_pdu());
+    }
+};
+
+TEST_F(PacketQueueTest, CapacityIsRoundedUp) {
+    EXPECT_EQ(8UL, SPSCQueue<int>(5).capacity());
+    EXPECT_EQ(8UL, SPSCQueue<int>(8).capacity());
+    EXPECT_EQ(2UL, SPSCQueue<int>(0).capacity());
+    EXPECT_EQ(16UL, MPMCQueue<int>(9).capacity());
+}
+
+TEST_F(PacketQueueTest, SPSCPushAndPop) {
+    SPSCQueue<int> queue(4);
+    int value = 0;
+    EXPECT_TRUE(queue.empty());
+    EXPECT_FALSE(queue.try_pop(value));
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(queue.try_push(int(i)));
+    }
+    EXPECT_EQ(4UL, queue.size());
+    EXPECT_FALSE(queue.try_push(4));
+    // Wrap around a few times
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(queue.try_pop(value));
+        EXPECT_EQ(i, value);
+        EXPECT_TRUE(queue.try_push(i + 4));
+    }
+    for (int i = 10; i < 14; ++i) {
+        EXPECT_TRUE(queue.try_pop(value));
+        EXPECT_EQ(i, value);
+    }
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST_F(PacketQueueTest, MPMCPushAndPop) {
+    MPMCQueue<int> queue(4);
+    int value = 0;
+    EXPECT_FALSE(queue.try_pop(value));
+    for (int i = 0; i < 4; ++i) {
+        EXPECT_TRUE(queue.try_push(int(i)));
+    }
+    EXPECT_FALSE(queue.try_push(4));
+    EXPECT_EQ(4UL, queue.size());
+    for (int i = 0; i < 10; ++i) {
+        EXPECT_TRUE(queue.try_pop(value));
+        EXPECT_EQ(i, value);
+        EXPECT_TRUE(queue.try_push(i + 4));
+    }
+    EXPECT_EQ(4UL, queue.size());
+}
+
+TEST_F(PacketQueueTest, MovesPackets) {
+    SPSCQueue<Packet> queue(4);
+    Packet packet = make_packet(80);
+    const PDU* pdu = packet.pdu();
+    EXPECT_TRUE(queue.try_push(move(packet)));
+    EXPECT_TRUE(packet.pdu() == 0);
+
+    Packet output;
+    EXPECT_TRUE(queue.try_pop(output));
+    // The PDU is handed over, not copied
+    EXPECT_EQ(pdu, output.pdu());
+    EXPECT_EQ(80, output.pdu()->rfind_pdu<UDP>().dport());
+}
+
+TEST_F(PacketQueueTest, FailedPushDoesNotMove) {
+    SPSCQueue<Packet> queue(2);
+    EXPECT_TRUE(queue.try_push(make_packet(1)));
+    EXPECT_TRUE(queue.try_push(make_packet(2)));
+    Packet packet = make_packet(3);
+    EXPECT_FALSE(queue.try_push(move(packet)));
+    EXPECT_TRUE(packet.pdu() != 0);
+}
+
+TEST_F(PacketQueueTest, MovesLazyPackets) {
+    MPMCQueue<LazyPacket> queue(4);
+    PDU::serialization_type buffer = make_packet(53).pdu()->serialize();
+    EXPECT_TRUE(queue.try_push(LazyPacket(PDU::ETHERNET_II, &buffer[0],
+                                          buffer.size(), Timestamp())));
+    LazyPacket output;
+    EXPECT_TRUE(queue.try_pop(output));
+    EXPECT_EQ(53, output.pdu()->rfind_pdu<UDP>().dport());
+}
+
+TEST_F(PacketQueueTest, SPSCAcrossThreads) {
+    const size_t count = 200000;
+    SPSCQueue<size_t> queue(64);
+    thread producer([&]() {
+        for (size_t i = 0; i < count; ++i) {
+            while (!queue.try_push(size_t(i))) {
+                this_thread::yield();
+            }
+        }
+    });
+    size_t expected = 0;
+    bool in_order = true;
+    while (expected < count) {
+        size_t value;
+        if (queue.try_pop(value)) {
+            in_order = in_order && value == expected;
+            expected++;
+        }
+    }
+    producer.join();
+    EXPECT_TRUE(in_order);
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST_F(PacketQueueTest, MPMCAcrossThreads) {
+    const size_t producers = 4, consumers = 4, count = 50000;
+    MPMCQueue<size_t> queue(128);
+    atomic<size_t> popped(0);
+    atomic<uint64_t> sum(0);
+    vector<thread> threads;
+    for (size_t i = 0; i < producers; ++i) {
+        threads.emplace_back([&, i]() {
+            for (size_t j = 0; j < count; ++j) {
+                while (!queue.try_push(i * count + j + 1)) {
+                    this_thread::yield();
+                }
+            }
+        });
+    }
+    for (size_t i = 0; i < consumers; ++i) {
+        threads.emplace_back([&]() {
+            size_t value;
+            while (popped.load() < producers * count) {
+                if (queue.try_pop(value)) {
+                    sum += value;
+                    popped++;
+                }
+                else {
+                    this_thread::yield();
+                }
+            }
+        });
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    const uint64_t total = producers * count;
+    EXPECT_EQ(total, popped.load());
+    EXPECT_EQ(total * (total + 1) / 2, sum.load());
+}
+
+#endif // TINS_HAVE_CXX11
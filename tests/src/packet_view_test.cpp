@@ -0,0 +1,235 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <tins/packet_view.h>
+#include <tins/ethernetII.h>
+#include <tins/dot1q.h>
+#include <tins/ip.h>
+#include <tins/ipv6.h>
+#include <tins/arp.h>
+#include <tins/icmp.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/exceptions.h>
+#include <tins/constants.h>
+
+using namespace std;
+using namespace Tins;
+
+class PacketViewTest : public testing::Test {
+public:
+    static string payload_of(const PacketView& view) {
+        return string(view.payload(), view.payload() + view.payload_size());
+    }
+};
+
+TEST_F(PacketViewTest, DefaultConstructor) {
+    PacketView view;
+    EXPECT_EQ(0U, view.layer_count());
+    EXPECT_FALSE(view.is_malformed());
+    EXPECT_EQ(0U, view.payload_size());
+    EXPECT_FALSE(view.has_layer(PDU::IP));
+    EXPECT_THROW(view.ip(), pdu_not_found);
+}
+
+TEST_F(PacketViewTest, EthernetIPTCP) {
+    TCP tcp(80, 1234);
+    tcp.seq(0x12345678);
+    tcp.ack_seq(0x87654321);
+    tcp.flags(TCP::SYN | TCP::ACK);
+    tcp.window(4321);
+    IP ip("1.2.3.4", "5.6.7.8");
+    ip.ttl(23);
+    ip.id(0x1234);
+    EthernetII eth = EthernetII("00:01:02:03:04:05", "06:07:08:09:0a:0b") / ip / tcp /
+                     RawPDU("hello");
+    PDU::serialization_type buffer = eth.serialize();
+    PacketView view(PDU::ETHERNET_II, &buffer[0], buffer.size());
+
+    EXPECT_FALSE(view.is_malformed());
+    ASSERT_EQ(3U, view.layer_count());
+    EXPECT_EQ(PDU::ETHERNET_II, view.layer_at(0).type);
+    EXPECT_EQ(0U, view.layer_at(0).offset);
+    EXPECT_EQ(14U, view.layer_at(0).header_size);
+    EXPECT_EQ(PDU::IP, view.layer_at(1).type);
+    EXPECT_EQ(14U, view.layer_at(1).offset);
+    EXPECT_EQ(20U, view.layer_at(1).header_size);
+    EXPECT_EQ(PDU::TCP, view.layer_at(2).type);
+    EXPECT_EQ(34U, view.layer_at(2).offset);
+
+    EXPECT_EQ(EthernetII::address_type("00:01:02:03:04:05"), view.ethernet().dst_addr());
+    EXPECT_EQ(EthernetII::address_type("06:07:08:09:0a:0b"), view.ethernet().src_addr());
+    EXPECT_EQ(0x0800, view.ethernet().payload_type());
+
+    EXPECT_EQ(IPv4Address("1.2.3.4"), view.ip().dst_addr());
+    EXPECT_EQ(IPv4Address("5.6.7.8"), view.ip().src_addr());
+    EXPECT_EQ(Constants::IP::PROTO_TCP, view.ip().protocol());
+    EXPECT_EQ(23, view.ip().ttl());
+    EXPECT_EQ(0x1234, view.ip().id());
+    EXPECT_EQ(5, view.ip().head_len());
+    EXPECT_EQ(20 + 20 + 5, view.ip().tot_len());
+
+    EXPECT_EQ(80, view.tcp().dport());
+    EXPECT_EQ(1234, view.tcp().sport());
+    EXPECT_EQ(0x12345678U, view.tcp().seq());
+    EXPECT_EQ(0x87654321U, view.tcp().ack_seq());
+    EXPECT_EQ(4321, view.tcp().window());
+    EXPECT_EQ(5, view.tcp().data_offset());
+    EXPECT_TRUE(view.tcp().has_flags(TCP::SYN | TCP::ACK));
+    EXPECT_FALSE(view.tcp().has_flags(TCP::RST));
+
+    EXPECT_EQ("hello", payload_of(view));
+    EXPECT_THROW(view.udp(), pdu_not_found);
+    EXPECT_THROW(view.ipv6(), pdu_not_found);
+}
+
+TEST_F(PacketViewTest, TCPOptions) {
+    TCP tcp(80, 1234);
+    tcp.mss(1460);
+    EthernetII eth = EthernetII() / IP() / tcp / RawPDU("data");
+    PDU::serialization_type buffer = eth.serialize();
+    PacketView view(PDU::ETHERNET_II, &buffer[0], buffer.size());
+    ASSERT_TRUE(view.has_layer(PDU::TCP));
+    EXPECT_EQ(tcp.header_size(), view.find_layer(PDU::TCP)->header_size);
+    EXPECT_EQ("data", payload_of(view));
+}
+
+TEST_F(PacketViewTest, Dot1Q) {
+    EthernetII eth = EthernetII() / Dot1Q(42) / IP("1.2.3.4") / UDP(53, 1000) /
+                     RawPDU("query");
+    PDU::serialization_type buffer = eth.serialize();
+    PacketView view(PDU::ETHERNET_II, &buffer[0], buffer.size());
+    ASSERT_EQ(4U, view.layer_count());
+    EXPECT_EQ(PDU::DOT1Q, view.layer_at(1).type);
+    EXPECT_EQ(42, view.dot1q().id());
+    EXPECT_EQ(0x0800, view.dot1q().payload_type());
+    EXPECT_EQ(53, view.udp().dport());
+    EXPECT_EQ(1000, view.udp().sport());
+    EXPECT_EQ(8 + 5, view.udp().length());
+    EXPECT_EQ("query", payload_of(view));
+}
+
+TEST_F(PacketViewTest, IPv6) {
+    IPv6 ipv6("::1", "fe80::2");
+    ipv6.hop_limit(12);
+    EthernetII eth = EthernetII() / ipv6 / UDP(5353, 5353) / RawPDU("mdns");
+    PDU::serialization_type buffer = eth.serialize();
+    PacketView view(PDU::ETHERNET_II, &buffer[0], buffer.size());
+    ASSERT_EQ(3U, view.layer_count());
+    EXPECT_EQ(PDU::IPv6, view.layer_at(1).type);
+    EXPECT_EQ(IPv6Address("::1"), view.ipv6().dst_addr());
+    EXPECT_EQ(IPv6Address("fe80::2"), view.ipv6().src_addr());
+    EXPECT_EQ(12, view.ipv6().hop_limit());
+    EXPECT_EQ(Constants::IP::PROTO_UDP, view.ipv6().next_header());
+    EXPECT_EQ(8 + 4, view.ipv6().payload_length());
+    EXPECT_EQ(5353, view.udp().dport());
+    EXPECT_EQ("mdns", payload_of(view));
+}
+
+TEST_F(PacketViewTest, RawIPLinkType) {
+    PDU::serialization_type buffer = (IPv6() / TCP(22, 2222)).serialize();
+    PacketView view(PDU::IP, &buffer[0], buffer.size());
+    ASSERT_EQ(2U, view.layer_count());
+    EXPECT_EQ(PDU::IPv6, view.layer_at(0).type);
+    EXPECT_EQ(22, view.tcp().dport());
+
+    buffer = (IP() / TCP(22, 2222)).serialize();
+    view.parse(PDU::IP, &buffer[0], buffer.size());
+    ASSERT_EQ(2U, view.layer_count());
+    EXPECT_EQ(PDU::IP, view.layer_at(0).type);
+    EXPECT_EQ(2222, view.tcp().sport());
+}
+
+TEST_F(PacketViewTest, ARP) {
+    EthernetII eth = ARP::make_arp_request("1.2.3.4", "5.6.7.8", "00:01:02:03:04:05");
+    PDU::serialization_type buffer = eth.serialize();
+    PacketView view(PDU::ETHERNET_II, &buffer[0], buffer.size());
+    ASSERT_EQ(2U, view.layer_count());
+    EXPECT_EQ(ARP::REQUEST, view.arp().opcode());
+    EXPECT_EQ(IPv4Address("1.2.3.4"), view.arp().target_ip_addr());
+    EXPECT_EQ(IPv4Address("5.6.7.8"), view.arp().sender_ip_addr());
+    EXPECT_EQ(ARP::hwaddress_type("00:01:02:03:04:05"), view.arp().sender_hw_addr());
+}
+
+TEST_F(PacketViewTest, ICMP) {
+    ICMP icmp(ICMP::ECHO_REQUEST);
+    icmp.id(0x1234);
+    icmp.sequence(7);
+    PDU::serialization_type buffer = (IP() / icmp).serialize();
+    PacketView view(PDU::IP, &buffer[0], buffer.size());
+    ASSERT_EQ(2U, view.layer_count());
+    EXPECT_EQ(ICMP::ECHO_REQUEST, view.icmp().type());
+    EXPECT_EQ(0, view.icmp().code());
+    EXPECT_EQ(0x1234, view.icmp().id());
+    EXPECT_EQ(7, view.icmp().sequence());
+}
+
+TEST_F(PacketViewTest, FragmentsAreNotDissected) {
+    IP ip = IP("1.2.3.4") / UDP(53, 53) / RawPDU("fragment");
+    ip.flags(IP::MORE_FRAGMENTS);
+    PDU::serialization_type buffer = ip.serialize();
+    PacketView view(PDU::IP, &buffer[0], buffer.size());
+    EXPECT_FALSE(view.is_malformed());
+    ASSERT_EQ(1U, view.layer_count());
+    EXPECT_EQ(buffer.size() - 20, view.payload_size());
+
+    ip.flags(IP::FLAG_RESERVED);
+    ip.fragment_offset(10);
+    buffer = ip.serialize();
+    view.parse(PDU::IP, &buffer[0], buffer.size());
+    EXPECT_EQ(1U, view.layer_count());
+}
+
+TEST_F(PacketViewTest, LinkLayerPaddingIsIgnored) {
+    PDU::serialization_type buffer = (EthernetII() / IP() / UDP(1, 2) /
+                                      RawPDU("abc")).serialize();
+    buffer.insert(buffer.end(), 20, 0);
+    PacketView view(PDU::ETHERNET_II, &buffer[0], buffer.size());
+    EXPECT_FALSE(view.is_malformed());
+    EXPECT_EQ("abc", payload_of(view));
+}
+
+TEST_F(PacketViewTest, TruncatedHeader) {
+    PDU::serialization_type buffer = (EthernetII() / IP() / TCP()).serialize();
+    // Cut the TCP header in half
+    PacketView view(PDU::ETHERNET_II, &buffer[0], 14 + 20 + 10);
+    EXPECT_TRUE(view.is_malformed());
+    ASSERT_EQ(2U, view.layer_count());
+    EXPECT_FALSE(view.has_layer(PDU::TCP));
+    EXPECT_EQ(10U, view.payload_size());
+    EXPECT_FALSE(view.parse(PDU::ETHERNET_II, &buffer[0], 10));
+    EXPECT_EQ(0U, view.layer_count());
+}
+
+TEST_F(PacketViewTest, InvalidHeaderLength) {
+    PDU::serialization_type buffer = (IP() / TCP()).serialize();
+    // IHL smaller than the minimum header size
+    buffer[0] = 0x42;
+    PacketView view(PDU::IP, &buffer[0], buffer.size());
+    EXPECT_TRUE(view.is_malformed());
+    EXPECT_EQ(0U, view.layer_count());
+
+    // Data offset pointing past the end of the buffer
+    buffer = (IP() / TCP()).serialize();
+    buffer[20 + 12] = 0xf0;
+    view.parse(PDU::IP, &buffer[0], buffer.size());
+    EXPECT_TRUE(view.is_malformed());
+    EXPECT_EQ(1U, view.layer_count());
+}
+
+TEST_F(PacketViewTest, TruncatedIPv6ExtensionHeader) {
+    IPv6 ipv6;
+    ipv6.add_header(IPv6::ext_header(IPv6::HOP_BY_HOP));
+    PDU::serialization_type buffer = (ipv6 / UDP()).serialize();
+    PacketView view(PDU::IPv6, &buffer[0], 40 + 2);
+    EXPECT_TRUE(view.is_malformed());
+    EXPECT_EQ(0U, view.layer_count());
+}
+
+TEST_F(PacketViewTest, UnsupportedLinkType) {
+    const uint8_t buffer[] = { 1, 2, 3, 4 };
+    PacketView view(PDU::RADIOTAP, buffer, sizeof(buffer));
+    EXPECT_FALSE(view.is_malformed());
+    EXPECT_EQ(0U, view.layer_count());
+    EXPECT_EQ(sizeof(buffer), view.payload_size());
+}
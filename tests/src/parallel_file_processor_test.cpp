@@ -0,0 +1,215 @@
+#include <tins/config.h>
+#include <gtest/gtest.h>
+
+#ifdef TINS_HAVE_CXX11
+
+#include <cstdio>
+#include <map>
+#include <atomic>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <tins/parallel_file_processor.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/arp.h>
+#include <tins/rawpdu.h>
+#include "tests/pcap_file.h"
+
+using namespace std;
+using namespace Tins;
+
+class ParallelFileProcessorTest : public testing::Test {
+public:
+    static const char* file_name;
+    static const uint16_t packet_count;
+
+    void TearDown() {
+        remove(file_name);
+    }
+
+    // Writes packet_count TCP packets. Packet i uses source port i and 
+    // belongs to flow i % 10, in alternating directions
+    static void write_file() {
+        PcapFileBuilder builder;
+        for (uint16_t i = 0; i < packet_count; ++i) {
+            const uint16_t flow = i % 10;
+            EthernetII eth;
+            if (i % 2 == 0) {
+                eth /= IP("10.0.0.1", "10.0.0.2") / TCP(80, 1000 + flow);
+            }
+            else {
+                eth /= IP("10.0.0.2", "10.0.0.1") / TCP(1000 + flow, 80);
+            }
+            // Use variable sizes so chunk boundaries fall in the middle of records
+            eth /= RawPDU(string(i % 37, 'a'));
+            eth.rfind_pdu<IP>().id(i);
+            builder.add_record(eth, 1500000000);
+        }
+        builder.write(file_name);
+    }
+
+    static uint16_t flow_port(const PDU& pdu) {
+        const TCP& tcp = pdu.rfind_pdu<TCP>();
+        return tcp.dport() == 80 ? tcp.sport() : tcp.dport();
+    }
+};
+
+const char* ParallelFileProcessorTest::file_name = "parallel_file_processor_test.pcap";
+const uint16_t ParallelFileProcessorTest::packet_count = 500;
+
+TEST_F(ParallelFileProcessorTest, ChunksAreContiguous) {
+    write_file();
+    ParallelFileProcessor processor(file_name, 4);
+    EXPECT_EQ(4UL, processor.size());
+    EXPECT_EQ(ParallelFileProcessor::CHUNKS, processor.partition_mode());
+    EXPECT_EQ(24U, processor.worker_range(0).begin);
+    for (size_t i = 1; i < processor.size(); ++i) {
+        EXPECT_EQ(processor.worker_range(i - 1).end, processor.worker_range(i).begin);
+        EXPECT_LT(processor.worker_range(i).begin, processor.worker_range(i).end);
+    }
+    PcapFileReader reader(file_name);
+    EXPECT_EQ(reader.file_size(), processor.worker_range(3).end);
+}
+
+TEST_F(ParallelFileProcessorTest, EveryPacketIsProcessedOnce) {
+    write_file();
+    ParallelFileProcessor processor(file_name, 4);
+    vector<vector<uint16_t> > ids(processor.size());
+    processor.process([&](size_t index) {
+        vector<uint16_t>* output = &ids[index];
+        return [output](PDU& pdu) {
+            output->push_back(pdu.rfind_pdu<IP>().id());
+            return true;
+        };
+    });
+    vector<uint16_t> all_ids;
+    for (size_t i = 0; i < ids.size(); ++i) {
+        EXPECT_FALSE(ids[i].empty());
+        // Each chunk is processed in file order
+        for (size_t j = 1; j < ids[i].size(); ++j) {
+            EXPECT_EQ(ids[i][j - 1] + 1, ids[i][j]);
+        }
+        all_ids.insert(all_ids.end(), ids[i].begin(), ids[i].end());
+    }
+    ASSERT_EQ(packet_count, all_ids.size());
+    for (uint16_t i = 0; i < packet_count; ++i) {
+        EXPECT_EQ(i, all_ids[i]);
+    }
+}
+
+TEST_F(ParallelFileProcessorTest, MoreWorkersThanRecords) {
+    write_file();
+    ParallelFileProcessor processor(file_name, 1000);
+    size_t total = 0;
+    vector<size_t> counts(processor.size());
+    processor.process([&](size_t index) {
+        size_t* count = &counts[index];
+        return [count](Packet&) {
+            (*count)++;
+            return true;
+        };
+    });
+    for (size_t i = 0; i < counts.size(); ++i) {
+        total += counts[i];
+    }
+    EXPECT_EQ(packet_count, total);
+}
+
+TEST_F(ParallelFileProcessorTest, FlowHashPartitioning) {
+    write_file();
+    ParallelFileProcessor processor(file_name, 3, ParallelFileProcessor::FLOW_HASH);
+    vector<set<uint16_t> > flows(processor.size());
+    vector<size_t> counts(processor.size());
+    processor.process([&](size_t index) {
+        set<uint16_t>* output = &flows[index];
+        size_t* count = &counts[index];
+        return [output, count](PDU& pdu) {
+            output->insert(flow_port(pdu));
+            (*count)++;
+            return true;
+        };
+    });
+    map<uint16_t, size_t> owners;
+    size_t total = 0;
+    for (size_t i = 0; i < flows.size(); ++i) {
+        total += counts[i];
+        for (set<uint16_t>::const_iterator iter = flows[i].begin(); iter != flows[i].end(); ++iter) {
+            // A flow can't be seen by more than one worker
+            EXPECT_TRUE(owners.insert(make_pair(*iter, i)).second);
+        }
+    }
+    EXPECT_EQ(10UL, owners.size());
+    EXPECT_EQ(packet_count, total);
+}
+
+TEST_F(ParallelFileProcessorTest, FlowHash) {
+    PDU::serialization_type forward = (EthernetII() / IP("1.2.3.4", "5.6.7.8") /
+                                       TCP(80, 1234)).serialize();
+    PDU::serialization_type backward = (EthernetII() / IP("5.6.7.8", "1.2.3.4") /
+                                        TCP(1234, 80)).serialize();
+    PDU::serialization_type other_port = (EthernetII() / IP("1.2.3.4", "5.6.7.8") /
+                                          TCP(81, 1234)).serialize();
+    PDU::serialization_type udp = (EthernetII() / IP("1.2.3.4", "5.6.7.8") /
+                                   UDP(80, 1234)).serialize();
+    PDU::serialization_type arp = (EthernetII() / ARP()).serialize();
+    const uint32_t hash = ParallelFileProcessor::flow_hash(PDU::ETHERNET_II, &forward[0],
+                                                           forward.size());
+    EXPECT_EQ(hash, ParallelFileProcessor::flow_hash(PDU::ETHERNET_II, &backward[0],
+                                                     backward.size()));
+    EXPECT_NE(hash, ParallelFileProcessor::flow_hash(PDU::ETHERNET_II, &other_port[0],
+                                                     other_port.size()));
+    EXPECT_NE(hash, ParallelFileProcessor::flow_hash(PDU::ETHERNET_II, &udp[0],
+                                                     udp.size()));
+    EXPECT_EQ(0U, ParallelFileProcessor::flow_hash(PDU::ETHERNET_II, &arp[0], arp.size()));
+}
+
+TEST_F(ParallelFileProcessorTest, Stop) {
+    write_file();
+    ParallelFileProcessor processor(file_name, 2);
+    vector<size_t> counts(processor.size());
+    processor.process([&](size_t index) {
+        size_t* count = &counts[index];
+        return [&processor, count](Packet&) {
+            (*count)++;
+            processor.stop();
+            return true;
+        };
+    });
+    EXPECT_LT(counts[0] + counts[1], (size_t)packet_count);
+
+    // Processing again resets the stopped state
+    atomic<size_t> total(0);
+    processor.process([&](size_t) {
+        return [&total](Packet&) {
+            total++;
+            return true;
+        };
+    });
+    EXPECT_EQ(packet_count, total.load());
+}
+
+TEST_F(ParallelFileProcessorTest, ExceptionsAreRethrown) {
+    write_file();
+    ParallelFileProcessor processor(file_name, 4);
+    EXPECT_THROW(
+        processor.process([&](size_t index) {
+            return [index](Packet&) -> bool {
+                if (index == 2) {
+                    throw std::runtime_error("worker failed");
+                }
+                return true;
+            };
+        }),
+        std::runtime_error
+    );
+}
+
+TEST_F(ParallelFileProcessorTest, InvalidFile) {
+    EXPECT_THROW(ParallelFileProcessor("/ishallnotexist.pcap", 2), file_open_error);
+}
+
+#endif // TINS_HAVE_CXX11
@@ -0,0 +1,368 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <tins/pcap_file_reader.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#ifdef TINS_HAVE_PCAP
+    #include <tins/offline_packet_filter.h>
+#endif // TINS_HAVE_PCAP
+#include "tests/pcap_file.h"
+
+using namespace std;
+using namespace Tins;
+
+class PcapFileReaderTest : public testing::Test {
+public:
+    static const char* file_name;
+
+    void TearDown() {
+        remove(file_name);
+    }
+
+    static PDU::serialization_type make_packet(uint16_t dport) {
+        EthernetII eth = EthernetII() / IP("1.2.3.4", "5.6.7.8") / TCP(dport, 1234) /
+                         RawPDU("hello");
+        return eth.serialize();
+    }
+
+    // Writes a file containing 3 TCP packets with destination ports 1, 2 and 3
+    static void write_tcp_file() {
+        PcapFileBuilder builder;
+        for (uint16_t i = 1; i <= 3; ++i) {
+            builder.add_record(make_packet(i), 1500000000 + i, i * 1000, 10);
+        }
+        builder.write(file_name);
+    }
+};
+
+const char* PcapFileReaderTest::file_name = "pcap_file_reader_test.pcap";
+
+TEST_F(PcapFileReaderTest, FileHeader) {
+    write_tcp_file();
+    PcapFileReader reader(file_name);
+    EXPECT_EQ(PDU::ETHERNET_II, reader.link_type());
+    EXPECT_EQ(1U, reader.data_link_type());
+    EXPECT_EQ(65535U, reader.snap_len());
+    EXPECT_FALSE(reader.has_nanosecond_timestamps());
+}
+
+TEST_F(PcapFileReaderTest, NextRecord) {
+    write_tcp_file();
+    PcapFileReader reader(file_name);
+    PcapFileReader::record current;
+    for (uint16_t i = 1; i <= 3; ++i) {
+        ASSERT_TRUE(reader.next_record(current));
+        const PDU::serialization_type expected = make_packet(i);
+        ASSERT_EQ(expected.size(), current.size);
+        EXPECT_EQ(expected.size() + 10, current.length);
+        EXPECT_EQ(expected, PDU::serialization_type(current.data,
+                                                    current.data + current.size));
+        EXPECT_EQ(1500000000 + i, current.timestamp.seconds());
+        EXPECT_EQ(i * 1000, current.timestamp.microseconds());
+    }
+    EXPECT_FALSE(reader.next_record(current));
+    EXPECT_FALSE(reader.next_record(current));
+}
+
+TEST_F(PcapFileReaderTest, NextPacket) {
+    write_tcp_file();
+    PcapFileReader reader(file_name);
+    for (uint16_t i = 1; i <= 3; ++i) {
+        Packet packet = reader.next_packet();
+        ASSERT_TRUE(packet.pdu() != 0);
+        EXPECT_EQ(i, packet.pdu()->rfind_pdu<TCP>().dport());
+        EXPECT_EQ(1500000000 + i, packet.timestamp().seconds());
+    }
+    EXPECT_TRUE(reader.next_packet().pdu() == 0);
+}
+
+TEST_F(PcapFileReaderTest, NextPackets) {
+    write_tcp_file();
+    PcapFileReader reader(file_name);
+    vector<Packet> batch;
+    ASSERT_TRUE(reader.next_packets(batch, 2));
+    ASSERT_EQ(2UL, batch.size());
+    EXPECT_EQ(2, batch[1].pdu()->rfind_pdu<TCP>().dport());
+    ASSERT_TRUE(reader.next_packets(batch));
+    ASSERT_EQ(1UL, batch.size());
+    EXPECT_EQ(3, batch[0].pdu()->rfind_pdu<TCP>().dport());
+    EXPECT_FALSE(reader.next_packets(batch));
+    EXPECT_TRUE(batch.empty());
+}
+
+TEST_F(PcapFileReaderTest, SniffLoop) {
+    write_tcp_file();
+    PcapFileReader reader(file_name);
+    vector<uint16_t> ports;
+    reader.sniff_loop([&](PDU& pdu) {
+        ports.push_back(pdu.rfind_pdu<TCP>().dport());
+        return true;
+    });
+    ASSERT_EQ(3UL, ports.size());
+    EXPECT_EQ(3, ports[2]);
+
+    reader.rewind();
+    ports.clear();
+    reader.sniff_loop([&](Packet& packet) {
+        ports.push_back(packet.pdu()->rfind_pdu<TCP>().dport());
+        return true;
+    }, 2);
+    EXPECT_EQ(2UL, ports.size());
+}
+
+TEST_F(PcapFileReaderTest, SniffLazyLoop) {
+    write_tcp_file();
+    PcapFileReader reader(file_name);
+    size_t count = 0;
+    reader.sniff_lazy_loop([&](LazyPacket& packet) {
+        EXPECT_FALSE(packet.is_decoded());
+        EXPECT_EQ(PDU::ETHERNET_II, packet.link_type());
+        if (++count == 2) {
+            EXPECT_EQ(2, packet.rfind_pdu<TCP>().dport());
+            return false;
+        }
+        return true;
+    });
+    EXPECT_EQ(2UL, count);
+}
+
+TEST_F(PcapFileReaderTest, Rewind) {
+    write_tcp_file();
+    PcapFileReader reader(file_name);
+    PcapFileReader::record current;
+    while (reader.next_record(current)) {
+
+    }
+    reader.rewind();
+    ASSERT_TRUE(reader.next_record(current));
+    EXPECT_EQ(1500000001, current.timestamp.seconds());
+}
+
+TEST_F(PcapFileReaderTest, OffsetAndSeek) {
+    write_tcp_file();
+    PcapFileReader reader(file_name);
+    EXPECT_EQ(24U, reader.offset());
+    PcapFileReader::record current;
+    ASSERT_TRUE(reader.next_record(current));
+    const uint64_t second_offset = reader.offset();
+    EXPECT_EQ(24U + 16 + current.size, second_offset);
+    ASSERT_TRUE(reader.next_record(current));
+    reader.seek(second_offset);
+    ASSERT_TRUE(reader.next_record(current));
+    EXPECT_EQ(1500000002, current.timestamp.seconds());
+    reader.seek(reader.file_size() + 100);
+    EXPECT_EQ(reader.file_size(), reader.offset());
+    EXPECT_FALSE(reader.next_record(current));
+    reader.seek(0);
+    EXPECT_EQ(24U, reader.offset());
+}
+
+TEST_F(PcapFileReaderTest, RecordAt) {
+    write_tcp_file();
+    PcapFileReader reader(file_name);
+    PcapFileReader::record current;
+    ASSERT_TRUE(reader.next_record(current));
+    const uint64_t second_offset = reader.offset();
+    ASSERT_TRUE(reader.record_at(second_offset, current));
+    EXPECT_EQ(1500000002, current.timestamp.seconds());
+    ASSERT_TRUE(reader.record_at(24, current));
+    EXPECT_EQ(1500000001, current.timestamp.seconds());
+    EXPECT_EQ(second_offset, reader.offset());
+    EXPECT_FALSE(reader.record_at(0, current));
+    EXPECT_FALSE(reader.record_at(reader.file_size(), current));
+    EXPECT_FALSE(reader.record_at(reader.file_size() + 10, current));
+}
+
+TEST_F(PcapFileReaderTest, FindRecordBoundary) {
+    write_tcp_file();
+    PcapFileReader reader(file_name);
+    PcapFileReader::record current;
+    vector<uint64_t> offsets;
+    offsets.push_back(reader.offset());
+    while (reader.next_record(current)) {
+        offsets.push_back(reader.offset());
+    }
+    EXPECT_EQ(offsets[0], reader.find_record_boundary(0));
+    EXPECT_EQ(offsets[0], reader.find_record_boundary(offsets[0]));
+    EXPECT_EQ(offsets[1], reader.find_record_boundary(offsets[0] + 1));
+    EXPECT_EQ(offsets[2], reader.find_record_boundary(offsets[2] - 1));
+    EXPECT_EQ(reader.file_size(), reader.find_record_boundary(offsets[2] + 1));
+    EXPECT_EQ(reader.file_size(), reader.find_record_boundary(reader.file_size()));
+}
+
+TEST_F(PcapFileReaderTest, FindRecordBoundaryLongChain) {
+    PcapFileBuilder builder;
+    for (uint16_t i = 0; i < PcapFileReader::RECORD_BOUNDARY_CHAIN * 2; ++i) {
+        builder.add_record(make_packet(i), 1500000000 + i);
+    }
+    builder.write(file_name);
+    PcapFileReader reader(file_name);
+    PcapFileReader::record current;
+    ASSERT_TRUE(reader.next_record(current));
+    const uint64_t second_offset = reader.offset();
+    EXPECT_EQ(second_offset, reader.find_record_boundary(30));
+    reader.seek(reader.find_record_boundary(reader.file_size() / 2));
+    size_t count = 0;
+    while (reader.next_record(current)) {
+        EXPECT_EQ(1500000000 + PcapFileReader::RECORD_BOUNDARY_CHAIN + count,
+                  (uint64_t)current.timestamp.seconds());
+        ++count;
+    }
+    EXPECT_EQ(PcapFileReader::RECORD_BOUNDARY_CHAIN, count);
+}
+
+TEST_F(PcapFileReaderTest, SwappedNanosecondFile) {
+    PcapFileBuilder builder(1, 0xa1b23c4d, true);
+    builder.add_record(make_packet(80), 1500000000, 123456789);
+    builder.write(file_name);
+    PcapFileReader reader(file_name);
+    EXPECT_TRUE(reader.has_nanosecond_timestamps());
+    EXPECT_EQ(PDU::ETHERNET_II, reader.link_type());
+    Packet packet = reader.next_packet();
+    ASSERT_TRUE(packet.pdu() != 0);
+    EXPECT_EQ(80, packet.pdu()->rfind_pdu<TCP>().dport());
+    EXPECT_EQ(1500000000, packet.timestamp().seconds());
+    EXPECT_EQ(123456, packet.timestamp().microseconds());
+}
+
+TEST_F(PcapFileReaderTest, RawIPFile) {
+    PcapFileBuilder builder(101);
+    IP ip = IP("1.2.3.4", "5.6.7.8") / UDP(53, 1234);
+    builder.add_record(ip, 1500000000);
+    builder.write(file_name);
+    PcapFileReader reader(file_name);
+    EXPECT_EQ(PDU::IP, reader.link_type());
+    Packet packet = reader.next_packet();
+    ASSERT_TRUE(packet.pdu() != 0);
+    EXPECT_EQ(53, packet.pdu()->rfind_pdu<UDP>().dport());
+}
+
+TEST_F(PcapFileReaderTest, TruncatedLastRecord) {
+    PcapFileBuilder builder;
+    builder.add_record(make_packet(1), 1500000000);
+    builder.add_record(make_packet(2), 1500000000);
+    builder.contents().resize(builder.contents().size() - 5);
+    builder.write(file_name);
+    PcapFileReader reader(file_name);
+    PcapFileReader::record current;
+    EXPECT_TRUE(reader.next_record(current));
+    EXPECT_FALSE(reader.next_record(current));
+}
+
+TEST_F(PcapFileReaderTest, MalformedRecordsAreSkipped) {
+    PcapFileBuilder builder;
+    builder.add_record(PDU::serialization_type(5, 0), 1500000000);
+    builder.add_record(make_packet(2), 1500000000);
+    builder.write(file_name);
+    PcapFileReader reader(file_name);
+    Packet packet = reader.next_packet();
+    ASSERT_TRUE(packet.pdu() != 0);
+    EXPECT_EQ(2, packet.pdu()->rfind_pdu<TCP>().dport());
+}
+
+TEST_F(PcapFileReaderTest, UnknownLinkType) {
+    PcapFileBuilder builder(147);
+    builder.add_record(make_packet(1), 1500000000);
+    builder.write(file_name);
+    PcapFileReader reader(file_name);
+    EXPECT_EQ(PDU::UNKNOWN, reader.link_type());
+    EXPECT_EQ(147U, reader.data_link_type());
+    EXPECT_THROW(reader.next_packet(), unknown_link_type);
+    reader.rewind();
+    PcapFileReader::record current;
+    EXPECT_TRUE(reader.next_record(current));
+}
+
+TEST_F(PcapFileReaderTest, InvalidFiles) {
+    EXPECT_THROW(PcapFileReader("/ishallnotexist.pcap"), file_open_error);
+    {
+        ofstream output(file_name, ios::binary);
+        output << string(30, 'A');
+    }
+    EXPECT_THROW(PcapFileReader reader(file_name), invalid_file_format);
+    // Just the magic number
+    PcapFileBuilder builder;
+    builder.contents().resize(4);
+    builder.write(file_name);
+    EXPECT_THROW(PcapFileReader reader(file_name), invalid_file_format);
+    {
+        ofstream output(file_name, ios::binary | ios::trunc);
+    }
+    EXPECT_THROW(PcapFileReader reader(file_name), invalid_file_format);
+}
+
+TEST_F(PcapFileReaderTest, EmptyFile) {
+    PcapFileBuilder().write(file_name);
+    PcapFileReader reader(file_name);
+    PcapFileReader::record current;
+    EXPECT_FALSE(reader.next_record(current));
+    EXPECT_TRUE(reader.next_packet().pdu() == 0);
+}
+
+#ifdef TINS_HAVE_CXX11
+
+TEST_F(PcapFileReaderTest, ZeroCopyPayloads) {
+    write_tcp_file();
+    PcapFileReader reader(file_name);
+    reader.set_zero_copy_payloads(true);
+    Packet packet = reader.next_packet();
+    ASSERT_TRUE(packet.pdu() != 0);
+    const RawPDU& raw = packet.pdu()->rfind_pdu<RawPDU>();
+    EXPECT_TRUE(raw.is_payload_borrowed());
+    EXPECT_EQ("hello", string(raw.payload_data(), raw.payload_data() + raw.payload_size()));
+}
+
+TEST_F(PcapFileReaderTest, MaxDecodeLayer) {
+    write_tcp_file();
+    PcapFileReader reader(file_name);
+    reader.set_max_decode_layer(PacketDecoder::NETWORK_LAYER);
+    Packet packet = reader.next_packet();
+    ASSERT_TRUE(packet.pdu() != 0);
+    EXPECT_TRUE(packet.pdu()->find_pdu<IP>() != 0);
+    EXPECT_TRUE(packet.pdu()->find_pdu<TCP>() == 0);
+    LazyPacket lazy;
+    ASSERT_TRUE(reader.next_packet(lazy));
+    EXPECT_EQ(PacketDecoder::NETWORK_LAYER, lazy.max_decode_layer());
+}
+
+TEST_F(PcapFileReaderTest, PrefetchSize) {
+    write_tcp_file();
+    PcapFileReader reader(file_name);
+    reader.set_prefetch_size(0);
+    vector<Packet> batch;
+    EXPECT_TRUE(reader.next_packets(batch));
+    EXPECT_EQ(3UL, batch.size());
+    reader.rewind();
+    reader.set_prefetch_size(16);
+    EXPECT_TRUE(reader.next_packets(batch));
+    EXPECT_EQ(3UL, batch.size());
+}
+
+#endif // TINS_HAVE_CXX11
+
+#ifdef TINS_HAVE_PCAP
+
+TEST_F(PcapFileReaderTest, Filter) {
+    write_tcp_file();
+    PcapFileReader reader(file_name);
+    reader.set_filter(OfflinePacketFilter("tcp dst port 2", DataLinkType<EthernetII>()));
+    PcapFileReader::record current;
+    ASSERT_TRUE(reader.next_record(current));
+    EXPECT_EQ(make_packet(2), PDU::serialization_type(current.data,
+                                                      current.data + current.size));
+    EXPECT_FALSE(reader.next_record(current));
+    reader.clear_filter();
+    reader.rewind();
+    vector<Packet> batch;
+    reader.next_packets(batch);
+    EXPECT_EQ(3UL, batch.size());
+}
+
+#endif // TINS_HAVE_PCAP
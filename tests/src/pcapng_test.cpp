@@ -0,0 +1,399 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <tins/pcapng_reader.h>
+#include <tins/pcapng_writer.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/tcp.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/endianness.h>
+
+using namespace std;
+using namespace Tins;
+
+class PcapNgTest : public testing::Test {
+public:
+    static const char* file_name;
+
+    void TearDown() {
+        remove(file_name);
+    }
+
+    static PDU::serialization_type make_ethernet_packet(uint16_t dport) {
+        EthernetII eth = EthernetII() / IP("1.2.3.4", "5.6.7.8") / TCP(dport, 1234) /
+                         RawPDU("hello");
+        return eth.serialize();
+    }
+
+    static PDU::serialization_type make_ip_packet(uint16_t dport) {
+        IP ip = IP("1.2.3.4", "5.6.7.8") / UDP(dport, 1234);
+        return ip.serialize();
+    }
+
+    // Builds blocks by hand, optionally using the opposite byte order
+    class block_builder {
+    public:
+        block_builder(bool swap = false) : swap_(swap) { }
+
+        block_builder& u16(uint16_t value) {
+            if (swap_) {
+                value = Endian::change_endian(value);
+            }
+            const uint8_t* ptr = (const uint8_t*)&value;
+            body_.insert(body_.end(), ptr, ptr + sizeof(value));
+            return *this;
+        }
+
+        block_builder& u32(uint32_t value) {
+            if (swap_) {
+                value = Endian::change_endian(value);
+            }
+            const uint8_t* ptr = (const uint8_t*)&value;
+            body_.insert(body_.end(), ptr, ptr + sizeof(value));
+            return *this;
+        }
+
+        block_builder& bytes(const vector<uint8_t>& data) {
+            body_.insert(body_.end(), data.begin(), data.end());
+            body_.resize(body_.size() + (4 - data.size() % 4) % 4);
+            return *this;
+        }
+
+        void append_to(vector<uint8_t>& output, uint32_t type) const {
+            block_builder header(swap_);
+            header.u32(type).u32(body_.size() + 12);
+            output.insert(output.end(), header.body_.begin(), header.body_.end());
+            output.insert(output.end(), body_.begin(), body_.end());
+            block_builder trailer(swap_);
+            trailer.u32(body_.size() + 12);
+            output.insert(output.end(), trailer.body_.begin(), trailer.body_.end());
+        }
+    private:
+        bool swap_;
+        vector<uint8_t> body_;
+    };
+
+    static void add_section_header(vector<uint8_t>& output, bool swap = false) {
+        block_builder(swap).u32(0x1a2b3c4d).u16(1).u16(0).u32(0xffffffff)
+                           .u32(0xffffffff).append_to(output, 0x0a0d0d0a);
+    }
+
+    static void add_interface(vector<uint8_t>& output, uint16_t link_type,
+                              int resolution = -1, bool swap = false) {
+        block_builder builder(swap);
+        builder.u16(link_type).u16(0).u32(65535);
+        if (resolution != -1) {
+            builder.u16(9).u16(1).bytes(vector<uint8_t>(1, resolution));
+        }
+        builder.u16(0).u16(0).append_to(output, 1);
+    }
+
+    static void add_packet(vector<uint8_t>& output, uint32_t interface_id,
+                           uint64_t timestamp, const vector<uint8_t>& data,
+                           bool swap = false) {
+        block_builder(swap).u32(interface_id).u32(timestamp >> 32)
+                           .u32(timestamp & 0xffffffff).u32(data.size())
+                           .u32(data.size()).bytes(data).append_to(output, 6);
+    }
+
+    static void write_file(const vector<uint8_t>& contents) {
+        ofstream output(file_name, ios::binary);
+        output.write((const char*)&contents[0], contents.size());
+    }
+};
+
+const char* PcapNgTest::file_name = "pcapng_test.pcapng";
+
+TEST_F(PcapNgTest, WriteAndRead) {
+    {
+        PcapNgWriter writer(file_name);
+        EXPECT_EQ(0U, writer.add_interface(PDU::ETHERNET_II, 65535, "eth0"));
+        EXPECT_EQ(1U, writer.add_interface(PDU::IP, 0, "tun0"));
+        PDU::serialization_type eth_packet = make_ethernet_packet(80);
+        PDU::serialization_type ip_packet = make_ip_packet(53);
+        writer.write_record(0, 1500000000123456789ULL, &eth_packet[0],
+                            eth_packet.size(), eth_packet.size());
+        writer.write_record(1, 1500000001000000001ULL, &ip_packet[0],
+                            ip_packet.size(), ip_packet.size() + 100);
+    }
+    PcapNgReader reader(file_name);
+    ASSERT_EQ(2UL, reader.interface_count());
+    EXPECT_EQ("eth0", reader.interface_at(0).name);
+    EXPECT_EQ(PDU::ETHERNET_II, reader.interface_at(0).link_type);
+    EXPECT_EQ(65535U, reader.interface_at(0).snap_len);
+    EXPECT_EQ(9, reader.interface_at(0).timestamp_resolution);
+    EXPECT_EQ("tun0", reader.interface_at(1).name);
+    EXPECT_EQ(PDU::IP, reader.interface_at(1).link_type);
+    EXPECT_EQ(101U, reader.interface_at(1).data_link_type);
+    EXPECT_THROW(reader.interface_at(2), invalid_interface);
+
+    PcapNgReader::record current;
+    ASSERT_TRUE(reader.next_record(current));
+    EXPECT_EQ(0U, current.interface_id);
+    EXPECT_EQ(1500000000123456789ULL, current.timestamp_ns);
+    EXPECT_EQ(1500000000, current.timestamp.seconds());
+    EXPECT_EQ(123456, current.timestamp.microseconds());
+    EXPECT_EQ(make_ethernet_packet(80), PDU::serialization_type(current.data,
+                                                               current.data + current.size));
+    ASSERT_TRUE(reader.next_record(current));
+    EXPECT_EQ(1U, current.interface_id);
+    EXPECT_EQ(1500000001000000001ULL, current.timestamp_ns);
+    EXPECT_EQ(current.size + 100, current.length);
+    EXPECT_FALSE(reader.next_record(current));
+}
+
+TEST_F(PcapNgTest, DecodeUsingEachInterfacesLinkType) {
+    {
+        PcapNgWriter writer(file_name);
+        writer.add_interface(PDU::ETHERNET_II);
+        writer.add_interface(PDU::IP);
+        EthernetII eth = EthernetII() / IP() / TCP(80, 1234);
+        IP ip = IP() / UDP(53, 1234);
+        writer.write(eth);
+        writer.write(ip, 1);
+        Packet packet(eth, Timestamp());
+        writer.write(packet);
+    }
+    PcapNgReader reader(file_name);
+    Packet packet = reader.next_packet();
+    ASSERT_TRUE(packet.pdu() != 0);
+    EXPECT_EQ(PDU::ETHERNET_II, packet.pdu()->pdu_type());
+    EXPECT_EQ(80, packet.pdu()->rfind_pdu<TCP>().dport());
+    EXPECT_NE(0, packet.timestamp().seconds());
+
+    LazyPacket lazy;
+    ASSERT_TRUE(reader.next_packet(lazy));
+    EXPECT_EQ(PDU::IP, lazy.link_type());
+    EXPECT_EQ(53, lazy.rfind_pdu<UDP>().dport());
+
+    vector<Packet> batch;
+    ASSERT_TRUE(reader.next_packets(batch));
+    ASSERT_EQ(1UL, batch.size());
+    EXPECT_EQ(0, batch[0].timestamp().seconds());
+    EXPECT_FALSE(reader.next_packets(batch));
+}
+
+TEST_F(PcapNgTest, SniffLoops) {
+    {
+        PcapNgWriter writer(file_name);
+        writer.add_interface(PDU::ETHERNET_II);
+        for (uint16_t i = 1; i <= 3; ++i) {
+            EthernetII eth = EthernetII() / IP() / TCP(i, 1234);
+            writer.write(eth);
+        }
+    }
+    PcapNgReader reader(file_name);
+    vector<uint16_t> ports;
+    reader.sniff_loop([&](PDU& pdu) {
+        ports.push_back(pdu.rfind_pdu<TCP>().dport());
+        return true;
+    });
+    ASSERT_EQ(3UL, ports.size());
+    EXPECT_EQ(3, ports[2]);
+
+    reader.rewind();
+    EXPECT_EQ(1UL, reader.interface_count());
+    size_t count = 0;
+    reader.sniff_lazy_loop([&](LazyPacket& packet) {
+        EXPECT_FALSE(packet.is_decoded());
+        ++count;
+        return true;
+    }, 2);
+    EXPECT_EQ(2UL, count);
+}
+
+TEST_F(PcapNgTest, SnapLengthTruncatesPackets) {
+    {
+        PcapNgWriter writer(file_name);
+        writer.add_interface(PDU::ETHERNET_II, 20);
+        PDU::serialization_type packet = make_ethernet_packet(80);
+        writer.write_record(0, 0, &packet[0], packet.size(), packet.size());
+        EXPECT_THROW(writer.write_record(1, 0, &packet[0], packet.size(), packet.size()),
+                     invalid_interface);
+    }
+    PcapNgReader reader(file_name);
+    PcapNgReader::record current;
+    ASSERT_TRUE(reader.next_record(current));
+    EXPECT_EQ(20U, current.size);
+    EXPECT_EQ(make_ethernet_packet(80).size(), current.length);
+}
+
+TEST_F(PcapNgTest, SmallWriterBuffer) {
+    {
+        PcapNgWriter writer(file_name, 64);
+        writer.add_interface(PDU::ETHERNET_II);
+        for (uint16_t i = 0; i < 100; ++i) {
+            EthernetII eth = EthernetII() / IP() / TCP(i, 1234);
+            writer.write(eth);
+        }
+    }
+    PcapNgReader reader(file_name);
+    PcapNgReader::record current;
+    size_t count = 0;
+    while (reader.next_record(current)) {
+        ++count;
+    }
+    EXPECT_EQ(100UL, count);
+}
+
+TEST_F(PcapNgTest, UnsupportedLinkType) {
+    PcapNgWriter writer(file_name);
+    EXPECT_THROW(writer.add_interface(PDU::TCP), unknown_link_type);
+}
+
+TEST_F(PcapNgTest, DefaultResolutionIsMicroseconds) {
+    vector<uint8_t> contents;
+    add_section_header(contents);
+    add_interface(contents, 1);
+    add_packet(contents, 0, 1500000000123456ULL, make_ethernet_packet(80));
+    write_file(contents);
+    PcapNgReader reader(file_name);
+    EXPECT_EQ(6, reader.interface_at(0).timestamp_resolution);
+    PcapNgReader::record current;
+    ASSERT_TRUE(reader.next_record(current));
+    EXPECT_EQ(1500000000123456000ULL, current.timestamp_ns);
+}
+
+TEST_F(PcapNgTest, PowerOfTwoResolution) {
+    vector<uint8_t> contents;
+    add_section_header(contents);
+    // 2^-10 seconds
+    add_interface(contents, 1, 0x80 | 10);
+    add_packet(contents, 0, (5ULL << 10) | 512, make_ethernet_packet(80));
+    write_file(contents);
+    PcapNgReader reader(file_name);
+    PcapNgReader::record current;
+    ASSERT_TRUE(reader.next_record(current));
+    EXPECT_EQ(5500000000ULL, current.timestamp_ns);
+}
+
+TEST_F(PcapNgTest, SwappedByteOrder) {
+    vector<uint8_t> contents;
+    add_section_header(contents, true);
+    add_interface(contents, 1, 9, true);
+    add_packet(contents, 0, 1500000000000000001ULL, make_ethernet_packet(80), true);
+    write_file(contents);
+    PcapNgReader reader(file_name);
+    EXPECT_EQ(PDU::ETHERNET_II, reader.interface_at(0).link_type);
+    Packet packet = reader.next_packet();
+    ASSERT_TRUE(packet.pdu() != 0);
+    EXPECT_EQ(80, packet.pdu()->rfind_pdu<TCP>().dport());
+}
+
+TEST_F(PcapNgTest, MultipleSections) {
+    vector<uint8_t> contents;
+    add_section_header(contents);
+    add_interface(contents, 1);
+    add_packet(contents, 0, 0, make_ethernet_packet(80));
+    // The second section uses the other byte order and link type
+    add_section_header(contents, true);
+    add_interface(contents, 101, -1, true);
+    add_packet(contents, 0, 0, make_ip_packet(53), true);
+    write_file(contents);
+    PcapNgReader reader(file_name);
+    Packet packet = reader.next_packet();
+    ASSERT_TRUE(packet.pdu() != 0);
+    EXPECT_EQ(80, packet.pdu()->rfind_pdu<TCP>().dport());
+    packet = reader.next_packet();
+    ASSERT_TRUE(packet.pdu() != 0);
+    EXPECT_EQ(PDU::IP, packet.pdu()->pdu_type());
+    EXPECT_EQ(53, packet.pdu()->rfind_pdu<UDP>().dport());
+    EXPECT_EQ(1UL, reader.interface_count());
+}
+
+TEST_F(PcapNgTest, SimplePacketBlocksAndUnknownBlocks) {
+    vector<uint8_t> contents;
+    add_section_header(contents);
+    add_interface(contents, 1);
+    // Name resolution block, which is skipped
+    block_builder().u16(0).u16(0).append_to(contents, 4);
+    const PDU::serialization_type data = make_ethernet_packet(80);
+    block_builder().u32(data.size()).bytes(data).append_to(contents, 3);
+    write_file(contents);
+    PcapNgReader reader(file_name);
+    PcapNgReader::record current;
+    ASSERT_TRUE(reader.next_record(current));
+    EXPECT_EQ(data.size(), current.size);
+    EXPECT_EQ(0U, current.timestamp_ns);
+    EXPECT_FALSE(reader.next_record(current));
+}
+
+TEST_F(PcapNgTest, PacketsOnUnknownInterfacesAreSkipped) {
+    vector<uint8_t> contents;
+    add_section_header(contents);
+    add_interface(contents, 1);
+    add_packet(contents, 3, 0, make_ethernet_packet(80));
+    add_packet(contents, 0, 0, make_ethernet_packet(81));
+    write_file(contents);
+    PcapNgReader reader(file_name);
+    Packet packet = reader.next_packet();
+    ASSERT_TRUE(packet.pdu() != 0);
+    EXPECT_EQ(81, packet.pdu()->rfind_pdu<TCP>().dport());
+}
+
+TEST_F(PcapNgTest, PacketsOnUnsupportedLinkTypesAreSkipped) {
+    vector<uint8_t> contents;
+    add_section_header(contents);
+    // LINKTYPE_USER0
+    add_interface(contents, 147);
+    add_interface(contents, 1);
+    add_packet(contents, 0, 0, make_ethernet_packet(80));
+    add_packet(contents, 1, 0, make_ethernet_packet(81));
+    add_packet(contents, 0, 0, make_ethernet_packet(82));
+    write_file(contents);
+    PcapNgReader reader(file_name);
+    EXPECT_EQ(PDU::UNKNOWN, reader.interface_at(0).link_type);
+    LazyPacket lazy;
+    ASSERT_TRUE(reader.next_packet(lazy));
+    EXPECT_EQ(PDU::ETHERNET_II, lazy.link_type());
+    EXPECT_EQ(81, lazy.rfind_pdu<TCP>().dport());
+    EXPECT_FALSE(reader.next_packet(lazy));
+}
+
+TEST_F(PcapNgTest, TruncatedBlock) {
+    vector<uint8_t> contents;
+    add_section_header(contents);
+    add_interface(contents, 1);
+    add_packet(contents, 0, 0, make_ethernet_packet(80));
+    add_packet(contents, 0, 0, make_ethernet_packet(81));
+    contents.resize(contents.size() - 8);
+    write_file(contents);
+    PcapNgReader reader(file_name);
+    PcapNgReader::record current;
+    EXPECT_TRUE(reader.next_record(current));
+    EXPECT_FALSE(reader.next_record(current));
+}
+
+TEST_F(PcapNgTest, InvalidFiles) {
+    EXPECT_THROW(PcapNgReader("/ishallnotexist.pcapng"), file_open_error);
+    EXPECT_THROW(PcapNgWriter("/ishallnotexist/file.pcapng"), file_open_error);
+    write_file(vector<uint8_t>(40, 0x41));
+    EXPECT_THROW(PcapNgReader reader(file_name), invalid_file_format);
+    // A pcap file's header
+    vector<uint8_t> contents;
+    block_builder().u16(2).u16(4).u32(0).u32(0).append_to(contents, 0xa1b2c3d4);
+    write_file(contents);
+    EXPECT_THROW(PcapNgReader reader(file_name), invalid_file_format);
+}
+
+#ifdef TINS_HAVE_CXX11
+
+TEST_F(PcapNgTest, ZeroCopyPayloads) {
+    {
+        PcapNgWriter writer(file_name);
+        writer.add_interface(PDU::ETHERNET_II);
+        EthernetII eth = EthernetII() / IP() / TCP() / RawPDU("hello");
+        writer.write(eth);
+    }
+    PcapNgReader reader(file_name);
+    reader.set_zero_copy_payloads(true);
+    Packet packet = reader.next_packet();
+    ASSERT_TRUE(packet.pdu() != 0);
+    EXPECT_TRUE(packet.pdu()->rfind_pdu<RawPDU>().is_payload_borrowed());
+}
+
+#endif // TINS_HAVE_CXX11
@@ -8,6 +8,10 @@
 #include <tins/rawpdu.h>
 #include <tins/pdu.h>
 #include <tins/packet.h>
+#include <tins/packet_decoder.h>
+#include <tins/ethernetII.h>
+#include <tins/radiotap.h>
+#include <tins/dot11.h>
 
 using namespace std;
 using namespace Tins;
@@ -102,3 +106,76 @@ TEST_F(PDUTest, TinsCast) {
     EXPECT_THROW(tins_cast<UDP>(*pdu), bad_tins_cast);
 }
 
+TEST_F(PDUTest, FindLastPDU) {
+    IP ip = IP("1.1.1.1") / IP("2.2.2.2") / UDP(53, 1234);
+    EXPECT_EQ(&ip, ip.find_pdu<IP>());
+    EXPECT_EQ(ip.inner_pdu(), ip.find_last_pdu<IP>());
+    EXPECT_EQ(IPv4Address("2.2.2.2"), ip.find_last_pdu<IP>()->dst_addr());
+    EXPECT_TRUE(ip.find_last_pdu<TCP>() == 0);
+}
+
+TEST_F(PDUTest, LayerIndex) {
+    IP ip = IP("1.1.1.1") / IP("2.2.2.2") / TCP(22, 52) / RawPDU("Test");
+    EXPECT_FALSE(ip.has_layer_index());
+    ip.build_layer_index();
+    EXPECT_TRUE(ip.has_layer_index());
+    EXPECT_EQ(&ip, ip.find_pdu<IP>());
+    EXPECT_EQ(ip.inner_pdu(), ip.find_last_pdu<IP>());
+    EXPECT_EQ(ip.inner_pdu()->inner_pdu(), ip.find_pdu<TCP>());
+    EXPECT_EQ(ip.find_pdu<TCP>(), ip.find_last_pdu<TCP>());
+    EXPECT_TRUE(ip.find_pdu<RawPDU>() != 0);
+    EXPECT_TRUE(ip.find_pdu<UDP>() == 0);
+    EXPECT_THROW(ip.rfind_pdu<UDP>(), pdu_not_found);
+
+    const IP& const_ip = ip;
+    EXPECT_EQ(ip.find_pdu<TCP>(), const_ip.find_pdu<TCP>());
+
+    // Copies don't keep the index
+    IP copy(ip);
+    EXPECT_FALSE(copy.has_layer_index());
+}
+
+TEST_F(PDUTest, LayerIndexInvalidation) {
+    IP ip = IP("1.1.1.1") / TCP(22, 52) / RawPDU("Test");
+    ip.build_layer_index();
+    // Modifying an inner PDU drops the root's index
+    ip.rfind_pdu<TCP>().inner_pdu(UDP(53, 53));
+    EXPECT_FALSE(ip.has_layer_index());
+    EXPECT_TRUE(ip.find_pdu<RawPDU>() == 0);
+    EXPECT_TRUE(ip.find_pdu<UDP>() != 0);
+
+    ip.build_layer_index();
+    delete ip.release_inner_pdu();
+    EXPECT_FALSE(ip.has_layer_index());
+    EXPECT_TRUE(ip.find_pdu<TCP>() == 0);
+
+    ip.build_layer_index();
+    ip /= TCP(80, 1234);
+    EXPECT_FALSE(ip.has_layer_index());
+    EXPECT_TRUE(ip.find_pdu<TCP>() != 0);
+}
+
+#ifdef TINS_HAVE_DOT11
+
+TEST_F(PDUTest, LayerIndexMatchesBaseFlags) {
+    RadioTap radio = RadioTap() / Dot11QoSData();
+    radio.build_layer_index();
+    EXPECT_TRUE(radio.has_layer_index());
+    EXPECT_EQ(radio.inner_pdu(), radio.find_pdu<Dot11QoSData>());
+    EXPECT_EQ(radio.inner_pdu(), radio.find_pdu<Dot11Data>());
+    EXPECT_EQ(radio.inner_pdu(), radio.find_pdu<Dot11>());
+    EXPECT_TRUE(radio.find_pdu<Dot11Beacon>() == 0);
+}
+
+#endif // TINS_HAVE_DOT11
+
+TEST_F(PDUTest, DecoderBuildsLayerIndex) {
+    PDU::serialization_type buffer = (EthernetII() / IP("1.2.3.4") / TCP(22, 52) /
+                                      RawPDU("Test")).serialize();
+    PDU* pdu = PacketDecoder::decode(PDU::ETHERNET_II, &buffer[0], buffer.size());
+    ASSERT_TRUE(pdu != 0);
+    EXPECT_TRUE(pdu->has_layer_index());
+    EXPECT_EQ(52, pdu->rfind_pdu<TCP>().sport());
+    EXPECT_EQ(pdu->inner_pdu(), pdu->find_pdu<IP>());
+    delete pdu;
+}
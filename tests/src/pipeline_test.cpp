@@ -0,0 +1,157 @@
+#include <tins/config.h>
+#include <gtest/gtest.h>
+
+#ifdef TINS_HAVE_CXX11
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <stdexcept>
+#include <tins/pipeline.h>
+#include <tins/packet.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/udp.h>
+
+using namespace std;
+using namespace Tins;
+
+class PipelineTest : public testing::Test {
+public:
+    static Packet make_packet(uint16_t port) {
+        EthernetII eth = EthernetII() / IP("1.2.3.4", "5.6.7.8") / UDP(port, 1234);
+        return Packet(eth.clone(), Timestamp(), Packet::own_pdu());
+    }
+};
+
+TEST_F(PipelineTest, DistributesPackets) {
+    Pipeline<Packet> pipeline(3);
+    EXPECT_EQ(3UL, pipeline.size());
+    EXPECT_EQ(Pipeline<Packet>::BLOCK, pipeline.overflow_policy());
+    vector<size_t> counts(3);
+    vector<uint64_t> ports(3);
+    pipeline.start([&](size_t index) {
+        size_t* count = &counts[index];
+        uint64_t* port_sum = &ports[index];
+        return [count, port_sum](Packet& packet) {
+            (*count)++;
+            *port_sum += packet.pdu()->rfind_pdu<UDP>().dport();
+        };
+    });
+    for (uint16_t i = 1; i <= 300; ++i) {
+        EXPECT_TRUE(pipeline.push(make_packet(i)));
+    }
+    pipeline.stop();
+    EXPECT_EQ(300UL, pipeline.pushed());
+    EXPECT_EQ(0UL, pipeline.dropped());
+    uint64_t port_sum = 0;
+    for (size_t i = 0; i < counts.size(); ++i) {
+        // Round robin
+        EXPECT_EQ(100UL, counts[i]);
+        port_sum += ports[i];
+    }
+    EXPECT_EQ(300UL * 301 / 2, port_sum);
+}
+
+TEST_F(PipelineTest, PushToWorker) {
+    Pipeline<int> pipeline(2, 16);
+    vector<vector<int> > values(2);
+    pipeline.start([&](size_t index) {
+        vector<int>* output = &values[index];
+        return [output](int& value) {
+            output->push_back(value);
+        };
+    });
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(pipeline.push(int(i), i % 7 == 0 ? 1 : 0));
+    }
+    pipeline.stop();
+    ASSERT_EQ(143UL, values[1].size());
+    ASSERT_EQ(857UL, values[0].size());
+    for (size_t i = 0; i < values[1].size(); ++i) {
+        EXPECT_EQ(int(i * 7), values[1][i]);
+    }
+}
+
+TEST_F(PipelineTest, DropWhenFull) {
+    Pipeline<int> pipeline(1, 4, Pipeline<int>::DROP);
+    atomic<bool> release(false);
+    atomic<size_t> processed(0);
+    pipeline.start([&](size_t) {
+        return [&](int&) {
+            while (!release) {
+                this_thread::sleep_for(chrono::milliseconds(1));
+            }
+            processed++;
+        };
+    });
+    size_t accepted = 0;
+    for (int i = 0; i < 100; ++i) {
+        if (pipeline.push(int(i))) {
+            accepted++;
+        }
+    }
+    // At most one value is being processed and the queue holds 4 more
+    EXPECT_LE(accepted, 5UL);
+    EXPECT_GE(accepted, 4UL);
+    EXPECT_EQ(100 - accepted, pipeline.dropped());
+    EXPECT_EQ(100 - accepted, pipeline.dropped(0));
+    EXPECT_EQ(accepted, pipeline.pushed());
+    release = true;
+    pipeline.stop();
+    EXPECT_EQ(accepted, processed.load());
+}
+
+TEST_F(PipelineTest, BlockWhenFull) {
+    Pipeline<int> pipeline(2, 2, Pipeline<int>::BLOCK);
+    atomic<uint64_t> sum(0);
+    pipeline.start([&](size_t) {
+        return [&](int& value) {
+            this_thread::sleep_for(chrono::microseconds(10));
+            sum += value;
+        };
+    });
+    for (int i = 1; i <= 500; ++i) {
+        EXPECT_TRUE(pipeline.push(int(i)));
+    }
+    pipeline.stop();
+    EXPECT_EQ(0UL, pipeline.dropped());
+    EXPECT_EQ(500UL * 501 / 2, sum.load());
+}
+
+TEST_F(PipelineTest, WorkerException) {
+    Pipeline<int> pipeline(2, 8);
+    pipeline.start([&](size_t) {
+        return [&](int& value) {
+            if (value == 10) {
+                throw runtime_error("worker failed");
+            }
+        };
+    });
+    for (int i = 0; i < 100; ++i) {
+        pipeline.push(int(i));
+    }
+    EXPECT_THROW(pipeline.stop(), runtime_error);
+    // Once stopped, the error is cleared
+    pipeline.stop();
+}
+
+TEST_F(PipelineTest, Restart) {
+    Pipeline<int> pipeline(1);
+    atomic<size_t> processed(0);
+    for (size_t run = 0; run < 2; ++run) {
+        pipeline.start([&](size_t) {
+            return [&](int&) {
+                processed++;
+            };
+        });
+        for (int i = 0; i < 10; ++i) {
+            pipeline.push(int(i));
+        }
+        pipeline.stop();
+    }
+    EXPECT_EQ(20UL, processed.load());
+}
+
+#endif // TINS_HAVE_CXX11
@@ -1,5 +1,12 @@
 #include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <string>
+#include <vector>
 #include <tins/rawpdu.h>
+#include <tins/exceptions.h>
+#include <tins/ip.h>
+#include <tins/udp.h>
 
 using namespace Tins;
 
@@ -18,4 +25,206 @@ TEST_F(RawPDUTest, ConstructFromPayloadType) {
     // The payload should have been copied
     payload.push_back(0x03);
     EXPECT_NE(payload, raw.payload());
-}
\ No newline at end of file
+}
+
+TEST_F(RawPDUTest, BorrowedPayload) {
+    uint8_t buffer[] = { 1, 2, 3, 4 };
+    RawPDU raw(buffer, sizeof(buffer), RawPDU::borrow_payload());
+    EXPECT_TRUE(raw.is_payload_borrowed());
+    EXPECT_EQ(buffer, raw.payload_data());
+    EXPECT_EQ(sizeof(buffer), raw.payload_size());
+    EXPECT_EQ(sizeof(buffer), raw.size());
+    EXPECT_EQ(RawPDU::payload_type(buffer, buffer + sizeof(buffer)), raw.serialize());
+
+    // Changes to the buffer are visible until the payload is copied
+    buffer[0] = 5;
+    EXPECT_EQ(5, raw.payload_data()[0]);
+    raw.own_payload();
+    EXPECT_FALSE(raw.is_payload_borrowed());
+    EXPECT_EQ(RawPDU::payload_type(buffer, buffer + sizeof(buffer)), raw.payload());
+    buffer[0] = 6;
+    EXPECT_EQ(5, raw.payload()[0]);
+}
+
+TEST_F(RawPDUTest, ConstGetterDoesntCopyBorrowedPayload) {
+    uint8_t buffer[] = { 1, 2, 3, 4 };
+    RawPDU raw(buffer, sizeof(buffer), RawPDU::borrow_payload());
+    const RawPDU& const_raw = raw;
+    EXPECT_THROW(const_raw.payload(), payload_not_owned);
+    EXPECT_TRUE(raw.is_payload_borrowed());
+
+    // The non-const getter copies it
+    EXPECT_EQ(RawPDU::payload_type(buffer, buffer + sizeof(buffer)), raw.payload());
+    EXPECT_FALSE(raw.is_payload_borrowed());
+    EXPECT_EQ(RawPDU::payload_type(buffer, buffer + sizeof(buffer)), const_raw.payload());
+}
+
+TEST_F(RawPDUTest, CopyOwnsPayload) {
+    uint8_t buffer[] = { 1, 2, 3, 4 };
+    RawPDU raw(buffer, sizeof(buffer), RawPDU::borrow_payload());
+    RawPDU copy(raw);
+    std::unique_ptr<RawPDU> clone(raw.clone());
+    EXPECT_FALSE(copy.is_payload_borrowed());
+    EXPECT_FALSE(clone->is_payload_borrowed());
+    EXPECT_TRUE(raw.is_payload_borrowed());
+    buffer[0] = 5;
+    EXPECT_EQ(1, copy.payload()[0]);
+    EXPECT_EQ(1, clone->payload()[0]);
+
+    RawPDU assigned("abc");
+    assigned = raw;
+    EXPECT_FALSE(assigned.is_payload_borrowed());
+    EXPECT_EQ(raw.payload_size(), assigned.payload_size());
+}
+
+TEST_F(RawPDUTest, SetPayloadDropsBorrowedOne) {
+    uint8_t buffer[] = { 1, 2, 3, 4 };
+    RawPDU raw(buffer, sizeof(buffer), RawPDU::borrow_payload());
+    raw.payload(buffer, buffer + 2);
+    EXPECT_FALSE(raw.is_payload_borrowed());
+    EXPECT_EQ(2U, raw.payload_size());
+}
+
+#ifdef TINS_HAVE_CXX11
+
+TEST_F(RawPDUTest, ZeroCopyScope) {
+    const uint8_t buffer[] = { 1, 2, 3, 4 };
+    EXPECT_FALSE(RawPDU::zero_copy_scope::is_enabled());
+    {
+        RawPDU::zero_copy_scope zero_copy;
+        EXPECT_TRUE(RawPDU::zero_copy_scope::is_enabled());
+        RawPDU raw(buffer, sizeof(buffer));
+        EXPECT_TRUE(raw.is_payload_borrowed());
+        EXPECT_EQ(buffer, raw.payload_data());
+        {
+            RawPDU::zero_copy_scope disabled(false);
+            EXPECT_FALSE(RawPDU(buffer, sizeof(buffer)).is_payload_borrowed());
+        }
+        EXPECT_TRUE(RawPDU::zero_copy_scope::is_enabled());
+    }
+    EXPECT_FALSE(RawPDU::zero_copy_scope::is_enabled());
+    EXPECT_FALSE(RawPDU(buffer, sizeof(buffer)).is_payload_borrowed());
+}
+
+TEST_F(RawPDUTest, ZeroCopyParsing) {
+    IP::serialization_type buffer = (IP("1.2.3.4") / UDP(53, 53) / RawPDU("hello")).serialize();
+    RawPDU::zero_copy_scope zero_copy;
+    IP ip(&buffer[0], buffer.size());
+    const RawPDU& raw = ip.rfind_pdu<RawPDU>();
+    EXPECT_TRUE(raw.is_payload_borrowed());
+    EXPECT_EQ(&buffer[buffer.size() - 5], raw.payload_data());
+    EXPECT_EQ(buffer, ip.serialize());
+
+    std::unique_ptr<IP> clone(ip.clone());
+    EXPECT_FALSE(clone->rfind_pdu<RawPDU>().is_payload_borrowed());
+    EXPECT_EQ(buffer, clone->serialize());
+}
+
+TEST_F(RawPDUTest, CopiesSharePayload) {
+    RawPDU raw("hello world");
+    EXPECT_FALSE(raw.is_payload_shared());
+    std::unique_ptr<RawPDU> clone(raw.clone());
+    RawPDU copy(raw);
+    EXPECT_TRUE(raw.is_payload_shared());
+    EXPECT_TRUE(clone->is_payload_shared());
+    EXPECT_EQ(raw.payload_data(), clone->payload_data());
+    EXPECT_EQ(raw.payload_data(), copy.payload_data());
+
+    RawPDU assigned("abc");
+    assigned = copy;
+    EXPECT_EQ(raw.payload_data(), assigned.payload_data());
+
+    // The payload outlives the original
+    const uint8_t* data = raw.payload_data();
+    raw = RawPDU("other");
+    EXPECT_EQ(data, clone->payload_data());
+    EXPECT_EQ("hello world", std::string(clone->payload().begin(), clone->payload().end()));
+}
+
+TEST_F(RawPDUTest, SetterDetachesPayload) {
+    RawPDU raw("hello");
+    RawPDU copy(raw);
+    const uint8_t other[] = { 1, 2 };
+    copy.payload(other, other + sizeof(other));
+    EXPECT_FALSE(raw.is_payload_shared());
+    EXPECT_FALSE(copy.is_payload_shared());
+    EXPECT_EQ(5U, raw.payload_size());
+    EXPECT_EQ(2U, copy.payload_size());
+    EXPECT_EQ('h', raw.payload()[0]);
+}
+
+TEST_F(RawPDUTest, NonConstGetterDetachesPayload) {
+    RawPDU raw("hello");
+    RawPDU copy(raw);
+    RawPDU::payload_type& payload = copy.payload();
+    EXPECT_FALSE(raw.is_payload_shared());
+    payload[0] = 'j';
+    EXPECT_EQ('h', raw.payload_data()[0]);
+
+    // The reference may still be used, so copies can't share it anymore
+    RawPDU other(copy);
+    EXPECT_FALSE(other.is_payload_shared());
+    payload[0] = 'm';
+    EXPECT_EQ('j', other.payload_data()[0]);
+    EXPECT_EQ('m', copy.payload_data()[0]);
+}
+
+TEST_F(RawPDUTest, SetterMakesPayloadShareableAgain) {
+    RawPDU raw("hello");
+    raw.payload()[0] = 'j';
+    RawPDU copy(raw);
+    EXPECT_FALSE(copy.is_payload_shared());
+
+    const uint8_t other[] = { 1, 2 };
+    raw.payload(other, other + sizeof(other));
+    RawPDU other_copy(raw);
+    EXPECT_TRUE(other_copy.is_payload_shared());
+    EXPECT_EQ(raw.payload_data(), other_copy.payload_data());
+}
+
+TEST_F(RawPDUTest, CopyDoesntModifySource) {
+    RawPDU raw("hello");
+    const RawPDU& const_raw = raw;
+    const RawPDU::payload_type& payload = const_raw.payload();
+    RawPDU copy(const_raw);
+    std::unique_ptr<RawPDU> clone(copy.clone());
+    EXPECT_EQ(copy.payload_data(), clone->payload_data());
+    // References obtained before copying stay valid
+    EXPECT_EQ("hello", std::string(payload.begin(), payload.end()));
+
+    // The source takes its own payload back without copying it
+    EXPECT_EQ(&payload, &raw.payload());
+    EXPECT_FALSE(raw.is_payload_shared());
+    EXPECT_TRUE(copy.is_payload_shared());
+}
+
+TEST_F(RawPDUTest, ConcurrentCopies) {
+    const RawPDU raw(RawPDU::payload_type(1000, 0x2a));
+    std::vector<std::unique_ptr<RawPDU> > copies(8);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < copies.size(); ++i) {
+        threads.emplace_back([&, i]() {
+            copies[i].reset(raw.clone());
+        });
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    // All of them end up sharing the same storage
+    for (size_t i = 0; i < copies.size(); ++i) {
+        const RawPDU& copy = *copies[i];
+        EXPECT_EQ(raw.payload_data(), copy.payload_data());
+        EXPECT_EQ(raw.payload(), copy.payload());
+    }
+}
+
+TEST_F(RawPDUTest, OperatorSlashSharesPayload) {
+    RawPDU raw(RawPDU::payload_type(1000, 0x2a));
+    IP ip = IP("1.2.3.4") / UDP(53, 53) / raw;
+    EXPECT_EQ(raw.payload_data(), ip.rfind_pdu<RawPDU>().payload_data());
+    IP copy(ip);
+    EXPECT_EQ(raw.payload_data(), copy.rfind_pdu<RawPDU>().payload_data());
+    EXPECT_EQ(ip.serialize(), copy.serialize());
+}
+
+#endif // TINS_HAVE_CXX11
@@ -0,0 +1,283 @@
+#include <tins/config.h>
+#include <gtest/gtest.h>
+
+#ifdef TINS_HAVE_TPACKET_V3
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <tins/ring_sniffer.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/udp.h>
+#include <tins/rawpdu.h>
+#include <tins/exceptions.h>
+
+using namespace std;
+using namespace Tins;
+
+class RingSnifferTest : public ::testing::Test {
+public:
+    static const string iface_name;
+    static const uint16_t port;
+
+    RingSnifferConfiguration make_configuration() {
+        RingSnifferConfiguration config;
+        config.set_block_size(1 << 16);
+        config.set_block_count(4);
+        config.set_timeout(100);
+        return config;
+    }
+
+    void send_udp(const string& payload) {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        ASSERT_NE(-1, fd);
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        sendto(fd, payload.data(), payload.size(), 0,
+               reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        close(fd);
+    }
+
+    static bool is_our_packet(const PDU& pdu) {
+        const UDP* udp = pdu.find_pdu<UDP>();
+        return udp && udp->dport() == port;
+    }
+};
+
+const string RingSnifferTest::iface_name("lo");
+const uint16_t RingSnifferTest::port = 48213;
+
+// Stops the sniffer if nothing shows up, so a broken test can't hang
+class SniffStopper {
+public:
+    SniffStopper(RingSniffer& sniffer)
+    : done_(false), thread_([&] {
+        unique_lock<mutex> lock(mutex_);
+        if (!condition_.wait_for(lock, chrono::seconds(5), [&] { return done_; })) {
+            sniffer.stop_sniff();
+        }
+    }) {
+
+    }
+
+    ~SniffStopper() {
+        {
+            lock_guard<mutex> _(mutex_);
+            done_ = true;
+        }
+        condition_.notify_one();
+        thread_.join();
+    }
+private:
+    mutex mutex_;
+    condition_variable condition_;
+    bool done_;
+    thread thread_;
+};
+
+TEST_F(RingSnifferTest, CaptureOnLoopback) {
+    try {
+        RingSniffer sniffer(iface_name, make_configuration());
+        EXPECT_EQ(PDU::ETHERNET_II, sniffer.link_type());
+        EXPECT_NE(-1, sniffer.get_fd());
+        send_udp("ring sniffer");
+        SniffStopper stopper(sniffer);
+
+        bool found = false;
+        sniffer.sniff_loop([&](Packet& packet) {
+            if (is_our_packet(*packet.pdu())) {
+                const RawPDU& raw = packet.pdu()->rfind_pdu<RawPDU>();
+                EXPECT_EQ("ring sniffer", string(raw.payload().begin(),
+                                                 raw.payload().end()));
+                EXPECT_NE(0, packet.timestamp().seconds());
+                found = true;
+                return false;
+            }
+            return true;
+        }, 1000);
+        EXPECT_TRUE(found);
+    }
+    catch (socket_open_error&) {
+        // Not enough privileges to open an AF_PACKET socket
+        GTEST_SKIP();
+    }
+}
+
+TEST_F(RingSnifferTest, NextPackets) {
+    try {
+        RingSniffer sniffer(iface_name, make_configuration());
+        for (size_t i = 0; i < 5; ++i) {
+            send_udp("batch");
+        }
+        SniffStopper stopper(sniffer);
+        vector<Packet> batch;
+        size_t found = 0;
+        while (found < 5 && sniffer.next_packets(batch, 3)) {
+            EXPECT_FALSE(batch.empty());
+            EXPECT_LE(batch.size(), 3UL);
+            for (size_t i = 0; i < batch.size(); ++i) {
+                if (is_our_packet(*batch[i].pdu())) {
+                    found++;
+                }
+            }
+        }
+        EXPECT_EQ(5UL, found);
+    }
+    catch (socket_open_error&) {
+        // Not enough privileges to open an AF_PACKET socket
+        GTEST_SKIP();
+    }
+}
+
+TEST_F(RingSnifferTest, ArenaAllocation) {
+    try {
+        RingSnifferConfiguration config = make_configuration();
+        config.set_arena_allocation(true);
+        RingSniffer sniffer(iface_name, config);
+        send_udp("arena");
+        SniffStopper stopper(sniffer);
+
+        bool found = false;
+        sniffer.sniff_loop([&](PDU& pdu) {
+            if (is_our_packet(pdu)) {
+                EXPECT_EQ(5U, pdu.rfind_pdu<RawPDU>().payload_size());
+                found = true;
+                return false;
+            }
+            return true;
+        }, 1000);
+        EXPECT_TRUE(found);
+    }
+    catch (socket_open_error&) {
+        // Not enough privileges to open an AF_PACKET socket
+        GTEST_SKIP();
+    }
+}
+
+TEST_F(RingSnifferTest, ZeroCopyPayloads) {
+    try {
+        RingSnifferConfiguration config = make_configuration();
+        config.set_zero_copy_payloads(true);
+        RingSniffer sniffer(iface_name, config);
+        send_udp("zero copy");
+        SniffStopper stopper(sniffer);
+
+        bool found = false;
+        sniffer.sniff_loop([&](PDU& pdu) {
+            if (is_our_packet(pdu)) {
+                const RawPDU& raw = pdu.rfind_pdu<RawPDU>();
+                EXPECT_TRUE(raw.is_payload_borrowed());
+                EXPECT_EQ("zero copy", string(raw.payload_data(),
+                                              raw.payload_data() + raw.payload_size()));
+                found = true;
+                return false;
+            }
+            return true;
+        }, 1000);
+        EXPECT_TRUE(found);
+    }
+    catch (socket_open_error&) {
+        // Not enough privileges to open an AF_PACKET socket
+        GTEST_SKIP();
+    }
+}
+
+TEST_F(RingSnifferTest, MaxDecodeLayer) {
+    try {
+        RingSnifferConfiguration config = make_configuration();
+        config.set_max_decode_layer(PacketDecoder::NETWORK_LAYER);
+        RingSniffer sniffer(iface_name, config);
+        const string payload = "decode depth";
+        send_udp(payload);
+        SniffStopper stopper(sniffer);
+
+        bool found = false;
+        sniffer.sniff_loop([&](PDU& pdu) {
+            EXPECT_TRUE(pdu.find_pdu<UDP>() == 0);
+            const RawPDU* raw = pdu.find_pdu<RawPDU>();
+            if (pdu.find_pdu<IP>() && raw && raw->payload_size() > payload.size()) {
+                // The UDP header is part of the payload
+                const RawPDU::payload_type& data = raw->payload();
+                if (string(data.end() - payload.size(), data.end()) == payload) {
+                    EXPECT_EQ(payload.size() + 8, data.size());
+                    found = true;
+                    return false;
+                }
+            }
+            return true;
+        }, 1000);
+        EXPECT_TRUE(found);
+    }
+    catch (socket_open_error&) {
+        // Not enough privileges to open an AF_PACKET socket
+        GTEST_SKIP();
+    }
+}
+
+TEST_F(RingSnifferTest, StopSniff) {
+    try {
+        RingSniffer sniffer(iface_name, make_configuration());
+        sniffer.stop_sniff();
+        RingSniffer::frame frame;
+        // Drain anything captured so far, this has to end once we're stopped
+        while (sniffer.next_frame(frame)) {
+            EXPECT_GE(frame.length, frame.size);
+        }
+    }
+    catch (socket_open_error&) {
+        // Not enough privileges to open an AF_PACKET socket
+        GTEST_SKIP();
+    }
+}
+
+TEST_F(RingSnifferTest, StopSniffWithReadyBlock) {
+    try {
+        RingSniffer sniffer(iface_name, make_configuration());
+        send_udp("stop");
+        // Give the kernel time to retire the block
+        this_thread::sleep_for(chrono::milliseconds(100));
+        sniffer.stop_sniff();
+        RingSniffer::frame current;
+        EXPECT_FALSE(sniffer.next_frame(current));
+    }
+    catch (socket_open_error&) {
+        // Not enough privileges to open an AF_PACKET socket
+        GTEST_SKIP();
+    }
+}
+
+TEST_F(RingSnifferTest, NanosecondTimestamps) {
+    try {
+        RingSniffer sniffer(iface_name, make_configuration());
+        send_udp("timestamp");
+        SniffStopper stopper(sniffer);
+        RingSniffer::frame current;
+        ASSERT_TRUE(sniffer.next_frame(current));
+        EXPECT_EQ(static_cast<uint64_t>(current.timestamp.seconds()),
+                  current.timestamp_ns / 1000000000);
+        EXPECT_EQ(static_cast<uint64_t>(current.timestamp.microseconds()),
+                  (current.timestamp_ns / 1000) % 1000000);
+    }
+    catch (socket_open_error&) {
+        // Not enough privileges to open an AF_PACKET socket
+        GTEST_SKIP();
+    }
+}
+
+TEST_F(RingSnifferTest, InvalidInterface) {
+    EXPECT_THROW(RingSniffer("ishallnotexist"), invalid_interface);
+}
+
+#endif // TINS_HAVE_TPACKET_V3
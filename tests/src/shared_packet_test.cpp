@@ -0,0 +1,147 @@
+#include <tins/config.h>
+#include <gtest/gtest.h>
+
+#ifdef TINS_HAVE_CXX11
+
+#include <vector>
+#include <thread>
+#include <tins/shared_packet.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/tcp.h>
+#include <tins/rawpdu.h>
+
+using namespace std;
+using namespace Tins;
+
+class SharedPacketTest : public testing::Test {
+public:
+    static PDU::serialization_type make_buffer() {
+        EthernetII eth = EthernetII() / IP("1.2.3.4", "5.6.7.8") / TCP(80, 1234) /
+                         RawPDU("hello");
+        return eth.serialize();
+    }
+
+    static Timestamp make_timestamp() {
+        timeval tv;
+        tv.tv_sec = 1500000000;
+        tv.tv_usec = 1234;
+        return Timestamp(tv);
+    }
+};
+
+TEST_F(SharedPacketTest, DefaultConstructor) {
+    SharedPacket packet;
+    EXPECT_FALSE(packet);
+    EXPECT_TRUE(packet.pdu() == 0);
+    EXPECT_TRUE(packet.data() == 0);
+    EXPECT_EQ(0U, packet.size());
+    EXPECT_EQ(0UL, packet.use_count());
+    EXPECT_FALSE(packet.to_packet());
+}
+
+TEST_F(SharedPacketTest, FromPacket) {
+    EthernetII eth = EthernetII() / IP("1.2.3.4", "5.6.7.8") / TCP(80, 1234);
+    Packet input(eth.clone(), make_timestamp(), Packet::own_pdu());
+    const PDU* chain = input.pdu();
+    SharedPacket packet(move(input));
+    EXPECT_TRUE(input.pdu() == 0);
+    EXPECT_TRUE(packet);
+    EXPECT_EQ(chain, packet.pdu());
+    EXPECT_EQ(make_timestamp().microseconds(), packet.timestamp().microseconds());
+    EXPECT_TRUE(packet.data() == 0);
+    EXPECT_EQ(80, packet.rfind_pdu<TCP>().dport());
+}
+
+TEST_F(SharedPacketTest, CopiesShareChain) {
+    SharedPacket packet((IP("1.2.3.4") / TCP(22, 1234)).clone(), make_timestamp());
+    EXPECT_EQ(1UL, packet.use_count());
+    {
+        SharedPacket copy(packet);
+        EXPECT_EQ(2UL, packet.use_count());
+        EXPECT_EQ(packet.pdu(), copy.pdu());
+
+        SharedPacket assigned;
+        assigned = copy;
+        EXPECT_EQ(3UL, packet.use_count());
+        EXPECT_EQ(packet.pdu(), assigned.pdu());
+
+        assigned = assigned;
+        EXPECT_EQ(3UL, packet.use_count());
+
+        SharedPacket moved(move(assigned));
+        EXPECT_FALSE(assigned);
+        EXPECT_EQ(3UL, packet.use_count());
+    }
+    EXPECT_EQ(1UL, packet.use_count());
+    EXPECT_EQ(22, packet.rfind_pdu<TCP>().dport());
+}
+
+TEST_F(SharedPacketTest, FromBytes) {
+    PDU::serialization_type buffer = make_buffer();
+    SharedPacket packet(PDU::ETHERNET_II, &buffer[0], buffer.size(), make_timestamp());
+    ASSERT_EQ(buffer.size(), packet.size());
+    EXPECT_TRUE(equal(buffer.begin(), buffer.end(), packet.data()));
+    SharedPacket copy(packet);
+    ASSERT_TRUE(copy.pdu() != 0);
+    EXPECT_EQ(packet.pdu(), copy.pdu());
+    const RawPDU& raw = packet.rfind_pdu<RawPDU>();
+    // The shared chain never borrows the buffer
+    EXPECT_FALSE(raw.is_payload_borrowed());
+    EXPECT_EQ("hello", string(raw.payload().begin(), raw.payload().end()));
+}
+
+TEST_F(SharedPacketTest, FromLazyPacket) {
+    PDU::serialization_type buffer = make_buffer();
+    LazyPacket lazy(PDU::ETHERNET_II, &buffer[0], buffer.size(), make_timestamp());
+    SharedPacket packet(move(lazy));
+    EXPECT_EQ(buffer.size(), packet.size());
+    EXPECT_EQ(make_timestamp().microseconds(), packet.timestamp().microseconds());
+    EXPECT_EQ(1234, packet.rfind_pdu<TCP>().sport());
+}
+
+TEST_F(SharedPacketTest, MalformedBytes) {
+    const uint8_t buffer[] = { 0x45, 0x00 };
+    SharedPacket packet(PDU::IP, buffer, sizeof(buffer), make_timestamp());
+    EXPECT_TRUE(packet);
+    EXPECT_TRUE(packet.pdu() == 0);
+    EXPECT_TRUE(packet.find_pdu<IP>() == 0);
+    EXPECT_THROW(packet.rfind_pdu<IP>(), pdu_not_found);
+}
+
+TEST_F(SharedPacketTest, ToPacket) {
+    PDU::serialization_type buffer = make_buffer();
+    SharedPacket packet(PDU::ETHERNET_II, &buffer[0], buffer.size(), make_timestamp());
+    Packet copy = packet.to_packet();
+    ASSERT_TRUE(copy.pdu() != 0);
+    EXPECT_NE(packet.pdu(), copy.pdu());
+    copy.pdu()->rfind_pdu<TCP>().dport(443);
+    EXPECT_EQ(80, packet.rfind_pdu<TCP>().dport());
+}
+
+TEST_F(SharedPacketTest, ConcurrentAccess) {
+    PDU::serialization_type buffer = make_buffer();
+    SharedPacket packet(PDU::ETHERNET_II, &buffer[0], buffer.size(), make_timestamp());
+    vector<const PDU*> chains(4);
+    vector<thread> threads;
+    for (size_t i = 0; i < chains.size(); ++i) {
+        SharedPacket copy(packet);
+        threads.emplace_back([copy, &chains, i]() {
+            // Copies are created and destroyed while decoding
+            for (size_t j = 0; j < 1000; ++j) {
+                SharedPacket other(copy);
+                chains[i] = other.pdu();
+            }
+        });
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+    ASSERT_TRUE(chains[0] != 0);
+    for (size_t i = 0; i < chains.size(); ++i) {
+        EXPECT_EQ(chains[0], chains[i]);
+    }
+    EXPECT_EQ(1UL, packet.use_count());
+}
+
+#endif // TINS_HAVE_CXX11
@@ -0,0 +1,195 @@
+#include <tins/config.h>
+#include <gtest/gtest.h>
+
+#ifdef TINS_HAVE_TPACKET_V3
+
+#include <string>
+#include <vector>
+#include <set>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <stdexcept>
+#include <cstring>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <tins/sniffer_group.h>
+#include <tins/udp.h>
+#include <tins/exceptions.h>
+
+using namespace std;
+using namespace Tins;
+
+class SnifferGroupTest : public ::testing::Test {
+public:
+    static const string iface_name;
+    static const uint16_t port;
+
+    RingSnifferConfiguration make_configuration() {
+        RingSnifferConfiguration config;
+        config.set_block_size(1 << 16);
+        config.set_block_count(4);
+        config.set_timeout(100);
+        return config;
+    }
+
+    void send_udp(uint16_t source_port) {
+        int fd = socket(AF_INET, SOCK_DGRAM, 0);
+        ASSERT_NE(-1, fd);
+        sockaddr_in address;
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_port = htons(source_port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        ASSERT_EQ(0, ::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)));
+        address.sin_port = htons(port);
+        sendto(fd, "group", 5, 0, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+        close(fd);
+    }
+};
+
+const string SnifferGroupTest::iface_name("lo");
+const uint16_t SnifferGroupTest::port = 48214;
+
+// Stops the group if the test takes too long, so a lost packet can't hang it
+class GroupStopper {
+public:
+    GroupStopper(SnifferGroup& group)
+    : done_(false), thread_([&] {
+        unique_lock<mutex> lock(mutex_);
+        if (!condition_.wait_for(lock, chrono::seconds(5), [&] { return done_; })) {
+            group.stop_sniff();
+        }
+    }) {
+
+    }
+
+    ~GroupStopper() {
+        {
+            lock_guard<mutex> _(mutex_);
+            done_ = true;
+        }
+        condition_.notify_one();
+        thread_.join();
+    }
+private:
+    mutex mutex_;
+    condition_variable condition_;
+    bool done_;
+    thread thread_;
+};
+
+TEST_F(SnifferGroupTest, FlowsStayOnOneMember) {
+    try {
+        const size_t packet_count = 20;
+        SnifferGroup group(iface_name, 3, RingSnifferConfiguration::FANOUT_HASH,
+                           make_configuration());
+        EXPECT_EQ(3UL, group.size());
+        for (size_t i = 0; i < packet_count; ++i) {
+            send_udp(static_cast<uint16_t>(40000 + i));
+        }
+
+        // Packets sent over loopback are captured twice, once per direction
+        vector<multiset<uint16_t> > ports(group.size());
+        atomic<size_t> total(0);
+        GroupStopper stopper(group);
+        group.sniff_loop([&](size_t index) {
+            multiset<uint16_t>* member_ports = &ports[index];
+            return [&, member_ports](const PDU& pdu) {
+                const UDP* udp = pdu.find_pdu<UDP>();
+                if (udp && udp->dport() == port) {
+                    member_ports->insert(udp->sport());
+                    if (++total == packet_count * 2) {
+                        group.stop_sniff();
+                    }
+                }
+                return true;
+            };
+        });
+        EXPECT_EQ(packet_count * 2, total);
+        for (size_t i = 0; i < packet_count; ++i) {
+            const uint16_t source_port = static_cast<uint16_t>(40000 + i);
+            size_t members = 0;
+            for (size_t j = 0; j < ports.size(); ++j) {
+                if (ports[j].count(source_port)) {
+                    EXPECT_EQ(2UL, ports[j].count(source_port));
+                    members++;
+                }
+            }
+            EXPECT_EQ(1UL, members);
+        }
+    }
+    catch (socket_open_error&) {
+        // Not enough privileges to open an AF_PACKET socket
+        GTEST_SKIP();
+    }
+}
+
+TEST_F(SnifferGroupTest, PreviousStopIsCleared) {
+    try {
+        SnifferGroup group(iface_name, 2, RingSnifferConfiguration::FANOUT_ROUND_ROBIN,
+                           make_configuration());
+        // Neither member is sniffing, so nothing consumes this
+        group.stop_sniff();
+        send_udp(42000);
+        atomic<size_t> total(0);
+        GroupStopper stopper(group);
+        group.sniff_loop([&](size_t) {
+            return [&](const PDU& pdu) {
+                const UDP* udp = pdu.find_pdu<UDP>();
+                if (udp && udp->dport() == port && ++total == 2) {
+                    group.stop_sniff();
+                }
+                return true;
+            };
+        });
+        EXPECT_EQ(2UL, total);
+    }
+    catch (socket_open_error&) {
+        // Not enough privileges to open an AF_PACKET socket
+        GTEST_SKIP();
+    }
+}
+
+TEST_F(SnifferGroupTest, ExceptionIsPropagated) {
+    try {
+        SnifferGroup group(iface_name, 2, RingSnifferConfiguration::FANOUT_ROUND_ROBIN,
+                           make_configuration());
+        send_udp(41000);
+        send_udp(41001);
+        EXPECT_THROW(
+            group.sniff_loop([&](size_t) {
+                return [&](const PDU&) -> bool {
+                    throw runtime_error("failed");
+                };
+            }),
+            runtime_error
+        );
+    }
+    catch (socket_open_error&) {
+        // Not enough privileges to open an AF_PACKET socket
+        GTEST_SKIP();
+    }
+}
+
+TEST_F(SnifferGroupTest, GroupsUseDifferentFanoutGroups) {
+    try {
+        SnifferGroup first(iface_name, 2, RingSnifferConfiguration::FANOUT_HASH,
+                           make_configuration());
+        SnifferGroup second(iface_name, 2, RingSnifferConfiguration::FANOUT_HASH,
+                            make_configuration());
+        EXPECT_EQ(first.sniffer(0).fanout_group_id(), first.sniffer(1).fanout_group_id());
+        EXPECT_EQ(second.sniffer(0).fanout_group_id(), second.sniffer(1).fanout_group_id());
+        EXPECT_NE(first.sniffer(0).fanout_group_id(), second.sniffer(0).fanout_group_id());
+    }
+    catch (socket_open_error&) {
+        // Not enough privileges to open an AF_PACKET socket
+        GTEST_SKIP();
+    }
+}
+
+#endif // TINS_HAVE_TPACKET_V3
@@ -0,0 +1,179 @@
+#include <tins/config.h>
+#include <gtest/gtest.h>
+
+#ifdef TINS_HAVE_EPOLL
+
+#include <thread>
+#include <chrono>
+#include <unistd.h>
+#include <tins/sniffer_reactor.h>
+#include <tins/exceptions.h>
+
+using namespace std;
+using namespace Tins;
+
+class SnifferReactorTest : public ::testing::Test {
+public:
+    SnifferReactorTest() {
+        EXPECT_EQ(0, pipe(first_pipe_));
+        EXPECT_EQ(0, pipe(second_pipe_));
+    }
+
+    ~SnifferReactorTest() {
+        close(first_pipe_[0]);
+        close(first_pipe_[1]);
+        close(second_pipe_[0]);
+        close(second_pipe_[1]);
+    }
+
+    static void write_byte(int fd) {
+        const char value = 'a';
+        EXPECT_EQ(1, write(fd, &value, sizeof(value)));
+    }
+
+    static void read_byte(int fd) {
+        char value;
+        EXPECT_EQ(1, read(fd, &value, sizeof(value)));
+    }
+protected:
+    int first_pipe_[2];
+    int second_pipe_[2];
+};
+
+TEST_F(SnifferReactorTest, Descriptors) {
+    SnifferReactor reactor;
+    int first_calls = 0;
+    int second_calls = 0;
+    reactor.add_descriptor(first_pipe_[0], [&](int fd) {
+        EXPECT_EQ(first_pipe_[0], fd);
+        read_byte(fd);
+        first_calls++;
+        return true;
+    });
+    reactor.add_descriptor(second_pipe_[0], [&](int fd) {
+        read_byte(fd);
+        second_calls++;
+        return true;
+    });
+    EXPECT_EQ(2UL, reactor.size());
+    EXPECT_EQ(0UL, reactor.run_once(0));
+
+    write_byte(first_pipe_[1]);
+    EXPECT_EQ(1UL, reactor.run_once(100));
+    EXPECT_EQ(1, first_calls);
+    EXPECT_EQ(0, second_calls);
+
+    write_byte(first_pipe_[1]);
+    write_byte(second_pipe_[1]);
+    EXPECT_EQ(2UL, reactor.run_once(100));
+    EXPECT_EQ(2, first_calls);
+    EXPECT_EQ(1, second_calls);
+}
+
+TEST_F(SnifferReactorTest, ReturningFalseRemovesSource) {
+    SnifferReactor reactor;
+    int calls = 0;
+    reactor.add_descriptor(first_pipe_[0], [&](int fd) {
+        read_byte(fd);
+        calls++;
+        return false;
+    });
+    write_byte(first_pipe_[1]);
+    write_byte(first_pipe_[1]);
+    EXPECT_EQ(1UL, reactor.run_once(100));
+    EXPECT_EQ(0UL, reactor.size());
+    EXPECT_EQ(0UL, reactor.run_once(0));
+    EXPECT_EQ(1, calls);
+}
+
+TEST_F(SnifferReactorTest, RemoveFromCallback) {
+    SnifferReactor reactor;
+    int calls = 0;
+    SnifferReactor::handle_type second = 0;
+    reactor.add_descriptor(first_pipe_[0], [&](int fd) {
+        read_byte(fd);
+        reactor.remove(second);
+        calls++;
+        return true;
+    });
+    second = reactor.add_descriptor(second_pipe_[0], [&](int fd) {
+        read_byte(fd);
+        reactor.remove(second);
+        calls++;
+        return true;
+    });
+    write_byte(first_pipe_[1]);
+    write_byte(second_pipe_[1]);
+    // Whichever runs first removes the second source
+    reactor.run_once(100);
+    EXPECT_EQ(1UL, reactor.size());
+    EXPECT_GE(calls, 1);
+    // Unknown handles are ignored
+    reactor.remove(second);
+    reactor.remove(12345);
+    EXPECT_EQ(1UL, reactor.size());
+}
+
+TEST_F(SnifferReactorTest, Timers) {
+    SnifferReactor reactor;
+    int fast_calls = 0;
+    int slow_calls = 0;
+    reactor.add_timer(5, [&]() {
+        return ++fast_calls < 3;
+    });
+    SnifferReactor::handle_type slow = reactor.add_timer(10000, [&]() {
+        slow_calls++;
+        return true;
+    });
+    while (reactor.size() == 2) {
+        reactor.run_once(1000);
+    }
+    EXPECT_EQ(3, fast_calls);
+    EXPECT_EQ(0, slow_calls);
+    reactor.remove(slow);
+    // No sources left, so this returns right away
+    reactor.run();
+}
+
+TEST_F(SnifferReactorTest, ZeroIntervalTimer) {
+    SnifferReactor reactor;
+    EXPECT_THROW(reactor.add_timer(0, [&]() { return true; }), event_loop_error);
+    EXPECT_EQ(0UL, reactor.size());
+}
+
+TEST_F(SnifferReactorTest, StopFromAnotherThread) {
+    SnifferReactor reactor;
+    reactor.add_descriptor(first_pipe_[0], [&](int) {
+        return true;
+    });
+    thread stopper([&]() {
+        this_thread::sleep_for(chrono::milliseconds(50));
+        reactor.stop();
+    });
+    reactor.run();
+    stopper.join();
+    EXPECT_EQ(1UL, reactor.size());
+}
+
+TEST_F(SnifferReactorTest, StopBeforeRun) {
+    SnifferReactor reactor;
+    int calls = 0;
+    reactor.add_descriptor(first_pipe_[0], [&](int fd) {
+        read_byte(fd);
+        // Stopping from a callback makes run return afterwards
+        reactor.stop();
+        return ++calls < 2;
+    });
+    reactor.stop();
+    reactor.run();
+    EXPECT_EQ(0, calls);
+    write_byte(first_pipe_[1]);
+    reactor.run();
+    EXPECT_EQ(1, calls);
+    write_byte(first_pipe_[1]);
+    reactor.run();
+    EXPECT_EQ(2, calls);
+    EXPECT_EQ(0UL, reactor.size());
+}
+
+#endif // TINS_HAVE_EPOLL
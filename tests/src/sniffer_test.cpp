@@ -0,0 +1,130 @@
+#include <tins/config.h>
+#include <gtest/gtest.h>
+
+#ifdef TINS_HAVE_CXX11
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <tins/sniffer.h>
+#include <tins/packet_writer.h>
+#include <tins/packet.h>
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/tcp.h>
+#include <tins/rawpdu.h>
+
+using namespace std;
+using namespace Tins;
+
+class SnifferTest : public testing::Test {
+public:
+    static const char* file_name;
+    static const uint16_t packet_count;
+
+    // Writes a file containing TCP packets with destination ports 1 to packet_count
+    void SetUp() {
+        PacketWriter writer(file_name, DataLinkType<EthernetII>());
+        for (uint16_t i = 1; i <= packet_count; ++i) {
+            EthernetII eth = EthernetII() / IP("1.2.3.4", "5.6.7.8") / TCP(i, 1234) /
+                             RawPDU("hello");
+            writer.write(eth);
+        }
+    }
+
+    void TearDown() {
+        remove(file_name);
+    }
+
+    static uint16_t dport(const Packet& packet) {
+        return packet.pdu()->rfind_pdu<TCP>().dport();
+    }
+};
+
+const char* SnifferTest::file_name = "sniffer_test.pcap";
+const uint16_t SnifferTest::packet_count = 5;
+
+TEST_F(SnifferTest, NextPackets) {
+    FileSniffer sniffer(file_name);
+    vector<Packet> batch;
+    EXPECT_TRUE(sniffer.next_packets(batch, 2));
+    ASSERT_EQ(2UL, batch.size());
+    EXPECT_EQ(1, dport(batch[0]));
+    EXPECT_EQ(2, dport(batch[1]));
+
+    EXPECT_TRUE(sniffer.next_packets(batch, 2));
+    ASSERT_EQ(2UL, batch.size());
+    EXPECT_EQ(3, dport(batch[0]));
+    EXPECT_EQ(4, dport(batch[1]));
+
+    // Only one packet is left
+    EXPECT_TRUE(sniffer.next_packets(batch, 2));
+    ASSERT_EQ(1UL, batch.size());
+    EXPECT_EQ(5, dport(batch[0]));
+
+    // We've reached the end of the file
+    EXPECT_FALSE(sniffer.next_packets(batch, 2));
+    EXPECT_TRUE(batch.empty());
+}
+
+TEST_F(SnifferTest, NextPacketsWholeFile) {
+    FileSniffer sniffer(file_name);
+    vector<Packet> batch;
+    EXPECT_TRUE(sniffer.next_packets(batch));
+    ASSERT_EQ(static_cast<size_t>(packet_count), batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        EXPECT_EQ(i + 1, dport(batch[i]));
+    }
+    EXPECT_FALSE(sniffer.next_packets(batch));
+    EXPECT_TRUE(batch.empty());
+}
+
+TEST_F(SnifferTest, NextPacketsDoesNotBorrowPayloads) {
+    FileSniffer sniffer(file_name);
+    sniffer.set_zero_copy_payloads(true);
+    vector<Packet> batch;
+    EXPECT_TRUE(sniffer.next_packets(batch));
+    ASSERT_EQ(static_cast<size_t>(packet_count), batch.size());
+    for (size_t i = 0; i < batch.size(); ++i) {
+        const RawPDU& raw = batch[i].pdu()->rfind_pdu<RawPDU>();
+        EXPECT_FALSE(raw.is_payload_borrowed());
+        EXPECT_EQ("hello", string(raw.payload_data(),
+                                  raw.payload_data() + raw.payload_size()));
+    }
+}
+
+TEST_F(SnifferTest, SniffBatchLoop) {
+    FileSniffer sniffer(file_name);
+    vector<uint16_t> ports;
+    sniffer.sniff_batch_loop([&](Packet& packet) {
+        ports.push_back(dport(packet));
+        return true;
+    }, 2);
+    ASSERT_EQ(2UL, ports.size());
+
+    // The loop carries on where the previous one stopped and ends with the file
+    ports.clear();
+    sniffer.sniff_batch_loop([&](Packet& packet) {
+        ports.push_back(dport(packet));
+        return true;
+    });
+    ASSERT_EQ(3UL, ports.size());
+    EXPECT_EQ(3, ports[0]);
+    EXPECT_EQ(4, ports[1]);
+    EXPECT_EQ(5, ports[2]);
+}
+
+TEST_F(SnifferTest, SniffBatchLoopStopsWhenFunctorReturnsFalse) {
+    FileSniffer sniffer(file_name);
+    vector<uint16_t> ports;
+    sniffer.sniff_batch_loop([&](Packet& packet) {
+        ports.push_back(dport(packet));
+        return ports.size() < 3;
+    });
+    ASSERT_EQ(3UL, ports.size());
+    EXPECT_EQ(1, ports[0]);
+    EXPECT_EQ(2, ports[1]);
+    EXPECT_EQ(3, ports[2]);
+}
+
+#endif // TINS_HAVE_CXX11
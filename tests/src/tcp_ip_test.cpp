@@ -8,7 +8,16 @@
 #include <string>
 #include <limits>
 #include <cassert>
+#include <map>
+#include <memory>
+#include <set>
+#include <mutex>
+#include <thread>
 #include <tins/tcp_ip/stream_follower.h>
+#include <tins/tcp_ip/stream_identifier.h>
+#include <tins/tcp_ip/parallel_stream_follower.h>
+#include <tins/tcp_ip/data_tracker.h>
+#include <tins/tcp_ip/memory_budget.h>
 #include <tins/tcp.h>
 #include <tins/ip.h>
 #include <tins/ip_address.h>
@@ -286,6 +295,93 @@ TEST_F(FlowTest, Overlapping) {
     run_tests(chunks, payload);
 }
 
+TEST_F(FlowTest, DataSpanCallback) {
+    ordering_info_type chunks = split_payload(payload, 5);
+    swap(chunks[1], chunks[3]);
+    reverse(chunks.begin() + 5, chunks.end());
+    const uint32_t initial_seqs[] = { 0, 20, numeric_limits<uint32_t>::max() - 10 };
+    for (size_t i = 0; i < sizeof(initial_seqs) / sizeof(initial_seqs[0]); ++i) {
+        string flow_payload;
+        Flow flow(IPv4Address("1.2.3.4"), 22, initial_seqs[i]);
+        flow.data_span_callback([&](Flow& flow, const uint8_t* data, size_t size,
+                                    uint64_t offset) {
+            EXPECT_EQ(flow_payload.size(), offset);
+            EXPECT_TRUE(flow.payload().empty());
+            flow_payload.append(data, data + size);
+        });
+        vector<EthernetII> packets = chunks_to_packets(initial_seqs[i], chunks, payload);
+        for (size_t j = 0; j < packets.size(); ++j) {
+            flow.process_packet(packets[j]);
+        }
+        EXPECT_EQ(payload, flow_payload);
+        EXPECT_TRUE(flow.payload().empty());
+        EXPECT_EQ(0U, flow.total_buffered_bytes());
+        EXPECT_TRUE(flow.buffered_payload().empty());
+    }
+}
+
+TEST_F(FlowTest, KeepPayloadSegments) {
+    ordering_info_type chunks = split_payload(payload, 5);
+    swap(chunks[1], chunks[3]);
+    reverse(chunks.begin() + 5, chunks.end());
+    const uint32_t initial_seqs[] = { 0, 20, numeric_limits<uint32_t>::max() - 10 };
+    for (size_t i = 0; i < sizeof(initial_seqs) / sizeof(initial_seqs[0]); ++i) {
+        Flow flow(IPv4Address("1.2.3.4"), 22, initial_seqs[i]);
+        flow.keep_payload_segments(true);
+        vector<EthernetII> packets = chunks_to_packets(initial_seqs[i], chunks, payload);
+        for (size_t j = 0; j < packets.size(); ++j) {
+            flow.process_packet(packets[j]);
+        }
+        EXPECT_TRUE(flow.payload().empty());
+        EXPECT_EQ(payload.size(), flow.payload_size());
+        Flow::payload_segments_type segments = flow.payload_segments();
+        EXPECT_EQ(chunks.size(), segments.size());
+        string flow_payload;
+        for (size_t j = 0; j < segments.size(); ++j) {
+            flow_payload.append(segments[j].data, segments[j].data + segments[j].size);
+        }
+        EXPECT_EQ(payload, flow_payload);
+        flow.clear_payload();
+        EXPECT_TRUE(flow.payload_segments().empty());
+        EXPECT_EQ(0U, flow.payload_size());
+    }
+}
+
+TEST_F(FlowTest, KeptSegmentsSkipOverlaps) {
+    DataTracker tracker(1000);
+    tracker.keep_payload_segments(true);
+    const string data = "0123456789";
+    EXPECT_TRUE(tracker.process_payload(1000, (const uint8_t*)&data[0], 6));
+    EXPECT_TRUE(tracker.process_payload(1004, DataTracker::payload_type(data.begin() + 4,
+                                                                        data.end())));
+    DataTracker::payload_segments_type segments = tracker.payload_segments();
+    ASSERT_EQ(2U, segments.size());
+    EXPECT_EQ("012345", string(segments[0].data, segments[0].data + segments[0].size));
+    EXPECT_EQ("6789", string(segments[1].data, segments[1].data + segments[1].size));
+    EXPECT_EQ(10U, tracker.payload_size());
+    EXPECT_EQ(1010U, tracker.sequence_number());
+}
+
+TEST_F(FlowTest, OwnedPayloadsAreNotCopied) {
+    Flow flow(IPv4Address("1.2.3.4"), 22, 1000);
+    EthernetII in_order = EthernetII() / IP("1.2.3.4", "4.3.2.1") / TCP(22, 23) /
+                          RawPDU(string(50, 'a'));
+    in_order.rfind_pdu<TCP>().seq(1000);
+    EthernetII out_of_order = EthernetII() / IP("1.2.3.4", "4.3.2.1") / TCP(22, 23) /
+                              RawPDU(string(10, 'b'));
+    out_of_order.rfind_pdu<TCP>().seq(1100);
+    const uint8_t* in_order_data = in_order.rfind_pdu<RawPDU>().payload_data();
+    const uint8_t* out_of_order_data = out_of_order.rfind_pdu<RawPDU>().payload_data();
+
+    flow.process_packet(out_of_order);
+    ASSERT_EQ(1UL, flow.buffered_payload().size());
+    EXPECT_EQ(out_of_order_data, flow.buffered_payload().begin()->second.data());
+
+    flow.process_packet(in_order);
+    EXPECT_EQ(in_order_data, flow.payload().data());
+    EXPECT_EQ(50UL, flow.payload().size());
+}
+
 TEST_F(FlowTest, IgnoreDataPackets) {
     using std::placeholders::_1;
 
@@ -430,6 +526,359 @@ TEST_F(FlowTest, StreamFollower_CleanupWorks) {
     EXPECT_TRUE(timed_out);
 }
 
+TEST_F(FlowTest, StreamFollower_RecentlySeenStreamsAreKept) {
+    using std::placeholders::_1;
+
+    vector<EthernetII> packets1 = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    vector<EthernetII> packets2 = three_way_handshake(29, 60, "1.2.3.5", 22, "4.3.2.1", 25);
+    vector<EthernetII> packets3 = three_way_handshake(29, 60, "1.2.3.6", 22, "4.3.2.1", 25);
+    vector<IPv4Address> timed_out;
+    StreamFollower follower;
+    follower.new_stream_callback(bind(&FlowTest::on_new_stream, this, _1));
+    follower.stream_termination_callback([&](Stream& stream,
+                                             StreamFollower::TerminationReason reason) {
+        EXPECT_EQ(StreamFollower::TIMEOUT, reason);
+        timed_out.push_back(stream.client_addr_v4());
+    });
+    auto base_time = duration_cast<Stream::timestamp_type>(system_clock::now().time_since_epoch());
+    Packet packet1(packets1[0], base_time);
+    Packet packet2(packets2[0], base_time + minutes(1));
+    // The first stream is seen again, so it should outlive the second one
+    Packet packet3(packets1[1], base_time + minutes(4));
+    Packet packet4(packets3[0], base_time + minutes(7));
+    follower.process_packet(packet1);
+    follower.process_packet(packet2);
+    follower.process_packet(packet3);
+    follower.process_packet(packet4);
+    ASSERT_EQ(1UL, timed_out.size());
+    EXPECT_EQ(IPv4Address("1.2.3.5"), timed_out[0]);
+    EXPECT_NO_THROW(
+        follower.find_stream(IPv4Address("1.2.3.4"), 22, IPv4Address("4.3.2.1"), 25)
+    );
+    // Now the first one expires as well
+    Packet packet5(packets3[1], base_time + minutes(10));
+    follower.process_packet(packet5);
+    ASSERT_EQ(2UL, timed_out.size());
+    EXPECT_EQ(IPv4Address("1.2.3.4"), timed_out[1]);
+    EXPECT_NO_THROW(
+        follower.find_stream(IPv4Address("1.2.3.6"), 22, IPv4Address("4.3.2.1"), 25)
+    );
+}
+
+TEST_F(FlowTest, StreamFollower_OutOfOrderTimestamps) {
+    using std::placeholders::_1;
+
+    vector<EthernetII> packets1 = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    vector<EthernetII> packets2 = three_way_handshake(29, 60, "1.2.3.5", 22, "4.3.2.1", 25);
+    vector<EthernetII> packets3 = three_way_handshake(29, 60, "1.2.3.6", 22, "4.3.2.1", 25);
+    vector<IPv4Address> timed_out;
+    StreamFollower follower;
+    follower.new_stream_callback(bind(&FlowTest::on_new_stream, this, _1));
+    follower.stream_termination_callback([&](Stream& stream,
+                                             StreamFollower::TerminationReason reason) {
+        EXPECT_EQ(StreamFollower::TIMEOUT, reason);
+        timed_out.push_back(stream.client_addr_v4());
+    });
+    auto base_time = duration_cast<Stream::timestamp_type>(system_clock::now().time_since_epoch());
+    // The second stream is processed last, but it was seen first
+    Packet packet1(packets1[0], base_time + minutes(4));
+    Packet packet2(packets2[0], base_time);
+    Packet packet3(packets3[0], base_time + minutes(6));
+    follower.process_packet(packet1);
+    follower.process_packet(packet2);
+    EXPECT_TRUE(timed_out.empty());
+    follower.process_packet(packet3);
+    ASSERT_EQ(1UL, timed_out.size());
+    EXPECT_EQ(IPv4Address("1.2.3.5"), timed_out[0]);
+    EXPECT_NO_THROW(
+        follower.find_stream(IPv4Address("1.2.3.4"), 22, IPv4Address("4.3.2.1"), 25)
+    );
+}
+
+TEST_F(FlowTest, StreamFollower_MemoryPressure) {
+    using std::placeholders::_1;
+
+    vector<pair<uint16_t, StreamFollower::TerminationReason> > terminated;
+    StreamFollower follower;
+    follower.new_stream_callback(bind(&FlowTest::on_new_stream, this, _1));
+    follower.stream_termination_callback([&](Stream& stream,
+                                             StreamFollower::TerminationReason reason) {
+        terminated.push_back(make_pair(stream.client_port(), reason));
+    });
+    follower.memory_budget(150);
+    EXPECT_EQ(150U, follower.memory_budget()->limit());
+    ordering_info_type chunks;
+    chunks.push_back(order_element(0, 100));
+    for (uint16_t port = 22; port < 25; ++port) {
+        vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", port,
+                                                         "4.3.2.1", 25);
+        // Leave a gap so the data is buffered
+        vector<EthernetII> data = chunks_to_packets(40, chunks, payload);
+        set_endpoints(data, "1.2.3.4", port, "4.3.2.1", 25);
+        packets.push_back(data[0]);
+        for (size_t i = 0; i < packets.size(); ++i) {
+            follower.process_packet(packets[i]);
+        }
+        // The previous stream is the least recently seen one
+        if (port == 22) {
+            EXPECT_TRUE(terminated.empty());
+        }
+        else {
+            ASSERT_EQ(port - 22UL, terminated.size());
+            EXPECT_EQ(port - 1, terminated.back().first);
+            EXPECT_EQ(StreamFollower::MEMORY_PRESSURE, terminated.back().second);
+        }
+        EXPECT_EQ(100U, follower.buffered_bytes());
+        EXPECT_EQ(100U, follower.memory_budget()->usage());
+    }
+    EXPECT_THROW(
+        follower.find_stream(IPv4Address("1.2.3.4"), 22, IPv4Address("4.3.2.1"), 25), 
+        stream_not_found
+    );
+    EXPECT_NO_THROW(
+        follower.find_stream(IPv4Address("1.2.3.4"), 24, IPv4Address("4.3.2.1"), 25)
+    );
+}
+
+TEST_F(FlowTest, StreamFollower_SharedMemoryBudget) {
+    using std::placeholders::_1;
+
+    shared_ptr<MemoryBudget> budget = make_shared<MemoryBudget>(1000);
+    ordering_info_type chunks;
+    chunks.push_back(order_element(0, 100));
+    {
+        StreamFollower follower1;
+        StreamFollower follower2;
+        follower1.memory_budget(budget);
+        follower2.memory_budget(budget);
+        StreamFollower* followers[] = { &follower1, &follower2 };
+        for (uint16_t i = 0; i < 2; ++i) {
+            followers[i]->new_stream_callback(bind(&FlowTest::on_new_stream, this, _1));
+            vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", 22 + i,
+                                                             "4.3.2.1", 25);
+            vector<EthernetII> data = chunks_to_packets(40, chunks, payload);
+            set_endpoints(data, "1.2.3.4", 22 + i, "4.3.2.1", 25);
+            packets.push_back(data[0]);
+            for (size_t j = 0; j < packets.size(); ++j) {
+                followers[i]->process_packet(packets[j]);
+            }
+        }
+        EXPECT_EQ(100U, follower1.buffered_bytes());
+        EXPECT_EQ(100U, follower2.buffered_bytes());
+        EXPECT_EQ(200U, budget->usage());
+    }
+    // The followers release what they were using when destroyed
+    EXPECT_EQ(0U, budget->usage());
+}
+
+TEST_F(FlowTest, StreamFollower_ImbalancedMemoryBudget) {
+    using std::placeholders::_1;
+
+    shared_ptr<MemoryBudget> budget = make_shared<MemoryBudget>(10000);
+    StreamFollower small_follower;
+    StreamFollower large_follower;
+    vector<uint16_t> small_terminated;
+    vector<uint16_t> large_terminated;
+    StreamFollower* followers[] = { &small_follower, &large_follower };
+    vector<uint16_t>* terminated[] = { &small_terminated, &large_terminated };
+    for (size_t i = 0; i < 2; ++i) {
+        vector<uint16_t>& ports = *terminated[i];
+        followers[i]->memory_budget(budget);
+        followers[i]->new_stream_callback(bind(&FlowTest::on_new_stream, this, _1));
+        followers[i]->stream_termination_callback([&](Stream& stream,
+                                                      StreamFollower::TerminationReason reason) {
+            EXPECT_EQ(StreamFollower::MEMORY_PRESSURE, reason);
+            ports.push_back(stream.client_port());
+        });
+    }
+    // Each stream buffers size bytes
+    auto add_stream = [&](StreamFollower& follower, uint16_t port, uint32_t size) {
+        ordering_info_type chunks;
+        chunks.push_back(order_element(0, size));
+        vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", port,
+                                                         "4.3.2.1", 25);
+        vector<EthernetII> data = chunks_to_packets(40, chunks, payload);
+        set_endpoints(data, "1.2.3.4", port, "4.3.2.1", 25);
+        packets.push_back(data[0]);
+        for (size_t i = 0; i < packets.size(); ++i) {
+            follower.process_packet(packets[i]);
+        }
+    };
+    for (uint16_t port = 22; port < 25; ++port) {
+        add_stream(small_follower, port, 100);
+    }
+    for (uint16_t port = 100; port < 110; ++port) {
+        add_stream(large_follower, port, 100);
+    }
+    EXPECT_EQ(1300U, budget->usage());
+    budget->limit(1300);
+
+    // The small follower crosses the limit, but it only frees its share of
+    // the excess, 400 * 700 / 1700 bytes, rather than all of its streams
+    add_stream(small_follower, 25, 400);
+    ASSERT_EQ(2U, small_terminated.size());
+    EXPECT_EQ(22, small_terminated[0]);
+    EXPECT_EQ(23, small_terminated[1]);
+    EXPECT_TRUE(large_terminated.empty());
+    EXPECT_EQ(500U, small_follower.buffered_bytes());
+    EXPECT_EQ(1500U, budget->usage());
+
+    // The large follower frees the rest as soon as it processes packets
+    add_stream(large_follower, 110, 100);
+    ASSERT_EQ(3U, large_terminated.size());
+    EXPECT_EQ(100, large_terminated[0]);
+    EXPECT_EQ(102, large_terminated[2]);
+    EXPECT_EQ(2U, small_terminated.size());
+    EXPECT_EQ(800U, large_follower.buffered_bytes());
+    EXPECT_EQ(1300U, budget->usage());
+    EXPECT_FALSE(budget->exceeded());
+}
+
+TEST_F(FlowTest, StreamFollower_UsesProcessMemoryBudget) {
+    StreamFollower follower;
+    EXPECT_EQ(MemoryBudget::process_budget(), follower.memory_budget());
+    ParallelStreamFollower parallel_follower(2);
+    EXPECT_EQ(MemoryBudget::process_budget(), parallel_follower.memory_budget());
+    follower.memory_budget(100);
+    EXPECT_NE(MemoryBudget::process_budget(), follower.memory_budget());
+}
+
+TEST_F(FlowTest, StreamFollower_CopyKeepsMemoryBudget) {
+    using std::placeholders::_1;
+
+    shared_ptr<MemoryBudget> budget = make_shared<MemoryBudget>(1000);
+    ordering_info_type chunks;
+    chunks.push_back(order_element(0, 100));
+    StreamFollower follower;
+    follower.memory_budget(budget);
+    follower.new_stream_callback(bind(&FlowTest::on_new_stream, this, _1));
+    vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    vector<EthernetII> data = chunks_to_packets(40, chunks, payload);
+    set_endpoints(data, "1.2.3.4", 22, "4.3.2.1", 25);
+    packets.push_back(data[0]);
+    for (size_t i = 0; i < packets.size(); ++i) {
+        follower.process_packet(packets[i]);
+    }
+    {
+        StreamFollower copy(follower);
+        EXPECT_EQ(budget, copy.memory_budget());
+        EXPECT_EQ(100U, copy.buffered_bytes());
+        EXPECT_EQ(200U, budget->usage());
+        Stream& stream = copy.find_stream(IPv4Address("1.2.3.4"), 22,
+                                          IPv4Address("4.3.2.1"), 25);
+        EXPECT_NE(&stream, &follower.find_stream(IPv4Address("1.2.3.4"), 22,
+                                                 IPv4Address("4.3.2.1"), 25));
+
+        StreamFollower other;
+        other = copy;
+        EXPECT_EQ(budget, other.memory_budget());
+        EXPECT_EQ(300U, budget->usage());
+        other = StreamFollower();
+        EXPECT_EQ(0U, other.buffered_bytes());
+        EXPECT_EQ(200U, budget->usage());
+    }
+    EXPECT_EQ(100U, budget->usage());
+}
+
+TEST_F(FlowTest, ParallelStreamFollower_FollowStreams) {
+    const uint16_t stream_count = 8;
+    mutex data_mutex;
+    map<uint16_t, string> client_data;
+    map<uint16_t, set<thread::id> > threads;
+    ParallelStreamFollower follower(4);
+    EXPECT_EQ(4UL, follower.size());
+    follower.new_stream_callback([&](Stream& stream) {
+        stream.client_data_callback([&](Stream& stream) {
+            lock_guard<mutex> _(data_mutex);
+            const Stream::payload_type& payload = stream.client_payload();
+            client_data[stream.client_port()].append(payload.begin(), payload.end());
+            threads[stream.client_port()].insert(this_thread::get_id());
+        });
+    });
+    vector<EthernetII> packets;
+    for (uint16_t i = 0; i < stream_count; ++i) {
+        vector<EthernetII> handshake = three_way_handshake(29, 60, "1.2.3.4", 1000 + i,
+                                                           "4.3.2.1", 25);
+        packets.insert(packets.end(), handshake.begin(), handshake.end());
+    }
+    // Interleave every stream's data
+    vector<vector<EthernetII> > data_packets;
+    for (uint16_t i = 0; i < stream_count; ++i) {
+        data_packets.push_back(chunks_to_packets(30, split_payload(payload, 50), payload));
+        set_endpoints(data_packets.back(), "1.2.3.4", 1000 + i, "4.3.2.1", 25);
+    }
+    for (size_t i = 0; i < data_packets[0].size(); ++i) {
+        for (uint16_t j = 0; j < stream_count; ++j) {
+            packets.push_back(data_packets[j][i]);
+        }
+    }
+    for (size_t i = 0; i < packets.size(); ++i) {
+        follower.process_packet(packets[i]);
+    }
+    follower.stop();
+    // Data is cleared after every callback
+    EXPECT_EQ(0U, follower.buffered_bytes());
+
+    ASSERT_EQ(stream_count, client_data.size());
+    for (uint16_t i = 0; i < stream_count; ++i) {
+        EXPECT_EQ(payload, client_data[1000 + i]);
+        // A stream is always handled by the same shard
+        EXPECT_EQ(1UL, threads[1000 + i].size());
+        EXPECT_EQ(follower.shard_index(packets[i * 3]),
+                  follower.shard_index(packets[i * 3 + 1]));
+    }
+}
+
+TEST_F(FlowTest, ParallelStreamFollower_BorrowedPayloads) {
+    mutex data_mutex;
+    string client_data;
+    ParallelStreamFollower follower(2);
+    follower.new_stream_callback([&](Stream& stream) {
+        stream.client_data_callback([&](Stream& stream) {
+            lock_guard<mutex> _(data_mutex);
+            const Stream::payload_type& payload = stream.client_payload();
+            client_data.append(payload.begin(), payload.end());
+        });
+    });
+    vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    vector<EthernetII> data = chunks_to_packets(30, split_payload(payload, 50), payload);
+    set_endpoints(data, "1.2.3.4", 22, "4.3.2.1", 25);
+    packets.insert(packets.end(), data.begin(), data.end());
+    // Every packet is read into the same buffer, just like a capture does
+    PDU::serialization_type buffer(2048);
+    for (size_t i = 0; i < packets.size(); ++i) {
+        const PDU::serialization_type serialized = packets[i].serialize();
+        copy(serialized.begin(), serialized.end(), buffer.begin());
+        PDU* pdu = 0;
+        {
+            RawPDU::zero_copy_scope zero_copy;
+            pdu = new EthernetII(&buffer[0], serialized.size());
+        }
+        follower.process_packet(Packet(pdu, Timestamp(), Packet::own_pdu()));
+        fill(buffer.begin(), buffer.end(), 0);
+    }
+    follower.stop();
+    EXPECT_EQ(payload, client_data);
+}
+
+TEST_F(FlowTest, ParallelStreamFollower_CallbackNotSet) {
+    vector<EthernetII> packets = three_way_handshake(29, 60, "1.2.3.4", 22, "4.3.2.1", 25);
+    ParallelStreamFollower follower(2);
+    EXPECT_THROW(follower.process_packet(packets[0]), callback_not_set);
+}
+
+TEST_F(FlowTest, StreamIdentifierHash) {
+    StreamIdentifier identifier1(StreamIdentifier::serialize(IPv4Address("1.2.3.4")), 22,
+                                 StreamIdentifier::serialize(IPv4Address("4.3.2.1")), 25);
+    StreamIdentifier identifier2(StreamIdentifier::serialize(IPv4Address("4.3.2.1")), 25,
+                                 StreamIdentifier::serialize(IPv4Address("1.2.3.4")), 22);
+    StreamIdentifier identifier3(StreamIdentifier::serialize(IPv4Address("1.2.3.4")), 23,
+                                 StreamIdentifier::serialize(IPv4Address("4.3.2.1")), 25);
+    EXPECT_EQ(identifier1.hash(), identifier2.hash());
+    EXPECT_EQ(std::hash<StreamIdentifier>()(identifier1), identifier1.hash());
+    EXPECT_NE(identifier1.hash(), identifier3.hash());
+}
+
 TEST_F(FlowTest, StreamFollower_RSTClosesStream) {
     using std::placeholders::_1;
 
@@ -561,6 +1010,34 @@ TEST_F(FlowTest, StreamFollower_AttachToStreams_PacketsInBothDirections) {
     EXPECT_EQ(payload, merge_chunks(stream_server_payload_chunks));
 }
 
+TEST_F(FlowTest, StreamFollower_DataSpanCallback) {
+    ordering_info_type chunks = split_payload(payload, 5);
+    swap(chunks[2], chunks[4]);
+    vector<EthernetII> packets = chunks_to_packets(30 /*initial_seq*/, chunks, payload);
+    set_endpoints(packets, "1.2.3.4", 22, "4.3.2.1", 25);
+
+    string client_payload;
+    bool data_callback_executed = false;
+    StreamFollower follower;
+    follower.follow_partial_streams(true);
+    follower.new_stream_callback([&](Stream& stream) {
+        stream.client_data_callback([&](Stream&) {
+            data_callback_executed = true;
+        });
+        stream.client_data_span_callback([&](Stream& stream, const uint8_t* data,
+                                             size_t size, uint64_t offset) {
+            EXPECT_EQ(client_payload.size(), offset);
+            EXPECT_TRUE(stream.client_payload().empty());
+            client_payload.append(data, data + size);
+        });
+    });
+    for (size_t i = 0; i < packets.size(); ++i) {
+        follower.process_packet(packets[i]);
+    }
+    EXPECT_EQ(payload, client_payload);
+    EXPECT_FALSE(data_callback_executed);
+}
+
 TEST_F(FlowTest, StreamFollower_AttachToStreams_SecondPacketLost) {
     using std::placeholders::_1;
 
@@ -617,6 +1094,84 @@ TEST_F(FlowTest, StreamFollower_AttachToStreams_RecoveryMode) {
     EXPECT_EQ(trimmed_payload, merge_chunks(stream_client_payload_chunks));
 }
 
+TEST(DataTrackerTest, InOrderSegmentIsNotCopied) {
+    DataTracker tracker(100);
+    DataTracker::payload_type payload(50, 'a');
+    const uint8_t* data = payload.data();
+    EXPECT_TRUE(tracker.process_payload(100, move(payload)));
+    EXPECT_EQ(data, tracker.payload().data());
+    EXPECT_EQ(150U, tracker.sequence_number());
+
+    // There's pending data now, so this one is appended
+    EXPECT_TRUE(tracker.process_payload(150, DataTracker::payload_type(10, 'b')));
+    EXPECT_EQ(60UL, tracker.payload().size());
+    EXPECT_EQ(160U, tracker.sequence_number());
+}
+
+TEST(DataTrackerTest, OverlappingBufferedSegments) {
+    const string data = "0123456789abcdefghij";
+    DataTracker tracker(1000);
+    // [1005, 1012), [1010, 1020) and [1003, 1008) are all out of order
+    EXPECT_FALSE(tracker.process_payload(1005, DataTracker::payload_type(data.begin() + 5,
+                                                                         data.begin() + 12)));
+    EXPECT_FALSE(tracker.process_payload(1010, DataTracker::payload_type(data.begin() + 10,
+                                                                         data.end())));
+    EXPECT_FALSE(tracker.process_payload(1003, DataTracker::payload_type(data.begin() + 3,
+                                                                         data.begin() + 8)));
+    EXPECT_EQ(22U, tracker.total_buffered_bytes());
+    // This one overlaps with the first buffered segment
+    const uint8_t* raw_data = reinterpret_cast<const uint8_t*>(data.data());
+    EXPECT_TRUE(tracker.process_payload(1000, raw_data, 4));
+    EXPECT_EQ(data, string(tracker.payload().begin(), tracker.payload().end()));
+    EXPECT_EQ(1020U, tracker.sequence_number());
+    EXPECT_EQ(0U, tracker.total_buffered_bytes());
+    EXPECT_TRUE(tracker.buffered_payload().empty());
+}
+
+TEST(DataTrackerTest, SequenceNumberWrapAround) {
+    DataTracker tracker(0xfffffffe);
+    EXPECT_FALSE(tracker.process_payload(2, DataTracker::payload_type(2, 'b')));
+    EXPECT_TRUE(tracker.process_payload(0xfffffffe, DataTracker::payload_type(4, 'a')));
+    EXPECT_EQ("aaaabb", string(tracker.payload().begin(), tracker.payload().end()));
+    EXPECT_EQ(4U, tracker.sequence_number());
+}
+
+TEST(DataTrackerTest, DataSpanCallback) {
+    const string data = "0123456789";
+    const uint8_t* raw_data = reinterpret_cast<const uint8_t*>(data.data());
+    vector<pair<string, uint64_t> > spans;
+    const uint8_t* first_span = 0;
+    const DataTracker::data_span_callback_type callback = 
+        [&](const uint8_t* span, size_t size, uint64_t offset) {
+            if (spans.empty()) {
+                first_span = span;
+            }
+            spans.push_back(make_pair(string(span, span + size), offset));
+        };
+    DataTracker tracker(100);
+    EXPECT_TRUE(tracker.process_payload(100, raw_data, 4, callback));
+    // In order data is handed over straight from the given buffer
+    EXPECT_EQ(raw_data, first_span);
+    EXPECT_FALSE(tracker.process_payload(106, raw_data + 6, 4, callback));
+    EXPECT_EQ(4U, tracker.total_buffered_bytes());
+    // This one overlaps with what was already seen and fills the gap
+    EXPECT_TRUE(tracker.process_payload(103, DataTracker::payload_type(data.begin() + 3,
+                                                                       data.begin() + 6),
+                                        callback));
+    ASSERT_EQ(3UL, spans.size());
+    EXPECT_EQ(make_pair(string("0123"), uint64_t(0)), spans[0]);
+    EXPECT_EQ(make_pair(string("45"), uint64_t(4)), spans[1]);
+    EXPECT_EQ(make_pair(string("6789"), uint64_t(6)), spans[2]);
+    EXPECT_TRUE(tracker.payload().empty());
+    EXPECT_EQ(0U, tracker.total_buffered_bytes());
+    EXPECT_EQ(110U, tracker.sequence_number());
+    EXPECT_EQ(10U, tracker.stream_offset());
+
+    // Skipped data still counts towards the stream offset
+    tracker.advance_sequence(120);
+    EXPECT_EQ(20U, tracker.stream_offset());
+}
+
 #ifdef TINS_HAVE_ACK_TRACKER
 
 using namespace boost;
@@ -300,3 +300,14 @@ TEST_F(TCPTest, RemoveOption) {
     PDU::serialization_type new_buffer = tcp.serialize();
     EXPECT_EQ(old_buffer, new_buffer);
 }
+
+TEST_F(TCPTest, TryExtractMetadata) {
+    PDU::metadata metadata;
+    EXPECT_TRUE(TCP::try_extract_metadata(expected_packet, sizeof(expected_packet),
+                                          metadata));
+    EXPECT_EQ(PDU::TCP, metadata.current_pdu_type);
+    EXPECT_EQ(52U, metadata.header_size);
+    EXPECT_FALSE(TCP::try_extract_metadata(expected_packet, 10, metadata));
+    // The data offset points past the end of the buffer
+    EXPECT_FALSE(TCP::try_extract_metadata(expected_packet, 24, metadata));
+}
@@ -0,0 +1,195 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <tins/timestamp_index.h>
+#include <tins/pcap_file_reader.h>
+#include <tins/packet.h>
+#ifdef TINS_HAVE_PCAP
+    #include <tins/packet_writer.h>
+#endif // TINS_HAVE_PCAP
+#include <tins/ethernetII.h>
+#include <tins/ip.h>
+#include <tins/tcp.h>
+#include <tins/exceptions.h>
+#include "tests/pcap_file.h"
+
+using namespace std;
+using namespace Tins;
+
+class TimestampIndexTest : public testing::Test {
+public:
+    static const char* capture_file_name;
+    static const char* index_file_name;
+
+    void TearDown() {
+        remove(capture_file_name);
+        remove(index_file_name);
+    }
+
+    static Timestamp make_timestamp(uint32_t seconds, uint32_t microseconds = 0) {
+        timeval tv;
+        tv.tv_sec = seconds;
+        tv.tv_usec = microseconds;
+        return Timestamp(tv);
+    }
+
+    // Writes a record per timestamp. Each record's TCP destination port is 
+    // its position in the file
+    static vector<uint64_t> write_capture(const vector<uint32_t>& timestamps) {
+        PcapFileBuilder builder;
+        vector<uint64_t> offsets;
+        for (size_t i = 0; i < timestamps.size(); ++i) {
+            EthernetII eth = EthernetII() / IP() / TCP(i, 1234);
+            offsets.push_back(builder.add_record(eth, timestamps[i]));
+        }
+        builder.write(capture_file_name);
+        return offsets;
+    }
+
+    static vector<uint64_t> write_sequential_capture(size_t count) {
+        vector<uint32_t> timestamps;
+        for (size_t i = 0; i < count; ++i) {
+            timestamps.push_back(1500000000 + i);
+        }
+        return write_capture(timestamps);
+    }
+
+    static uint16_t next_port(PcapFileReader& reader) {
+        Packet packet = reader.next_packet();
+        return packet.pdu() ? packet.pdu()->rfind_pdu<TCP>().dport() : 0xffff;
+    }
+};
+
+const char* TimestampIndexTest::capture_file_name = "timestamp_index_test.pcap";
+const char* TimestampIndexTest::index_file_name = "timestamp_index_test.pcap.idx";
+
+TEST_F(TimestampIndexTest, Build) {
+    vector<uint64_t> offsets = write_sequential_capture(100);
+    TimestampIndex::build(capture_file_name, index_file_name, 8);
+    TimestampIndex index(index_file_name);
+    EXPECT_EQ(13U, index.size());
+    EXPECT_EQ(8U, index.interval());
+    EXPECT_EQ(offsets[0], index.find(make_timestamp(1400000000)));
+    EXPECT_EQ(offsets[0], index.find(make_timestamp(1500000008)));
+    EXPECT_EQ(offsets[8], index.find(make_timestamp(1500000009)));
+    EXPECT_EQ(offsets[48], index.find(make_timestamp(1500000050)));
+    EXPECT_EQ(offsets[96], index.find(make_timestamp(1600000000)));
+}
+
+TEST_F(TimestampIndexTest, SeekByTimestamp) {
+    write_sequential_capture(100);
+    TimestampIndex::build(capture_file_name, index_file_name, 8);
+    TimestampIndex index(index_file_name);
+    PcapFileReader reader(capture_file_name);
+    reader.seek(make_timestamp(1500000050), index);
+    EXPECT_EQ(50, next_port(reader));
+    reader.seek(make_timestamp(1500000050, 1), index);
+    EXPECT_EQ(51, next_port(reader));
+    reader.seek(make_timestamp(1400000000), index);
+    EXPECT_EQ(0, next_port(reader));
+    reader.seek(make_timestamp(1500000099), index);
+    EXPECT_EQ(99, next_port(reader));
+    reader.seek(make_timestamp(1600000000), index);
+    EXPECT_EQ(0xffff, next_port(reader));
+}
+
+TEST_F(TimestampIndexTest, UnorderedRecords) {
+    vector<uint32_t> timestamps;
+    timestamps.push_back(10);
+    timestamps.push_back(11);
+    timestamps.push_back(13);
+    timestamps.push_back(12);
+    timestamps.push_back(14);
+    write_capture(timestamps);
+    TimestampIndex::build(capture_file_name, index_file_name, 1);
+    TimestampIndex index(index_file_name);
+    PcapFileReader reader(capture_file_name);
+    // Every record before the one found has a lower timestamp
+    reader.seek(make_timestamp(12), index);
+    EXPECT_EQ(2, next_port(reader));
+    reader.seek(make_timestamp(14), index);
+    EXPECT_EQ(4, next_port(reader));
+}
+
+TEST_F(TimestampIndexTest, SniffTimeRange) {
+    write_sequential_capture(100);
+    TimestampIndex::build(capture_file_name, index_file_name, 16);
+    TimestampIndex index(index_file_name);
+    PcapFileReader reader(capture_file_name);
+    vector<uint16_t> ports;
+    reader.sniff_time_range([&](PDU& pdu) {
+        ports.push_back(pdu.rfind_pdu<TCP>().dport());
+        return true;
+    }, make_timestamp(1500000020), make_timestamp(1500000030), index);
+    ASSERT_EQ(10UL, ports.size());
+    EXPECT_EQ(20, ports.front());
+    EXPECT_EQ(29, ports.back());
+}
+
+TEST_F(TimestampIndexTest, IncrementalWriter) {
+    vector<uint64_t> offsets = write_sequential_capture(10);
+    TimestampIndexWriter writer(index_file_name, 2);
+    for (size_t i = 0; i < 6; ++i) {
+        writer.add_record(make_timestamp(1500000000 + i), offsets[i]);
+    }
+    writer.flush();
+    {
+        TimestampIndex index(index_file_name);
+        EXPECT_EQ(3U, index.size());
+        EXPECT_EQ(offsets[4], index.find(make_timestamp(1500000009)));
+    }
+    for (size_t i = 6; i < 10; ++i) {
+        writer.add_record(make_timestamp(1500000000 + i), offsets[i]);
+    }
+    writer.flush();
+    TimestampIndex index(index_file_name);
+    EXPECT_EQ(5U, index.size());
+    PcapFileReader reader(capture_file_name);
+    reader.seek(make_timestamp(1500000007), index);
+    EXPECT_EQ(7, next_port(reader));
+}
+
+#if defined(TINS_HAVE_PCAP) && TINS_IS_CXX11
+TEST_F(TimestampIndexTest, PacketWriterMoveAssignmentClosesIndex) {
+    const char* other_file_name = "timestamp_index_test_other.pcap";
+    {
+        PacketWriter writer(capture_file_name, DataLinkType<EthernetII>());
+        writer.set_timestamp_index(index_file_name, 1);
+        for (uint16_t i = 0; i < 4; ++i) {
+            EthernetII eth = EthernetII() / IP() / TCP(i, 1234);
+            Packet packet(eth, make_timestamp(1500000000 + i));
+            writer.write(packet);
+        }
+        writer = PacketWriter(other_file_name, DataLinkType<EthernetII>());
+        // The previous file and its index are complete at this point
+        TimestampIndex index(index_file_name);
+        EXPECT_EQ(4U, index.size());
+        PcapFileReader reader(capture_file_name);
+        reader.seek(make_timestamp(1500000002), index);
+        EXPECT_EQ(2, next_port(reader));
+    }
+    remove(other_file_name);
+}
+#endif // TINS_HAVE_PCAP && TINS_IS_CXX11
+
+TEST_F(TimestampIndexTest, EmptyIndex) {
+    write_sequential_capture(10);
+    {
+        TimestampIndexWriter writer(index_file_name);
+    }
+    TimestampIndex index(index_file_name);
+    EXPECT_EQ(0U, index.size());
+    EXPECT_EQ(0U, index.find(make_timestamp(1500000005)));
+    PcapFileReader reader(capture_file_name);
+    reader.seek(make_timestamp(1500000005), index);
+    EXPECT_EQ(5, next_port(reader));
+}
+
+TEST_F(TimestampIndexTest, InvalidFiles) {
+    EXPECT_THROW(TimestampIndex("/ishallnotexist.idx"), file_open_error);
+    EXPECT_THROW(TimestampIndexWriter("/ishallnotexist/file.idx"), file_open_error);
+    write_sequential_capture(1);
+    // A capture file is not an index
+    EXPECT_THROW(TimestampIndex index(capture_file_name), invalid_file_format);
+}